@@ -265,10 +265,13 @@ int ss_pcap_match(ss_pcap_entry_t* pcap_entry, ss_pcap_match_t* pcap_match) {
 int ss_dns_chain_destroy() {
     ss_dns_entry_t* dptr;
     ss_dns_entry_t* dtmp;
+    HASH_CLEAR(hh, ss_conf->dns_chain.ip_table);
     TAILQ_FOREACH_SAFE(dptr, &ss_conf->dns_chain.dns_list, entry, dtmp) {
         ss_dns_entry_destroy(dptr);
         TAILQ_REMOVE(&ss_conf->dns_chain.dns_list, dptr, entry);
     }
+    ss_dns_trie_destroy(ss_conf->dns_chain.dns_trie);
+    ss_conf->dns_chain.dns_trie = NULL;
     return 0;
 }
 
@@ -298,12 +301,23 @@ ss_dns_entry_t* ss_dns_entry_create(json_object* dns_json) {
         goto error_out;
     }
     
-    char* dns = ss_json_string_get(dns_json, "dns");
+    const char* dns = ss_json_string_view(dns_json, "dns");
     if (dns == NULL) {
         memset(&dns_entry->dns, 0, sizeof(dns_entry->dns));
     }
     else {
-        strlcpy(dns_entry->dns, dns, sizeof(dns_entry->dns));
+        // "*.example.com." matches names below example.com. only
+        const char* match = ss_json_string_view(dns_json, "match");
+        dns_entry->match = match ? ss_dns_match_load(match) : SS_DNS_MATCH_SUFFIX;
+        if ((int) dns_entry->match == -1) {
+            fprintf(stderr, "dns_entry match is invalid\n");
+            goto error_out;
+        }
+        dns_entry->match = ss_dns_name_match_get(&dns, dns_entry->match);
+        if (!ss_dns_name_canonicalize(dns_entry->dns, dns, sizeof(dns_entry->dns))) {
+            fprintf(stderr, "dns_entry dns is invalid\n");
+            goto error_out;
+        }
     }
     
     const char* ip_str = ss_json_string_get(dns_json, "ip");
@@ -338,7 +352,61 @@ int ss_dns_entry_destroy(ss_dns_entry_t* dns_entry) {
     return 0;
 }
 
+/*
+ * Address rules are hashed on the whole ip_addr_t, the same bytes the
+ * answers are compared with, so one lookup per answer finds every rule.
+ */
+static void ss_dns_chain_ip_add(ss_dns_entry_t* dns_entry) {
+    ss_dns_entry_t* head = NULL;
+    ss_dns_entry_t** dpptr;
+    
+    HASH_FIND(hh, ss_conf->dns_chain.ip_table, &dns_entry->ip, sizeof(ip_addr_t), head);
+    if (head == NULL) {
+        dns_entry->ip_next = NULL;
+        HASH_ADD(hh, ss_conf->dns_chain.ip_table, ip, sizeof(ip_addr_t), dns_entry);
+        return;
+    }
+    // keep the rules for one address in config order
+    for (dpptr = &head->ip_next; *dpptr; dpptr = &(*dpptr)->ip_next);
+    dns_entry->ip_next = NULL;
+    *dpptr = dns_entry;
+}
+
+static void ss_dns_chain_ip_remove(ss_dns_entry_t* dns_entry) {
+    ss_dns_entry_t* head = NULL;
+    ss_dns_entry_t** dpptr;
+    
+    HASH_FIND(hh, ss_conf->dns_chain.ip_table, &dns_entry->ip, sizeof(ip_addr_t), head);
+    if (head == NULL) return;
+    if (head == dns_entry) {
+        HASH_DEL(ss_conf->dns_chain.ip_table, head);
+        if (head->ip_next) {
+            HASH_ADD(hh, ss_conf->dns_chain.ip_table, ip, sizeof(ip_addr_t), head->ip_next);
+        }
+        head->ip_next = NULL;
+        return;
+    }
+    for (dpptr = &head->ip_next; *dpptr; dpptr = &(*dpptr)->ip_next) {
+        if (*dpptr == dns_entry) {
+            *dpptr = dns_entry->ip_next;
+            dns_entry->ip_next = NULL;
+            return;
+        }
+    }
+}
+
+ss_dns_entry_t* ss_dns_chain_ip_lookup(ip_addr_t* ip) {
+    ss_dns_entry_t* dptr = NULL;
+    HASH_FIND(hh, ss_conf->dns_chain.ip_table, ip, sizeof(ip_addr_t), dptr);
+    return dptr;
+}
+
 int ss_dns_chain_add(ss_dns_entry_t* dns_entry) {
+    if (dns_entry->dns[0]) {
+        int rv = ss_dns_trie_add(ss_conf->dns_chain.dns_trie, dns_entry->dns, dns_entry->match, dns_entry, 0);
+        if (rv) return -1;
+    }
+    if (dns_entry->ip.family) ss_dns_chain_ip_add(dns_entry);
     TAILQ_INSERT_TAIL(&ss_conf->dns_chain.dns_list, dns_entry, entry);
     return 0;
 }
@@ -349,6 +417,8 @@ int ss_dns_chain_remove_index(int index) {
     ss_dns_entry_t* dtmp;
     TAILQ_FOREACH_SAFE(dptr, &ss_conf->dns_chain.dns_list, entry, dtmp) {
         if (counter == index) {
+            if (dptr->dns[0]) ss_dns_trie_remove(ss_conf->dns_chain.dns_trie, dptr->dns, dptr->match, dptr);
+            if (dptr->ip.family) ss_dns_chain_ip_remove(dptr);
             TAILQ_REMOVE(&ss_conf->dns_chain.dns_list, dptr, entry);
             return 0;
         }
@@ -362,6 +432,8 @@ int ss_dns_chain_remove_name(char* name) {
     ss_dns_entry_t* dtmp;
     TAILQ_FOREACH_SAFE(dptr, &ss_conf->dns_chain.dns_list, entry, dtmp) {
         if (!strcasecmp(name, dptr->name)) {
+            if (dptr->dns[0]) ss_dns_trie_remove(ss_conf->dns_chain.dns_trie, dptr->dns, dptr->match, dptr);
+            if (dptr->ip.family) ss_dns_chain_ip_remove(dptr);
             TAILQ_REMOVE(&ss_conf->dns_chain.dns_list, dptr, entry);
             return 0;
         }
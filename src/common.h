@@ -26,8 +26,10 @@
 
 #include <uthash.h>
 
+#include "dns_trie.h"
 #include "ip_utils.h"
 #include "nn_queue.h"
+#include "timer_wheel.h"
 
 /* MACROS */
 
@@ -74,6 +76,7 @@
 #define IPPROTO_ICMPV4 IPPROTO_ICMP
 
 #define L4_PORT_DNS               53
+#define L4_PORT_HTTP              80
 #define L4_PORT_SYSLOG           514
 #define L4_PORT_SYSLOG_TCP       601
 #define L4_PORT_SFLOW           6343
@@ -81,15 +84,13 @@
 #define L4_PORT_NETFLOW_2       9995
 #define L4_PORT_NETFLOW_3       9996
 
-#define L4_TCP_HASH_SIZE            2048
 #define L4_TCP_BUCKET_SIZE             4
 #define L4_TCP_WINDOW_SHIFT           10 // 1 << 10 == 1024; i.e. 1KB scale multiplier
 #define L4_TCP_WINDOW_SIZE          8192 // 8192KB; allows 20 msec of data at 10 gbps
 #define L4_TCP_HEADER_OFFSET           5
 #define L4_TCP_MSS                  1460
-#define L4_TCP_BUFFER_SIZE          4096
-//#define L4_TCP_BUFFER_SIZE ((L4_TCP_WINDOW_SIZE << L4_TCP_WINDOW_SHIFT) * 2)
-#define L4_TCP_EXPIRED_SECONDS       600
+#define L4_TCP_OOO_SEGMENTS            8 // segments held per socket while waiting out a gap
+#define L4_TCP_SYSLOG_DIGITS_MAX       6 // longest RFC 6587 MSG-LEN accepted
 
 #define L4_TCP4 4
 #define L4_TCP6 6
@@ -175,6 +176,7 @@ typedef enum ss_answer_type_e ss_answer_type_t;
 
 struct ss_answer_s {
     ss_answer_type_t type;
+    uint32_t ttl;
     uint8_t payload[SS_DNS_NAME_MAX];
 };
 
@@ -205,9 +207,12 @@ struct ss_metadata_s {
 typedef struct ss_metadata_s ss_metadata_t;
 
 struct ss_ioc_file_s {
-    uint64_t   file_id;
-    char*      path;
-    nn_queue_t nn_queue;
+    uint64_t       file_id;
+    char*          path;
+    char*          delta_path;
+    ss_dns_match_t dns_match;
+    uint32_t       ttl;
+    nn_queue_t     nn_queue;
 };
 
 typedef struct ss_ioc_file_s ss_ioc_file_t;
@@ -260,21 +265,87 @@ enum ss_tcp_state_e {
 
 typedef enum ss_tcp_state_e ss_tcp_state_t;
 
+// RFC 1035 4.2.2: each DNS message over TCP follows a two byte length
+struct ss_dns_framing_s {
+    uint16_t expected;
+    uint16_t seen;
+    uint8_t  prefix_length;
+    uint8_t  prefix[2];
+};
+
+typedef struct ss_dns_framing_s ss_dns_framing_t;
+
+// RFC 6587 3.4: syslog over TCP is octet counted, "MSG-LEN SP SYSLOG-MSG",
+// or each message ends with LF or NUL; the first byte of the stream tells
+enum ss_syslog_framing_mode_e {
+    SS_SYSLOG_FRAMING_UNKNOWN     = 0,
+    SS_SYSLOG_FRAMING_OCTET_COUNT = 1,
+    SS_SYSLOG_FRAMING_DELIMITED   = 2,
+};
+
+typedef enum ss_syslog_framing_mode_e ss_syslog_framing_mode_t;
+
+struct ss_syslog_framing_s {
+    ss_syslog_framing_mode_t mode;
+    uint32_t expected;
+    uint32_t seen;
+    uint8_t  digits;
+    uint8_t  in_message;
+};
+
+typedef struct ss_syslog_framing_s ss_syslog_framing_t;
+
+/*
+ * The part of a message a TCP stream has delivered so far, in a chain of
+ * chunks from the pool in tcp_buffer.c. Empty buffers hold no memory.
+ */
+struct ss_tcp_buffer_s {
+    struct ss_tcp_chunk_s* head;
+    struct ss_tcp_chunk_s* tail;
+    uint16_t length;
+    uint16_t lcore_id; /* whose idle list it is on, while head is set */
+    uint8_t  budget;   /* ss_tcp_buffer_budget_t, the pool its chunks come from */
+    uint8_t  is_discarding; /* evicted mid message, so the rest of it is dropped */
+    void (*evict_cb)(struct ss_tcp_buffer_s* buffer); /* lets the owner drop its connection */
+    TAILQ_ENTRY(ss_tcp_buffer_s) entry;
+};
+
+typedef struct ss_tcp_buffer_s ss_tcp_buffer_t;
+
+/* a segment which arrived ahead of a gap, held by a reference to its mbuf */
+struct ss_tcp_segment_s {
+    rte_mbuf_t* mbuf;
+    uint8_t* data;
+    uint32_t seq;
+    uint16_t length;
+};
+
+typedef struct ss_tcp_segment_s ss_tcp_segment_t;
+
 // RFC 793, RFC 1122
 struct ss_tcp_socket_s {
     ss_flow_key_t  key;
     uint64_t id;
     
-    rte_spinlock_recursive_t lock;
     ss_tcp_state_t state;
 
     uint64_t rx_ticks;
     uint64_t tx_ticks;
+    ss_wheel_timer_t timer; /* rescheduled lazily, when it fires early */
     uint32_t last_seq;
     uint32_t last_ack_seq;
     
-    uint16_t rx_length;
-    uint8_t  rx_data[L4_TCP_BUFFER_SIZE];
+    uint32_t rx_seq;     /* the next stream byte expected from the peer */
+    uint8_t  has_rx_seq;
+    uint8_t  ooo_count;
+    ss_tcp_segment_t ooo_segments[L4_TCP_OOO_SEGMENTS]; /* by seq */
+    uint32_t ooo_queued;    /* segments which arrived ahead of a gap */
+    uint32_t retransmitted; /* segments with nothing new in them */
+    uint32_t dropped;       /* out of order segments with no room */
+    
+    ss_dns_framing_t dns_framing;
+    ss_syslog_framing_t syslog_framing;
+    ss_tcp_buffer_t rx_buffer;
 } __rte_cache_aligned;
 
 typedef struct ss_tcp_socket_s ss_tcp_socket_t;
@@ -316,10 +387,14 @@ typedef struct ss_pcap_chain_s ss_pcap_chain_t;
 struct ss_dns_entry_s {
     uint64_t matches;
     char dns[SS_DNS_NAME_MAX];
+    ss_dns_match_t match;
     ip_addr_t ip;
     nn_queue_t nn_queue;
     char* name;
     TAILQ_ENTRY(ss_dns_entry_s) entry;
+    /* rules for the same ip hang off the one in ip_table */
+    UT_hash_handle hh;
+    struct ss_dns_entry_s* ip_next;
 } __rte_cache_aligned;
 
 typedef struct ss_dns_entry_s ss_dns_entry_t;
@@ -330,6 +405,8 @@ typedef struct ss_dns_list_s ss_dns_list_t;
 struct ss_dns_chain_s {
     uint64_t matches;
     ss_dns_list_t dns_list;
+    ss_dns_trie_t* dns_trie;
+    ss_dns_entry_t* ip_table;
 } __rte_cache_aligned;
 
 typedef struct ss_dns_chain_s ss_dns_chain_t;
@@ -378,6 +455,7 @@ int ss_pcap_match(ss_pcap_entry_t* pcap_entry, ss_pcap_match_t* pcap_match);
 int ss_dns_chain_destroy(void);
 ss_dns_entry_t* ss_dns_entry_create(json_object* dns_json);
 int ss_dns_entry_destroy(ss_dns_entry_t* dns_entry);
+ss_dns_entry_t* ss_dns_chain_ip_lookup(ip_addr_t* ip);
 int ss_dns_chain_add(ss_dns_entry_t* dns_entry);
 int ss_dns_chain_remove_index(int index);
 int ss_dns_chain_remove_name(char* name);
@@ -0,0 +1,209 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dns_parse.h"
+
+#include "common.h"
+#include "ip_utils.h"
+
+/*
+ * Walks the DNS wire format in place. Only the question name and the
+ * A, AAAA, CNAME, NS, MX and PTR answers are decoded, straight into the
+ * frame metadata, so nothing is allocated and no other record is expanded.
+ */
+
+static inline uint16_t ss_dns_read16(const uint8_t* p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t ss_dns_read32(const uint8_t* p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+/*
+ * Reads the possibly compressed name at *offset, lowercased and with a
+ * trailing '.', and moves *offset past it. name can be NULL to skip it.
+ * Returns 0, 1 for a good name too long for name_size, -1 if malformed.
+ *
+ * Pointers must point before themselves, and the walk gives up past 255
+ * bytes of labels, so a compression loop always ends.
+ */
+static int ss_dns_name_read(const uint8_t* packet, size_t length, size_t* offset, char* name, size_t name_size) {
+    size_t position = *offset;
+    size_t wire     = 0;
+    size_t output   = 0;
+    int    jumped   = 0;
+    int    rv       = 0;
+    uint8_t label;
+
+    for (;;) {
+        if (position >= length) return -1;
+        label = packet[position];
+
+        if ((label & SS_DNS_POINTER) == SS_DNS_POINTER) {
+            if (position + 1 >= length) return -1;
+            size_t target = (size_t) ((label & ~SS_DNS_POINTER) << 8 | packet[position + 1]);
+            if (target >= position) return -1;
+            if (!jumped) *offset = position + 2;
+            jumped   = 1;
+            position = target;
+            continue;
+        }
+        /* 0x40 and 0x80 label types were never deployed */
+        if (label & SS_DNS_POINTER) return -1;
+
+        wire += (size_t) label + 1;
+        if (wire > SS_DNS_WIRE_NAME_MAX) return -1;
+
+        if (label == 0) {
+            if (!jumped) *offset = position + 1;
+            break;
+        }
+        if (position + 1 + label > length) return -1;
+
+        if (name && rv == 0) {
+            /* room for the label, its '.', and the NUL */
+            if (output + label + 2 > name_size) {
+                rv = 1;
+            }
+            else {
+                const uint8_t* src = &packet[position + 1];
+                for (uint8_t i = 0; i < label; ++i) {
+                    uint8_t c = src[i];
+                    name[output++] = (char) (c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+                }
+                name[output++] = '.';
+            }
+        }
+        position += (size_t) label + 1;
+    }
+
+    if (name && name_size) {
+        if (rv)               output = 0;
+        else if (output == 0) name[output++] = '.';
+        name[output] = '\0';
+    }
+    return rv;
+}
+
+static int ss_dns_answer_read(ss_answer_t* answer, uint16_t type, const uint8_t* packet, size_t offset, uint16_t rdlength) {
+    ip_addr_t* ip  = (ip_addr_t*) answer->payload;
+    char*      name = (char*) answer->payload;
+    size_t     end  = offset + rdlength;
+
+    /* dns rules memcmp the whole ip_addr_t, so the unused bytes must be 0 */
+    memset(answer, 0, sizeof(ss_answer_t));
+
+    switch (type) {
+        case SS_DNS_TYPE_A: {
+            if (rdlength != IPV4_ALEN) return -1;
+            ip->family = SS_AF_INET4;
+            ip->prefix = SS_V4_PREFIX_MAX;
+            memcpy(&ip->ip4_addr.addr, &packet[offset], IPV4_ALEN);
+            answer->type = SS_TYPE_IP;
+            return 0;
+        }
+        case SS_DNS_TYPE_AAAA: {
+            if (rdlength != IPV6_ALEN) return -1;
+            ip->family = SS_AF_INET6;
+            ip->prefix = SS_V6_PREFIX_MAX;
+            memcpy(ip->ip6_addr.addr, &packet[offset], IPV6_ALEN);
+            answer->type = SS_TYPE_IP;
+            return 0;
+        }
+        case SS_DNS_TYPE_MX: {
+            /* preference comes before the exchange */
+            if (rdlength < 2) return -1;
+            offset += 2;
+        }
+        /* fallthrough */
+        case SS_DNS_TYPE_NS:
+        case SS_DNS_TYPE_CNAME:
+        case SS_DNS_TYPE_PTR: {
+            if (ss_dns_name_read(packet, end, &offset, name, sizeof(answer->payload))) {
+                name[0] = '\0';
+                return -1;
+            }
+            answer->type = SS_TYPE_NAME;
+            return 0;
+        }
+        default: {
+            return -1;
+        }
+    }
+}
+
+/*
+ * Fills in dns->name, md->dns_name and up to SS_DNS_RESULT_MAX
+ * md->dns_answers. Returns 0, or -1 if the header or question is malformed.
+ */
+int ss_dns_parse(ss_dns_parse_t* dns, ss_metadata_t* md, const uint8_t* packet, size_t length) {
+    size_t offset = SS_DNS_HEADER_SIZE;
+    size_t name_length;
+    uint16_t type;
+    uint16_t rdlength;
+    uint32_t ttl;
+    int rv;
+
+    memset(dns, 0, sizeof(ss_dns_parse_t));
+    md->dns_name[0] = '\0';
+    if (length < SS_DNS_HEADER_SIZE) return -1;
+
+    dns->id      = ss_dns_read16(&packet[0]);
+    dns->flags   = ss_dns_read16(&packet[2]);
+    dns->qdcount = ss_dns_read16(&packet[4]);
+    dns->ancount = ss_dns_read16(&packet[6]);
+    if (dns->qdcount == 0) return -1;
+
+    /* any name within SS_DNS_WIRE_NAME_MAX fits dns->name */
+    rv = ss_dns_name_read(packet, length, &offset, dns->name, sizeof(dns->name));
+    if (rv) return -1;
+    name_length = strlen(dns->name);
+    if (name_length >= sizeof(md->dns_name)) {
+        name_length   = sizeof(md->dns_name) - 1;
+        dns->name_cut = 1;
+    }
+    memcpy(md->dns_name, dns->name, name_length);
+    md->dns_name[name_length] = '\0';
+    if (offset + 4 > length) return -1;
+    dns->qtype  = ss_dns_read16(&packet[offset]);
+    dns->qclass = ss_dns_read16(&packet[offset + 2]);
+    offset += 4;
+
+    /* nothing sends more than one question, but step over any others */
+    for (uint16_t i = 1; i < dns->qdcount; ++i) {
+        if (ss_dns_name_read(packet, length, &offset, NULL, 0) < 0) return -1;
+        offset += 4;
+        if (offset > length) return -1;
+    }
+
+    /*
+     * A message cut short, like the head of a long DNS over TCP response,
+     * still yields the answers before the cut.
+     */
+    for (uint16_t i = 0; i < dns->ancount && dns->answer_count < SS_DNS_RESULT_MAX; ++i) {
+        if (ss_dns_name_read(packet, length, &offset, NULL, 0) < 0) goto truncated;
+        if (offset + SS_DNS_RR_SIZE > length) goto truncated;
+        type     = ss_dns_read16(&packet[offset]);
+        ttl      = ss_dns_read32(&packet[offset + 4]);
+        rdlength = ss_dns_read16(&packet[offset + 8]);
+        offset  += SS_DNS_RR_SIZE;
+        if (offset + rdlength > length) goto truncated;
+
+        rv = ss_dns_answer_read(&md->dns_answers[dns->answer_count], type, packet, offset, rdlength);
+        if (rv == 0) md->dns_answers[dns->answer_count++].ttl = ttl;
+        offset += rdlength;
+    }
+    goto out;
+
+    truncated:
+    dns->truncated = 1;
+
+    out:
+    /* several messages can share one frame's metadata over TCP */
+    for (uint16_t i = dns->answer_count; i < SS_DNS_RESULT_MAX; ++i) {
+        md->dns_answers[i].type = SS_TYPE_EMPTY;
+    }
+    return 0;
+}
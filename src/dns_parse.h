@@ -0,0 +1,61 @@
+#ifndef __DNS_PARSE_H__
+#define __DNS_PARSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/* CONSTANTS */
+
+#define SS_DNS_HEADER_SIZE       12
+#define SS_DNS_RR_SIZE           10
+#define SS_DNS_TCP_PREFIX_SIZE    2
+#define SS_DNS_WIRE_NAME_MAX    255
+
+#define SS_DNS_FLAG_QR       0x8000
+#define SS_DNS_RCODE_MASK    0x000f
+#define SS_DNS_RCODE_SERVFAIL     2
+#define SS_DNS_RCODE_NXDOMAIN     3
+#define SS_DNS_POINTER         0xc0
+
+enum ss_dns_type_e {
+    SS_DNS_TYPE_A     =  1,
+    SS_DNS_TYPE_NS    =  2,
+    SS_DNS_TYPE_CNAME =  5,
+    SS_DNS_TYPE_PTR   = 12,
+    SS_DNS_TYPE_MX    = 15,
+    SS_DNS_TYPE_AAAA  = 28,
+};
+
+typedef enum ss_dns_type_e ss_dns_type_t;
+
+/* DATA TYPES */
+
+/*
+ * Header fields and the question of a parsed message. The answers, and the
+ * question name cut to SS_DNS_NAME_MAX for export, go straight into the
+ * frame's ss_metadata_t; name keeps it whole, for matching.
+ */
+struct ss_dns_parse_s {
+    char     name[SS_DNS_WIRE_NAME_MAX + 1];
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qdcount;
+    uint16_t ancount;
+    uint16_t qtype;
+    uint16_t qclass;
+    uint16_t answer_count; /* answers kept in dns_answers */
+    uint8_t  truncated;    /* answers ended early */
+    uint8_t  name_cut;     /* md->dns_name holds only the start of name */
+};
+
+typedef struct ss_dns_parse_s ss_dns_parse_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_dns_parse(ss_dns_parse_t* dns, ss_metadata_t* md, const uint8_t* packet, size_t length);
+
+/* END PROTOTYPES */
+
+#endif /* __DNS_PARSE_H__ */
@@ -0,0 +1,415 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include "dns_trie.h"
+
+/* UTILITIES */
+
+static inline uint8_t ss_dns_tolower(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t) (c | 0x20) : c;
+}
+
+/* FNV-1a over the lowercased label, so lookups never copy the name */
+static inline uint32_t ss_dns_label_hash(const char* label, uint8_t length) {
+    uint32_t hash = 2166136261U;
+    for (uint8_t i = 0; i < length; ++i) {
+        hash ^= ss_dns_tolower((uint8_t) label[i]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static inline uint32_t ss_dns_slot_hash(uint32_t parent, uint32_t label_hash) {
+    uint32_t hash = label_hash ^ (parent * 0x9E3779B1U);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static inline bool ss_dns_label_equal(const char* stored, const char* label, uint8_t length) {
+    for (uint8_t i = 0; i < length; ++i) {
+        if (stored[i] != (char) ss_dns_tolower((uint8_t) label[i])) return false;
+    }
+    return true;
+}
+
+/*
+ * Step one label to the left of *end. Returns the label length, or -1 if
+ * the label is empty or longer than permitted by RFC 1035.
+ */
+static inline int ss_dns_label_next(const char* name, size_t* end, const char** label) {
+    size_t start = *end;
+    while (start > 0 && name[start - 1] != '.') --start;
+    size_t length = *end - start;
+    if (length == 0 || length > SS_DNS_LABEL_MAX) return -1;
+    *label = name + start;
+    *end   = start ? start - 1 : 0;
+    return (int) length;
+}
+
+static inline size_t ss_dns_name_length(const char* name, size_t length) {
+    if (length == 0) length = strlen(name);
+    while (length > 0 && name[length - 1] == '.') --length;
+    return length;
+}
+
+ss_dns_match_t ss_dns_match_load(const char* dns_match) {
+    if (!strcasecmp(dns_match, "exact"))    return SS_DNS_MATCH_EXACT;
+    if (!strcasecmp(dns_match, "suffix"))   return SS_DNS_MATCH_SUFFIX;
+    if (!strcasecmp(dns_match, "wildcard")) return SS_DNS_MATCH_WILDCARD;
+    return (ss_dns_match_t) -1;
+}
+
+const char* ss_dns_match_dump(ss_dns_match_t dns_match) {
+    switch (dns_match) {
+        case SS_DNS_MATCH_EMPTY:    return "empty";
+        case SS_DNS_MATCH_EXACT:    return "exact";
+        case SS_DNS_MATCH_SUFFIX:   return "suffix";
+        case SS_DNS_MATCH_WILDCARD: return "wildcard";
+        default:                    return "unknown";
+    }
+}
+
+/*
+ * Convert a name to canonical form: lowercase with exactly one trailing '.'.
+ * Returns the canonical length, or 0 if the name is empty or will not fit.
+ */
+size_t ss_dns_name_canonicalize(char* dst, const char* src, size_t size) {
+    size_t length = ss_dns_name_length(src, 0);
+    if (length == 0 || length + 2 > size) {
+        if (size) dst[0] = '\0';
+        return 0;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        dst[i] = (char) ss_dns_tolower((uint8_t) src[i]);
+    }
+    dst[length]     = '.';
+    dst[length + 1] = '\0';
+    return length + 1;
+}
+
+/* strip a leading "*." and report it as a wildcard match */
+ss_dns_match_t ss_dns_name_match_get(const char** name, ss_dns_match_t vdefault) {
+    size_t length = strlen(SS_DNS_WILDCARD_PREFIX);
+    if (!strncmp(*name, SS_DNS_WILDCARD_PREFIX, length)) {
+        *name += length;
+        return SS_DNS_MATCH_WILDCARD;
+    }
+    return vdefault;
+}
+
+/* TRIE */
+
+static int ss_dns_trie_rehash(ss_dns_trie_t* trie, uint32_t slot_count) {
+    uint32_t* slots = je_calloc(slot_count, sizeof(uint32_t));
+    if (slots == NULL) return -1;
+
+    uint32_t mask = slot_count - 1;
+    // node 0 is the root, which is never anybody's child
+    for (uint32_t i = 1; i < trie->node_count; ++i) {
+        ss_dns_trie_node_t* node = &trie->nodes[i];
+        uint32_t slot = ss_dns_slot_hash(node->parent, node->label_hash) & mask;
+        while (slots[slot]) slot = (slot + 1) & mask;
+        slots[slot] = i;
+    }
+
+    je_free(trie->slots);
+    trie->slots     = slots;
+    trie->slot_mask = mask;
+    return 0;
+}
+
+static uint32_t ss_dns_trie_child_find(ss_dns_trie_t* trie, uint32_t parent, const char* label, uint8_t length, uint32_t label_hash) {
+    uint32_t slot = ss_dns_slot_hash(parent, label_hash) & trie->slot_mask;
+    for (uint32_t index = trie->slots[slot]; index; index = trie->slots[slot]) {
+        ss_dns_trie_node_t* node = &trie->nodes[index];
+        if (node->parent       == parent     &&
+            node->label_hash   == label_hash &&
+            node->label_length == length     &&
+            ss_dns_label_equal(trie->labels + node->label_offset, label, length)) {
+            return index;
+        }
+        slot = (slot + 1) & trie->slot_mask;
+    }
+    return 0;
+}
+
+static uint32_t ss_dns_trie_child_create(ss_dns_trie_t* trie, uint32_t parent, const char* label, uint8_t length, uint32_t label_hash) {
+    // keep the slot table at most half full so probe sequences stay short
+    if ((trie->node_count + 1) * 2 > trie->slot_mask + 1) {
+        if (ss_dns_trie_rehash(trie, (trie->slot_mask + 1) * 2)) return 0;
+    }
+    if (trie->node_count == trie->node_max) {
+        uint32_t node_max = trie->node_max * 2;
+        ss_dns_trie_node_t* nodes = je_realloc(trie->nodes, node_max * sizeof(ss_dns_trie_node_t));
+        if (nodes == NULL) return 0;
+        trie->nodes    = nodes;
+        trie->node_max = node_max;
+    }
+    if (trie->label_size + length > trie->label_max) {
+        uint32_t label_max = trie->label_max * 2;
+        if (label_max < trie->label_size + length) label_max = trie->label_size + length;
+        char* labels = je_realloc(trie->labels, label_max);
+        if (labels == NULL) return 0;
+        trie->labels    = labels;
+        trie->label_max = label_max;
+    }
+
+    uint32_t index = trie->node_count++;
+    ss_dns_trie_node_t* node = &trie->nodes[index];
+    memset(node, 0, sizeof(*node));
+    node->parent       = parent;
+    node->label_hash   = label_hash;
+    node->label_offset = trie->label_size;
+    node->label_length = length;
+    for (uint8_t i = 0; i < length; ++i) {
+        trie->labels[trie->label_size++] = (char) ss_dns_tolower((uint8_t) label[i]);
+    }
+
+    uint32_t slot = ss_dns_slot_hash(parent, label_hash) & trie->slot_mask;
+    while (trie->slots[slot]) slot = (slot + 1) & trie->slot_mask;
+    trie->slots[slot] = index;
+    return index;
+}
+
+/* walk the labels of name right to left; returns the final node or 0 */
+static uint32_t ss_dns_trie_node_find(ss_dns_trie_t* trie, const char* name, bool create) {
+    const char* label;
+    int         length;
+    uint32_t    index = 0;
+    size_t      end   = ss_dns_name_length(name, 0);
+
+    if (end == 0) return 0;
+    while (end > 0) {
+        length = ss_dns_label_next(name, &end, &label);
+        if (length < 0) return 0;
+        uint32_t label_hash = ss_dns_label_hash(label, (uint8_t) length);
+        uint32_t child = ss_dns_trie_child_find(trie, index, label, (uint8_t) length, label_hash);
+        if (child == 0 && create) {
+            child = ss_dns_trie_child_create(trie, index, label, (uint8_t) length, label_hash);
+        }
+        if (child == 0) return 0;
+        index = child;
+    }
+    return index;
+}
+
+ss_dns_trie_t* ss_dns_trie_create() {
+    ss_dns_trie_t* trie = je_calloc(1, sizeof(ss_dns_trie_t));
+    if (trie == NULL) {
+        fprintf(stderr, "could not allocate dns trie\n");
+        goto error_out;
+    }
+
+    trie->node_max = SS_DNS_TRIE_SLOTS_MIN / 2;
+    trie->nodes    = je_calloc(trie->node_max, sizeof(ss_dns_trie_node_t));
+    if (trie->nodes == NULL) {
+        fprintf(stderr, "could not allocate dns trie nodes\n");
+        goto error_out;
+    }
+    // node 0 is the root; it holds no label
+    trie->node_count = 1;
+
+    trie->slot_mask = SS_DNS_TRIE_SLOTS_MIN - 1;
+    trie->slots     = je_calloc(SS_DNS_TRIE_SLOTS_MIN, sizeof(uint32_t));
+    if (trie->slots == NULL) {
+        fprintf(stderr, "could not allocate dns trie slots\n");
+        goto error_out;
+    }
+
+    trie->label_max = SS_DNS_TRIE_SLOTS_MIN * 8;
+    trie->labels    = je_malloc(trie->label_max);
+    if (trie->labels == NULL) {
+        fprintf(stderr, "could not allocate dns trie labels\n");
+        goto error_out;
+    }
+
+    return trie;
+
+    error_out:
+    ss_dns_trie_destroy(trie);
+    return NULL;
+}
+
+int ss_dns_trie_destroy(ss_dns_trie_t* trie) {
+    if (trie == NULL) return 0;
+
+    for (uint32_t i = 0; trie->nodes && i < trie->node_count; ++i) {
+        for (int match = 0; match < SS_DNS_MATCH_MAX; ++match) {
+            ss_dns_trie_value_t* vptr = trie->nodes[i].values[match];
+            while (vptr) {
+                ss_dns_trie_value_t* vtmp = vptr->next;
+                je_free(vptr);
+                vptr = vtmp;
+            }
+        }
+    }
+    je_free(trie->nodes);
+    je_free(trie->slots);
+    je_free(trie->labels);
+    je_free(trie);
+    return 0;
+}
+
+/*
+ * Attach value to name. Values for the same name and match type are kept
+ * in insertion order. When is_unique is set, a name which already has a
+ * value for this match type is left alone and 1 is returned.
+ */
+int ss_dns_trie_add(ss_dns_trie_t* trie, const char* name, ss_dns_match_t match, void* value, int is_unique) {
+    if (match <= SS_DNS_MATCH_EMPTY || match >= SS_DNS_MATCH_MAX) {
+        fprintf(stderr, "dns trie name %s has invalid match type %d\n", name, match);
+        return -1;
+    }
+
+    uint32_t index = ss_dns_trie_node_find(trie, name, true);
+    if (index == 0) {
+        fprintf(stderr, "could not insert dns trie name %s\n", name);
+        return -1;
+    }
+
+    ss_dns_trie_value_t** vpptr = &trie->nodes[index].values[match];
+    if (is_unique && *vpptr) return 1;
+    while (*vpptr) vpptr = &(*vpptr)->next;
+
+    ss_dns_trie_value_t* vptr = je_calloc(1, sizeof(ss_dns_trie_value_t));
+    if (vptr == NULL) {
+        fprintf(stderr, "could not allocate dns trie value for name %s\n", name);
+        return -1;
+    }
+    vptr->value = value;
+    *vpptr = vptr;
+    ++trie->value_count;
+    return 0;
+}
+
+/*
+ * Detach value from name, or every value of this match type if value is
+ * NULL. Nodes are left in place, since they are cheap and may be reused.
+ */
+int ss_dns_trie_remove(ss_dns_trie_t* trie, const char* name, ss_dns_match_t match, void* value) {
+    if (match <= SS_DNS_MATCH_EMPTY || match >= SS_DNS_MATCH_MAX) return -1;
+
+    uint32_t index = ss_dns_trie_node_find(trie, name, false);
+    if (index == 0) return -1;
+
+    int removed = 0;
+    ss_dns_trie_value_t** vpptr = &trie->nodes[index].values[match];
+    while (*vpptr) {
+        ss_dns_trie_value_t* vptr = *vpptr;
+        if (value == NULL || vptr->value == value) {
+            *vpptr = vptr->next;
+            je_free(vptr);
+            --trie->value_count;
+            ++removed;
+        }
+        else {
+            vpptr = &vptr->next;
+        }
+    }
+    return removed ? 0 : -1;
+}
+
+static inline int ss_dns_trie_collect(ss_dns_trie_value_t* vptr, void** results, int count, int results_max) {
+    for (; vptr && count < results_max; vptr = vptr->next) {
+        results[count++] = vptr->value;
+    }
+    return count;
+}
+
+/*
+ * Find every value whose indicator covers name. name need not be canonical
+ * or NUL terminated if length is given (0 means strlen). Results are
+ * stored from least to most specific; returns the number stored.
+ */
+int ss_dns_trie_match(ss_dns_trie_t* trie, const char* name, size_t length, void** results, int results_max) {
+    const char* label;
+    int         llength;
+    int         count = 0;
+    uint32_t    index = 0;
+    size_t      end   = ss_dns_name_length(name, length);
+
+    while (end > 0) {
+        llength = ss_dns_label_next(name, &end, &label);
+        if (llength < 0) break;
+        index = ss_dns_trie_child_find(trie, index, label, (uint8_t) llength, ss_dns_label_hash(label, (uint8_t) llength));
+        if (index == 0) break;
+
+        ss_dns_trie_node_t* node = &trie->nodes[index];
+        count = ss_dns_trie_collect(node->values[SS_DNS_MATCH_SUFFIX], results, count, results_max);
+        if (end > 0) {
+            count = ss_dns_trie_collect(node->values[SS_DNS_MATCH_WILDCARD], results, count, results_max);
+        }
+        else {
+            count = ss_dns_trie_collect(node->values[SS_DNS_MATCH_EXACT], results, count, results_max);
+        }
+    }
+    return count;
+}
+
+/* return the first value of the most specific indicator covering name */
+void* ss_dns_trie_lookup(ss_dns_trie_t* trie, const char* name, size_t length) {
+    const char* label;
+    int         llength;
+    void*       result = NULL;
+    uint32_t    index  = 0;
+    size_t      end    = ss_dns_name_length(name, length);
+
+    while (end > 0) {
+        llength = ss_dns_label_next(name, &end, &label);
+        if (llength < 0) break;
+        index = ss_dns_trie_child_find(trie, index, label, (uint8_t) llength, ss_dns_label_hash(label, (uint8_t) llength));
+        if (index == 0) break;
+
+        ss_dns_trie_node_t* node = &trie->nodes[index];
+        if (end == 0 && node->values[SS_DNS_MATCH_EXACT]) {
+            result = node->values[SS_DNS_MATCH_EXACT]->value;
+        }
+        else if (node->values[SS_DNS_MATCH_SUFFIX]) {
+            result = node->values[SS_DNS_MATCH_SUFFIX]->value;
+        }
+        else if (end > 0 && node->values[SS_DNS_MATCH_WILDCARD]) {
+            result = node->values[SS_DNS_MATCH_WILDCARD]->value;
+        }
+    }
+    return result;
+}
+
+int ss_dns_trie_dump(ss_dns_trie_t* trie, uint64_t limit, ss_dns_trie_dump_cb dump_cb) {
+    char     name[SS_DNS_LABELS_MAX * (SS_DNS_LABEL_MAX + 1) + 1];
+    uint64_t count = 0;
+
+    fprintf(stderr, "dns trie: %u nodes, %lu values\n", trie->node_count, trie->value_count);
+    for (uint32_t i = 1; i < trie->node_count; ++i) {
+        ss_dns_trie_node_t* node = &trie->nodes[i];
+        size_t offset = 0;
+
+        // walking toward the root yields the labels left to right
+        for (uint32_t j = i; j && offset + SS_DNS_LABEL_MAX + 2 < sizeof(name); j = trie->nodes[j].parent) {
+            ss_dns_trie_node_t* lnode = &trie->nodes[j];
+            memcpy(name + offset, trie->labels + lnode->label_offset, lnode->label_length);
+            offset += lnode->label_length;
+            name[offset++] = '.';
+        }
+        name[offset] = '\0';
+
+        for (int match = SS_DNS_MATCH_EXACT; match < SS_DNS_MATCH_MAX; ++match) {
+            for (ss_dns_trie_value_t* vptr = node->values[match]; vptr; vptr = vptr->next) {
+                if (count >= limit) return 0;
+                dump_cb(name, (ss_dns_match_t) match, vptr->value);
+                ++count;
+            }
+        }
+    }
+    return 0;
+}
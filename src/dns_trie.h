@@ -0,0 +1,88 @@
+#ifndef __DNS_TRIE_H__
+#define __DNS_TRIE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CONSTANTS */
+
+#define SS_DNS_LABEL_MAX           63
+#define SS_DNS_LABELS_MAX         128
+#define SS_DNS_TRIE_SLOTS_MIN    1024
+#define SS_DNS_TRIE_RESULT_MAX     16
+
+#define SS_DNS_WILDCARD_PREFIX   "*."
+
+enum ss_dns_match_e {
+    SS_DNS_MATCH_EMPTY    = 0,
+    SS_DNS_MATCH_EXACT    = 1, /* name only */
+    SS_DNS_MATCH_SUFFIX   = 2, /* name and every name below it */
+    SS_DNS_MATCH_WILDCARD = 3, /* every name below it, but not the name */
+    SS_DNS_MATCH_MAX,
+};
+
+typedef enum ss_dns_match_e ss_dns_match_t;
+
+/* DATA TYPES */
+
+struct ss_dns_trie_value_s {
+    void* value;
+    struct ss_dns_trie_value_s* next;
+};
+
+typedef struct ss_dns_trie_value_s ss_dns_trie_value_t;
+
+/*
+ * Names are stored reversed, one node per label, so "cdn.a.evil.example."
+ * walks example -> evil -> a -> cdn from the root (node 0).
+ *
+ * Edges are not stored in the nodes. Every node lives in one open addressing
+ * slot table, hashed by (parent, label), which keeps a lookup to one probe
+ * sequence per label, and label bytes are kept lowercased in one arena.
+ */
+struct ss_dns_trie_node_s {
+    uint32_t parent;
+    uint32_t label_hash;
+    uint32_t label_offset;
+    uint8_t  label_length;
+    ss_dns_trie_value_t* values[SS_DNS_MATCH_MAX];
+};
+
+typedef struct ss_dns_trie_node_s ss_dns_trie_node_t;
+
+struct ss_dns_trie_s {
+    uint64_t value_count;
+
+    uint32_t node_count;
+    uint32_t node_max;
+    ss_dns_trie_node_t* nodes;
+
+    uint32_t slot_mask;
+    uint32_t* slots;
+
+    uint32_t label_size;
+    uint32_t label_max;
+    char* labels;
+};
+
+typedef struct ss_dns_trie_s ss_dns_trie_t;
+
+typedef int (*ss_dns_trie_dump_cb)(const char* name, ss_dns_match_t match, void* value);
+
+/* BEGIN PROTOTYPES */
+
+ss_dns_match_t ss_dns_match_load(const char* dns_match);
+const char* ss_dns_match_dump(ss_dns_match_t dns_match);
+size_t ss_dns_name_canonicalize(char* dst, const char* src, size_t size);
+ss_dns_match_t ss_dns_name_match_get(const char** name, ss_dns_match_t vdefault);
+ss_dns_trie_t* ss_dns_trie_create(void);
+int ss_dns_trie_destroy(ss_dns_trie_t* trie);
+int ss_dns_trie_add(ss_dns_trie_t* trie, const char* name, ss_dns_match_t match, void* value, int is_unique);
+int ss_dns_trie_remove(ss_dns_trie_t* trie, const char* name, ss_dns_match_t match, void* value);
+int ss_dns_trie_match(ss_dns_trie_t* trie, const char* name, size_t length, void** results, int results_max);
+void* ss_dns_trie_lookup(ss_dns_trie_t* trie, const char* name, size_t length);
+int ss_dns_trie_dump(ss_dns_trie_t* trie, uint64_t limit, ss_dns_trie_dump_cb dump_cb);
+
+/* END PROTOTYPES */
+
+#endif /* __DNS_TRIE_H__ */
@@ -0,0 +1,404 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+
+#include "dns_txn.h"
+
+#include "common.h"
+#include "sdn_sensor.h"
+
+/*
+ * Pairs each DNS query with its response, by client, server, client port
+ * and transaction id, to measure how long names take to resolve, and to
+ * count NXDOMAIN answers and unanswered queries per client.
+ *
+ * This relies on a query and its response reaching the same lcore, which
+ * the symmetric RSS key set up in sdn_sensor.c makes sure of.
+ */
+
+static ss_dns_txn_lcore_t ss_dns_txn_lcores[RTE_MAX_LCORE];
+
+/* only touched by the master lcore */
+static ss_dns_txn_stats_t ss_dns_txn_totals;
+static uint32_t           ss_dns_txn_totals_mask;
+static uint64_t           ss_dns_txn_next_tsc;
+
+static inline uint32_t ss_dns_txn_client_hash(uint8_t family, const uint8_t* ip) {
+    return rte_hash_crc(ip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN, SS_DNS_TXN_HASH_INIT + family);
+}
+
+/* callers keep the slots under 3/4 full, so a free slot is always found */
+static ss_dns_client_t* ss_dns_txn_client_slot(ss_dns_client_t* clients, uint32_t mask, uint8_t family, const uint8_t* ip) {
+    uint32_t i = ss_dns_txn_client_hash(family, ip) & mask;
+
+    for (;;) {
+        ss_dns_client_t* cptr = &clients[i];
+        if (cptr->family == 0) return cptr;
+        if (cptr->family == family && !memcmp(cptr->ip, ip, sizeof(cptr->ip))) return cptr;
+        i = (i + 1) & mask;
+    }
+}
+
+/* returns NULL once the table is 3/4 full, the count then goes to overflow */
+static ss_dns_client_t* ss_dns_txn_client(ss_dns_txn_stats_t* stats, uint32_t mask, uint8_t family, const uint8_t* ip) {
+    ss_dns_client_t* cptr = ss_dns_txn_client_slot(stats->clients, mask, family, ip);
+
+    if (cptr->family) return cptr;
+    if (stats->clients_used >= (mask + 1) / 4 * 3) {
+        ++stats->clients_overflow;
+        return NULL;
+    }
+    cptr->family = family;
+    memcpy(cptr->ip, ip, sizeof(cptr->ip));
+    ++stats->clients_used;
+    return cptr;
+}
+
+int ss_dns_txn_init() {
+    unsigned int lcore_id;
+    uint32_t slots = 1;
+    uint32_t client_slots = 1;
+
+    if (ss_conf->dns_txn_seconds == 0) return 0;
+
+    while (slots < ss_conf->dns_txn_entries) slots <<= 1;
+    /* room for the clients below the 3/4 limit */
+    while (client_slots / 4 * 3 < ss_conf->dns_txn_clients) client_slots <<= 1;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_dns_txn_lcore_t* lcore = &ss_dns_txn_lcores[lcore_id];
+        lcore->txns = je_calloc(slots, sizeof(ss_dns_txn_t));
+        if (lcore->txns == NULL) goto error_out;
+        for (int i = 0; i < 2; ++i) {
+            lcore->stats[i].clients = je_calloc(client_slots, sizeof(ss_dns_client_t));
+            if (lcore->stats[i].clients == NULL) goto error_out;
+        }
+        lcore->mask            = slots - 1;
+        lcore->client_mask     = client_slots - 1;
+        lcore->next_expire_tsc = rte_rdtsc();
+    }
+
+    /* the clients of every lcore meet here */
+    ss_dns_txn_totals.clients = je_calloc(client_slots * 4, sizeof(ss_dns_client_t));
+    if (ss_dns_txn_totals.clients == NULL) goto error_out;
+    ss_dns_txn_totals_mask = client_slots * 4 - 1;
+    ss_dns_txn_next_tsc    = rte_rdtsc() + ss_conf->dns_txn_seconds * rte_get_tsc_hz();
+
+    return 0;
+
+    error_out:
+    RTE_LOG(ERR, EXTRACTOR, "could not allocate dns transaction table\n");
+    ss_dns_txn_destroy();
+    return -1;
+}
+
+static void ss_dns_txn_unanswered(ss_dns_txn_lcore_t* lcore, ss_dns_txn_t* tptr) {
+    ss_dns_txn_stats_t* stats = &lcore->stats[lcore->active];
+    ss_dns_client_t* cptr;
+
+    ++stats->unanswered;
+    cptr = ss_dns_txn_client(stats, lcore->client_mask, tptr->key.family, tptr->key.client);
+    if (cptr) ++cptr->unanswered;
+    tptr->signature = 0;
+}
+
+static void ss_dns_txn_latency(ss_dns_txn_stats_t* stats, uint64_t cycles) {
+    uint64_t usecs = (uint64_t) ((double) cycles * 1E6 / (double) rte_get_tsc_hz());
+    unsigned int bucket = 0;
+
+    while (bucket < SS_DNS_TXN_LATENCY_BUCKETS - 1 && (usecs >> (bucket + 1))) ++bucket;
+    ++stats->latency[bucket];
+    stats->latency_sum += usecs;
+    stats->latency_max  = SS_MAX(stats->latency_max, usecs);
+}
+
+/*
+ * Counts the message, and pairs a response with its query. Returns 1 for
+ * a response to a query which was not seen here, else 0, also when
+ * pairing is off.
+ */
+int ss_dns_txn_record(ss_frame_t* fbuf, ss_dns_parse_t* dns) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_dns_txn_lcore_t* lcore;
+    ss_dns_txn_stats_t* stats;
+    ss_dns_txn_t* tptr;
+    ss_dns_txn_t* slot = NULL;
+    ss_dns_client_t* cptr;
+    ss_dns_txn_key_t key;
+    uint32_t signature;
+    uint64_t now;
+    int is_response = (dns->flags & SS_DNS_FLAG_QR) != 0;
+    size_t length;
+
+    if (lcore_id >= RTE_MAX_LCORE) return 0;
+    lcore = &ss_dns_txn_lcores[lcore_id];
+    if (lcore->txns == NULL) return 0;
+    stats = &lcore->stats[lcore->active];
+
+    memset(&key, 0, sizeof(key));
+    key.family = fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4;
+    key.id     = dns->id;
+    length     = key.family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN;
+    if (is_response) {
+        key.port = fbuf->data.dport;
+        memcpy(key.client, fbuf->data.dip, length);
+        memcpy(key.server, fbuf->data.sip, length);
+    }
+    else {
+        key.port = fbuf->data.sport;
+        memcpy(key.client, fbuf->data.sip, length);
+        memcpy(key.server, fbuf->data.dip, length);
+    }
+
+    /* 0 marks an empty slot */
+    signature = rte_hash_crc(&key, sizeof(key), SS_DNS_TXN_HASH_INIT) | 1;
+    now       = rte_rdtsc();
+    cptr      = ss_dns_txn_client(stats, lcore->client_mask, key.family, key.client);
+
+    if (is_response) {
+        uint16_t rcode = dns->flags & SS_DNS_RCODE_MASK;
+        ++stats->responses;
+        if (cptr) ++cptr->responses;
+        if (rcode == SS_DNS_RCODE_NXDOMAIN) {
+            ++stats->nxdomain;
+            if (cptr) ++cptr->nxdomain;
+        }
+        else if (rcode == SS_DNS_RCODE_SERVFAIL) {
+            ++stats->servfail;
+        }
+
+        for (uint32_t i = 0; i < SS_DNS_TXN_PROBE_MAX; ++i) {
+            tptr = &lcore->txns[(signature + i) & lcore->mask];
+            if (tptr->signature == signature && !memcmp(&tptr->key, &key, sizeof(key))) {
+                ss_dns_txn_latency(stats, now - tptr->query_tsc);
+                tptr->signature = 0;
+                return 0;
+            }
+        }
+        ++stats->unmatched;
+        return 1;
+    }
+
+    ++stats->queries;
+    if (cptr) ++cptr->queries;
+
+    for (uint32_t i = 0; i < SS_DNS_TXN_PROBE_MAX; ++i) {
+        tptr = &lcore->txns[(signature + i) & lcore->mask];
+        /* a retransmission, latency counts from the first query */
+        if (tptr->signature == signature && !memcmp(&tptr->key, &key, sizeof(key))) return 0;
+        if (tptr->signature == 0) {
+            if (slot == NULL || slot->signature) slot = tptr;
+        }
+        else if (slot == NULL || (slot->signature && tptr->query_tsc < slot->query_tsc)) {
+            slot = tptr;
+        }
+    }
+
+    /* no room in the probe window, the oldest query gives up its slot */
+    if (slot->signature) ss_dns_txn_unanswered(lcore, slot);
+
+    slot->key       = key;
+    slot->signature = signature;
+    slot->query_tsc = now;
+    return 0;
+}
+
+/*
+ * Times out the queries in the next SS_DNS_TXN_EXPIRE_BUDGET slots from
+ * the hand, paced so the whole table is swept about once a second, so no
+ * call stalls the lcore for a full scan.
+ */
+void ss_dns_txn_expire_callback(unsigned int lcore_id) {
+    ss_dns_txn_lcore_t* lcore = &ss_dns_txn_lcores[lcore_id];
+    uint64_t timeout;
+    uint64_t now;
+    uint32_t budget;
+
+    if (lcore->txns == NULL) return;
+
+    now = rte_rdtsc();
+    if (now < lcore->next_expire_tsc) return;
+    budget  = SS_MIN(SS_DNS_TXN_EXPIRE_BUDGET, lcore->mask + 1);
+    timeout = ss_conf->dns_txn_timeout * rte_get_tsc_hz();
+    lcore->next_expire_tsc = now + rte_get_tsc_hz() * budget / (lcore->mask + 1);
+
+    for (uint32_t i = 0; i < budget; ++i) {
+        ss_dns_txn_t* tptr = &lcore->txns[lcore->expire_hand];
+        lcore->expire_hand = (lcore->expire_hand + 1) & lcore->mask;
+        if (tptr->signature && now - tptr->query_tsc >= timeout) ss_dns_txn_unanswered(lcore, tptr);
+    }
+}
+
+static void ss_dns_txn_merge(ss_dns_txn_stats_t* stats, uint32_t mask) {
+    ss_dns_txn_stats_t* totals = &ss_dns_txn_totals;
+
+    totals->queries     += stats->queries;
+    totals->responses   += stats->responses;
+    totals->unmatched   += stats->unmatched;
+    totals->nxdomain    += stats->nxdomain;
+    totals->servfail    += stats->servfail;
+    totals->unanswered  += stats->unanswered;
+    totals->latency_sum += stats->latency_sum;
+    totals->latency_max  = SS_MAX(totals->latency_max, stats->latency_max);
+    for (int i = 0; i < SS_DNS_TXN_LATENCY_BUCKETS; ++i) {
+        totals->latency[i] += stats->latency[i];
+    }
+    totals->clients_overflow += stats->clients_overflow;
+
+    for (uint32_t i = 0; stats->clients_used && i <= mask; ++i) {
+        ss_dns_client_t* cptr = &stats->clients[i];
+        ss_dns_client_t* tptr;
+        if (cptr->family == 0) continue;
+        tptr = ss_dns_txn_client(totals, ss_dns_txn_totals_mask, cptr->family, cptr->ip);
+        if (tptr == NULL) continue;
+        tptr->queries    += cptr->queries;
+        tptr->responses  += cptr->responses;
+        tptr->nxdomain   += cptr->nxdomain;
+        tptr->unanswered += cptr->unanswered;
+    }
+}
+
+/* upper bound in msecs of the latency bucket holding the permille */
+static double ss_dns_txn_percentile(ss_dns_txn_stats_t* stats, uint64_t count, uint64_t permille) {
+    uint64_t target = (count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < SS_DNS_TXN_LATENCY_BUCKETS; ++i) {
+        seen += stats->latency[i];
+        if (seen >= target) return (double) (2ULL << i) / 1000.0;
+    }
+    return (double) stats->latency_max / 1000.0;
+}
+
+static void ss_dns_txn_dump(unsigned int behind) {
+    ss_dns_txn_stats_t* totals = &ss_dns_txn_totals;
+    ss_dns_client_t* top[SS_DNS_TXN_TOP_MAX];
+    unsigned int top_count = 0;
+    unsigned int limit = SS_MIN(ss_conf->dns_txn_top, SS_DNS_TXN_TOP_MAX);
+    char ip_str[SS_ADDR_STR_MAX];
+    uint64_t matched = 0;
+
+    for (int i = 0; i < SS_DNS_TXN_LATENCY_BUCKETS; ++i) matched += totals->latency[i];
+
+    RTE_LOG(NOTICE, EXTRACTOR, "dns in %u secs: %lu queries, %lu responses, %lu nxdomain (%.1f%%), "
+        "%lu servfail, %lu unanswered, %lu unmatched responses, %u lcores behind\n",
+        ss_conf->dns_txn_seconds, totals->queries, totals->responses,
+        totals->nxdomain, totals->responses ? 100.0 * totals->nxdomain / totals->responses : 0.0,
+        totals->servfail, totals->unanswered, totals->unmatched, behind);
+    if (matched) {
+        RTE_LOG(NOTICE, EXTRACTOR, "dns latency: avg %.3f ms, p50 < %.3f ms, p90 < %.3f ms, "
+            "p99 < %.3f ms, max %.3f ms\n",
+            (double) totals->latency_sum / matched / 1000.0,
+            ss_dns_txn_percentile(totals, matched, 500),
+            ss_dns_txn_percentile(totals, matched, 900),
+            ss_dns_txn_percentile(totals, matched, 990),
+            (double) totals->latency_max / 1000.0);
+    }
+
+    /* keep top sorted by failed lookups, largest first */
+    for (uint32_t i = 0; i <= ss_dns_txn_totals_mask; ++i) {
+        ss_dns_client_t* cptr = &ss_dns_txn_totals.clients[i];
+        uint64_t failed = cptr->nxdomain + cptr->unanswered;
+        unsigned int j;
+        if (cptr->family == 0 || failed == 0) continue;
+        if (top_count < limit) j = top_count++;
+        else if (limit && failed > top[limit - 1]->nxdomain + top[limit - 1]->unanswered) j = limit - 1;
+        else continue;
+        for (; j > 0 && top[j - 1]->nxdomain + top[j - 1]->unanswered < failed; --j) top[j] = top[j - 1];
+        top[j] = cptr;
+    }
+
+    for (unsigned int i = 0; i < top_count; ++i) {
+        ss_dns_client_t* cptr = top[i];
+        if (ss_inet_ntop_raw(cptr->family, cptr->ip, ip_str, sizeof(ip_str)) == NULL) continue;
+        RTE_LOG(NOTICE, EXTRACTOR, "dns client %s: %lu queries, %lu nxdomain (%.1f%%), %lu unanswered\n",
+            ip_str, cptr->queries, cptr->nxdomain,
+            cptr->responses ? 100.0 * cptr->nxdomain / cptr->responses : 0.0, cptr->unanswered);
+    }
+    if (totals->clients_overflow) {
+        RTE_LOG(NOTICE, EXTRACTOR, "dns clients: %lu counts past the client table\n", totals->clients_overflow);
+    }
+}
+
+/*
+ * Merges the counts of each lcore which switched since the last interval,
+ * then hands them back cleared, like ss_ioc_hits_aggregate.
+ */
+static void ss_dns_txn_aggregate(void) {
+    ss_dns_client_t* clients = ss_dns_txn_totals.clients;
+    unsigned int behind = 0;
+    unsigned int lcore_id;
+
+    memset(clients, 0, (ss_dns_txn_totals_mask + 1) * sizeof(ss_dns_client_t));
+    memset(&ss_dns_txn_totals, 0, sizeof(ss_dns_txn_totals));
+    ss_dns_txn_totals.clients = clients;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_dns_txn_lcore_t* lcore = &ss_dns_txn_lcores[lcore_id];
+        ss_dns_txn_stats_t* stats;
+
+        if (lcore->active != lcore->requested) {
+            ++behind;
+            continue;
+        }
+        rte_rmb();
+
+        stats = &lcore->stats[lcore->active ^ 1];
+        ss_dns_txn_merge(stats, lcore->client_mask);
+
+        clients = stats->clients;
+        if (stats->clients_used) memset(clients, 0, (lcore->client_mask + 1) * sizeof(ss_dns_client_t));
+        memset(stats, 0, sizeof(ss_dns_txn_stats_t));
+        stats->clients = clients;
+
+        rte_wmb();
+        lcore->requested = lcore->active ^ 1;
+    }
+
+    ss_dns_txn_dump(behind);
+}
+
+void ss_dns_txn_timer_callback(unsigned int lcore_id) {
+    ss_dns_txn_lcore_t* lcore = &ss_dns_txn_lcores[lcore_id];
+    uint64_t now;
+
+    if (lcore->txns == NULL) return;
+
+    /* the master lcore wants the current counts, move to the cleared ones */
+    if (lcore->requested != lcore->active) {
+        rte_rmb();
+        rte_wmb();
+        lcore->active = lcore->requested;
+    }
+
+    if (lcore_id != rte_get_master_lcore()) return;
+
+    now = rte_rdtsc();
+    if (now < ss_dns_txn_next_tsc) return;
+    ss_dns_txn_next_tsc = now + ss_conf->dns_txn_seconds * rte_get_tsc_hz();
+
+    ss_dns_txn_aggregate();
+}
+
+void ss_dns_txn_destroy() {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        ss_dns_txn_lcore_t* lcore = &ss_dns_txn_lcores[i];
+        if (lcore->txns) je_free(lcore->txns);
+        for (int j = 0; j < 2; ++j) {
+            if (lcore->stats[j].clients) je_free(lcore->stats[j].clients);
+        }
+        memset(lcore, 0, sizeof(ss_dns_txn_lcore_t));
+    }
+    if (ss_dns_txn_totals.clients) je_free(ss_dns_txn_totals.clients);
+    memset(&ss_dns_txn_totals, 0, sizeof(ss_dns_txn_totals));
+    ss_dns_txn_totals_mask = 0;
+}
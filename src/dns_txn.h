@@ -0,0 +1,113 @@
+#ifndef __DNS_TXN_H__
+#define __DNS_TXN_H__
+
+#include <stdint.h>
+
+#include <rte_memory.h>
+
+#include "common.h"
+#include "dns_parse.h"
+#include "ip_utils.h"
+
+/* CONSTANTS */
+
+#define SS_DNS_TXN_ENTRIES          8192
+#define SS_DNS_TXN_CLIENTS          1024
+#define SS_DNS_TXN_SECONDS            60
+#define SS_DNS_TXN_TIMEOUT             5
+#define SS_DNS_TXN_TOP                10
+#define SS_DNS_TXN_TOP_MAX           100
+#define SS_DNS_TXN_PROBE_MAX           8
+#define SS_DNS_TXN_EXPIRE_BUDGET     256 /* most slots checked per timer call */
+#define SS_DNS_TXN_LATENCY_BUCKETS    24
+#define SS_DNS_TXN_HASH_INIT  0x165667b1
+
+/* DATA TYPES */
+
+/* zeroed before it is filled in, so the padding hashes and compares equal */
+struct ss_dns_txn_key_s {
+    uint8_t  family;
+    uint16_t port;   /* client port */
+    uint16_t id;     /* transaction id */
+    uint8_t  client[IPV6_ALEN];
+    uint8_t  server[IPV6_ALEN];
+};
+
+typedef struct ss_dns_txn_key_s ss_dns_txn_key_t;
+
+/* one query waiting for its response, empty while signature is 0 */
+struct ss_dns_txn_s {
+    ss_dns_txn_key_t key;
+    uint32_t signature;
+    uint64_t query_tsc;
+};
+
+typedef struct ss_dns_txn_s ss_dns_txn_t;
+
+/* per client counts of one interval, empty while family is 0 */
+struct ss_dns_client_s {
+    uint8_t  family;
+    uint8_t  ip[IPV6_ALEN];
+    uint64_t queries;
+    uint64_t responses;
+    uint64_t nxdomain;
+    uint64_t unanswered;
+};
+
+typedef struct ss_dns_client_s ss_dns_client_t;
+
+/*
+ * Counts of one lcore during one interval. latency[i] counts responses
+ * which took less than 2^(i + 1) usecs. Clients past 3/4 of the slots are
+ * only counted in clients_overflow.
+ */
+struct ss_dns_txn_stats_s {
+    uint64_t queries;
+    uint64_t responses;
+    uint64_t unmatched;   /* responses to no query seen */
+    uint64_t nxdomain;
+    uint64_t servfail;
+    uint64_t unanswered;  /* queries timed out or pushed out */
+    uint64_t latency_sum;
+    uint64_t latency_max;
+    uint64_t latency[SS_DNS_TXN_LATENCY_BUCKETS];
+    uint32_t clients_used;
+    uint64_t clients_overflow;
+    ss_dns_client_t* clients;
+};
+
+typedef struct ss_dns_txn_stats_s ss_dns_txn_stats_t;
+
+/*
+ * Outstanding queries live in txns, probed linearly from the home slot
+ * for at most SS_DNS_TXN_PROBE_MAX slots, so a query flood costs a bounded
+ * amount of work and memory: the oldest query in the way is pushed out.
+ *
+ * The counts use the same handoff as the ioc hit counters. The lcore only
+ * writes stats[active], the master lcore asks for a switch through
+ * requested, and merges the other one once the lcore switched.
+ */
+struct ss_dns_txn_lcore_s {
+    volatile uint32_t active;
+    volatile uint32_t requested;
+    uint32_t mask;
+    uint32_t client_mask;
+    uint64_t next_expire_tsc;
+    uint32_t expire_hand;     /* next slot checked for a timed out query */
+    ss_dns_txn_t* txns;
+    ss_dns_txn_stats_t stats[2];
+} __rte_cache_aligned;
+
+typedef struct ss_dns_txn_lcore_s ss_dns_txn_lcore_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_dns_txn_init(void);
+int ss_dns_txn_record(ss_frame_t* fbuf, ss_dns_parse_t* dns);
+void ss_dns_txn_expire_callback(unsigned int lcore_id);
+void ss_dns_txn_timer_callback(unsigned int lcore_id);
+void ss_dns_txn_destroy(void);
+
+/* END PROTOTYPES */
+
+#endif /* __DNS_TXN_H__ */
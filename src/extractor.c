@@ -5,14 +5,22 @@
 #include <bsd/string.h>
 #include <bsd/sys/queue.h>
 
+#include <rte_lcore.h>
 #include <rte_memory.h>
 
 #include "extractor.h"
 
 #include "common.h"
+#include "dns_parse.h"
+#include "dns_txn.h"
+#include "http_parse.h"
 #include "ioc.h"
+#include "ioc_hits.h"
 #include "metadata.h"
+#include "pdns.h"
 #include "sdn_sensor.h"
+#include "suppress.h"
+#include "syslog_parse.h"
 
 // NOTE: this stuff comes from spcdns
 #include "dns.h"
@@ -64,9 +72,17 @@ int ss_extract_eth(ss_frame_t* fbuf) {
     iptr = ss_ioc_metadata_match(&fbuf->data);
     if (iptr) {
         // match
+        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
+        ss_ioc_hits_record(iptr);
+        rv = ss_suppress_hit("frame_ioc", NULL, nn_queue, iptr,
+            fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4,
+            fbuf->data.sip, fbuf->data.dip, fbuf->data.length);
+        if (rv == 0) {
+            RTE_LOG(DEBUG, EXTRACTOR, "suppressed repeated ioc match from frame\n");
+            return 0;
+        }
         RTE_LOG(NOTICE, EXTRACTOR, "successful ioc match from frame\n");
         ss_ioc_entry_dump_dpdk(iptr);
-        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
         // XXX: figure out what to put into "rule" field
         metadata = ss_metadata_prepare_frame("frame_ioc", NULL, nn_queue, fbuf, iptr);
         // XXX: for now assume the output is C char*
@@ -82,79 +98,99 @@ int ss_extract_eth(ss_frame_t* fbuf) {
     return -1;
 }
 
-int ss_extract_dns(ss_frame_t* fbuf) {
+// dns rule matches past SS_DNS_TRIE_RESULT_MAX in one message, per lcore
+static uint64_t ss_extract_dns_dropped[RTE_MAX_LCORE];
+
+/*
+ * Appends the rules not in dmatches yet, and returns the new count. A rule
+ * which does not fit is counted in dropped.
+ */
+static int ss_extract_dns_rules_add(ss_dns_entry_t** dmatches, int dcount, ss_dns_entry_t** rules, int count, uint64_t* dropped) {
+    for (int i = 0; i < count; ++i) {
+        int j = 0;
+        while (j < dcount && dmatches[j] != rules[i]) ++j;
+        if (j < dcount) continue;
+        if (dcount == SS_DNS_TRIE_RESULT_MAX) {
+            ++*dropped;
+            continue;
+        }
+        dmatches[dcount++] = rules[i];
+    }
+    return dcount;
+}
+
+/*
+ * DNS message extractor function, for a UDP payload or one message taken
+ * out of a TCP stream
+ */
+int ss_extract_dns(ss_frame_t* fbuf, uint8_t* l4_offset, uint16_t l4_length) {
     ss_dns_entry_t* dptr;
-    ss_dns_entry_t* dtmp;
     ss_ioc_entry_t* iptr;
     int rv;
     uint8_t* metadata;
     uint64_t mlength;
     
-    dns_decoded_t   dns_info[DNS_DECODEBUF_4K];
-    dns_query_t*    dns_query;
-    dns_question_t* dns_question;
-    dns_answer_t*   dns_answer;
+    ss_dns_parse_t  dns;
     ss_answer_t*    ss_answer;
-    enum dns_rcode  dns_rv;
-    size_t          dns_info_size = sizeof(dns_info);
     
-    RTE_LOG(INFO, EXTRACTOR, "decode udp dns packet\n");
-    dns_rv = dns_decode(dns_info, &dns_info_size, (dns_packet_t *) fbuf->l4_offset, fbuf->data.l4_length);
-    if (dns_rv != RCODE_OKAY) {
-        RTE_LOG(ERR, EXTRACTOR, "could not decode udp dns packet\n");
+    RTE_LOG(INFO, EXTRACTOR, "decode dns message length %hu\n", l4_length);
+    rv = ss_dns_parse(&dns, &fbuf->data, l4_offset, l4_length);
+    if (rv) {
+        RTE_LOG(ERR, EXTRACTOR, "could not decode dns message\n");
         rte_pktmbuf_dump(stderr, fbuf->mbuf, rte_pktmbuf_pkt_len(fbuf->mbuf));
         return -1;
     }
-    dns_query    = (dns_query_t*) dns_info;
-    dns_question = &dns_query->questions[0];
-    if (dns_question == NULL) {
-        RTE_LOG(ERR, EXTRACTOR, "dns question missing in query\n");
-        return -1;
+    int is_unseen = ss_dns_txn_record(fbuf, &dns);
+    // long names are matched whole, only the exported copy is cut
+    if (dns.name_cut) {
+        RTE_LOG(INFO, EXTRACTOR, "dns question name longer than %d exported cut\n", SS_DNS_NAME_MAX - 1);
     }
     
     RTE_LOG(INFO, EXTRACTOR, "rx dns query for name [%s] type [%s] class [%s]\n",
-        dns_question->name, dns_type_text(dns_question->type), dns_class_text(dns_question->class));
-    strlcpy((char*) &fbuf->data.dns_name, dns_question->name, SS_DNS_NAME_MAX);
-    size_t ancount = dns_query->ancount;
-    if (ancount > SS_DNS_RESULT_MAX) ancount = SS_DNS_RESULT_MAX;
+        dns.name, dns_type_text((enum dns_type) dns.qtype), dns_class_text((enum dns_class) dns.qclass));
+    size_t ancount = dns.answer_count;
+    
+    // responses feed the passive dns names used to enrich address hits
+    if (dns.flags & SS_DNS_FLAG_QR) ss_pdns_answers_add(&fbuf->data, dns.answer_count);
+    
+    // name rules come from the trie, least specific first; a rule can hit
+    // on the question and several answers, so each is only kept once
+    ss_dns_entry_t* dmatches[SS_DNS_TRIE_RESULT_MAX];
+    ss_dns_entry_t* rules[SS_DNS_TRIE_RESULT_MAX];
+    uint64_t dropped = 0;
+    int rcount = ss_dns_trie_match(ss_conf->dns_chain.dns_trie, dns.name, 0,
+        (void**) rules, SS_DNS_TRIE_RESULT_MAX);
+    int dcount = ss_extract_dns_rules_add(dmatches, 0, rules, rcount, &dropped);
+    // a response repeats the question, whose rules were reported with the
+    // query unless that was not seen here; they are kept, so its answers do
+    // not report them again, but skipped
+    int dfirst = (dns.flags & SS_DNS_FLAG_QR) && !is_unseen ? dcount : 0;
     for (size_t i = 0; i < ancount; ++i) {
-        dns_answer = &dns_query->answers[i];
-        rv = ss_extract_dns_atype(&fbuf->data.dns_answers[i], dns_answer);
-        if (rv) {
-            RTE_LOG(ERR, EXTRACTOR, "rx dns query decode failure for name [%s] answer index [%zd]\n",
-                dns_question->name, i);
-        }
+        ss_answer = &fbuf->data.dns_answers[i];
+        if (ss_answer->type != SS_TYPE_NAME) continue;
+        rcount = ss_dns_trie_match(ss_conf->dns_chain.dns_trie, (char*) ss_answer->payload, 0,
+            (void**) rules, SS_DNS_TRIE_RESULT_MAX);
+        dcount = ss_extract_dns_rules_add(dmatches, dcount, rules, rcount, &dropped);
     }
     
-    TAILQ_FOREACH_SAFE(dptr, &ss_conf->dns_chain.dns_list, entry, dtmp) {
-        int is_match = 0;
-        if (dptr->dns[0] && strcasestr(dns_question->name, dptr->dns)) {
-            is_match = 1; goto done;
-        }
-        for (size_t i = 0; i < ancount; ++i) {
-            ss_answer = &fbuf->data.dns_answers[i];
-            switch (ss_answer->type) {
-                case SS_TYPE_NAME: {
-                    if (dptr->dns[0] && strcasestr((char*) ss_answer->payload, dptr->dns)) {
-                        is_match = 1; goto done;
-                    }
-                    break;
-                }
-                case SS_TYPE_IP: {
-                    if (dptr->ip.family && !memcmp(ss_answer->payload, &dptr->ip, sizeof(ip_addr_t))) {
-                        is_match = 1; goto done;
-                    }
-                    break;
-                }
-                default: {
-                    if (ss_answer->type != SS_TYPE_EMPTY)
-                        RTE_LOG(ERR, EXTRACTOR, "unknown ss_answer type %d\n", ss_answer->type);
-                    continue;
-                }
-            }
+    // address rules come from the hash, one lookup per answer
+    for (size_t i = 0; i < ancount; ++i) {
+        ss_answer = &fbuf->data.dns_answers[i];
+        if (ss_answer->type != SS_TYPE_IP) continue;
+        dptr = ss_dns_chain_ip_lookup((ip_addr_t*) ss_answer->payload);
+        for (; dptr; dptr = dptr->ip_next) {
+            dcount = ss_extract_dns_rules_add(dmatches, dcount, &dptr, 1, &dropped);
         }
-        done:
-        if (!is_match) continue;
+    }
+    if (dropped) {
+        unsigned int lcore_id = rte_lcore_id();
+        if (lcore_id < RTE_MAX_LCORE) ss_extract_dns_dropped[lcore_id] += dropped;
+        RTE_LOG(NOTICE, EXTRACTOR, "dns rule matches past %d dropped: %lu, %lu on this lcore\n",
+            SS_DNS_TRIE_RESULT_MAX, dropped, lcore_id < RTE_MAX_LCORE ? ss_extract_dns_dropped[lcore_id] : 0);
+    }
+    
+    for (int i = dfirst; i < dcount; ++i) {
+        dptr = dmatches[i];
         RTE_LOG(NOTICE, EXTRACTOR, "successful match against dns rule %s\n", dptr->name);
         metadata = ss_metadata_prepare_frame("dns_rule", dptr->name, &dptr->nn_queue, fbuf, NULL);
         // XXX: for now assume the output is C string
@@ -163,113 +199,165 @@ int ss_extract_dns(ss_frame_t* fbuf) {
         rv = ss_nn_queue_send(&dptr->nn_queue, metadata, (uint16_t) mlength);
     }
 
-    iptr = ss_ioc_dns_match(&fbuf->data);
+    iptr = ss_ioc_dns_match(dns.name, &fbuf->data);
     if (iptr) {
         // match
+        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
+        ss_ioc_hits_record(iptr);
+        if (!ss_suppress_hit("dns_ioc", NULL, nn_queue, iptr,
+            fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4,
+            fbuf->data.sip, fbuf->data.dip, l4_length)) {
+            RTE_LOG(DEBUG, EXTRACTOR, "suppressed repeated ioc match from dns frame\n");
+            return 0;
+        }
         RTE_LOG(NOTICE, EXTRACTOR, "successful ioc match from dns frame\n");
         ss_ioc_entry_dump_dpdk(iptr);
-        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
         metadata = ss_metadata_prepare_frame("dns_ioc", NULL, nn_queue, fbuf, iptr);
-        // XXX: for now assume the output is C char*
-        mlength = strlen((char*) metadata);
-        //printf("metadata: %s\n", metadata);
-        rv = ss_nn_queue_send(nn_queue, metadata, (uint16_t) mlength);
+        if (metadata) {
+            // XXX: for now assume the output is C char*
+            mlength = strlen((char*) metadata);
+            //printf("metadata: %s\n", metadata);
+            rv = ss_nn_queue_send(nn_queue, metadata, (uint16_t) mlength);
+        }
     }
     
     return 0;
 }
 
-int ss_extract_dns_atype(ss_answer_t* result, dns_answer_t* aptr) {
-    char*        name  = (char*) result->payload;
-    ip_addr_t*   ip    = (ip_addr_t*) result->payload;
+/* reports one matching rule, and its indicator if it had one */
+static int ss_extract_syslog_match(const char* source, ss_frame_t* fbuf, ss_syslog_t* slog, uint16_t l4_length, ss_re_match_t* re_match) {
+    int rv;
+    uint8_t* metadata = NULL;
+    uint64_t mlength = 0;
     
-    result->type = SS_TYPE_EMPTY;
+    if (re_match->re_entry->type == SS_RE_TYPE_COMPLETE) {
+        metadata = ss_metadata_prepare_syslog(
+            source, re_match->re_entry->name, &re_match->re_entry->nn_queue,
+            fbuf, slog, NULL);
+    }
+    else if (re_match->re_entry->type == SS_RE_TYPE_SUBSTRING) {
+        //ss_ioc_entry_dump_dpdk(re_match->ioc_entry);
+        metadata = ss_metadata_prepare_syslog(
+            source, re_match->re_entry->name, &re_match->re_entry->nn_queue,
+            fbuf, slog, re_match->ioc_entry);
+    }
     
-    switch(aptr->generic.type) {
-        case RR_NS: {
-            result->type = SS_TYPE_NAME;
-            strlcpy(name, aptr->ns.nsdname, sizeof(result->payload));
-            break;
-        }
-        case RR_A: {
-            result->type = SS_TYPE_IP;
-            ip->family   = SS_AF_INET4;
-            ip->prefix   = 32;
-            ip->ip4_addr.addr = aptr->a.address;
-            break;
-        }
-        case RR_AAAA: {
-            result->type = SS_TYPE_IP;
-            ip->family   = SS_AF_INET6;
-            ip->prefix   = 128;
-            rte_memcpy(ip->ip6_addr.addr, &aptr->aaaa.address, sizeof(ip->ip6_addr.addr));
-            break;
-        }
-        case RR_CNAME: {
-            result->type = SS_TYPE_NAME;
-            strlcpy(name, aptr->cname.cname, sizeof(result->payload));
-            break;
-        }
-        case RR_MX: {
-            result->type = SS_TYPE_NAME;
-            strlcpy(name, aptr->mx.exchange, sizeof(result->payload));
-            break;
-        }
-        case RR_PTR: {
-            result->type = SS_TYPE_NAME;
-            strlcpy(name, aptr->ptr.ptr, sizeof(result->payload));
-            break;
+    if (metadata) {
+        // XXX: for now assume the output is C char*
+        mlength = strlen((char*) metadata);
+        rv = ss_nn_queue_send(&re_match->re_entry->nn_queue, metadata, (uint16_t) mlength);
+    }
+    else {
+        RTE_LOG(ERR, EXTRACTOR, "unexpected state matching against syslog rule %s\n", re_match->re_entry->name);
+        rv = -1;
+    }
+    
+    // like frame and netflow matches, also report the indicator
+    // to the queue of the ioc_file it came from
+    if (re_match->ioc_entry) {
+        nn_queue_t* nn_queue = &ss_conf->ioc_files[re_match->ioc_entry->file_id].nn_queue;
+        ss_ioc_hits_record(re_match->ioc_entry);
+        if (!ss_suppress_hit("syslog_ioc", re_match->re_entry->name, nn_queue, re_match->ioc_entry,
+            fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4,
+            fbuf->data.sip, fbuf->data.dip, l4_length)) {
+            return rv;
         }
-        default: {
-            fprintf(stderr, "unknown dns answer type %d\n", aptr->generic.type);
-            memset(result, 0, sizeof(ss_answer_t));
-            break;
+        metadata = ss_metadata_prepare_syslog(
+            "syslog_ioc", re_match->re_entry->name, nn_queue,
+            fbuf, slog, re_match->ioc_entry);
+        if (metadata) {
+            // XXX: for now assume the output is C char*
+            mlength = strlen((char*) metadata);
+            ss_nn_queue_send(nn_queue, metadata, (uint16_t) mlength);
         }
     }
     
-    error_out:
-    return -1;
+    return rv;
 }
 
 int ss_extract_syslog(const char* source, ss_frame_t* fbuf, uint8_t* l4_offset, uint16_t l4_length) {
-    int rv;
-    uint8_t* metadata = NULL;
-    uint64_t mlength = 0;
-    ss_re_match_t re_match;
+    int rv = 0;
+    int match_count;
+    ss_re_match_t re_matches[SS_RE_MATCH_RESULT_MAX];
+    ss_syslog_t slog;
 
     RTE_LOG(INFO, EXTRACTOR, "attempt syslog match port %u frame direction %d payload length %hu\n",
         fbuf->data.port_id, fbuf->data.direction,
         l4_length);
     
-    rv = ss_re_chain_match(&re_match, l4_offset, l4_length);
-    if (rv <= 0 || re_match.re_entry == NULL) {
-        RTE_LOG(DEBUG, EXTRACTOR, "no match against syslog rule %s\n", re_match.re_entry->name);
+    // parsed once here, for the rules scoped to fields and for the metadata
+    if (ss_syslog_parse(&slog, l4_offset, l4_length)) {
+        RTE_LOG(FINE, EXTRACTOR, "no syslog header found, match whole payload\n");
+    }
+    
+    match_count = ss_re_chain_match(re_matches, SS_RE_MATCH_RESULT_MAX, &slog);
+    if (match_count <= 0) {
+        RTE_LOG(DEBUG, EXTRACTOR, "no match against syslog rules\n");
         return 0;
     }
     
-    if (re_match.re_entry->type == SS_RE_TYPE_COMPLETE) {
-        // include length of null byte
-        metadata = ss_metadata_prepare_syslog(
-            source, re_match.re_entry->name, &re_match.re_entry->nn_queue,
-            fbuf, l4_offset, l4_length, NULL);
+    for (int i = 0; i < match_count; ++i) {
+        if (ss_extract_syslog_match(source, fbuf, &slog, l4_length, &re_matches[i])) rv = -1;
     }
-    else if (re_match.re_entry->type == SS_RE_TYPE_SUBSTRING) {
-        //ss_ioc_entry_dump_dpdk(re_match.ioc_entry);
-        // include length of null byte
-        metadata = ss_metadata_prepare_syslog(
-            source, re_match.re_entry->name, &re_match.re_entry->nn_queue,
-            fbuf, l4_offset, l4_length, re_match.ioc_entry);
+    
+    return rv;
+}
+
+/*
+ * HTTP request head extractor function, for the first request of a
+ * followed port 80 connection. The normalized url is checked against the
+ * url IOCs, then without its query, then its host against the domain IOCs.
+ * The full url is known here, so the hosts of url IOCs are not looked up
+ * on their own.
+ */
+int ss_extract_http(ss_frame_t* fbuf, uint8_t* l4_offset, uint16_t l4_length) {
+    ss_http_request_t http;
+    ss_ioc_entry_t* iptr;
+    char url[SS_HTTP_URL_MAX];
+    int url_length;
+    const char* query;
+    const char* host;
+    uint8_t* metadata;
+    uint64_t mlength;
+    
+    if (ss_http_request_parse(&http, l4_offset, l4_length)) {
+        RTE_LOG(DEBUG, EXTRACTOR, "could not parse http request head length %hu\n", l4_length);
+        return -1;
+    }
+    url_length = ss_http_url_normalize(&http, url, sizeof(url));
+    if (url_length < 0) {
+        RTE_LOG(DEBUG, EXTRACTOR, "no url in http %.*s request\n", http.method.length, http.method.data);
+        return 0;
+    }
+    RTE_LOG(INFO, EXTRACTOR, "rx http request %.*s %s\n", http.method.length, http.method.data, url);
+    
+    iptr  = ss_ioc_syslog_match(url, (size_t) url_length, SS_IOC_TYPE_URL);
+    query = memchr(url, '?', (size_t) url_length);
+    if (iptr == NULL && query) {
+        iptr = ss_ioc_syslog_match(url, (size_t) (query - url), SS_IOC_TYPE_URL);
     }
+    if (iptr == NULL) {
+        host = url + strlen("http://");
+        iptr = ss_ioc_domain_match(host, strcspn(host, ":/"), 0);
+    }
+    if (iptr == NULL) return 0;
     
+    nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
+    ss_ioc_hits_record(iptr);
+    if (!ss_suppress_hit("http_ioc", NULL, nn_queue, iptr,
+        fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4,
+        fbuf->data.sip, fbuf->data.dip, l4_length)) {
+        RTE_LOG(DEBUG, EXTRACTOR, "suppressed repeated ioc match from http request\n");
+        return 0;
+    }
+    RTE_LOG(NOTICE, EXTRACTOR, "successful ioc match from http request\n");
+    ss_ioc_entry_dump_dpdk(iptr);
+    metadata = ss_metadata_prepare_http("http_ioc", NULL, nn_queue, fbuf, &http, url, iptr);
     if (metadata) {
         // XXX: for now assume the output is C char*
         mlength = strlen((char*) metadata);
-        rv = ss_nn_queue_send(&re_match.re_entry->nn_queue, metadata, (uint16_t) mlength);
-    }
-    else {
-        RTE_LOG(ERR, EXTRACTOR, "unexpected state matching against syslog rule %s\n", re_match.re_entry->name);
-        rv = -1;
+        ss_nn_queue_send(nn_queue, metadata, (uint16_t) mlength);
     }
     
-    return rv;
+    return 0;
 }
@@ -0,0 +1,80 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hex_utils.h"
+
+/* nibble value of each hex digit, 0xff for anything else */
+static const uint8_t ss_hex_values[256] = {
+    ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+    ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+    ['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+    ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d, ['E'] = 0x1e, ['F'] = 0x1f,
+};
+
+static const char ss_hex_digits[] = "0123456789abcdef";
+
+static inline int ss_hex_decode_scalar(uint8_t* dst, const char* src, size_t length) {
+    for (size_t i = 0; i < length; i += 2) {
+        // NOTE: table entries are biased by 0x10, so a zero marks a bad digit
+        uint8_t hi = ss_hex_values[(uint8_t) src[i]];
+        uint8_t lo = ss_hex_values[(uint8_t) src[i + 1]];
+        if (!hi || !lo) return -1;
+        dst[i / 2] = (uint8_t) (((hi & 0x0f) << 4) | (lo & 0x0f));
+    }
+    return 0;
+}
+
+/*
+ * Decode length hex digits (either case) from src into length / 2 bytes.
+ * Returns -1 on an odd length or a character which is not a hex digit.
+ *
+ * The SSE2 loop validates and converts 16 digits per iteration: a digit's
+ * low nibble is its value, plus 9 for letters, then adjacent nibbles are
+ * merged in 16-bit lanes and packed down to 8 bytes.
+ */
+int ss_hex_decode(uint8_t* dst, const char* src, size_t length) {
+    if (length % 2) return -1;
+    
+#ifdef __SSE2__
+    const __m128i digit_lo = _mm_set1_epi8('0' - 1);
+    const __m128i digit_hi = _mm_set1_epi8('9' + 1);
+    const __m128i alpha_lo = _mm_set1_epi8('a' - 1);
+    const __m128i alpha_hi = _mm_set1_epi8('f' + 1);
+    const __m128i lower    = _mm_set1_epi8(0x20);
+    const __m128i nibble   = _mm_set1_epi8(0x0f);
+    const __m128i nine     = _mm_set1_epi8(9);
+    const __m128i low_byte = _mm_set1_epi16(0x00ff);
+    
+    for (; length >= 16; length -= 16, src += 16, dst += 8) {
+        __m128i chars = _mm_loadu_si128((const __m128i*) src);
+        __m128i folded = _mm_or_si128(chars, lower);
+        // bytes above 0x7f compare as negative, so they fail both ranges
+        __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(chars, digit_lo), _mm_cmplt_epi8(chars, digit_hi));
+        __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(folded, alpha_lo), _mm_cmplt_epi8(folded, alpha_hi));
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xffff) return -1;
+        
+        __m128i values = _mm_add_epi8(_mm_and_si128(chars, nibble), _mm_and_si128(is_alpha, nine));
+        // little endian lanes hold (first digit, second digit)
+        __m128i merged = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(values, low_byte), 4),
+            _mm_srli_epi16(values, 8));
+        _mm_storel_epi64((__m128i*) dst, _mm_packus_epi16(merged, merged));
+    }
+#endif
+    
+    return ss_hex_decode_scalar(dst, src, length);
+}
+
+/* writes length * 2 lowercase digits and a NUL, returns the digit count */
+size_t ss_hex_encode(char* dst, const uint8_t* src, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        dst[i * 2]     = ss_hex_digits[src[i] >> 4];
+        dst[i * 2 + 1] = ss_hex_digits[src[i] & 0x0f];
+    }
+    dst[length * 2] = '\0';
+    return length * 2;
+}
@@ -0,0 +1,21 @@
+#ifndef __HEX_UTILS_H__
+#define __HEX_UTILS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CONSTANTS */
+
+#define SS_MD5_SIZE      16
+#define SS_SHA1_SIZE     20
+#define SS_SHA256_SIZE   32
+#define SS_DIGEST_MAX    SS_SHA256_SIZE
+
+/* BEGIN PROTOTYPES */
+
+int ss_hex_decode(uint8_t* dst, const char* src, size_t length);
+size_t ss_hex_encode(char* dst, const uint8_t* src, size_t length);
+
+/* END PROTOTYPES */
+
+#endif /* __HEX_UTILS_H__ */
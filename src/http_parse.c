@@ -0,0 +1,186 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "http_parse.h"
+
+/*
+ * Splits the head of an HTTP/1.x request into views of the payload, and
+ * turns its target into the "http://host/path" form url IOCs are kept in.
+ * Only what names the resource is kept: the request line, Host and
+ * User-Agent.
+ */
+
+static inline int ss_http_is_token(char c) {
+    return c >= 'A' && c <= 'Z';
+}
+
+static inline int ss_http_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* RFC 3986 2.3, which may be decoded without changing the URL */
+static inline int ss_http_is_unreserved(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+/*
+ * Returns the length of the request head at data, up to and including
+ * the empty line, 0 if it has not all arrived, or -1 if data does not
+ * start like a request. Senders may end lines with a bare LF.
+ */
+int ss_http_head_length(const uint8_t* data, uint16_t length) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + length;
+    uint16_t i = 0;
+
+    // the method is upper case letters, then a space
+    while (i < length && i <= SS_HTTP_METHOD_MAX && ss_http_is_token((char) data[i])) ++i;
+    if (i < length && (i == 0 || i > SS_HTTP_METHOD_MAX || data[i] != ' ')) return -1;
+
+    while ((p = memchr(p, '\n', (size_t) (end - p))) != NULL) {
+        ++p;
+        if (p < end && *p == '\n')                              return (int) (p + 1 - data);
+        if (p + 1 < end && p[0] == '\r' && p[1] == '\n')        return (int) (p + 2 - data);
+    }
+    return 0;
+}
+
+/* one line of the head, without its line end */
+static uint16_t ss_http_line_get(const char* p, uint16_t length, uint16_t offset, ss_http_view_t* line) {
+    uint16_t i = offset;
+
+    while (i < length && p[i] != '\n') ++i;
+    line->data   = p + offset;
+    line->length = (uint16_t) (i - offset);
+    if (line->length && line->data[line->length - 1] == '\r') --line->length;
+    return (uint16_t) (i < length ? i + 1 : i);
+}
+
+static void ss_http_header_get(ss_http_view_t* line, const char* name, size_t name_length, ss_http_view_t* value) {
+    const char* p = line->data + name_length + 1;
+    const char* end = line->data + line->length;
+
+    if (line->length <= name_length || line->data[name_length] != ':') return;
+    if (strncasecmp(line->data, name, name_length)) return;
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    value->data   = p;
+    value->length = (uint16_t) (end - p);
+}
+
+/*
+ * Fills in http from the request head of length bytes at data, as
+ * measured by ss_http_head_length. Returns 0, or -1 if the request line
+ * is not METHOD SP target SP HTTP/1.x.
+ */
+int ss_http_request_parse(ss_http_request_t* http, const uint8_t* data, uint16_t length) {
+    const char* p = (const char*) data;
+    ss_http_view_t line;
+    const char* sp1;
+    const char* sp2;
+    uint16_t offset;
+
+    memset(http, 0, sizeof(*http));
+
+    offset = ss_http_line_get(p, length, 0, &line);
+    sp1 = memchr(line.data, ' ', line.length);
+    if (sp1 == NULL) return -1;
+    sp2 = memchr(sp1 + 1, ' ', (size_t) (line.data + line.length - sp1 - 1));
+    if (sp2 == NULL || sp2 == sp1 + 1) return -1;
+    http->method  = (ss_http_view_t) { line.data, (uint16_t) (sp1 - line.data) };
+    http->uri     = (ss_http_view_t) { sp1 + 1, (uint16_t) (sp2 - sp1 - 1) };
+    http->version = (ss_http_view_t) { sp2 + 1, (uint16_t) (line.data + line.length - sp2 - 1) };
+    if (http->version.length != 8 || memcmp(http->version.data, "HTTP/1.", 7)) return -1;
+
+    while (offset < length) {
+        offset = ss_http_line_get(p, length, offset, &line);
+        if (line.length == 0) break;
+        if (http->host.length == 0)       ss_http_header_get(&line, "host", 4, &http->host);
+        if (http->user_agent.length == 0) ss_http_header_get(&line, "user-agent", 10, &http->user_agent);
+    }
+    return 0;
+}
+
+/*
+ * Writes "http://host/path?query" for the request into url, and returns
+ * its length, or -1 if there is no host or it does not fit. The host is
+ * taken from an absolute target, else from Host, and is lower cased
+ * without a default port or trailing dot. In the path, escaped unreserved
+ * characters are decoded and any fragment is dropped.
+ */
+int ss_http_url_normalize(ss_http_request_t* http, char* url, size_t size) {
+    const char* target = http->uri.data;
+    const char* end    = http->uri.data + http->uri.length;
+    const char* host   = http->host.data;
+    const char* host_end;
+    size_t i = 0;
+
+    if (http->uri.length > 7 && !strncasecmp(target, "http://", 7)) {
+        host     = target + 7;
+        host_end = memchr(host, '/', (size_t) (end - host));
+        target   = host_end ? host_end : end;
+        host_end = target;
+    }
+    else if (target < end && *target == '/') {
+        host_end = host ? host + http->host.length : NULL;
+    }
+    else {
+        // "*" for OPTIONS, or host:port for CONNECT
+        return -1;
+    }
+    if (host == NULL || host_end == host) return -1;
+
+    // userinfo is not part of the host
+    for (const char* at = host; at < host_end; ++at) {
+        if (*at == '@') host = at + 1;
+    }
+    if (host_end - host > 3 && !memcmp(host_end - 3, ":80", 3)) host_end -= 3;
+    if (host_end > host && host_end[-1] == '.') --host_end;
+    if (host_end == host || (size_t) (host_end - host) + 8 >= size) return -1;
+
+    memcpy(url, "http://", 7);
+    i = 7;
+    for (const char* c = host; c < host_end; ++c) {
+        url[i++] = (*c >= 'A' && *c <= 'Z') ? (char) (*c + ('a' - 'A')) : *c;
+    }
+
+    if (target == end) url[i++] = '/';
+    for (const char* c = target; c < end && *c != '#'; ++c) {
+        char ch = *c;
+        if (ch == '%' && end - c > 2) {
+            int hi = ss_http_hex_value(c[1]);
+            int lo = ss_http_hex_value(c[2]);
+            if (hi >= 0 && lo >= 0 && ss_http_is_unreserved((char) (hi << 4 | lo))) {
+                ch = (char) (hi << 4 | lo);
+                c += 2;
+            }
+        }
+        if (i + 1 >= size) return -1;
+        url[i++] = ch;
+    }
+    url[i] = '\0';
+    return (int) i;
+}
+
+/*
+ * Normalizes the absolute "http://" url of length bytes at value, which
+ * need not be NUL terminated, such as a url IOC or a url seen in syslog,
+ * the same way as the target of a request, so they compare as strings.
+ * Returns its length, or -1 if it is not an http url with a host or does
+ * not fit.
+ */
+int ss_http_url_value_normalize(const char* value, size_t length, char* url, size_t size) {
+    ss_http_request_t http;
+
+    if (length <= 7 || length > SS_HTTP_URL_MAX || strncasecmp(value, "http://", 7)) return -1;
+    memset(&http, 0, sizeof(http));
+    http.uri.data   = value;
+    http.uri.length = (uint16_t) length;
+    return ss_http_url_normalize(&http, url, size);
+}
@@ -0,0 +1,43 @@
+#ifndef __HTTP_PARSE_H__
+#define __HTTP_PARSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CONSTANTS */
+
+#define SS_HTTP_HEAD_MAX     8192 /* a longer request head is not parsed */
+#define SS_HTTP_URL_MAX      2048
+#define SS_HTTP_METHOD_MAX     16
+
+/* DATA TYPES */
+
+/* a piece of the request head, not NUL terminated, empty when length is 0 */
+struct ss_http_view_s {
+    const char* data;
+    uint16_t    length;
+};
+
+typedef struct ss_http_view_s ss_http_view_t;
+
+/* the parts of an HTTP/1.x request head which name what is fetched */
+struct ss_http_request_s {
+    ss_http_view_t method;
+    ss_http_view_t uri;
+    ss_http_view_t version;
+    ss_http_view_t host;
+    ss_http_view_t user_agent;
+};
+
+typedef struct ss_http_request_s ss_http_request_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_http_head_length(const uint8_t* data, uint16_t length);
+int ss_http_request_parse(ss_http_request_t* http, const uint8_t* data, uint16_t length);
+int ss_http_url_normalize(ss_http_request_t* http, char* url, size_t size);
+int ss_http_url_value_normalize(const char* value, size_t length, char* url, size_t size);
+
+/* END PROTOTYPES */
+
+#endif /* __HTTP_PARSE_H__ */
@@ -1,5 +1,9 @@
 #define _GNU_SOURCE /* strcasestr */
 
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -7,6 +11,8 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <bsd/string.h>
 #include <bsd/sys/queue.h>
@@ -16,11 +22,17 @@
 #include <json-c/json.h>
 #include <json-c/json_object_private.h>
 
+#include <rte_atomic.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
 #include <rte_log.h>
+#include <rte_prefetch.h>
 
 #include "ioc.h"
 
 #include "common.h"
+#include "dns_parse.h"
+#include "http_parse.h"
 #include "ip_utils.h"
 #include "je_utils.h"
 #include "json.h"
@@ -38,6 +50,139 @@
 #define SS_IOC_HTTP_URL  "http://"
 #define SS_IOC_HTTPS_URL "https://"
 
+#define SS_IOC_DELTA_SUFFIX       ".csv"
+#define SS_IOC_SYNCHRONIZE_USEC   100
+#define SS_IOC_IP_HASH_INIT       0x9e3779b9
+
+struct ss_ioc_lcore_s {
+    volatile uint64_t generation;
+} __rte_cache_aligned;
+
+typedef struct ss_ioc_lcore_s ss_ioc_lcore_t;
+
+/* table generation each lcore was running when it last went quiescent */
+static ss_ioc_lcore_t ss_ioc_lcores[RTE_MAX_LCORE];
+
+/* coarse wall clock for expiry, ticked by the update thread */
+static volatile uint32_t ss_ioc_clock;
+static uint32_t ss_ioc_next_expire = UINT32_MAX;
+
+/* removed entries which the current tables may still reference */
+static ss_ioc_list_t ss_ioc_retired = TAILQ_HEAD_INITIALIZER(ss_ioc_retired);
+
+static ss_ioc_stats_t ss_ioc_stats;
+
+/* hides indicators whose ttl ran out before the next rebuild or sweep */
+static inline ss_ioc_entry_t* ss_ioc_entry_live(ss_ioc_entry_t* iptr) {
+    if (iptr && iptr->expire_time && iptr->expire_time <= ss_ioc_clock) return NULL;
+    return iptr;
+}
+
+#ifdef SS_IOC_BACKEND_DISK
+struct ss_ioc_mdb_lcore_s {
+    MDB_txn*       txn;
+    ss_ioc_entry_t entry;
+    ss_ioc_entry_t bulk[SS_IOC_BULK_MAX];
+} __rte_cache_aligned;
+
+typedef struct ss_ioc_mdb_lcore_s ss_ioc_mdb_lcore_t;
+
+// one extra slot for threads which are not EAL lcores
+static ss_ioc_mdb_lcore_t ss_ioc_mdb_lcores[RTE_MAX_LCORE + 1];
+
+static size_t ss_ioc_record_encode(ss_ioc_record_t* record, size_t size, ss_ioc_entry_t* iptr) {
+    size_t value_length = strlen(iptr->value);
+    size_t dns_length   = strlen(iptr->dns);
+    size_t length       = sizeof(*record) + value_length + 1 + dns_length + 1;
+    
+    if (length > size) return 0;
+    record->id           = iptr->id;
+    record->ip           = iptr->ip;
+    memcpy(record->threat_type, iptr->threat_type, sizeof(record->threat_type));
+    record->file_id      = (uint8_t) iptr->file_id;
+    record->type         = (uint8_t) iptr->type;
+    record->dns_match    = (uint8_t) iptr->dns_match;
+    record->value_length = (uint8_t) value_length;
+    record->expire_time  = iptr->expire_time;
+    memcpy(record->strings, iptr->value, value_length + 1);
+    memcpy(record->strings + value_length + 1, iptr->dns, dns_length + 1);
+    return length;
+}
+
+static ss_ioc_entry_t* ss_ioc_record_decode(MDB_val* value, ss_ioc_entry_t* iptr) {
+    ss_ioc_record_t* record = (ss_ioc_record_t*) value->mv_data;
+    
+    if (value->mv_size < sizeof(*record) + 2) return NULL;
+    if (value->mv_size < sizeof(*record) + record->value_length + 2) return NULL;
+    iptr->id        = record->id;
+    iptr->ip        = record->ip;
+    memcpy(iptr->threat_type, record->threat_type, sizeof(iptr->threat_type));
+    iptr->file_id   = record->file_id;
+    iptr->type      = (ss_ioc_type_t) record->type;
+    iptr->dns_match = (ss_dns_match_t) record->dns_match;
+    iptr->expire_time = record->expire_time;
+    strlcpy(iptr->value, record->strings, sizeof(iptr->value));
+    strlcpy(iptr->dns, record->strings + record->value_length + 1,
+        SS_MIN(sizeof(iptr->dns), value->mv_size - sizeof(*record) - record->value_length - 1));
+    return iptr;
+}
+
+/*
+ * Each lcore keeps one read transaction open between timer ticks, instead
+ * of paying for mdb_txn_begin and mdb_txn_abort on every lookup.
+ */
+static ss_ioc_mdb_lcore_t* ss_ioc_mdb_lcore_get() {
+    int rv;
+    unsigned int lcore_id = rte_lcore_id();
+    if (lcore_id >= RTE_MAX_LCORE) lcore_id = RTE_MAX_LCORE;
+    ss_ioc_mdb_lcore_t* lcore = &ss_ioc_mdb_lcores[lcore_id];
+    
+    if (lcore->txn == NULL) {
+        rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &lcore->txn);
+        if (rv) {
+            RTE_LOG(ERR, IOC, "could not begin ioc mdb read transaction: %s\n", mdb_strerror(rv));
+            lcore->txn = NULL;
+            return NULL;
+        }
+    }
+    return lcore;
+}
+
+/* the result lives in per-lcore storage until the next lookup on the lcore */
+static ss_ioc_entry_t* ss_ioc_mdb_get(MDB_dbi dbi, const void* data, size_t size) {
+    int      rv;
+    MDB_val  key, value;
+    ss_ioc_mdb_lcore_t* lcore = ss_ioc_mdb_lcore_get();
+    
+    if (lcore == NULL) return NULL;
+    key.mv_size = size;
+    key.mv_data = (void*) data;
+    rv = mdb_get(lcore->txn, dbi, &key, &value);
+    if (rv) {
+        if (rv != MDB_NOTFOUND) RTE_LOG(ERR, IOC, "could not read ioc mdb: %s\n", mdb_strerror(rv));
+        return NULL;
+    }
+    return ss_ioc_entry_live(ss_ioc_record_decode(&value, &lcore->entry));
+}
+
+static MDB_dbi ss_ioc_digest_dbi_get(ss_ioc_type_t ioc_type) {
+    switch (ioc_type) {
+        case SS_IOC_TYPE_MD5:    return ss_conf->md5_dbi;
+        case SS_IOC_TYPE_SHA1:   return ss_conf->sha1_dbi;
+        default:                 return ss_conf->sha256_dbi;
+    }
+}
+
+/* bulk results need their own copies, since each lookup reuses the entry */
+static ss_ioc_entry_t* ss_ioc_mdb_bulk_save(unsigned int index, ss_ioc_entry_t* iptr) {
+    if (iptr == NULL) return NULL;
+    ss_ioc_mdb_lcore_t* lcore = ss_ioc_mdb_lcore_get();
+    if (lcore == NULL) return NULL;
+    lcore->bulk[index] = *iptr;
+    return &lcore->bulk[index];
+}
+#endif
+
 int ss_ioc_file_load(json_object* ioc_json) {
     int rv = -1;
     uint64_t id;
@@ -63,12 +208,42 @@ int ss_ioc_file_load(json_object* ioc_json) {
         goto error_out;
     }
     
+    // how domain indicators match names below them, unless prefixed by "*."
+    const char* dns_match = ss_json_string_view(ioc_json, "dns_match");
+    ioc_file->dns_match = dns_match ? ss_dns_match_load(dns_match) : SS_DNS_MATCH_SUFFIX;
+    if ((int) ioc_file->dns_match == -1) {
+        fprintf(stderr, "ioc_file %s dns_match is invalid\n", ioc_file->path);
+        goto error_out;
+    }
+    
+    // default lifetime for indicators without their own ttl field
+    json_object* item = json_object_object_get(ioc_json, "ttl");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "ioc_file %s ttl is not valid seconds\n", ioc_file->path);
+            goto error_out;
+        }
+        ioc_file->ttl = (uint32_t) json_object_get_int64(item);
+    }
+    
+    // directory polled for add / del delta files
+    ioc_file->delta_path = ss_json_string_get(ioc_json, "delta_path");
+    
     rv = ss_nn_queue_create(ioc_json, &ioc_file->nn_queue);
     if (rv) {
         fprintf(stderr, "could not allocate ioc_file %s nm_queue\n", ioc_file->path);
         goto error_out;
     }
     
+#ifdef SS_IOC_BACKEND_DISK
+    if (ss_conf->mdb_is_loaded) {
+        fprintf(stderr, "using indicators for ioc file %s from existing mdb\n", ioc_file->path);
+        rv = 0;
+        goto error_out;
+    }
+#endif
+    
     ioc_fd = fopen(ioc_file->path, "r");
     if (ioc_fd == NULL) {
         fprintf(stderr, "could not open ioc file %s: %s\n",
@@ -77,8 +252,8 @@ int ss_ioc_file_load(json_object* ioc_json) {
     }
     
     ssize_t grv;
-    char* ioc_str;
-    size_t ioc_len;
+    char* ioc_str = NULL;
+    size_t ioc_len = 0;
     ss_ioc_entry_t* ioc;
     uint64_t line = 0;
     uint64_t indicators = 0;
@@ -115,13 +290,18 @@ int ss_ioc_file_load(json_object* ioc_json) {
     }
     
     fprintf(stderr, "loaded %lu IOCs from %s\n", indicators, ioc_file->path);
+    if (ioc_str) free(ioc_str);
     rv = 0;
     
     error_out:
-    if (ioc_file->path) je_free(ioc_file->path);
     if (ioc_fd)         fclose(ioc_fd);
+    // NOTE: on success, path and delta_path are kept for log messages and updates
     if (rv != 0) {
         fprintf(stderr, "ioc_file %s could not be loaded\n", ioc_file->path);
+        if (ioc_file->path)       je_free(ioc_file->path);
+        if (ioc_file->delta_path) je_free(ioc_file->delta_path);
+        ioc_file->path       = NULL;
+        ioc_file->delta_path = NULL;
     }
     
     return rv;
@@ -143,23 +323,45 @@ int ss_ioc_chain_dump(uint64_t limit) {
     return 0;
 }
 
+#ifdef SS_IOC_BACKEND_RAM
+static int ss_ioc_domain_dump(const char* name, ss_dns_match_t match, void* value) {
+    fprintf(stderr, "domain_table entry %s match %s\n", name, ss_dns_match_dump(match));
+    return ss_ioc_entry_dump((ss_ioc_entry_t*) value);
+}
+
+static int ss_ioc_host_dump(const char* name, ss_dns_match_t match, void* value) {
+    fprintf(stderr, "host_table entry %s match %s\n", name, ss_dns_match_dump(match));
+    return ss_ioc_entry_dump((ss_ioc_entry_t*) value);
+}
+#endif
+
 int ss_ioc_tables_dump(uint64_t limit) {
     uint64_t counter;
     ss_ioc_entry_t* iptr;
 #ifdef SS_IOC_BACKEND_RAM
     ss_ioc_entry_t* itmp;
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) return -1;
+    int g = tables->generation % SS_IOC_GENERATIONS;
 #elif SS_IOC_BACKEND_DISK
     int rv;
     MDB_txn*    txn;
     MDB_cursor* cursor;
     MDB_val     key, value;
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, 0, &txn);
+    ss_ioc_entry_t ioc;
+    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
+    if (rv) {
+        fprintf(stderr, "could not begin ioc dump mdb transaction: %s\n", mdb_strerror(rv));
+        return -1;
+    }
 #endif
     
     counter = 1;
     fprintf(stderr, "dumping %lu entries from ip4_table...\n", limit);
 #ifdef SS_IOC_BACKEND_RAM
-    HASH_ITER(hh, ss_conf->ip4_table, iptr, itmp) {
+    for (uint32_t i = 0; tables->ip4_table.slots && i <= tables->ip4_table.mask; ++i) {
+        iptr = tables->ip4_table.slots[i].entry;
+        if (iptr == NULL) continue;
         fprintf(stderr, "ip4_table entry number %lu\n", counter);
         ss_ioc_entry_dump(iptr);
         counter++;
@@ -169,8 +371,8 @@ int ss_ioc_tables_dump(uint64_t limit) {
     rv = mdb_cursor_open(txn, ss_conf->ip4_dbi, &cursor);
     while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
         fprintf(stderr, "ip4_table entry number %lu\n", counter);
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        ss_ioc_entry_dump(iptr);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
@@ -180,7 +382,9 @@ int ss_ioc_tables_dump(uint64_t limit) {
     counter = 1;
     fprintf(stderr, "dumping %lu entries from ip6_table...\n", limit);
 #ifdef SS_IOC_BACKEND_RAM
-    HASH_ITER(hh, ss_conf->ip6_table, iptr, itmp) {
+    for (uint32_t i = 0; tables->ip6_table.slots && i <= tables->ip6_table.mask; ++i) {
+        iptr = tables->ip6_table.slots[i].entry;
+        if (iptr == NULL) continue;
         fprintf(stderr, "ip6_table entry number %lu\n", counter);
         ss_ioc_entry_dump(iptr);
         counter++;
@@ -190,8 +394,8 @@ int ss_ioc_tables_dump(uint64_t limit) {
     rv = mdb_cursor_open(txn, ss_conf->ip6_dbi, &cursor);
     while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
         fprintf(stderr, "ip6_table entry number %lu\n", counter);
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        ss_ioc_entry_dump(iptr);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
@@ -201,18 +405,29 @@ int ss_ioc_tables_dump(uint64_t limit) {
     counter = 1;
     fprintf(stderr, "dumping %lu entries from domain_table...\n", limit);
 #ifdef SS_IOC_BACKEND_RAM
-    HASH_ITER(hh, ss_conf->domain_table, iptr, itmp) {
+    ss_dns_trie_dump(tables->domain_table, limit ? limit : UINT64_MAX, &ss_ioc_domain_dump);
+#elif SS_IOC_BACKEND_DISK
+    rv = mdb_cursor_open(txn, ss_conf->domain_dbi, &cursor);
+    while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
         fprintf(stderr, "domain_table entry number %lu\n", counter);
-        ss_ioc_entry_dump(iptr);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
+    mdb_cursor_close(cursor);
+#endif
+    
+    counter = 1;
+    fprintf(stderr, "dumping %lu entries from host_table...\n", limit);
+#ifdef SS_IOC_BACKEND_RAM
+    ss_dns_trie_dump(tables->host_table, limit ? limit : UINT64_MAX, &ss_ioc_host_dump);
 #elif SS_IOC_BACKEND_DISK
-    rv = mdb_cursor_open(txn, ss_conf->domain_dbi, &cursor);
+    rv = mdb_cursor_open(txn, ss_conf->host_dbi, &cursor);
     while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
-        fprintf(stderr, "domain_table entry number %lu\n", counter);
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        ss_ioc_entry_dump(iptr);
+        fprintf(stderr, "host_table entry number %lu\n", counter);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
@@ -222,7 +437,7 @@ int ss_ioc_tables_dump(uint64_t limit) {
     counter = 1;
     fprintf(stderr, "dumping %lu entries from url_table...\n", limit);
 #ifdef SS_IOC_BACKEND_RAM
-    HASH_ITER(hh_full, ss_conf->url_table, iptr, itmp) {
+    HASH_ITER(hh_full[g], tables->url_table, iptr, itmp) {
         fprintf(stderr, "url_table entry number %lu\n", counter);
         ss_ioc_entry_dump(iptr);
         counter++;
@@ -232,8 +447,8 @@ int ss_ioc_tables_dump(uint64_t limit) {
     rv = mdb_cursor_open(txn, ss_conf->url_dbi, &cursor);
     while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
         fprintf(stderr, "url_table entry number %lu\n", counter);
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        ss_ioc_entry_dump(iptr);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
@@ -243,7 +458,7 @@ int ss_ioc_tables_dump(uint64_t limit) {
     counter = 1;
     fprintf(stderr, "dumping %lu entries from email_table...\n", limit);
 #ifdef SS_IOC_BACKEND_RAM
-    HASH_ITER(hh_full, ss_conf->email_table, iptr, itmp) {
+    HASH_ITER(hh_full[g], tables->email_table, iptr, itmp) {
         fprintf(stderr, "email_table entry number %lu\n", counter);
         ss_ioc_entry_dump(iptr);
         counter++;
@@ -253,14 +468,43 @@ int ss_ioc_tables_dump(uint64_t limit) {
     rv = mdb_cursor_open(txn, ss_conf->email_dbi, &cursor);
     while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
         fprintf(stderr, "email_table entry number %lu\n", counter);
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        ss_ioc_entry_dump(iptr);
+        iptr = ss_ioc_record_decode(&value, &ioc);
+        if (iptr) ss_ioc_entry_dump(iptr);
         counter++;
         if (limit && counter > limit) break;
     }
     mdb_cursor_close(cursor);
 #endif
 
+    const char* digest_names[] = { "md5_table", "sha1_table", "sha256_table" };
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_entry_t* digest_tables[] = { tables->md5_table, tables->sha1_table, tables->sha256_table };
+#elif SS_IOC_BACKEND_DISK
+    MDB_dbi digest_dbis[] = { ss_conf->md5_dbi, ss_conf->sha1_dbi, ss_conf->sha256_dbi };
+#endif
+    for (int i = 0; i < 3; ++i) {
+        counter = 1;
+        fprintf(stderr, "dumping %lu entries from %s...\n", limit, digest_names[i]);
+#ifdef SS_IOC_BACKEND_RAM
+        HASH_ITER(hh_full[g], digest_tables[i], iptr, itmp) {
+            fprintf(stderr, "%s entry number %lu\n", digest_names[i], counter);
+            ss_ioc_entry_dump(iptr);
+            counter++;
+            if (limit && counter > limit) break;
+        }
+#elif SS_IOC_BACKEND_DISK
+        rv = mdb_cursor_open(txn, digest_dbis[i], &cursor);
+        while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
+            fprintf(stderr, "%s entry number %lu\n", digest_names[i], counter);
+            iptr = ss_ioc_record_decode(&value, &ioc);
+            if (iptr) ss_ioc_entry_dump(iptr);
+            counter++;
+            if (limit && counter > limit) break;
+        }
+        mdb_cursor_close(cursor);
+#endif
+    }
+
 #ifdef SS_IOC_BACKEND_DISK
     if (txn) mdb_txn_abort(txn);
 #endif
@@ -282,7 +526,8 @@ ss_ioc_entry_t* ss_ioc_entry_create(ss_ioc_file_t* ioc_file, char* ioc_str) {
         fprintf(stderr, "could not allocate ioc entry\n");
         goto error_out;
     }
-    ioc->file_id = ioc_file->file_id;
+    ioc->file_id   = ioc_file->file_id;
+    ioc->dns_match = ioc_file->dns_match;
     
     field = strsep(&sepptr, SS_IOC_FIELD_DELIMITERS);
     errno = 0;
@@ -318,6 +563,20 @@ ss_ioc_entry_t* ss_ioc_entry_create(ss_ioc_file_t* ioc_file, char* ioc_str) {
     field = strsep(&sepptr, SS_IOC_FIELD_DELIMITERS);
     strlcpy(ioc->value, field, sizeof(ioc->value));
     
+    // optional ttl in seconds, otherwise the ioc_file default (0 is forever)
+    uint64_t ttl = ioc_file->ttl;
+    field = strsep(&sepptr, SS_IOC_FIELD_DELIMITERS);
+    if (field && *field) {
+        errno = 0;
+        ttl = strtoull(field, NULL, 10);
+        if (errno || ttl > UINT32_MAX) {
+            fprintf(stderr, "ioc id: %lu: ttl was corrupt: %s\n",
+                ioc->id, field);
+            goto error_out;
+        }
+    }
+    if (ttl) ioc->expire_time = (uint32_t) SS_MIN((uint64_t) time(NULL) + ttl, UINT32_MAX);
+    
     je_free(freeptr); freeptr = NULL;
     return ioc;
     
@@ -365,6 +624,7 @@ ss_ioc_type_t ss_ioc_type_load(const char* ioc_type) {
     if (!strcasecmp(ioc_type, "url"))    return SS_IOC_TYPE_URL;
     if (!strcasecmp(ioc_type, "email"))  return SS_IOC_TYPE_EMAIL;
     if (!strcasecmp(ioc_type, "md5"))    return SS_IOC_TYPE_MD5;
+    if (!strcasecmp(ioc_type, "sha1"))   return SS_IOC_TYPE_SHA1;
     if (!strcasecmp(ioc_type, "sha256")) return SS_IOC_TYPE_SHA256;
     return (ss_ioc_type_t) -1;
 }
@@ -376,6 +636,7 @@ const char* ss_ioc_type_dump(ss_ioc_type_t ioc_type) {
         case SS_IOC_TYPE_URL:    return "URL";
         case SS_IOC_TYPE_EMAIL:  return "EMAIL";
         case SS_IOC_TYPE_MD5:    return "MD5";
+        case SS_IOC_TYPE_SHA1:   return "SHA1";
         case SS_IOC_TYPE_SHA256: return "SHA256";
         default:                 return "UNKNOWN";
     }
@@ -416,390 +677,1034 @@ int ss_ioc_chain_remove_id(uint64_t id) {
     return -1;
 }
 
-int ss_ioc_chain_optimize() {
-    ss_ioc_entry_t* iptr;
-    ss_ioc_entry_t* itmp;
+/* binary size of a file hash indicator, 0 for the other types */
+static inline size_t ss_ioc_digest_size(ss_ioc_type_t ioc_type) {
+    switch (ioc_type) {
+        case SS_IOC_TYPE_MD5:    return SS_MD5_SIZE;
+        case SS_IOC_TYPE_SHA1:   return SS_SHA1_SIZE;
+        case SS_IOC_TYPE_SHA256: return SS_SHA256_SIZE;
+        default:                 return 0;
+    }
+}
+
+/*
+ * Canonicalize an indicator before it goes into a table: domains get
+ * their trailing '.', urls and emails get the host they implicate in dns.
+ */
+static int ss_ioc_entry_prepare(ss_ioc_entry_t* iptr) {
     char*  header;
     char   tvalue[SS_DNS_NAME_MAX];
     size_t offset;
-#ifdef SS_IOC_BACKEND_RAM
-    ss_ioc_entry_t* hiptr;
-#elif SS_IOC_BACKEND_DISK
-    int   rv;
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
-    
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, 0, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc optimization mdb transaction: %s\n", mdb_strerror(rv));
-        return -1;
-    }
-#endif
-    
-    fprintf(stderr, "optimizing IOCs...\n");
     
-    uint64_t indicators = 0;
-    next_ioc: TAILQ_FOREACH_SAFE(iptr, &ss_conf->ioc_chain.ioc_list, entry, itmp) {
-        switch (iptr->type) {
-            case SS_IOC_TYPE_IP: {
-                const char* result = ss_inet_ntop(&iptr->ip, tvalue, sizeof(tvalue));
-                if (result == NULL) {
-                    fprintf(stderr, "ioc id %lu: could not parse ip value\n", iptr->id);
-                    goto next_ioc;
-                }
-                //fprintf(stderr, "ioc id %lu, extracted ip value: %s\n", iptr->id, tvalue);
-                switch (iptr->ip.family) {
-                    case SS_AF_INET4: {
-#ifdef SS_IOC_BACKEND_RAM
-                        HASH_FIND_INT(ss_conf->ip4_table, &iptr->ip.ip4_addr, hiptr);
-                        if (hiptr == NULL) {
-                            HASH_ADD_INT(ss_conf->ip4_table, ip.ip4_addr, iptr);
-                        }
-                        else {
-                            fprintf(stderr, "ioc id %lu: skipping duplicate value: %s\n", iptr->id, result);
-                        }
-#elif SS_IOC_BACKEND_DISK
-                        key.mv_size   = sizeof(iptr->ip.ip4_addr);
-                        key.mv_data   = &iptr->ip.ip4_addr;
-                        value.mv_size = sizeof(*iptr);
-                        value.mv_data = iptr;
-                        rv = mdb_put(txn, ss_conf->ip4_dbi, &key, &value, 0);
-                        if (rv) {
-                            fprintf(stderr, "ioc id %lu: could not insert in ip4_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                            goto next_ioc;
-                        }
-#endif
-                        break;
-                    }
-                    case SS_AF_INET6: {
-#ifdef SS_IOC_BACKEND_RAM
-                        HASH_FIND(hh, ss_conf->ip6_table, &iptr->ip.ip6_addr, sizeof(iptr->ip.ip6_addr), hiptr);
-                        if (hiptr == NULL) {
-                            HASH_ADD(hh, ss_conf->ip6_table, ip.ip6_addr, sizeof(iptr->ip.ip6_addr), iptr);
-                        }
-                        else {
-                            fprintf(stderr, "ioc id %lu: skipping duplicate value: %s\n", iptr->id, result);
-                        }
-#elif SS_IOC_BACKEND_DISK
-                        key.mv_size   = sizeof(iptr->ip.ip6_addr);
-                        key.mv_data   = &iptr->ip.ip6_addr;
-                        value.mv_size = sizeof(*iptr);
-                        value.mv_data = iptr;
-                        rv = mdb_put(txn, ss_conf->ip6_dbi, &key, &value, 0);
-                        if (rv) {
-                            fprintf(stderr, "ioc id %lu: could not insert in ip6_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                            goto next_ioc;
-                        }
-#endif
-                        break;
-                    }
-                    default: {
-                        fprintf(stderr, "ioc id %lu: could not parse ip value: %s\n", iptr->id, tvalue);
-                        goto next_ioc;
-                    }
-                }
-                break;
+    switch (iptr->type) {
+        case SS_IOC_TYPE_IP: {
+            if (iptr->ip.family != SS_AF_INET4 && iptr->ip.family != SS_AF_INET6) {
+                fprintf(stderr, "ioc id %lu: could not parse ip value\n", iptr->id);
+                return -1;
             }
-            case SS_IOC_TYPE_DOMAIN: {
-                // NOTE: convert names to canonical form (trailing '.')
-                offset = strlcpy(tvalue, iptr->value, sizeof(tvalue));
-                if (tvalue[offset] != '.') {
-                    tvalue[offset] = '.';
-                    tvalue[offset + 1] = '\0';
-                }
-                strlcpy(iptr->value, tvalue, sizeof(iptr->value));
-                //fprintf(stderr, "ioc %lu extracted dns domain: %s\n", iptr->id, domain);
-#ifdef SS_IOC_BACKEND_RAM
-                HASH_FIND_STR(ss_conf->domain_table, iptr->value, hiptr);
-                if (hiptr == NULL) {
-                    HASH_ADD_STR(ss_conf->domain_table, value, iptr);
-                }
-                else {
-                    fprintf(stderr, "ioc id %lu: skipping duplicate value: %s\n", iptr->id, iptr->value);
-                }
-#elif SS_IOC_BACKEND_DISK
-                key.mv_size   = strlen(iptr->value);
-                key.mv_data   = iptr->value;
-                value.mv_size = sizeof(*iptr);
-                value.mv_data = iptr;
-                rv = mdb_put(txn, ss_conf->domain_dbi, &key, &value, 0);
-                if (rv) {
-                    fprintf(stderr, "ioc id %lu: could not insert in domain_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                    goto next_ioc;
-                }
-#endif
-                break;
+            return 0;
+        }
+        case SS_IOC_TYPE_DOMAIN: {
+            // NOTE: convert names to canonical form (trailing '.')
+            const char* domain = iptr->value;
+            iptr->dns_match = ss_dns_name_match_get(&domain, iptr->dns_match);
+            if (!ss_dns_name_canonicalize(tvalue, domain, sizeof(tvalue))) {
+                fprintf(stderr, "ioc %lu has corrupt domain: %s\n", iptr->id, iptr->value);
+                return -1;
             }
-            case SS_IOC_TYPE_URL: {
-                // insert in domain and url hashes
-                // (for DNS and HTTP interception)
-                header = strcasestr(iptr->value, SS_IOC_HTTP_URL);
-                offset = strlen(SS_IOC_HTTP_URL);
-                if (header == NULL || header != iptr->value) {
-                    header = strcasestr(iptr->value, SS_IOC_HTTPS_URL);
-                    offset = strlen(SS_IOC_HTTPS_URL);
-                }
-                
-                if (header == NULL || header != iptr->value) {
+            strlcpy(iptr->value, tvalue, sizeof(iptr->value));
+            //fprintf(stderr, "ioc %lu extracted dns domain: %s\n", iptr->id, domain);
+            return 0;
+        }
+        case SS_IOC_TYPE_URL: {
+            // insert in domain and url hashes
+            // (for DNS and HTTP interception)
+            header = strcasestr(iptr->value, SS_IOC_HTTP_URL);
+            offset = strlen(SS_IOC_HTTP_URL);
+            if (header == NULL || header != iptr->value) {
+                header = strcasestr(iptr->value, SS_IOC_HTTPS_URL);
+                offset = strlen(SS_IOC_HTTPS_URL);
+            }
+            
+            if (header == NULL || header != iptr->value) {
+                fprintf(stderr, "ioc %lu has corrupt url: %s\n", iptr->id, iptr->value);
+                return -1;
+            }
+            // NOTE: convert http urls to the form ss_extract_http looks up
+            if (offset == strlen(SS_IOC_HTTP_URL)) {
+                char url[SS_IOC_VALUE_SIZE];
+                if (ss_http_url_value_normalize(iptr->value, strlen(iptr->value), url, sizeof(url)) < 0) {
                     fprintf(stderr, "ioc %lu has corrupt url: %s\n", iptr->id, iptr->value);
-                    goto next_ioc;
+                    return -1;
                 }
-                // NOTE: convert names to canonical form (trailing '.')
-                strlcpy(tvalue, iptr->value + offset, sizeof(tvalue) - 2);
-                for (int i = 0; ; ++i) {
-                    if (tvalue[i] == '/' || tvalue[i] == '\0') {
-                        tvalue[i] = '.';
-                        tvalue[i+1] = '\0';
-                        break;
-                    }
-                }
-                strlcpy(iptr->dns, tvalue, sizeof(iptr->dns));
-                //fprintf(stderr, "ioc %lu extracted url domain: %s\n", iptr->id, tvalue);
-#ifdef SS_IOC_BACKEND_RAM
-                HASH_FIND_STR(ss_conf->domain_table, iptr->dns, hiptr);
-                if (hiptr == NULL) {
-                    HASH_ADD_STR(ss_conf->domain_table, dns, iptr);
-                }
-                else {
-                    fprintf(stderr, "ioc id %lu: skipping duplicate dns: %s\n", iptr->id, iptr->dns);
-                }
-                HASH_FIND(hh_full, ss_conf->url_table, &iptr->value, strlen(iptr->value), hiptr);
-                if (hiptr == NULL) {
-                    HASH_ADD(hh_full, ss_conf->url_table, value, strlen(iptr->value), iptr);
-                }
-                else {
-                    fprintf(stderr, "ioc id %lu: skipping duplicate value: %s\n", iptr->id, iptr->value);
-                }
-#elif SS_IOC_BACKEND_DISK
-                key.mv_size   = strlen(iptr->dns);
-                key.mv_data   = iptr->dns;
-                value.mv_size = sizeof(*iptr);
-                value.mv_data = iptr;
-                rv = mdb_put(txn, ss_conf->domain_dbi, &key, &value, 0);
-                if (rv) {
-                    fprintf(stderr, "ioc id %lu: could not insert in domain_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                    goto next_ioc;
-                }
-                key.mv_size   = strlen(iptr->value);
-                key.mv_data   = iptr->value;
-                value.mv_size = sizeof(*iptr);
-                value.mv_data = iptr;
-                rv = mdb_put(txn, ss_conf->url_dbi, &key, &value, 0);
-                if (rv) {
-                    fprintf(stderr, "ioc id %lu: could not insert in url_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                    goto next_ioc;
-                }
-#endif
-                break;
+                strlcpy(iptr->value, url, sizeof(iptr->value));
             }
-            case SS_IOC_TYPE_EMAIL: {
-                // insert in domain and email hashes
-                // (for DNS and SMTP interception)
-                char* domain = strstr(iptr->value, "@");
-                if (domain == NULL || domain + 0 == '\0' || domain + 1 == '\0') {
-                    fprintf(stderr, "ioc %lu has corrupt email: %s\n", iptr->id, iptr->value);
-                    goto next_ioc;
-                }
-                // move forward to first byte after first '@'
-                domain += 1;
-                // NOTE: convert names to canonical form (trailing '.')
-                offset = strlcpy(tvalue, domain, sizeof(tvalue) - 2);
-                if (tvalue[offset] != '.') {
-                    tvalue[offset] = '.';
-                    tvalue[offset + 1] = '\0';
-                }
-                strlcpy(iptr->dns, tvalue, sizeof(iptr->dns));
-                fprintf(stderr, "ioc %lu extracted email domain: %s\n", iptr->id, tvalue);
-#ifdef SS_IOC_BACKEND_RAM
-                HASH_FIND_STR(ss_conf->domain_table, iptr->dns, hiptr);
-                if (hiptr == NULL) {
-                    HASH_ADD_STR(ss_conf->domain_table, dns, iptr);
-                }
-                else {
-                    fprintf(stderr, "ioc id %lu: skipping duplicate dns: %s\n", iptr->id, iptr->dns);
-                }
-                HASH_FIND(hh_full, ss_conf->email_table, &iptr->value, strlen(iptr->value), hiptr);
-                if (hiptr == NULL) {
-                    HASH_ADD(hh_full, ss_conf->email_table, value, strlen(iptr->value), iptr);
-                }
-                else {
-                    fprintf(stderr, "ioc id %lu: skipping duplicate value: %s\n", iptr->id, iptr->value);
-                }
-#elif SS_IOC_BACKEND_DISK
-                key.mv_size   = strlen(iptr->dns);
-                key.mv_data   = iptr->dns;
-                value.mv_size = sizeof(*iptr);
-                value.mv_data = iptr;
-                rv = mdb_put(txn, ss_conf->domain_dbi, &key, &value, 0);
-                if (rv) {
-                    fprintf(stderr, "ioc id %lu: could not insert in domain_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                    goto next_ioc;
-                }
-                key.mv_size   = strlen(iptr->value);
-                key.mv_data   = iptr->value;
-                value.mv_size = sizeof(*iptr);
-                value.mv_data = iptr;
-                rv = mdb_put(txn, ss_conf->email_dbi, &key, &value, 0);
-                if (rv) {
-                    fprintf(stderr, "ioc id %lu: could not insert in email_dbi: %s\n", iptr->id, mdb_strerror(rv));
-                    goto next_ioc;
-                }
-#endif
-                break;
+            // NOTE: convert names to canonical form (trailing '.')
+            strlcpy(tvalue, iptr->value + offset, sizeof(tvalue));
+            tvalue[strcspn(tvalue, ":/")] = '\0';
+            if (!ss_dns_name_canonicalize(iptr->dns, tvalue, sizeof(iptr->dns))) {
+                fprintf(stderr, "ioc %lu has corrupt url domain: %s\n", iptr->id, iptr->value);
+                return -1;
             }
-            case SS_IOC_TYPE_MD5: {
-                fprintf(stderr, "ioc %lu is unsupported md5 type\n", iptr->id);
-                goto next_ioc;
+            // the url only implicates its own host, not the whole zone
+            iptr->dns_match = SS_DNS_MATCH_EXACT;
+            //fprintf(stderr, "ioc %lu extracted url domain: %s\n", iptr->id, iptr->dns);
+            return 0;
+        }
+        case SS_IOC_TYPE_EMAIL: {
+            // insert in domain and email hashes
+            // (for DNS and SMTP interception)
+            char* domain = strchr(iptr->value, '@');
+            if (domain == NULL) {
+                fprintf(stderr, "ioc %lu has corrupt email: %s\n", iptr->id, iptr->value);
+                return -1;
             }
-            case SS_IOC_TYPE_SHA256: {
-                fprintf(stderr, "ioc %lu is unsupported sha256 type\n", iptr->id);
-                goto next_ioc;
+            // move forward to first byte after first '@'
+            domain += 1;
+            // NOTE: convert names to canonical form (trailing '.')
+            if (!ss_dns_name_canonicalize(iptr->dns, domain, sizeof(iptr->dns))) {
+                fprintf(stderr, "ioc %lu has corrupt email domain: %s\n", iptr->id, iptr->value);
+                return -1;
             }
-            default: {
-                fprintf(stderr, "ioc %lu is unknown type %d\n", iptr->id, iptr->type);
-                goto next_ioc;
+            iptr->dns_match = SS_DNS_MATCH_EXACT;
+            //fprintf(stderr, "ioc %lu extracted email domain: %s\n", iptr->id, iptr->dns);
+            return 0;
+        }
+        case SS_IOC_TYPE_MD5:
+        case SS_IOC_TYPE_SHA1:
+        case SS_IOC_TYPE_SHA256: {
+            // file hashes are matched as raw bytes, not as hex strings
+            size_t size = ss_ioc_digest_size(iptr->type);
+            if (strlen(iptr->value) != size * 2 || ss_hex_decode(iptr->digest, iptr->value, size * 2)) {
+                fprintf(stderr, "ioc %lu has corrupt %s: %s\n",
+                    iptr->id, ss_ioc_type_dump(iptr->type), iptr->value);
+                return -1;
             }
+            // NOTE: convert hashes to canonical form (lowercase)
+            ss_hex_encode(iptr->value, iptr->digest, size);
+            return 0;
         }
-        ++indicators;
-        if (indicators && indicators % 10000 == 0) {
-            fprintf(stderr, "checkpoint IOC count %lu\n", indicators);
+        default: {
+            fprintf(stderr, "ioc %lu is unknown type %d\n", iptr->id, iptr->type);
+            return -1;
         }
     }
-    
-#ifdef SS_IOC_BACKEND_DISK
-    rv = mdb_txn_commit(txn);
-    if (rv) {
-        fprintf(stderr, "could not commit ioc optimization mdb transaction: %s\n", mdb_strerror(rv));
-        return -1;
+}
+
+static void ss_ioc_entries_destroy(ss_ioc_list_t* ioc_list) {
+    ss_ioc_entry_t* iptr;
+    ss_ioc_entry_t* itmp;
+    TAILQ_FOREACH_SAFE(iptr, ioc_list, entry, itmp) {
+        TAILQ_REMOVE(ioc_list, iptr, entry);
+        ss_ioc_entry_destroy(iptr);
     }
-#endif
+}
+
+/* IP TABLES */
+
+#ifdef SS_IOC_BACKEND_RAM
+static inline uint32_t ss_ioc_ip_signature(const void* key, uint32_t length) {
+    uint32_t signature = rte_hash_crc(key, length, SS_IOC_IP_HASH_INIT);
+    return signature ? signature : 1;
+}
+
+static int ss_ioc_ip_table_resize(ss_ioc_ip_table_t* table, uint32_t slot_count) {
+    ss_ioc_ip_slot_t* slots = je_calloc(slot_count, sizeof(ss_ioc_ip_slot_t));
+    if (slots == NULL) return -1;
     
-    fprintf(stderr, "optimized %lu IOCs\n", indicators);
+    uint32_t mask = slot_count - 1;
+    for (uint32_t i = 0; table->slots && i <= table->mask; ++i) {
+        ss_ioc_ip_slot_t* slot = &table->slots[i];
+        if (slot->signature == 0) continue;
+        uint32_t j = slot->signature & mask;
+        while (slots[j].signature) j = (j + 1) & mask;
+        slots[j] = *slot;
+    }
+    if (table->slots) je_free(table->slots);
+    table->slots = slots;
+    table->mask  = mask;
     return 0;
 }
 
-ss_ioc_entry_t* ss_ioc_metadata_match(ss_metadata_t* md) {
-    ss_ioc_entry_t* iptr = NULL;
-    uint32_t ip;
-#ifdef SS_IOC_BACKEND_DISK
-    int   rv;
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
+/* returns 1 if the key was already present from another entry */
+static int ss_ioc_ip_table_add(ss_ioc_ip_table_t* table, const void* key, ss_ioc_entry_t* iptr) {
+    uint32_t signature = ss_ioc_ip_signature(key, table->key_length);
     
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc metadata mdb transaction: %s\n", mdb_strerror(rv));
-        return NULL;
+    // stay at or below 50% load, so misses end after a short probe
+    if (table->slots == NULL || (table->count + 1) * 2 > table->mask + 1) {
+        uint32_t slot_count = table->slots ? (table->mask + 1) * 2 : SS_IOC_IP_SLOTS_MIN;
+        if (ss_ioc_ip_table_resize(table, slot_count)) return -1;
     }
-#endif
     
-    if (md->eth_type == ETHER_TYPE_IPV4) {
-        ip = *(uint32_t*) &md->sip;
-#ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND_INT(ss_conf->ip4_table, &ip, iptr);
-        if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-        key.mv_size = sizeof(uint32_t);
-        key.mv_data = (uint32_t*) &md->sip;
-        rv = mdb_get(txn, ss_conf->ip4_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
-        }
-#endif
-        
-        ip = *(uint32_t*) &md->dip;
-#ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND_INT(ss_conf->ip4_table, &ip, iptr);
-        if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-        key.mv_size = sizeof(uint32_t);
-        key.mv_data = (uint32_t*) &md->dip;
-        rv = mdb_get(txn, ss_conf->ip4_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
-        }
-#endif
+    uint32_t i = signature & table->mask;
+    for (; table->slots[i].signature; i = (i + 1) & table->mask) {
+        if (table->slots[i].signature == signature &&
+            !memcmp(table->slots[i].key, key, table->key_length)) return 1;
     }
-    else if (md->eth_type == ETHER_TYPE_IPV6) {
-#ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND(hh, ss_conf->ip6_table, &md->sip, sizeof(md->sip), iptr);
-        if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-        key.mv_size = sizeof(md->sip);
-        key.mv_data = &md->sip;
-        rv = mdb_get(txn, ss_conf->ip6_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
-        }
-#endif
-        
-#ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND(hh, ss_conf->ip6_table, &md->dip, sizeof(md->dip), iptr);
-        if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-        key.mv_size = sizeof(md->dip);
-        key.mv_data = &md->dip;
-        rv = mdb_get(txn, ss_conf->ip6_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
+    memcpy(table->slots[i].key, key, table->key_length);
+    table->slots[i].signature = signature;
+    table->slots[i].entry     = iptr;
+    ++table->count;
+    return 0;
+}
+
+static inline ss_ioc_entry_t* ss_ioc_ip_table_find(ss_ioc_ip_table_t* table, const void* key, uint32_t signature) {
+    if (table->slots == NULL) return NULL;
+    for (uint32_t i = signature & table->mask; ; i = (i + 1) & table->mask) {
+        ss_ioc_ip_slot_t* slot = &table->slots[i];
+        if (slot->signature == 0) return NULL;
+        if (slot->signature == signature && !memcmp(slot->key, key, table->key_length)) {
+            return ss_ioc_entry_live(slot->entry);
         }
-#endif
     }
-    
-    out:
-#ifdef SS_IOC_BACKEND_DISK
-    if (txn) mdb_txn_abort(txn);
-#endif
-    return iptr;
 }
 
-ss_ioc_entry_t* ss_ioc_dns_match(ss_metadata_t* md) {
-    ss_ioc_entry_t* iptr = NULL;
-#ifdef SS_IOC_BACKEND_DISK
-    int   rv;
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
+struct ss_ioc_ip_probe_s {
+    ss_ioc_ip_table_t* table;
+    const void*        key;
+    uint32_t           signature;
+};
+
+typedef struct ss_ioc_ip_probe_s ss_ioc_ip_probe_t;
+
+/*
+ * Same staging as rte_hash_lookup_bulk: hash every key and prefetch its
+ * slot first, so the cache misses of the whole batch are in flight at
+ * once, then compare. Probes with no table are misses.
+ */
+static uint64_t ss_ioc_ip_probe_bulk(ss_ioc_ip_probe_t* probes, unsigned int count, ss_ioc_entry_t** results) {
+    uint64_t hits = 0;
     
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc dns match mdb transaction: %s\n", mdb_strerror(rv));
-        return NULL;
+    for (unsigned int i = 0; i < count; ++i) {
+        ss_ioc_ip_probe_t* probe = &probes[i];
+        if (probe->table == NULL || probe->table->slots == NULL) continue;
+        probe->signature = ss_ioc_ip_signature(probe->key, probe->table->key_length);
+        rte_prefetch0(&probe->table->slots[probe->signature & probe->table->mask]);
     }
-#endif
-
-#ifdef SS_IOC_BACKEND_RAM
-    HASH_FIND_STR(ss_conf->domain_table, (char*) md->dns_name, iptr);
-    if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-    key.mv_size = strlen((char*)md->dns_name);
-    key.mv_data = &md->dns_name;
-    rv = mdb_get(txn, ss_conf->domain_dbi, &key, &value);
-    if (rv != MDB_NOTFOUND) {
-        iptr = (ss_ioc_entry_t*) value.mv_data;
-        goto out;
+    
+    for (unsigned int i = 0; i < count; ++i) {
+        ss_ioc_ip_probe_t* probe = &probes[i];
+        results[i] = NULL;
+        if (probe->table == NULL || probe->table->slots == NULL) continue;
+        results[i] = ss_ioc_ip_table_find(probe->table, probe->key, probe->signature);
+        if (results[i]) hits |= UINT64_C(1) << i;
     }
-#endif
+    
+    return hits;
+}
+
+static inline ss_ioc_ip_table_t* ss_ioc_ip_table_get(ss_ioc_tables_t* tables, int family) {
+    if (family == SS_AF_INET4) return &tables->ip4_table;
+    if (family == SS_AF_INET6) return &tables->ip6_table;
+    return NULL;
+}
+
+static inline ss_ioc_entry_t** ss_ioc_digest_table_get(ss_ioc_tables_t* tables, ss_ioc_type_t ioc_type) {
+    switch (ioc_type) {
+        case SS_IOC_TYPE_MD5:    return &tables->md5_table;
+        case SS_IOC_TYPE_SHA1:   return &tables->sha1_table;
+        case SS_IOC_TYPE_SHA256: return &tables->sha256_table;
+        default:                 return NULL;
+    }
+}
+#endif
+
+/* TABLES */
+
+ss_ioc_tables_t* ss_ioc_tables_create(uint64_t generation) {
+    ss_ioc_tables_t* tables = je_calloc(1, sizeof(ss_ioc_tables_t));
+    if (tables == NULL) goto error_out;
+    
+    tables->generation   = generation;
+    tables->ip4_table.key_length = IPV4_ALEN;
+    tables->ip6_table.key_length = IPV6_ALEN;
+    tables->domain_table = ss_dns_trie_create();
+    if (tables->domain_table == NULL) goto error_out;
+    tables->host_table   = ss_dns_trie_create();
+    if (tables->host_table == NULL) goto error_out;
+    
+    return tables;
+    
+    error_out:
+    if (tables) {
+        ss_dns_trie_destroy(tables->domain_table);
+        je_free(tables);
+    }
+    return NULL;
+}
+
+/* frees the tables only; the entries belong to the ioc_chain */
+int ss_ioc_tables_destroy(ss_ioc_tables_t* tables) {
+    if (tables == NULL) return 0;
+    
+    int g = tables->generation % SS_IOC_GENERATIONS;
+    if (tables->ip4_table.slots) je_free(tables->ip4_table.slots);
+    if (tables->ip6_table.slots) je_free(tables->ip6_table.slots);
+    HASH_CLEAR(hh_full[g], tables->url_table);
+    HASH_CLEAR(hh_full[g], tables->email_table);
+    HASH_CLEAR(hh_full[g], tables->md5_table);
+    HASH_CLEAR(hh_full[g], tables->sha1_table);
+    HASH_CLEAR(hh_full[g], tables->sha256_table);
+    ss_dns_trie_destroy(tables->domain_table);
+    ss_dns_trie_destroy(tables->host_table);
+    je_free(tables);
+    
+    return 0;
+}
+
+#ifdef SS_IOC_BACKEND_RAM
+/* returns 1 if the value was already present from another entry */
+static int ss_ioc_tables_insert(ss_ioc_tables_t* tables, ss_ioc_entry_t* iptr) {
+    int g = tables->generation % SS_IOC_GENERATIONS;
+    int rv = 0;
+    ss_ioc_entry_t* hiptr = NULL;
+    
+    switch (iptr->type) {
+        case SS_IOC_TYPE_IP: {
+            if (iptr->ip.family == SS_AF_INET4) {
+                rv = ss_ioc_ip_table_add(&tables->ip4_table, &iptr->ip.ip4_addr, iptr);
+            }
+            else {
+                rv = ss_ioc_ip_table_add(&tables->ip6_table, &iptr->ip.ip6_addr, iptr);
+            }
+            if (rv < 0) return -1;
+            if (rv) hiptr = iptr;
+            break;
+        }
+        case SS_IOC_TYPE_DOMAIN: {
+            rv = ss_dns_trie_add(tables->domain_table, iptr->value, iptr->dns_match, iptr, 1);
+            if (rv < 0) return -1;
+            if (rv) hiptr = iptr;
+            break;
+        }
+        case SS_IOC_TYPE_URL: {
+            rv = ss_dns_trie_add(tables->host_table, iptr->dns, iptr->dns_match, iptr, 1);
+            if (rv < 0) return -1;
+            HASH_FIND(hh_full[g], tables->url_table, iptr->value, strlen(iptr->value), hiptr);
+            if (hiptr == NULL) {
+                HASH_ADD(hh_full[g], tables->url_table, value, strlen(iptr->value), iptr);
+            }
+            break;
+        }
+        case SS_IOC_TYPE_EMAIL: {
+            rv = ss_dns_trie_add(tables->host_table, iptr->dns, iptr->dns_match, iptr, 1);
+            if (rv < 0) return -1;
+            HASH_FIND(hh_full[g], tables->email_table, iptr->value, strlen(iptr->value), hiptr);
+            if (hiptr == NULL) {
+                HASH_ADD(hh_full[g], tables->email_table, value, strlen(iptr->value), iptr);
+            }
+            break;
+        }
+        case SS_IOC_TYPE_MD5:
+        case SS_IOC_TYPE_SHA1:
+        case SS_IOC_TYPE_SHA256: {
+            ss_ioc_entry_t** table = ss_ioc_digest_table_get(tables, iptr->type);
+            size_t size = ss_ioc_digest_size(iptr->type);
+            HASH_FIND(hh_full[g], *table, iptr->digest, size, hiptr);
+            if (hiptr == NULL) {
+                HASH_ADD(hh_full[g], *table, digest, size, iptr);
+            }
+            break;
+        }
+        default: {
+            return -1;
+        }
+    }
+    
+    if (hiptr) return 1;
+    ++tables->count;
+    return 0;
+}
+
+/*
+ * Build a new generation of tables from the ioc_chain, while the lcores
+ * keep reading the current one. Expired entries are moved to retired,
+ * to be freed once no lcore can still be using them.
+ */
+static ss_ioc_tables_t* ss_ioc_tables_build(uint64_t generation, ss_ioc_list_t* retired) {
+    ss_ioc_entry_t* iptr;
+    ss_ioc_entry_t* itmp;
+    uint32_t        next_expire = UINT32_MAX;
+    
+    ss_ioc_tables_t* tables = ss_ioc_tables_create(generation);
+    if (tables == NULL) return NULL;
+    
+    TAILQ_FOREACH_SAFE(iptr, &ss_conf->ioc_chain.ioc_list, entry, itmp) {
+        if (iptr->expire_time && iptr->expire_time <= ss_ioc_clock) {
+            TAILQ_REMOVE(&ss_conf->ioc_chain.ioc_list, iptr, entry);
+            TAILQ_INSERT_TAIL(retired, iptr, entry);
+            ++ss_ioc_stats.expires;
+            continue;
+        }
+        if (iptr->expire_time && iptr->expire_time < next_expire) next_expire = iptr->expire_time;
+        if (ss_ioc_tables_insert(tables, iptr) < 0) {
+            ss_ioc_tables_destroy(tables);
+            return NULL;
+        }
+    }
+    
+    ss_ioc_next_expire = next_expire;
+    return tables;
+}
+
+/*
+ * Wait until every running lcore has passed ss_ioc_lcore_quiesce since
+ * generation was published. After that, no lcore can still hold a
+ * pointer into the tables it replaced.
+ */
+static void ss_ioc_synchronize(uint64_t generation) {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        while (ss_ioc_lcores[i].generation && ss_ioc_lcores[i].generation < generation) {
+            usleep(SS_IOC_SYNCHRONIZE_USEC);
+        }
+    }
+}
+
+static int ss_ioc_tables_publish() {
+    ss_ioc_tables_t* tables;
+    ss_ioc_tables_t* old_tables = ss_conf->ioc_tables;
+    uint64_t generation = old_tables ? old_tables->generation + 1 : 1;
+    
+    tables = ss_ioc_tables_build(generation, &ss_ioc_retired);
+    if (tables == NULL) return -1;
+    
+    rte_wmb();
+    ss_conf->ioc_tables = tables;
+    ss_ioc_synchronize(generation);
+    
+    ss_ioc_tables_destroy(old_tables);
+    ss_ioc_entries_destroy(&ss_ioc_retired);
+    return 0;
+}
+#endif
+
+#ifdef SS_IOC_BACKEND_DISK
+/* every table which can match the entry, with the key it is stored under */
+static int ss_ioc_mdb_keys(ss_ioc_entry_t* iptr, MDB_dbi* dbis, MDB_val* keys) {
+    switch (iptr->type) {
+        case SS_IOC_TYPE_IP: {
+            if (iptr->ip.family == SS_AF_INET4) {
+                dbis[0] = ss_conf->ip4_dbi;
+                keys[0].mv_size = sizeof(iptr->ip.ip4_addr);
+                keys[0].mv_data = &iptr->ip.ip4_addr;
+            }
+            else {
+                dbis[0] = ss_conf->ip6_dbi;
+                keys[0].mv_size = sizeof(iptr->ip.ip6_addr);
+                keys[0].mv_data = &iptr->ip.ip6_addr;
+            }
+            return 1;
+        }
+        case SS_IOC_TYPE_DOMAIN: {
+            dbis[0] = ss_conf->domain_dbi;
+            keys[0].mv_size = strlen(iptr->value);
+            keys[0].mv_data = iptr->value;
+            return 1;
+        }
+        case SS_IOC_TYPE_MD5:
+        case SS_IOC_TYPE_SHA1:
+        case SS_IOC_TYPE_SHA256: {
+            dbis[0] = ss_ioc_digest_dbi_get(iptr->type);
+            keys[0].mv_size = ss_ioc_digest_size(iptr->type);
+            keys[0].mv_data = iptr->digest;
+            return 1;
+        }
+        case SS_IOC_TYPE_URL:
+        case SS_IOC_TYPE_EMAIL: {
+            dbis[0] = ss_conf->host_dbi;
+            keys[0].mv_size = strlen(iptr->dns);
+            keys[0].mv_data = iptr->dns;
+            dbis[1] = iptr->type == SS_IOC_TYPE_URL ? ss_conf->url_dbi : ss_conf->email_dbi;
+            keys[1].mv_size = strlen(iptr->value);
+            keys[1].mv_data = iptr->value;
+            return 2;
+        }
+        default: {
+            return 0;
+        }
+    }
+}
+
+/*
+ * expire_dbi is ordered by expiry, so the sweep only visits due entries:
+ * key is big endian expire_time, then the dbi, then the dbi's key.
+ */
+static int ss_ioc_mdb_expire_put(MDB_txn* txn, MDB_dbi dbi, MDB_val* key, uint32_t expire_time) {
+    uint8_t ebuffer[sizeof(uint32_t) + sizeof(MDB_dbi) + SS_IOC_VALUE_SIZE];
+    MDB_val ekey, evalue;
+    uint32_t etime = htonl(expire_time);
+    
+    if (key->mv_size > SS_IOC_VALUE_SIZE) return EINVAL;
+    memcpy(ebuffer, &etime, sizeof(etime));
+    memcpy(ebuffer + sizeof(etime), &dbi, sizeof(dbi));
+    memcpy(ebuffer + sizeof(etime) + sizeof(dbi), key->mv_data, key->mv_size);
+    ekey.mv_size   = sizeof(etime) + sizeof(dbi) + key->mv_size;
+    ekey.mv_data   = ebuffer;
+    evalue.mv_size = 0;
+    evalue.mv_data = NULL;
+    return mdb_put(txn, ss_conf->expire_dbi, &ekey, &evalue, 0);
+}
+
+static int ss_ioc_mdb_insert(MDB_txn* txn, ss_ioc_entry_t* iptr) {
+    int      rv;
+    char     rbuffer[sizeof(ss_ioc_record_t) + SS_IOC_VALUE_SIZE + SS_IOC_DNS_SIZE];
+    MDB_dbi  dbis[2];
+    MDB_val  keys[2];
+    MDB_val  value;
+    
+    value.mv_size = ss_ioc_record_encode((ss_ioc_record_t*) rbuffer, sizeof(rbuffer), iptr);
+    value.mv_data = rbuffer;
+    int count = ss_ioc_mdb_keys(iptr, dbis, keys);
+    for (int i = 0; i < count; ++i) {
+        rv = mdb_put(txn, dbis[i], &keys[i], &value, 0);
+        if (rv) return rv;
+        if (iptr->expire_time) {
+            rv = ss_ioc_mdb_expire_put(txn, dbis[i], &keys[i], iptr->expire_time);
+            if (rv) return rv;
+        }
+    }
+    return 0;
+}
+
+/* only removes values which came from the same ioc_file */
+static int ss_ioc_mdb_delete(MDB_txn* txn, ss_ioc_entry_t* iptr, uint64_t* removed) {
+    int      rv;
+    MDB_dbi  dbis[2];
+    MDB_val  keys[2];
+    MDB_val  value;
+    ss_ioc_entry_t stored;
+    
+    int count = ss_ioc_mdb_keys(iptr, dbis, keys);
+    for (int i = 0; i < count; ++i) {
+        rv = mdb_get(txn, dbis[i], &keys[i], &value);
+        if (rv == MDB_NOTFOUND) continue;
+        if (rv) return rv;
+        if (!ss_ioc_record_decode(&value, &stored) || stored.file_id != iptr->file_id) continue;
+        rv = mdb_del(txn, dbis[i], &keys[i], NULL);
+        if (rv) return rv;
+        ++*removed;
+    }
+    return 0;
+}
+
+static int ss_ioc_mdb_expire(MDB_txn* txn, uint32_t now, uint64_t* expired) {
+    int         rv;
+    uint32_t    etime;
+    MDB_dbi     dbi;
+    MDB_cursor* cursor;
+    MDB_val     ekey, evalue, key, value;
+    ss_ioc_entry_t stored;
+    
+    rv = mdb_cursor_open(txn, ss_conf->expire_dbi, &cursor);
+    if (rv) return rv;
+    while ((rv = mdb_cursor_get(cursor, &ekey, &evalue, MDB_FIRST)) == 0) {
+        if (ekey.mv_size >= sizeof(etime) + sizeof(dbi)) {
+            memcpy(&etime, ekey.mv_data, sizeof(etime));
+            etime = ntohl(etime);
+            if (etime > now) break;
+            memcpy(&dbi, (uint8_t*) ekey.mv_data + sizeof(etime), sizeof(dbi));
+            key.mv_size = ekey.mv_size - sizeof(etime) - sizeof(dbi);
+            key.mv_data = (uint8_t*) ekey.mv_data + sizeof(etime) + sizeof(dbi);
+            // the value may have been replaced since, with another expiry
+            if (mdb_get(txn, dbi, &key, &value) == 0 &&
+                ss_ioc_record_decode(&value, &stored) && stored.expire_time == etime) {
+                rv = mdb_del(txn, dbi, &key, NULL);
+                if (rv) break;
+                ++*expired;
+            }
+        }
+        rv = mdb_cursor_del(cursor, 0);
+        if (rv) break;
+    }
+    mdb_cursor_close(cursor);
+    return rv == MDB_NOTFOUND ? 0 : rv;
+}
+#endif
+
+int ss_ioc_chain_optimize() {
+    ss_ioc_entry_t* iptr;
+    ss_ioc_entry_t* itmp;
+    int      rv;
+    uint64_t indicators = 0;
+#ifdef SS_IOC_BACKEND_DISK
+    MDB_txn* txn = NULL;
+    MDB_val  key, value;
+    
+    if (ss_conf->mdb_is_loaded) {
+        fprintf(stderr, "skipping IOC optimization, using existing mdb\n");
+        return 0;
+    }
+    
+    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, 0, &txn);
+    if (rv) {
+        fprintf(stderr, "could not begin ioc optimization mdb transaction: %s\n", mdb_strerror(rv));
+        return -1;
+    }
+#endif
+    
+    fprintf(stderr, "optimizing IOCs...\n");
+    ss_ioc_clock = (uint32_t) time(NULL);
+    
+    TAILQ_FOREACH_SAFE(iptr, &ss_conf->ioc_chain.ioc_list, entry, itmp) {
+        rv = ss_ioc_entry_prepare(iptr);
+        if (rv) {
+            TAILQ_REMOVE(&ss_conf->ioc_chain.ioc_list, iptr, entry);
+            ss_ioc_entry_destroy(iptr);
+            continue;
+        }
+#ifdef SS_IOC_BACKEND_DISK
+        rv = ss_ioc_mdb_insert(txn, iptr);
+        if (rv) {
+            fprintf(stderr, "ioc id %lu: could not insert in mdb: %s\n", iptr->id, mdb_strerror(rv));
+            continue;
+        }
+#endif
+        ++indicators;
+        if (indicators && indicators % 10000 == 0) {
+            fprintf(stderr, "checkpoint IOC count %lu\n", indicators);
+        }
+    }
+    
+#ifdef SS_IOC_BACKEND_RAM
+    rv = ss_ioc_tables_publish();
+    if (rv) {
+        fprintf(stderr, "could not build ioc tables\n");
+        return -1;
+    }
+    fprintf(stderr, "optimized %lu IOCs, %lu unique values\n", indicators, ss_conf->ioc_tables->count);
+#elif SS_IOC_BACKEND_DISK
+    // written last, so a partial load is never reused by a later run
+    uint32_t format = SS_IOC_MDB_FORMAT;
+    key.mv_size   = strlen(SS_IOC_MDB_FORMAT_KEY);
+    key.mv_data   = SS_IOC_MDB_FORMAT_KEY;
+    value.mv_size = sizeof(format);
+    value.mv_data = &format;
+    rv = mdb_put(txn, ss_conf->meta_dbi, &key, &value, 0);
+    if (rv) {
+        fprintf(stderr, "could not mark ioc mdb as loaded: %s\n", mdb_strerror(rv));
+        mdb_txn_abort(txn);
+        return -1;
+    }
+    rv = mdb_txn_commit(txn);
+    if (rv) {
+        fprintf(stderr, "could not commit ioc optimization mdb transaction: %s\n", mdb_strerror(rv));
+        return -1;
+    }
+    ss_conf->mdb_is_loaded = 1;
+    
+    // the records live in the map now, so drop the parsed copies
+    ss_ioc_entries_destroy(&ss_conf->ioc_chain.ioc_list);
+    fprintf(stderr, "optimized %lu IOCs\n", indicators);
+#endif
+    
+    return 0;
+}
+
+/* UPDATES */
+
+/* add is the entry of the last line for the key, NULL when it was a del */
+struct ss_ioc_key_s {
+    UT_hash_handle  hh;
+    ss_ioc_entry_t* add;
+    uint8_t         key[2 + SS_IOC_VALUE_SIZE];
+};
+
+typedef struct ss_ioc_key_s ss_ioc_key_t;
+
+/* ioc_file, type, and the value the entry is matched by */
+static size_t ss_ioc_entry_key(ss_ioc_entry_t* iptr, uint8_t* key) {
+    memset(key, 0, 2 + SS_IOC_VALUE_SIZE);
+    key[0] = (uint8_t) iptr->file_id;
+    key[1] = (uint8_t) iptr->type;
+    if (iptr->type == SS_IOC_TYPE_IP) {
+        memcpy(key + 2, &iptr->ip, sizeof(iptr->ip));
+        return 2 + sizeof(iptr->ip);
+    }
+    size_t length = strnlen(iptr->value, SS_IOC_VALUE_SIZE);
+    memcpy(key + 2, iptr->value, length);
+    return 2 + length;
+}
+
+/*
+ * Apply one delta file. Each line is "add," or "del," followed by an
+ * indicator in the ioc_file format. An add replaces any indicator from
+ * the same ioc_file with the same value. Lines take effect in file order,
+ * so of several lines for one value the last one wins.
+ */
+static int ss_ioc_update_apply(ss_ioc_file_t* ioc_file, const char* path) {
+    int       rv      = -1;
+    FILE*     ioc_fd  = NULL;
+    char*     ioc_str = NULL;
+    size_t    ioc_len = 0;
+    ssize_t   grv;
+    uint64_t  line    = 0;
+    ss_ioc_list_t adds;
+    ss_ioc_entry_t* iptr;
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_entry_t* itmp;
+    ss_ioc_key_t* keys = NULL;
+    ss_ioc_key_t* kptr;
+    ss_ioc_key_t* ktmp;
+    uint8_t       key[2 + SS_IOC_VALUE_SIZE];
+    size_t        key_length;
+#elif SS_IOC_BACKEND_DISK
+    MDB_txn* txn = NULL;
+    uint64_t added   = 0;
+    uint64_t removed = 0;
+#endif
+    
+    TAILQ_INIT(&adds);
+    
+    ioc_fd = fopen(path, "r");
+    if (ioc_fd == NULL) {
+        RTE_LOG(ERR, IOC, "could not open ioc delta %s: %s\n", path, strerror(errno));
+        goto error_out;
+    }
+    
+#ifdef SS_IOC_BACKEND_DISK
+    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, 0, &txn);
+    if (rv) {
+        RTE_LOG(ERR, IOC, "could not begin ioc delta mdb transaction: %s\n", mdb_strerror(rv));
+        rv = -1;
+        goto error_out;
+    }
+#endif
+    
+    while ((grv = getdelim(&ioc_str, &ioc_len, SS_IOC_LINE_DELIMITER, ioc_fd)) >= 0) {
+        ++line;
+        int is_add = !strncasecmp(ioc_str, "add,", 4);
+        int is_del = !strncasecmp(ioc_str, "del,", 4);
+        iptr = (is_add || is_del) ? ss_ioc_entry_create(ioc_file, ioc_str + 4) : NULL;
+        if (iptr == NULL || ss_ioc_entry_prepare(iptr)) {
+            RTE_LOG(ERR, IOC, "could not parse ioc delta %s, line %lu\n", path, line);
+            if (iptr) ss_ioc_entry_destroy(iptr);
+            ++ss_ioc_stats.errors;
+            continue;
+        }
+#ifdef SS_IOC_BACKEND_RAM
+        // a later line for the same value overrides this one
+        key_length = ss_ioc_entry_key(iptr, key);
+        HASH_FIND(hh, keys, key, key_length, kptr);
+        if (kptr == NULL) {
+            kptr = je_calloc(1, sizeof(ss_ioc_key_t));
+            if (kptr == NULL) {
+                ss_ioc_entry_destroy(iptr);
+                goto error_out;
+            }
+            memcpy(kptr->key, key, key_length);
+            HASH_ADD(hh, keys, key, key_length, kptr);
+        }
+        if (kptr->add) {
+            TAILQ_REMOVE(&adds, kptr->add, entry);
+            ss_ioc_entry_destroy(kptr->add);
+            kptr->add = NULL;
+        }
+        if (is_add) {
+            TAILQ_INSERT_TAIL(&adds, iptr, entry);
+            kptr->add = iptr;
+        }
+        else {
+            ss_ioc_entry_destroy(iptr);
+        }
+#elif SS_IOC_BACKEND_DISK
+        rv = is_add ? ss_ioc_mdb_insert(txn, iptr) : ss_ioc_mdb_delete(txn, iptr, &removed);
+        if (!rv && is_add) ++added;
+        ss_ioc_entry_destroy(iptr);
+        if (rv) break;
+#endif
+    }
+    
+#ifdef SS_IOC_BACKEND_RAM
+    // adds replace, so every value named in the file loses its old copy
+    TAILQ_FOREACH_SAFE(iptr, &ss_conf->ioc_chain.ioc_list, entry, itmp) {
+        if (iptr->file_id != ioc_file->file_id) continue;
+        key_length = ss_ioc_entry_key(iptr, key);
+        HASH_FIND(hh, keys, key, key_length, kptr);
+        if (kptr == NULL) continue;
+        // the current tables still point here until the next generation
+        TAILQ_REMOVE(&ss_conf->ioc_chain.ioc_list, iptr, entry);
+        TAILQ_INSERT_TAIL(&ss_ioc_retired, iptr, entry);
+        ++ss_ioc_stats.removes;
+    }
+    
+    TAILQ_FOREACH_SAFE(iptr, &adds, entry, itmp) {
+        TAILQ_REMOVE(&adds, iptr, entry);
+        TAILQ_INSERT_TAIL(&ss_conf->ioc_chain.ioc_list, iptr, entry);
+        ++ss_ioc_stats.adds;
+    }
+#elif SS_IOC_BACKEND_DISK
+    if (!rv) rv = mdb_txn_commit(txn);
+    else     mdb_txn_abort(txn);
+    if (rv) {
+        RTE_LOG(ERR, IOC, "could not apply ioc delta %s to mdb: %s\n", path, mdb_strerror(rv));
+        rv = -1;
+        goto error_out;
+    }
+    // an aborted delta changed nothing, so it is only counted once committed
+    ss_ioc_stats.adds    += added;
+    ss_ioc_stats.removes += removed;
+#endif
+    
+    rv = 0;
+    
+    error_out:
+#ifdef SS_IOC_BACKEND_RAM
+    HASH_ITER(hh, keys, kptr, ktmp) {
+        HASH_DEL(keys, kptr);
+        je_free(kptr);
+    }
+#endif
+    ss_ioc_entries_destroy(&adds);
+    if (ioc_str) free(ioc_str);
+    if (ioc_fd)  fclose(ioc_fd);
+    return rv;
+}
+
+static int ss_ioc_update_filter(const struct dirent* dirent) {
+    size_t length = strlen(dirent->d_name);
+    size_t suffix = strlen(SS_IOC_DELTA_SUFFIX);
+    return length > suffix && !strcmp(dirent->d_name + length - suffix, SS_IOC_DELTA_SUFFIX);
+}
+
+/*
+ * Apply pending delta files in name order, then expire indicators whose
+ * ttl has run out. Applied files are removed; failed ones are renamed so
+ * they are not retried forever.
+ */
+int ss_ioc_update_poll() {
+    int       rv;
+    int       changes = 0;
+    char      path[PATH_MAX];
+    char      failed_path[PATH_MAX];
+    uint64_t  adds    = ss_ioc_stats.adds;
+    uint64_t  removes = ss_ioc_stats.removes;
+    uint64_t  expires = ss_ioc_stats.expires;
+    struct timespec start, end;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ss_ioc_clock = (uint32_t) time(NULL);
+    
+    for (uint64_t i = 0; i < ss_conf->ioc_file_id; ++i) {
+        ss_ioc_file_t* ioc_file = &ss_conf->ioc_files[i];
+        struct dirent** names = NULL;
+        if (ioc_file->delta_path == NULL) continue;
+        
+        int count = scandir(ioc_file->delta_path, &names, ss_ioc_update_filter, alphasort);
+        if (count < 0) {
+            RTE_LOG(ERR, IOC, "could not scan ioc delta path %s: %s\n", ioc_file->delta_path, strerror(errno));
+            continue;
+        }
+        for (int j = 0; j < count; ++j) {
+            snprintf(path, sizeof(path), "%s/%s", ioc_file->delta_path, names[j]->d_name);
+            rv = ss_ioc_update_apply(ioc_file, path);
+            if (rv) {
+                ++ss_ioc_stats.errors;
+                snprintf(failed_path, sizeof(failed_path), "%s.failed", path);
+                rename(path, failed_path);
+            }
+            else {
+                ++changes;
+                unlink(path);
+            }
+            free(names[j]);
+        }
+        free(names);
+    }
+    
+#ifdef SS_IOC_BACKEND_RAM
+    if (changes || ss_ioc_clock >= ss_ioc_next_expire) {
+        rv = ss_ioc_tables_publish();
+        if (rv) {
+            RTE_LOG(ERR, IOC, "could not build ioc tables, keeping generation %lu\n",
+                ss_conf->ioc_tables->generation);
+            ++ss_ioc_stats.errors;
+            return -1;
+        }
+    }
+    else {
+        return 0;
+    }
+#elif SS_IOC_BACKEND_DISK
+    MDB_txn* txn = NULL;
+    uint64_t expired = 0;
+    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, 0, &txn);
+    if (!rv) rv = ss_ioc_mdb_expire(txn, ss_ioc_clock, &expired);
+    if (!rv) rv = mdb_txn_commit(txn);
+    else if (txn) mdb_txn_abort(txn);
+    if (rv) {
+        RTE_LOG(ERR, IOC, "could not expire ioc mdb entries: %s\n", mdb_strerror(rv));
+        ++ss_ioc_stats.errors;
+    }
+    else {
+        ss_ioc_stats.expires += expired;
+    }
+    if (!changes && expires == ss_ioc_stats.expires) return 0;
+#endif
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t latency = (uint64_t) (end.tv_sec - start.tv_sec) * 1000000 +
+        (uint64_t) (end.tv_nsec - start.tv_nsec) / 1000;
+    ++ss_ioc_stats.updates;
+    ss_ioc_stats.latency_last_usec = latency;
+    ss_ioc_stats.latency_max_usec  = SS_MAX(ss_ioc_stats.latency_max_usec, latency);
+    RTE_LOG(NOTICE, IOC, "ioc update %lu: %d files, %lu adds, %lu removes, %lu expires in %lu usec "
+        "(max %lu usec, totals: %lu adds, %lu removes, %lu expires, %lu errors)\n",
+        ss_ioc_stats.updates, changes,
+        ss_ioc_stats.adds - adds, ss_ioc_stats.removes - removes, ss_ioc_stats.expires - expires,
+        latency, ss_ioc_stats.latency_max_usec,
+        ss_ioc_stats.adds, ss_ioc_stats.removes, ss_ioc_stats.expires, ss_ioc_stats.errors);
+    return 0;
+}
+
+static void* ss_ioc_update_thread(void* arg) {
+    uint32_t elapsed = 0;
+    while (1) {
+        sleep(1);
+        // the coarse clock also drives expiry checks on lookup
+        ss_ioc_clock = (uint32_t) time(NULL);
+        if (++elapsed < ss_conf->ioc_update_seconds) continue;
+        elapsed = 0;
+        ss_ioc_update_poll();
+    }
+    return NULL;
+}
+
+int ss_ioc_update_start() {
+    int rv;
+    pthread_t thread;
+    
+    if (ss_conf->ioc_update_seconds == 0) return 0;
+    rv = pthread_create(&thread, NULL, ss_ioc_update_thread, NULL);
+    if (rv) {
+        fprintf(stderr, "could not create ioc update thread: %s\n", strerror(rv));
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+/*
+ * Copy of the update counters, for the periodic ioc stats. The update
+ * thread writes them, each 64 bit counter is read whole.
+ */
+void ss_ioc_stats_get(ss_ioc_stats_t* stats) {
+    *stats = ss_ioc_stats;
+}
+
+/* called by each lcore between bursts, when it holds no ioc pointers */
+void ss_ioc_lcore_quiesce(unsigned int lcore_id) {
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables) ss_ioc_lcores[lcore_id].generation = tables->generation;
+#endif
+}
+
+ss_ioc_entry_t* ss_ioc_metadata_match(ss_metadata_t* md) {
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_entry_t*   results[2];
+    ss_ioc_ip_probe_t probes[2];
+    ss_ioc_tables_t*  tables = ss_conf->ioc_tables;
+    if (tables == NULL) return NULL;
+    
+    if      (md->eth_type == ETHER_TYPE_IPV4) probes[0].table = &tables->ip4_table;
+    else if (md->eth_type == ETHER_TYPE_IPV6) probes[0].table = &tables->ip6_table;
+    else return NULL;
+    
+    // source and destination are probed together, so their misses overlap
+    probes[0].key   = md->sip;
+    probes[1].table = probes[0].table;
+    probes[1].key   = md->dip;
+    ss_ioc_ip_probe_bulk(probes, 2, results);
+    return results[0] ? results[0] : results[1];
+#elif SS_IOC_BACKEND_DISK
+    ss_ioc_entry_t* iptr = NULL;
+    uint32_t ip;
+    
+    if (md->eth_type == ETHER_TYPE_IPV4) {
+        ip = *(uint32_t*) &md->sip;
+        iptr = ss_ioc_mdb_get(ss_conf->ip4_dbi, &ip, sizeof(ip));
+        if (iptr) return iptr;
+        
+        ip = *(uint32_t*) &md->dip;
+        iptr = ss_ioc_mdb_get(ss_conf->ip4_dbi, &ip, sizeof(ip));
+    }
+    else if (md->eth_type == ETHER_TYPE_IPV6) {
+        iptr = ss_ioc_mdb_get(ss_conf->ip6_dbi, &md->sip, sizeof(md->sip));
+        if (iptr) return iptr;
+        
+        iptr = ss_ioc_mdb_get(ss_conf->ip6_dbi, &md->dip, sizeof(md->dip));
+    }
+    
+    return iptr;
+#endif
+}
+
+#ifdef SS_IOC_BACKEND_DISK
+/*
+ * LMDB has no suffix lookup, so probe the name and then each parent zone,
+ * most specific first, honoring the match type stored with the indicator.
+ */
+static ss_ioc_entry_t* ss_ioc_domain_mdb_match(MDB_dbi dbi, const char* name) {
+    ss_ioc_entry_t* iptr;
+    char            tdns[SS_DNS_WIRE_NAME_MAX + 1];
+    size_t          length;
+    
+    length = ss_dns_name_canonicalize(tdns, name, sizeof(tdns));
+    for (char* suffix = tdns; length && *suffix; ) {
+        iptr = ss_ioc_mdb_get(dbi, suffix, length - (size_t) (suffix - tdns));
+        if (iptr) {
+            if (suffix == tdns && iptr->dns_match != SS_DNS_MATCH_WILDCARD) return iptr;
+            if (suffix != tdns && iptr->dns_match != SS_DNS_MATCH_EXACT)    return iptr;
+        }
+        suffix = strchr(suffix, '.');
+        if (suffix == NULL) break;
+        ++suffix;
+    }
+    return NULL;
+}
+#endif
+
+/*
+ * Looks up the name of length bytes (0 means strlen) among the domain
+ * IOCs and then, with with_hosts, among the hosts of url and email IOCs.
+ * Those hosts are kept apart, so they never hide or block a domain IOC.
+ */
+ss_ioc_entry_t* ss_ioc_domain_match(const char* name, size_t length, int with_hosts) {
+    ss_ioc_entry_t* iptr = NULL;
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) return NULL;
+    
+    // the trie takes the length, and ignores case and trailing dots
+    iptr = ss_ioc_entry_live(ss_dns_trie_lookup(tables->domain_table, name, length));
+    if (iptr == NULL && with_hosts) {
+        iptr = ss_ioc_entry_live(ss_dns_trie_lookup(tables->host_table, name, length));
+    }
+#elif SS_IOC_BACKEND_DISK
+    char tdns[SS_DNS_WIRE_NAME_MAX + 1];
+    if (length == 0) length = strlen(name);
+    if (length >= sizeof(tdns)) return NULL;
+    memcpy(tdns, name, length);
+    tdns[length] = '\0';
+    iptr = ss_ioc_domain_mdb_match(ss_conf->domain_dbi, tdns);
+    if (iptr == NULL && with_hosts) iptr = ss_ioc_domain_mdb_match(ss_conf->host_dbi, tdns);
+#endif
+    return iptr;
+}
+
+/* name is the whole question name, which md->dns_name may hold only part of */
+ss_ioc_entry_t* ss_ioc_dns_match(const char* name, ss_metadata_t* md) {
+    ss_ioc_entry_t* iptr = NULL;
+    
+    iptr = ss_ioc_domain_match(name, 0, 1);
+    if (iptr) goto out;
     
     for (int i = 0; i < SS_DNS_RESULT_MAX; ++i) {
         ss_answer_t* dns_answer = &md->dns_answers[i];
         switch (dns_answer->type) {
             case SS_TYPE_NAME: {
-#ifdef SS_IOC_BACKEND_RAM
-                HASH_FIND_STR(ss_conf->domain_table, (char*) dns_answer->payload, iptr);
+                iptr = ss_ioc_domain_match((char*) dns_answer->payload, 0, 1);
                 if (iptr) goto out;
-#elif SS_IOC_BACKEND_DISK
-                key.mv_size = strlen((char*)md->dns_name);
-                key.mv_data = &md->dns_name;
-                rv = mdb_get(txn, ss_conf->domain_dbi, &key, &value);
-                if (rv != MDB_NOTFOUND) {
-                    iptr = (ss_ioc_entry_t*) value.mv_data;
-                    goto out;
-                }
-#endif
                 break;
             }
             case SS_TYPE_IP: {
@@ -815,34 +1720,36 @@ ss_ioc_entry_t* ss_ioc_dns_match(ss_metadata_t* md) {
     }
     
     out:
-#ifdef SS_IOC_BACKEND_DISK
-    if (txn) mdb_txn_abort(txn);
-#endif
     return iptr;
 }
 
 // XXX: for URL and email, this should also try to match the domain
-ss_ioc_entry_t* ss_ioc_syslog_match(const char* ioc, ss_ioc_type_t ioc_type) {
+/*
+ * Looks up an indicator of ioc_type in the length bytes at ioc, which
+ * need not be NUL terminated, so regex matches are checked right in the
+ * message. Whatever has to be a C string is copied to the stack first.
+ */
+ss_ioc_entry_t* ss_ioc_syslog_match(const char* ioc, size_t length, ss_ioc_type_t ioc_type) {
     int             rv;
     ss_ioc_entry_t* iptr = NULL;
     ip_addr_t       ip_addr;
-    char            tdns[SS_DNS_NAME_MAX];
-#ifdef SS_IOC_BACKEND_DISK
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
-    
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc syslog match mdb transaction: %s\n", mdb_strerror(rv));
-        return NULL;
-    }
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) return NULL;
+    int g = tables->generation % SS_IOC_GENERATIONS;
 #endif
     
+    if (length == 0) return NULL;
+    
     switch (ioc_type) {
         case SS_IOC_TYPE_IP: {
-            rv = ss_cidr_parse(ioc, &ip_addr);
+            char ip_string[SS_ADDR_STR_MAX];
+            if (length >= sizeof(ip_string)) break;
+            memcpy(ip_string, ioc, length);
+            ip_string[length] = '\0';
+            rv = ss_cidr_parse(ip_string, &ip_addr);
             if (rv != 1) {
-                fprintf(stderr, "could not extract ip from ioc %s\n", ioc);
+                RTE_LOG(FINER, IOC, "could not extract ip from ioc %s\n", ip_string);
             }
             else {
                 iptr = ss_ioc_ip_match(&ip_addr);
@@ -850,114 +1757,84 @@ ss_ioc_entry_t* ss_ioc_syslog_match(const char* ioc, ss_ioc_type_t ioc_type) {
             break;
         }
         case SS_IOC_TYPE_DOMAIN: {
-            // NOTE: convert names to canonical form (trailing '.')
-            rv = (int) strlcpy(tdns, ioc, sizeof(tdns) - 2);
-            if (tdns[rv] != '.') {
-                tdns[rv]         = '.';
-                tdns[rv + 1]     = '\0';
-            }
-#ifdef SS_IOC_BACKEND_RAM
-            HASH_FIND_STR(ss_conf->domain_table, tdns, iptr);
-#elif SS_IOC_BACKEND_DISK
-            key.mv_size   = strlen(tdns);
-            key.mv_data   = tdns;
-            rv = mdb_get(txn, ss_conf->domain_dbi, &key, &value);
-            if (rv != MDB_NOTFOUND) {
-                iptr = (ss_ioc_entry_t*) value.mv_data;
-            }
-#endif
+            iptr = ss_ioc_domain_match(ioc, length, 1);
             break;
         }
         case SS_IOC_TYPE_URL: {
+            // url IOCs are stored normalized, so http urls are looked up so too
+            char url[SS_IOC_VALUE_SIZE];
+            int  url_length = -1;
+            if (length > 7 && !strncasecmp(ioc, SS_IOC_HTTP_URL, 7)) {
+                url_length = ss_http_url_value_normalize(ioc, length, url, sizeof(url));
+            }
+            if (url_length > 0) {
+                ioc    = url;
+                length = (size_t) url_length;
+            }
 #ifdef SS_IOC_BACKEND_RAM
-            HASH_FIND(hh_full, ss_conf->url_table, ioc, strlen(ioc), iptr);
+            HASH_FIND(hh_full[g], tables->url_table, ioc, length, iptr);
+            iptr = ss_ioc_entry_live(iptr);
 #elif SS_IOC_BACKEND_DISK
-            key.mv_size   = strlen(ioc);
-            key.mv_data   = (void*) ioc;
-            rv = mdb_get(txn, ss_conf->url_dbi, &key, &value);
-            if (rv != MDB_NOTFOUND) {
-                iptr = (ss_ioc_entry_t*) value.mv_data;
-            }
+            iptr = ss_ioc_mdb_get(ss_conf->url_dbi, ioc, length);
 #endif
             break;
         }
         case SS_IOC_TYPE_EMAIL: {
 #ifdef SS_IOC_BACKEND_RAM
-            HASH_FIND(hh_full, ss_conf->email_table, ioc, strlen(ioc), iptr);
+            HASH_FIND(hh_full[g], tables->email_table, ioc, length, iptr);
+            iptr = ss_ioc_entry_live(iptr);
 #elif SS_IOC_BACKEND_DISK
-            key.mv_size   = strlen(ioc);
-            key.mv_data   = (void*) ioc;
-            rv = mdb_get(txn, ss_conf->email_dbi, &key, &value);
-            if (rv != MDB_NOTFOUND) {
-                iptr = (ss_ioc_entry_t*) value.mv_data;
-            }
+            iptr = ss_ioc_mdb_get(ss_conf->email_dbi, ioc, length);
 #endif
             break;
         }
-        case SS_IOC_TYPE_MD5: {
-            fprintf(stderr, "ioc %s is unsupported md5 type\n", ioc);
-            break;
-        }
+        case SS_IOC_TYPE_MD5:
+        case SS_IOC_TYPE_SHA1:
         case SS_IOC_TYPE_SHA256: {
-            fprintf(stderr, "ioc %s is unsupported sha256 type\n", ioc);
+            uint8_t digest[SS_DIGEST_MAX];
+            size_t  size = ss_ioc_digest_size(ioc_type);
+            if (length != size * 2 || ss_hex_decode(digest, ioc, size * 2)) break;
+#ifdef SS_IOC_BACKEND_RAM
+            ss_ioc_entry_t* table = *ss_ioc_digest_table_get(tables, ioc_type);
+            HASH_FIND(hh_full[g], table, digest, size, iptr);
+            iptr = ss_ioc_entry_live(iptr);
+#elif SS_IOC_BACKEND_DISK
+            iptr = ss_ioc_mdb_get(ss_ioc_digest_dbi_get(ioc_type), digest, size);
+#endif
             break;
         }
         default: {
-            fprintf(stderr, "ioc %s is unknown type %d\n", ioc, ioc_type);
+            RTE_LOG(ERR, IOC, "ioc %.*s is unknown type %d\n", (int) length, ioc, ioc_type);
             break;
         }
     }
     
-    out:
-#ifdef SS_IOC_BACKEND_DISK
-    if (txn) mdb_txn_abort(txn);
-#endif
     return iptr;
 }
 
 ss_ioc_entry_t* ss_ioc_ip_match(ip_addr_t* ip) {
     ss_ioc_entry_t* iptr = NULL;
-#ifdef SS_IOC_BACKEND_DISK
-    int   rv;
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
-    
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc ip match mdb transaction: %s\n", mdb_strerror(rv));
-        return NULL;
-    }
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) return NULL;
 #endif
 
     switch (ip->family) {
         case SS_AF_INET4: {
 #ifdef SS_IOC_BACKEND_RAM
-            uint32_t iip = *(uint32_t*) &ip->ip4_addr;
-            HASH_FIND_INT(ss_conf->ip4_table, &iip, iptr);
-            if (iptr) goto out;
+            iptr = ss_ioc_ip_table_find(&tables->ip4_table, &ip->ip4_addr,
+                ss_ioc_ip_signature(&ip->ip4_addr, IPV4_ALEN));
 #elif SS_IOC_BACKEND_DISK
-            key.mv_size   = sizeof(uint32_t);
-            key.mv_data   = (uint32_t*) &ip->ip4_addr;
-            rv = mdb_get(txn, ss_conf->ip4_dbi, &key, &value);
-            if (rv != MDB_NOTFOUND) {
-                iptr = (ss_ioc_entry_t*) value.mv_data;
-                goto out;
-            }
+            iptr = ss_ioc_mdb_get(ss_conf->ip4_dbi, &ip->ip4_addr, sizeof(uint32_t));
 #endif
             break;
         }
         case SS_AF_INET6: {
 #ifdef SS_IOC_BACKEND_RAM
-            HASH_FIND(hh, ss_conf->ip6_table, &ip->ip6_addr, sizeof(ip->ip6_addr), iptr);
-            if (iptr) goto out;
+            iptr = ss_ioc_ip_table_find(&tables->ip6_table, &ip->ip6_addr,
+                ss_ioc_ip_signature(&ip->ip6_addr, IPV6_ALEN));
 #elif SS_IOC_BACKEND_DISK
-            key.mv_size   = sizeof(ip->ip6_addr);
-            key.mv_data   = &ip->ip6_addr;
-            rv = mdb_get(txn, ss_conf->ip6_dbi, &key, &value);
-            if (rv != MDB_NOTFOUND) {
-                iptr = (ss_ioc_entry_t*) value.mv_data;
-                goto out;
-            }
+            iptr = ss_ioc_mdb_get(ss_conf->ip6_dbi, &ip->ip6_addr, sizeof(ip->ip6_addr));
 #endif
             break;
         }
@@ -965,63 +1842,94 @@ ss_ioc_entry_t* ss_ioc_ip_match(ip_addr_t* ip) {
         }
     }
     
-    out:
-#ifdef SS_IOC_BACKEND_DISK
-    if (txn) mdb_txn_abort(txn);
-#endif
     return iptr;
 }
 
+/*
+ * Look up to SS_IOC_BULK_MAX addresses at once. Bit i of the result is set
+ * when results[i] matched. With the disk backend, results stay valid until
+ * the next bulk lookup on the lcore.
+ */
+uint64_t ss_ioc_ip_match_bulk(ip_addr_t** ips, unsigned int count, ss_ioc_entry_t** results) {
+    if (count > SS_IOC_BULK_MAX) count = SS_IOC_BULK_MAX;
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_ip_probe_t probes[SS_IOC_BULK_MAX];
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) {
+        memset(results, 0, count * sizeof(*results));
+        return 0;
+    }
+    
+    for (unsigned int i = 0; i < count; ++i) {
+        probes[i].table = ss_ioc_ip_table_get(tables, ips[i]->family);
+        // ip4_addr and ip6_addr both start the address union
+        probes[i].key   = &ips[i]->ip6_addr;
+    }
+    return ss_ioc_ip_probe_bulk(probes, count, results);
+#elif SS_IOC_BACKEND_DISK
+    uint64_t hits = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        results[i] = ss_ioc_mdb_bulk_save(i, ss_ioc_ip_match(ips[i]));
+        if (results[i]) hits |= UINT64_C(1) << i;
+    }
+    return hits;
+#endif
+}
+
 ss_ioc_entry_t* ss_ioc_xaddr_match(struct xaddr* addr) {
     ss_ioc_entry_t* iptr = NULL;
     uint32_t ip;
-#ifdef SS_IOC_BACKEND_DISK
-    int   rv;
-    MDB_txn* txn = NULL;
-    MDB_val  key, value;
-    
-    rv = mdb_txn_begin(ss_conf->mdb_env, NULL, MDB_RDONLY, &txn);
-    if (rv) {
-        fprintf(stderr, "could not begin ioc xaddr match mdb transaction: %s\n", mdb_strerror(rv));
-        goto out;
-    }
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) return NULL;
 #endif
     
     if      (addr->af == SS_AF_INET4) {
         ip = *(uint32_t*) &addr->v4.s_addr;
 #ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND_INT(ss_conf->ip4_table, &ip, iptr);
+        iptr = ss_ioc_ip_table_find(&tables->ip4_table, &ip, ss_ioc_ip_signature(&ip, IPV4_ALEN));
 #elif SS_IOC_BACKEND_DISK
-        key.mv_size   = sizeof(uint32_t);
-        key.mv_data   = &ip;
-        rv = mdb_get(txn, ss_conf->ip4_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
-        }
+        iptr = ss_ioc_mdb_get(ss_conf->ip4_dbi, &ip, sizeof(ip));
 #endif
     }
     else if (addr->af == SS_AF_INET6) {
 #ifdef SS_IOC_BACKEND_RAM
-        HASH_FIND(hh, ss_conf->ip6_table, addr->v6.s6_addr, sizeof(addr->v6.s6_addr), iptr);
+        iptr = ss_ioc_ip_table_find(&tables->ip6_table, addr->v6.s6_addr,
+            ss_ioc_ip_signature(addr->v6.s6_addr, IPV6_ALEN));
 #elif SS_IOC_BACKEND_DISK
-        key.mv_size   = sizeof(addr->v6.s6_addr);
-        key.mv_data   = addr->v6.s6_addr;
-        rv = mdb_get(txn, ss_conf->ip6_dbi, &key, &value);
-        if (rv != MDB_NOTFOUND) {
-            iptr = (ss_ioc_entry_t*) value.mv_data;
-            goto out;
-        }
+        iptr = ss_ioc_mdb_get(ss_conf->ip6_dbi, addr->v6.s6_addr, sizeof(addr->v6.s6_addr));
 #endif
     }
 
-    out:    
-#ifdef SS_IOC_BACKEND_DISK
-    if (txn) mdb_txn_abort(txn);
-#endif
     return iptr;
 }
 
+/* same contract as ss_ioc_ip_match_bulk */
+uint64_t ss_ioc_xaddr_match_bulk(struct xaddr** addrs, unsigned int count, ss_ioc_entry_t** results) {
+    if (count > SS_IOC_BULK_MAX) count = SS_IOC_BULK_MAX;
+#ifdef SS_IOC_BACKEND_RAM
+    ss_ioc_ip_probe_t probes[SS_IOC_BULK_MAX];
+    ss_ioc_tables_t* tables = ss_conf->ioc_tables;
+    if (tables == NULL) {
+        memset(results, 0, count * sizeof(*results));
+        return 0;
+    }
+    
+    for (unsigned int i = 0; i < count; ++i) {
+        probes[i].table = ss_ioc_ip_table_get(tables, addrs[i]->af);
+        probes[i].key   = addrs[i]->addr8;
+    }
+    return ss_ioc_ip_probe_bulk(probes, count, results);
+#elif SS_IOC_BACKEND_DISK
+    uint64_t hits = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        results[i] = ss_ioc_mdb_bulk_save(i, ss_ioc_xaddr_match(addrs[i]));
+        if (results[i]) hits |= UINT64_C(1) << i;
+    }
+    return hits;
+#endif
+}
+
 ss_ioc_entry_t* ss_ioc_netflow_match(struct store_flow_complete* flow) {
     ss_ioc_entry_t* iptr = NULL;
     
@@ -1037,3 +1945,152 @@ ss_ioc_entry_t* ss_ioc_netflow_match(struct store_flow_complete* flow) {
     
     return iptr;
 }
+
+/*
+ * Match the four addresses of up to SS_IOC_NETFLOW_BULK_MAX flows in one
+ * bulk lookup. results[i] is the first match for flows[i], in the order
+ * used by ss_ioc_netflow_match. Returns how many flows were looked up;
+ * callers loop until all of theirs are done.
+ */
+unsigned int ss_ioc_netflow_match_bulk(struct store_flow_complete* flows, unsigned int count, ss_ioc_entry_t** results) {
+    struct xaddr*   addrs[SS_IOC_BULK_MAX];
+    ss_ioc_entry_t* aresults[SS_IOC_BULK_MAX];
+    
+    if (count > SS_IOC_NETFLOW_BULK_MAX) count = SS_IOC_NETFLOW_BULK_MAX;
+    for (unsigned int i = 0; i < count; ++i) {
+        /* XXX: some day, check the src_as and dst_as */
+        addrs[i * 4 + 0] = &flows[i].agent_addr;
+        addrs[i * 4 + 1] = &flows[i].src_addr;
+        addrs[i * 4 + 2] = &flows[i].dst_addr;
+        addrs[i * 4 + 3] = &flows[i].gateway_addr;
+    }
+    
+    ss_ioc_xaddr_match_bulk(addrs, count * 4, aresults);
+    for (unsigned int i = 0; i < count; ++i) {
+        results[i] = NULL;
+        for (unsigned int j = 0; j < 4 && results[i] == NULL; ++j) {
+            results[i] = aresults[i * 4 + j];
+        }
+    }
+    
+    return count;
+}
+
+/*
+ * Renew the lcore's read transaction, so it sees indicators committed
+ * since the last tick and stops pinning pages of the old snapshot.
+ */
+int ss_ioc_timer_callback(unsigned int lcore_id) {
+#ifdef SS_IOC_BACKEND_DISK
+    int rv;
+    if (lcore_id >= RTE_MAX_LCORE) return -1;
+    ss_ioc_mdb_lcore_t* lcore = &ss_ioc_mdb_lcores[lcore_id];
+    
+    if (lcore->txn == NULL) return 0;
+    mdb_txn_reset(lcore->txn);
+    rv = mdb_txn_renew(lcore->txn);
+    if (rv) {
+        RTE_LOG(ERR, IOC, "could not renew ioc mdb read transaction: %s\n", mdb_strerror(rv));
+        mdb_txn_abort(lcore->txn);
+        lcore->txn = NULL;
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+int ss_ioc_mdb_txns_destroy() {
+#ifdef SS_IOC_BACKEND_DISK
+    for (int i = 0; i <= RTE_MAX_LCORE; ++i) {
+        if (ss_ioc_mdb_lcores[i].txn) mdb_txn_abort(ss_ioc_mdb_lcores[i].txn);
+        ss_ioc_mdb_lcores[i].txn = NULL;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Time ss_ioc_ip_match one key at a time against ss_ioc_ip_match_bulk on
+ * the loaded indicators, and print lookups per second for both. One key
+ * in eight is a loaded IPv4 indicator, the rest are pseudo-random IPv4
+ * addresses, which nearly always miss. Run by "sdn_sensor -b" before the
+ * EAL starts, so it reports to stderr.
+ */
+int ss_ioc_ip_bench(uint64_t rounds) {
+    int             rv      = -1;
+    ip_addr_t*      ips     = NULL;
+    ip_addr_t*      batch[SS_IOC_BULK_MAX];
+    ss_ioc_entry_t* results[SS_IOC_BULK_MAX];
+    ss_ioc_entry_t* iptr;
+    ss_ioc_entry_t* hit     = NULL;
+    uint64_t        scalar_hits = 0;
+    uint64_t        bulk_hits   = 0;
+    uint32_t        seed    = 0x9e3779b9;
+    struct timespec start, end;
+    
+    ips = je_calloc(SS_IOC_BENCH_KEYS, sizeof(ip_addr_t));
+    if (ips == NULL) {
+        fprintf(stderr, "could not allocate ioc benchmark keys\n");
+        goto error_out;
+    }
+    
+    for (uint32_t i = 0; i < SS_IOC_BENCH_KEYS; ++i) {
+        ips[i].family = SS_AF_INET4;
+        ips[i].prefix = 32;
+        if (i % 8 == 0) {
+            // cycle through the IPv4 indicators, so hits land all over the table
+            do {
+                hit = hit ? TAILQ_NEXT(hit, entry) : TAILQ_FIRST(&ss_conf->ioc_chain.ioc_list);
+            } while (hit && !(hit->type == SS_IOC_TYPE_IP && hit->ip.family == SS_AF_INET4));
+            if (hit == NULL) {
+                for (hit = TAILQ_FIRST(&ss_conf->ioc_chain.ioc_list); hit; hit = TAILQ_NEXT(hit, entry)) {
+                    if (hit->type == SS_IOC_TYPE_IP && hit->ip.family == SS_AF_INET4) break;
+                }
+            }
+            if (hit) {
+                ips[i].ip4_addr = hit->ip.ip4_addr;
+                continue;
+            }
+        }
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        memcpy(&ips[i].ip4_addr, &seed, sizeof(seed));
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t round = 0; round < rounds; ++round) {
+        for (uint32_t i = 0; i < SS_IOC_BENCH_KEYS; ++i) {
+            iptr = ss_ioc_ip_match(&ips[i]);
+            if (iptr) ++scalar_hits;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double scalar_secs = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t round = 0; round < rounds; ++round) {
+        for (uint32_t i = 0; i < SS_IOC_BENCH_KEYS; i += SS_IOC_BULK_MAX) {
+            for (uint32_t j = 0; j < SS_IOC_BULK_MAX; ++j) batch[j] = &ips[i + j];
+            bulk_hits += (uint64_t) __builtin_popcountll(ss_ioc_ip_match_bulk(batch, SS_IOC_BULK_MAX, results));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double bulk_secs = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    uint64_t lookups = rounds * SS_IOC_BENCH_KEYS;
+    fprintf(stderr, "ioc ip benchmark: %lu lookups, %lu hits scalar, %lu hits bulk\n",
+        lookups, scalar_hits, bulk_hits);
+    fprintf(stderr, "ioc ip benchmark: scalar %.0f lookups/sec, bulk %.0f lookups/sec, speedup %.2fx\n",
+        (double) lookups / scalar_secs, (double) lookups / bulk_secs, scalar_secs / bulk_secs);
+    if (scalar_hits != bulk_hits) {
+        fprintf(stderr, "ioc ip benchmark: scalar and bulk lookups disagree\n");
+        goto error_out;
+    }
+    
+    rv = 0;
+    
+    error_out:
+    if (ips) je_free(ips);
+    return rv;
+}
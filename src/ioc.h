@@ -8,16 +8,25 @@
 #include <uthash.h>
 
 #include "common.h"
+#include "hex_utils.h"
 #include "ip_utils.h"
 #include "netflow_addr.h"
 #include "netflow_format.h"
 
 /* CONSTANTS */
 
-#define SS_IOC_FILE_MAX           8
+#define SS_IOC_FILE_MAX          64
 #define SS_IOC_THREAT_TYPE_SIZE  24
 #define SS_IOC_VALUE_SIZE        96
 #define SS_IOC_DNS_SIZE          96
+#define SS_IOC_MDB_FORMAT         3
+#define SS_IOC_MDB_FORMAT_KEY    "format"
+#define SS_IOC_GENERATIONS        2
+#define SS_IOC_BULK_MAX          64
+#define SS_IOC_NETFLOW_BULK_MAX  (SS_IOC_BULK_MAX / 4)
+#define SS_IOC_BENCH_KEYS      65536
+#define SS_IOC_BENCH_ROUNDS       64
+#define SS_IOC_IP_SLOTS_MIN    1024
 
 enum ss_ioc_type_e {
     SS_IOC_TYPE_EMPTY  = 0,
@@ -35,20 +44,41 @@ typedef enum ss_ioc_type_e ss_ioc_type_t;
 
 struct ss_ioc_entry_s {
     uint64_t      file_id;
-    uint64_t      matches;
     uint64_t      id;
     ss_ioc_type_t type;
     char          threat_type[SS_IOC_THREAT_TYPE_SIZE];
     ip_addr_t     ip;
     char          value[SS_IOC_VALUE_SIZE];
     char          dns[SS_IOC_DNS_SIZE];
-    UT_hash_handle hh;
-    UT_hash_handle hh_full;
+    uint8_t       digest[SS_DIGEST_MAX];
+    ss_dns_match_t dns_match;
+    uint32_t      expire_time;
+    /* one handle per live table generation, so an entry can sit in both */
+    UT_hash_handle hh_full[SS_IOC_GENERATIONS];
     TAILQ_ENTRY(ss_ioc_entry_s) entry;
 } __rte_cache_aligned;
 
 typedef struct ss_ioc_entry_s ss_ioc_entry_t;
 
+/*
+ * Fixed layout form of an indicator, stored as the LMDB value. It holds no
+ * pointers, so an existing environment can be reopened by a later run.
+ * value and dns follow the header as two NUL terminated strings.
+ */
+struct ss_ioc_record_s {
+    uint64_t  id;
+    ip_addr_t ip;
+    char      threat_type[SS_IOC_THREAT_TYPE_SIZE];
+    uint8_t   file_id;
+    uint8_t   type;
+    uint8_t   dns_match;
+    uint8_t   value_length;
+    uint32_t  expire_time;
+    char      strings[];
+} __attribute__((packed));
+
+typedef struct ss_ioc_record_s ss_ioc_record_t;
+
 TAILQ_HEAD(ss_ioc_list_s, ss_ioc_entry_s);
 typedef struct ss_ioc_list_s ss_ioc_list_t;
 
@@ -58,6 +88,61 @@ struct ss_ioc_chain_s {
 
 typedef struct ss_ioc_chain_s ss_ioc_chain_t;
 
+/*
+ * IP tables are open addressing with the key copied into the slot, so a
+ * probe touches one cache line and never the entry itself. That lets the
+ * bulk lookups hash every key and prefetch every slot before comparing.
+ */
+struct ss_ioc_ip_slot_s {
+    uint8_t         key[IPV6_ALEN];
+    uint32_t        signature; /* 0 marks an empty slot */
+    uint32_t        unused;
+    ss_ioc_entry_t* entry;
+};
+
+typedef struct ss_ioc_ip_slot_s ss_ioc_ip_slot_t;
+
+struct ss_ioc_ip_table_s {
+    uint32_t          key_length;
+    uint32_t          count;
+    uint32_t          mask;
+    ss_ioc_ip_slot_t* slots;
+};
+
+typedef struct ss_ioc_ip_table_s ss_ioc_ip_table_t;
+
+/*
+ * Lookup tables built from the ioc_chain. Updates build a new generation
+ * beside the current one and swap the pointer, so lcores never wait.
+ */
+struct ss_ioc_tables_s {
+    uint64_t        generation;
+    uint64_t        count;
+    ss_ioc_ip_table_t ip4_table;
+    ss_ioc_ip_table_t ip6_table;
+    ss_dns_trie_t*  domain_table;
+    ss_dns_trie_t*  host_table; /* hosts of url and email iocs, kept apart from domains */
+    ss_ioc_entry_t* url_table;
+    ss_ioc_entry_t* email_table;
+    ss_ioc_entry_t* md5_table;
+    ss_ioc_entry_t* sha1_table;
+    ss_ioc_entry_t* sha256_table;
+} __rte_cache_aligned;
+
+typedef struct ss_ioc_tables_s ss_ioc_tables_t;
+
+struct ss_ioc_stats_s {
+    uint64_t updates;
+    uint64_t adds;
+    uint64_t removes;
+    uint64_t expires;
+    uint64_t errors;
+    uint64_t latency_last_usec;
+    uint64_t latency_max_usec;
+};
+
+typedef struct ss_ioc_stats_s ss_ioc_stats_t;
+
 struct store_flow_complete;
 
 /* BEGIN PROTOTYPES */
@@ -75,13 +160,26 @@ int ss_ioc_chain_destroy(void);
 int ss_ioc_chain_add(ss_ioc_entry_t* ioc_entry);
 int ss_ioc_chain_remove_index(int index);
 int ss_ioc_chain_remove_id(uint64_t id);
+ss_ioc_tables_t* ss_ioc_tables_create(uint64_t generation);
+int ss_ioc_tables_destroy(ss_ioc_tables_t* tables);
 int ss_ioc_chain_optimize(void);
+int ss_ioc_update_poll(void);
+int ss_ioc_update_start(void);
+void ss_ioc_stats_get(ss_ioc_stats_t* stats);
+void ss_ioc_lcore_quiesce(unsigned int lcore_id);
 ss_ioc_entry_t* ss_ioc_metadata_match(ss_metadata_t* md);
-ss_ioc_entry_t* ss_ioc_dns_match(ss_metadata_t* md);
-ss_ioc_entry_t* ss_ioc_syslog_match(const char* ioc, ss_ioc_type_t ioc_type);
+ss_ioc_entry_t* ss_ioc_domain_match(const char* name, size_t length, int with_hosts);
+ss_ioc_entry_t* ss_ioc_dns_match(const char* name, ss_metadata_t* md);
+ss_ioc_entry_t* ss_ioc_syslog_match(const char* ioc, size_t length, ss_ioc_type_t ioc_type);
 ss_ioc_entry_t* ss_ioc_ip_match(ip_addr_t* ip);
+uint64_t ss_ioc_ip_match_bulk(ip_addr_t** ips, unsigned int count, ss_ioc_entry_t** results);
 ss_ioc_entry_t* ss_ioc_xaddr_match(struct xaddr* addr);
+uint64_t ss_ioc_xaddr_match_bulk(struct xaddr** addrs, unsigned int count, ss_ioc_entry_t** results);
 ss_ioc_entry_t* ss_ioc_netflow_match(struct store_flow_complete* flow);
+unsigned int ss_ioc_netflow_match_bulk(struct store_flow_complete* flows, unsigned int count, ss_ioc_entry_t** results);
+int ss_ioc_timer_callback(unsigned int lcore_id);
+int ss_ioc_mdb_txns_destroy(void);
+int ss_ioc_ip_bench(uint64_t rounds);
 
 /* END PROTOTYPES */
 
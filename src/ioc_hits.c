@@ -0,0 +1,283 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+
+#include "ioc_hits.h"
+
+#include "common.h"
+#include "sdn_sensor.h"
+
+/*
+ * Counts IOC hits per indicator without sharing a cache line between the
+ * lcores. Every interval the master lcore merges the per lcore buffers into
+ * its own totals, and logs the busiest indicators and the hits of each feed.
+ */
+
+static ss_ioc_hit_lcore_t ss_ioc_hit_lcores[RTE_MAX_LCORE];
+
+/* only touched by the master lcore */
+static ss_ioc_hit_t* ss_ioc_hit_totals;
+static uint32_t      ss_ioc_hit_totals_mask;
+static uint32_t      ss_ioc_hit_totals_used;
+static uint64_t      ss_ioc_hit_file_totals[SS_IOC_FILE_MAX];
+static uint64_t      ss_ioc_hit_next_tsc;
+static ss_ioc_stats_t ss_ioc_hit_updates;    /* update counters at the last dump */
+
+static inline uint32_t ss_ioc_hit_hash(uint64_t file_id, uint64_t id) {
+    return rte_hash_crc_8byte(id, rte_hash_crc_4byte((uint32_t) file_id, SS_IOC_HITS_HASH_INIT));
+}
+
+/* callers keep the slots under 3/4 full, so a free slot is always found */
+static ss_ioc_hit_t* ss_ioc_hit_slot(ss_ioc_hit_t* slots, uint32_t mask, uint64_t file_id, uint64_t id) {
+    uint32_t i = ss_ioc_hit_hash(file_id, id) & mask;
+
+    for (;;) {
+        ss_ioc_hit_t* hptr = &slots[i];
+        if (hptr->count == 0 && hptr->total == 0) return hptr;
+        if (hptr->id == id && hptr->file_id == file_id) return hptr;
+        i = (i + 1) & mask;
+    }
+}
+
+int ss_ioc_hits_init() {
+    unsigned int lcore_id;
+    uint32_t slots = SS_IOC_HITS_SLOTS_MIN;
+
+    if (ss_conf->ioc_stats_seconds == 0) return 0;
+
+    /* never so few that the 3/4 limit leaves no slot free for probing */
+    while (slots < ss_conf->ioc_stats_entries) slots <<= 1;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_ioc_hit_lcore_t* lcore = &ss_ioc_hit_lcores[lcore_id];
+        for (int i = 0; i < 2; ++i) {
+            lcore->buffers[i].slots = je_calloc(slots, sizeof(ss_ioc_hit_t));
+            if (lcore->buffers[i].slots == NULL) goto error_out;
+        }
+        lcore->mask = slots - 1;
+    }
+
+    ss_ioc_hit_totals = je_calloc(slots * 2, sizeof(ss_ioc_hit_t));
+    if (ss_ioc_hit_totals == NULL) goto error_out;
+    ss_ioc_hit_totals_mask = slots * 2 - 1;
+    ss_ioc_hit_next_tsc    = rte_rdtsc() + ss_conf->ioc_stats_seconds * rte_get_tsc_hz();
+
+    return 0;
+
+    error_out:
+    RTE_LOG(ERR, IOC, "could not allocate ioc hit counters\n");
+    ss_ioc_hits_destroy();
+    return -1;
+}
+
+void ss_ioc_hits_record(ss_ioc_entry_t* iptr) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_ioc_hit_lcore_t* lcore;
+    ss_ioc_hit_buffer_t* buffer;
+    ss_ioc_hit_t* hptr;
+
+    if (lcore_id >= RTE_MAX_LCORE) return;
+    lcore  = &ss_ioc_hit_lcores[lcore_id];
+    buffer = &lcore->buffers[lcore->active];
+    if (buffer->slots == NULL) return;
+
+    if (iptr->file_id < SS_IOC_FILE_MAX) ++buffer->file_hits[iptr->file_id];
+    hptr = ss_ioc_hit_slot(buffer->slots, lcore->mask, iptr->file_id, iptr->id);
+    if (hptr->count == 0) {
+        if (buffer->used >= (lcore->mask + 1) - (lcore->mask + 1) / 4) {
+            ++buffer->overflow;
+            return;
+        }
+        hptr->file_id = iptr->file_id;
+        hptr->id      = iptr->id;
+        ++buffer->used;
+    }
+    ++hptr->count;
+    hptr->last_tsc = rte_rdtsc();
+}
+
+static int ss_ioc_hits_totals_resize(void) {
+    uint32_t mask = ss_ioc_hit_totals_mask * 2 + 1;
+    ss_ioc_hit_t* totals = je_calloc(mask + 1, sizeof(ss_ioc_hit_t));
+
+    if (totals == NULL) {
+        RTE_LOG(ERR, IOC, "could not grow ioc hit totals to %u slots\n", mask + 1);
+        return -1;
+    }
+    for (uint32_t i = 0; i <= ss_ioc_hit_totals_mask; ++i) {
+        ss_ioc_hit_t* hptr = &ss_ioc_hit_totals[i];
+        if (hptr->total == 0) continue;
+        *ss_ioc_hit_slot(totals, mask, hptr->file_id, hptr->id) = *hptr;
+    }
+    je_free(ss_ioc_hit_totals);
+    ss_ioc_hit_totals      = totals;
+    ss_ioc_hit_totals_mask = mask;
+
+    return 0;
+}
+
+static void ss_ioc_hits_merge(ss_ioc_hit_t* hit) {
+    ss_ioc_hit_t* hptr;
+
+    if ((ss_ioc_hit_totals_used + 1) * 2 > ss_ioc_hit_totals_mask + 1 &&
+        ss_ioc_hits_totals_resize()) return;
+
+    hptr = ss_ioc_hit_slot(ss_ioc_hit_totals, ss_ioc_hit_totals_mask, hit->file_id, hit->id);
+    if (hptr->total == 0) {
+        hptr->file_id = hit->file_id;
+        hptr->id      = hit->id;
+        ++ss_ioc_hit_totals_used;
+    }
+    hptr->count   += hit->count;
+    hptr->total   += hit->count;
+    hptr->last_tsc = SS_MAX(hptr->last_tsc, hit->last_tsc);
+}
+
+static void ss_ioc_hits_dump(uint64_t now, uint64_t* file_hits, uint64_t overflow, unsigned int behind) {
+    ss_ioc_hit_t* top[SS_IOC_HITS_TOP_MAX];
+    unsigned int top_count = 0;
+    unsigned int limit = SS_MIN(ss_conf->ioc_stats_top, SS_IOC_HITS_TOP_MAX);
+    uint32_t seconds = ss_conf->ioc_stats_seconds;
+    double hz = (double) rte_get_tsc_hz();
+    uint64_t hits = 0;
+    uint32_t indicators = 0;
+    ss_ioc_stats_t updates;
+
+    for (uint32_t i = 0; i <= ss_ioc_hit_totals_mask; ++i) {
+        ss_ioc_hit_t* hptr = &ss_ioc_hit_totals[i];
+        unsigned int j;
+        if (hptr->count == 0) continue;
+        hits += hptr->count;
+        ++indicators;
+
+        /* keep top sorted by count, largest first */
+        if (top_count < limit) j = top_count++;
+        else if (limit && hptr->count > top[limit - 1]->count) j = limit - 1;
+        else continue;
+        for (; j > 0 && top[j - 1]->count < hptr->count; --j) top[j] = top[j - 1];
+        top[j] = hptr;
+    }
+
+    RTE_LOG(NOTICE, IOC, "ioc hits in %u secs: %lu hits on %u indicators, %lu untracked, %u lcores behind\n",
+        seconds, hits, indicators, overflow, behind);
+
+    for (uint64_t i = 0; i < ss_conf->ioc_file_id; ++i) {
+        ss_ioc_hit_file_totals[i] += file_hits[i];
+        RTE_LOG(NOTICE, IOC, "ioc feed %lu %s: %lu hits, %.3f hits/sec, %lu total\n",
+            i, ss_conf->ioc_files[i].path, file_hits[i],
+            (double) file_hits[i] / seconds, ss_ioc_hit_file_totals[i]);
+    }
+
+    for (unsigned int i = 0; i < top_count; ++i) {
+        RTE_LOG(NOTICE, IOC, "ioc top %u: feed %lu id %lu: %lu hits, %lu total, last %.1f secs ago\n",
+            i + 1, top[i]->file_id, top[i]->id, top[i]->count, top[i]->total,
+            (double) (now - top[i]->last_tsc) / hz);
+    }
+
+    /* feed churn from the update thread, since the last dump */
+    ss_ioc_stats_get(&updates);
+    RTE_LOG(NOTICE, IOC, "ioc updates in %u secs: %lu updates, %lu adds, %lu removes, %lu expires, %lu errors, "
+        "last %lu usec, max %lu usec\n",
+        seconds, updates.updates - ss_ioc_hit_updates.updates,
+        updates.adds - ss_ioc_hit_updates.adds, updates.removes - ss_ioc_hit_updates.removes,
+        updates.expires - ss_ioc_hit_updates.expires, updates.errors - ss_ioc_hit_updates.errors,
+        updates.latency_last_usec, updates.latency_max_usec);
+    ss_ioc_hit_updates = updates;
+}
+
+/*
+ * Merges the buffer of each lcore which switched since the last interval,
+ * then hands it back cleared. An lcore which has not switched yet is left
+ * for the next interval.
+ */
+static void ss_ioc_hits_aggregate(uint64_t now) {
+    uint64_t file_hits[SS_IOC_FILE_MAX];
+    uint64_t overflow = 0;
+    unsigned int behind = 0;
+    unsigned int lcore_id;
+
+    memset(file_hits, 0, sizeof(file_hits));
+    for (uint32_t i = 0; i <= ss_ioc_hit_totals_mask; ++i) {
+        ss_ioc_hit_totals[i].count = 0;
+    }
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_ioc_hit_lcore_t* lcore = &ss_ioc_hit_lcores[lcore_id];
+        ss_ioc_hit_buffer_t* buffer;
+
+        if (lcore->active != lcore->requested) {
+            ++behind;
+            continue;
+        }
+        rte_rmb();
+
+        buffer = &lcore->buffers[lcore->active ^ 1];
+        for (uint32_t i = 0; buffer->used && i <= lcore->mask; ++i) {
+            if (buffer->slots[i].count) ss_ioc_hits_merge(&buffer->slots[i]);
+        }
+        for (int i = 0; i < SS_IOC_FILE_MAX; ++i) {
+            file_hits[i] += buffer->file_hits[i];
+        }
+        overflow += buffer->overflow;
+
+        if (buffer->used) memset(buffer->slots, 0, (lcore->mask + 1) * sizeof(ss_ioc_hit_t));
+        memset(buffer->file_hits, 0, sizeof(buffer->file_hits));
+        buffer->used     = 0;
+        buffer->overflow = 0;
+
+        rte_wmb();
+        lcore->requested = lcore->active ^ 1;
+    }
+
+    ss_ioc_hits_dump(now, file_hits, overflow, behind);
+}
+
+void ss_ioc_hits_timer_callback(unsigned int lcore_id) {
+    ss_ioc_hit_lcore_t* lcore = &ss_ioc_hit_lcores[lcore_id];
+    uint64_t now;
+
+    if (lcore->buffers[0].slots == NULL) return;
+
+    /* the master lcore wants the current buffer, move to the cleared one */
+    if (lcore->requested != lcore->active) {
+        /* see the cleared buffer, and finish the old one, before switching */
+        rte_rmb();
+        rte_wmb();
+        lcore->active = lcore->requested;
+    }
+
+    if (lcore_id != rte_get_master_lcore()) return;
+
+    now = rte_rdtsc();
+    if (now < ss_ioc_hit_next_tsc) return;
+    ss_ioc_hit_next_tsc = now + ss_conf->ioc_stats_seconds * rte_get_tsc_hz();
+
+    ss_ioc_hits_aggregate(now);
+}
+
+void ss_ioc_hits_destroy() {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            if (ss_ioc_hit_lcores[i].buffers[j].slots) {
+                je_free(ss_ioc_hit_lcores[i].buffers[j].slots);
+            }
+        }
+        memset(&ss_ioc_hit_lcores[i], 0, sizeof(ss_ioc_hit_lcores[i]));
+    }
+    if (ss_ioc_hit_totals) {
+        je_free(ss_ioc_hit_totals);
+        ss_ioc_hit_totals = NULL;
+    }
+    ss_ioc_hit_totals_mask = 0;
+    ss_ioc_hit_totals_used = 0;
+    memset(&ss_ioc_hit_updates, 0, sizeof(ss_ioc_hit_updates));
+}
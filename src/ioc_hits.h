@@ -0,0 +1,70 @@
+#ifndef __IOC_HITS_H__
+#define __IOC_HITS_H__
+
+#include <stdint.h>
+
+#include <rte_memory.h>
+
+#include "ioc.h"
+
+/* CONSTANTS */
+
+#define SS_IOC_HITS_ENTRIES      4096
+#define SS_IOC_HITS_SLOTS_MIN      64
+#define SS_IOC_HITS_TOP_MAX       100
+#define SS_IOC_HITS_HASH_INIT  0xc2b2ae35
+
+/* DATA TYPES */
+
+/*
+ * Hits of one indicator. Slots are keyed by file and indicator id, not by
+ * pointer, since the IOC tables can be swapped under them.
+ */
+struct ss_ioc_hit_s {
+    uint64_t file_id;
+    uint64_t id;
+    uint64_t count;
+    uint64_t total;
+    uint64_t last_tsc;
+};
+
+typedef struct ss_ioc_hit_s ss_ioc_hit_t;
+
+/*
+ * Hits of one lcore during one interval. A slot is empty while its count
+ * is 0. New indicators past 3/4 of the slots, rounded up, are only counted
+ * in overflow.
+ */
+struct ss_ioc_hit_buffer_s {
+    uint32_t used;
+    uint64_t overflow;
+    uint64_t file_hits[SS_IOC_FILE_MAX];
+    ss_ioc_hit_t* slots;
+};
+
+typedef struct ss_ioc_hit_buffer_s ss_ioc_hit_buffer_t;
+
+/*
+ * The lcore only writes buffers[active]. The master lcore asks for a
+ * switch through requested, and reads the other buffer once the lcore has
+ * switched, so neither side ever takes a lock.
+ */
+struct ss_ioc_hit_lcore_s {
+    volatile uint32_t active;
+    volatile uint32_t requested;
+    uint32_t mask;
+    ss_ioc_hit_buffer_t buffers[2];
+} __rte_cache_aligned;
+
+typedef struct ss_ioc_hit_lcore_s ss_ioc_hit_lcore_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_ioc_hits_init(void);
+void ss_ioc_hits_record(ss_ioc_entry_t* iptr);
+void ss_ioc_hits_timer_callback(unsigned int lcore_id);
+void ss_ioc_hits_destroy(void);
+
+/* END PROTOTYPES */
+
+#endif /* __IOC_HITS_H__ */
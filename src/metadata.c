@@ -5,18 +5,25 @@
 #include <string.h>
 #include <strings.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include <jemalloc/jemalloc.h>
 
 #include <json-c/json.h>
 #include <json-c/json_object_private.h>
 
+#include <rte_cycles.h>
+
 #include "metadata.h"
 #include "common.h"
+#include "http_parse.h"
 #include "ioc.h"
+#include "ip_utils.h"
 #include "je_utils.h"
 #include "json.h"
 #include "nn_queue.h"
+#include "pdns.h"
+#include "suppress.h"
 
 int ss_metadata_prepare_eth(const char* source, const char* rule, nn_queue_t* nn_queue, json_object* jobject, ss_frame_t* fbuf) {
     char tmp[1024];
@@ -247,6 +254,12 @@ uint8_t* ss_metadata_prepare_frame(const char* source, const char* rule, nn_queu
     if (iptr) {
         irv = ss_metadata_prepare_ioc(source, rule, nn_queue, iptr, jobject);
         if (irv) goto error_out;
+        
+        uint8_t family = fbuf->data.eth_type == ETHER_TYPE_IPV6 ? SS_AF_INET6 : SS_AF_INET4;
+        irv = ss_metadata_prepare_dns_names(jobject, "sip_dns_names", family, fbuf->data.sip);
+        if (irv) goto error_out;
+        irv = ss_metadata_prepare_dns_names(jobject, "dip_dns_names", family, fbuf->data.dip);
+        if (irv) goto error_out;
     }
     
     // XXX: NOTE: String pointer is internal to JSON object.
@@ -268,9 +281,46 @@ uint8_t* ss_metadata_prepare_frame(const char* source, const char* rule, nn_queu
     return NULL;
 }
 
+/* adds the parsed header fields, skipping the ones the message left out */
+int ss_metadata_prepare_syslog_header(json_object* jobject, ss_syslog_t* slog) {
+    json_object* item;
+    struct {
+        const char* key;
+        ss_syslog_view_t* view;
+    } fields[] = {
+        { "syslog_timestamp",       &slog->timestamp       },
+        { "syslog_hostname",        &slog->hostname        },
+        { "syslog_app_name",        &slog->app_name        },
+        { "syslog_procid",          &slog->procid          },
+        { "syslog_msgid",           &slog->msgid           },
+        { "syslog_structured_data", &slog->structured_data },
+    };
+    
+    if (slog->format == SS_SYSLOG_FORMAT_EMPTY) return 0;
+    
+    item = json_object_new_string(ss_syslog_format_dump(slog->format));
+    if (item == NULL) return -1;
+    json_object_object_add(jobject, "syslog_format", item);
+    item = json_object_new_int(slog->facility);
+    if (item == NULL) return -1;
+    json_object_object_add(jobject, "syslog_facility", item);
+    item = json_object_new_int(slog->severity);
+    if (item == NULL) return -1;
+    json_object_object_add(jobject, "syslog_severity", item);
+    
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (fields[i].view->length == 0) continue;
+        item = json_object_new_string_len(fields[i].view->data, fields[i].view->length);
+        if (item == NULL) return -1;
+        json_object_object_add(jobject, fields[i].key, item);
+    }
+    
+    return 0;
+}
+
 uint8_t* ss_metadata_prepare_syslog(
     const char* source, const char* rule, nn_queue_t* nn_queue,
-    ss_frame_t* fbuf, uint8_t* l4_offset, uint16_t l4_length, ss_ioc_entry_t* iptr) {
+    ss_frame_t* fbuf, ss_syslog_t* slog, ss_ioc_entry_t* iptr) {
     int          irv;
     uint8_t*     rv       = NULL;
     json_object* item     = NULL;
@@ -306,8 +356,11 @@ uint8_t* ss_metadata_prepare_syslog(
         if (irv) goto error_out;
     }
     
-    // XXX: for now assume the message is C char*
-    item = json_object_new_string((char*) l4_offset);
+    irv = ss_metadata_prepare_syslog_header(jobject, slog);
+    if (irv) goto error_out;
+    
+    // the whole line, so consumers of "message" see the same thing as before
+    item = json_object_new_string_len(slog->all.data, slog->all.length);
     if (item == NULL) goto error_out;
     json_object_object_add(jobject, "message", item);
     
@@ -329,3 +382,286 @@ uint8_t* ss_metadata_prepare_syslog(
     
     return NULL;
 }
+
+/* an HTTP request, with the normalized url it was matched as */
+uint8_t* ss_metadata_prepare_http(
+    const char* source, const char* rule, nn_queue_t* nn_queue,
+    ss_frame_t* fbuf, ss_http_request_t* http, const char* url, ss_ioc_entry_t* iptr) {
+    int          irv;
+    uint8_t*     rv       = NULL;
+    json_object* item     = NULL;
+    json_object* jobject  = NULL;
+    uint8_t*     jstring  = NULL;
+    struct {
+        const char* key;
+        ss_http_view_t* view;
+    } fields[] = {
+        { "http_method",     &http->method     },
+        { "http_uri",        &http->uri        },
+        { "http_version",    &http->version    },
+        { "http_host",       &http->host       },
+        { "http_user_agent", &http->user_agent },
+    };
+    
+    if (nn_queue->format != NN_FORMAT_METADATA) {
+        fprintf(stderr, "format %d not supported yet\n", nn_queue->format);
+        goto error_out;
+    }
+    
+    jobject = json_object_new_object();
+    if (jobject == NULL) {
+        fprintf(stderr, "could not allocate json object\n");
+        goto error_out;
+    }
+    
+    item = json_object_new_string(source);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "source", item);
+    item = json_object_new_string(rule);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "rule", item);
+    item = json_object_new_int64((int64_t)__sync_add_and_fetch(&nn_queue->tx_messages, 1));
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "seq_num", item);
+
+    irv = ss_metadata_prepare_ip(source, rule, nn_queue, jobject, fbuf);
+    if (irv) goto error_out;
+    
+    if (iptr) {
+        irv = ss_metadata_prepare_ioc(source, rule, nn_queue, iptr, jobject);
+        if (irv) goto error_out;
+    }
+    
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (fields[i].view->length == 0) continue;
+        item = json_object_new_string_len(fields[i].view->data, fields[i].view->length);
+        if (item == NULL) goto error_out;
+        json_object_object_add(jobject, fields[i].key, item);
+    }
+    item = json_object_new_string(url);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "url", item);
+    
+    // XXX: NOTE: String pointer is internal to JSON object.
+    jstring = (uint8_t*) json_object_to_json_string_ext(jobject, JSON_C_TO_STRING_SPACED);
+    rv = (uint8_t*) je_strdup((char*)jstring);
+    if (!rv) goto error_out;
+    
+    item = NULL;
+    json_object_put(jobject); jobject = NULL;
+    
+    return rv;
+    
+    error_out:
+    fprintf(stderr, "could not create http metadata\n");
+    if (rv)      { je_free(rv); rv = NULL; }
+    if (jobject) { json_object_put(jobject); jobject  = NULL; }
+    
+    return NULL;
+}
+
+/*
+ * Summary of the hits held back by the suppression cache during one window,
+ * sent to the same queue and under the same source and rule as the first
+ * hit of the stream. The indicator is given by file_id and ioc_id only,
+ * the first record of the stream has its other fields.
+ */
+uint8_t* ss_metadata_prepare_suppress(
+    const char* source, const char* rule, nn_queue_t* nn_queue,
+    ss_suppress_entry_t* sptr, time_t first_seen, time_t last_seen) {
+    char         ip_str[SS_ADDR_STR_MAX];
+    const char*  result;
+    uint8_t*     rv       = NULL;
+    json_object* item     = NULL;
+    json_object* jobject  = NULL;
+    uint8_t*     jstring  = NULL;
+    
+    if (nn_queue->format != NN_FORMAT_METADATA) {
+        fprintf(stderr, "format %d not supported yet\n", nn_queue->format);
+        goto error_out;
+    }
+    
+    jobject = json_object_new_object();
+    if (jobject == NULL) {
+        fprintf(stderr, "could not allocate json object\n");
+        goto error_out;
+    }
+    
+    item = json_object_new_string(source);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "source", item);
+    if (rule) {
+        item = json_object_new_string(rule);
+        if (item == NULL) goto error_out;
+        json_object_object_add(jobject, "rule", item);
+    }
+    item = json_object_new_int64((int64_t)__sync_add_and_fetch(&nn_queue->tx_messages, 1));
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "seq_num", item);
+    item = json_object_new_string("summary");
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "record", item);
+    
+    result = ss_inet_ntop_raw(sptr->key.family, sptr->key.sip, ip_str, sizeof(ip_str));
+    if (result == NULL) goto error_out;
+    item = json_object_new_string(ip_str);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "sip", item);
+    result = ss_inet_ntop_raw(sptr->key.family, sptr->key.dip, ip_str, sizeof(ip_str));
+    if (result == NULL) goto error_out;
+    item = json_object_new_string(ip_str);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "dip", item);
+    
+    item = json_object_new_int64((int64_t) sptr->hits);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "hits", item);
+    item = json_object_new_int64((int64_t) sptr->bytes);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "bytes", item);
+    item = json_object_new_int64((int64_t) first_seen);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "first_seen", item);
+    item = json_object_new_int64((int64_t) last_seen);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "last_seen", item);
+    
+    item = json_object_new_int64((int64_t) sptr->key.file_id);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "file_id", item);
+    item = json_object_new_int64((int64_t) sptr->key.ioc_id);
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "ioc_id", item);
+    
+    // XXX: NOTE: String pointer is internal to JSON object.
+    jstring = (uint8_t*) json_object_to_json_string_ext(jobject, JSON_C_TO_STRING_SPACED);
+    rv = (uint8_t*) je_strdup((char*)jstring);
+    if (!rv) goto error_out;
+    
+    item = NULL;
+    json_object_put(jobject); jobject = NULL;
+    
+    return rv;
+    
+    error_out:
+    fprintf(stderr, "could not create suppression summary metadata\n");
+    if (rv)      { je_free(rv); rv = NULL; }
+    if (jobject) { json_object_put(jobject); jobject  = NULL; }
+    
+    return NULL;
+}
+
+/*
+ * Adds the names recently resolved to the address, if passive DNS saw any,
+ * so an indicator hit on a bare address shows what the client looked up.
+ */
+int ss_metadata_prepare_dns_names(json_object* jobject, const char* field, uint8_t family, const uint8_t* ip) {
+    char names[SS_PDNS_NAMES_MAX][SS_DNS_NAME_MAX];
+    json_object* array = NULL;
+    json_object* item  = NULL;
+    int count;
+    
+    count = ss_pdns_lookup(family, ip, names, SS_PDNS_NAMES_MAX);
+    if (count <= 0) return 0;
+    
+    array = json_object_new_array();
+    if (array == NULL) goto error_out;
+    for (int i = 0; i < count; ++i) {
+        item = json_object_new_string(names[i]);
+        if (item == NULL) goto error_out;
+        json_object_array_add(array, item);
+    }
+    json_object_object_add(jobject, field, array);
+    
+    return 0;
+    
+    error_out:
+    fprintf(stderr, "could not serialize passive dns names\n");
+    if (array) { json_object_put(array); array = NULL; }
+    
+    return -1;
+}
+
+/*
+ * One batch of passive DNS names from one lcore. now and wall are the same
+ * instant on the TSC and on the clock, to turn the TSC stamps into times.
+ */
+uint8_t* ss_metadata_prepare_pdns(nn_queue_t* nn_queue, ss_pdns_entry_t** batch, int count, uint64_t now, time_t wall) {
+    char         ip_str[SS_ADDR_STR_MAX];
+    const char*  result;
+    uint64_t     hz       = rte_get_tsc_hz();
+    uint8_t*     rv       = NULL;
+    json_object* item     = NULL;
+    json_object* record   = NULL;
+    json_object* records  = NULL;
+    json_object* jobject  = NULL;
+    uint8_t*     jstring  = NULL;
+    
+    if (nn_queue->format != NN_FORMAT_METADATA) {
+        fprintf(stderr, "format %d not supported yet\n", nn_queue->format);
+        goto error_out;
+    }
+    
+    jobject = json_object_new_object();
+    if (jobject == NULL) {
+        fprintf(stderr, "could not allocate json object\n");
+        goto error_out;
+    }
+    
+    item = json_object_new_string("passive_dns");
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "source", item);
+    item = json_object_new_int64((int64_t)__sync_add_and_fetch(&nn_queue->tx_messages, 1));
+    if (item == NULL) goto error_out;
+    json_object_object_add(jobject, "seq_num", item);
+    
+    records = json_object_new_array();
+    if (records == NULL) goto error_out;
+    json_object_object_add(jobject, "records", records);
+    
+    for (int i = 0; i < count; ++i) {
+        ss_pdns_entry_t* pptr = batch[i];
+        
+        record = json_object_new_object();
+        if (record == NULL) goto error_out;
+        json_object_array_add(records, record);
+        
+        result = ss_inet_ntop_raw(pptr->family, pptr->ip, ip_str, sizeof(ip_str));
+        if (result == NULL) goto error_out;
+        item = json_object_new_string(ip_str);
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "ip", item);
+        item = json_object_new_string(pptr->name);
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "name", item);
+        item = json_object_new_int64((int64_t) pptr->ttl);
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "ttl", item);
+        item = json_object_new_int64((int64_t) pptr->count);
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "count", item);
+        item = json_object_new_int64((int64_t) (wall - (time_t) ((now - pptr->first_tsc) / hz)));
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "first_seen", item);
+        item = json_object_new_int64((int64_t) (wall - (time_t) ((now - pptr->last_tsc) / hz)));
+        if (item == NULL) goto error_out;
+        json_object_object_add(record, "last_seen", item);
+    }
+    
+    // XXX: NOTE: String pointer is internal to JSON object.
+    jstring = (uint8_t*) json_object_to_json_string_ext(jobject, JSON_C_TO_STRING_SPACED);
+    rv = (uint8_t*) je_strdup((char*)jstring);
+    if (!rv) goto error_out;
+    
+    item = NULL;
+    json_object_put(jobject); jobject = NULL;
+    
+    return rv;
+    
+    error_out:
+    fprintf(stderr, "could not create passive dns metadata\n");
+    if (rv)      { je_free(rv); rv = NULL; }
+    if (jobject) { json_object_put(jobject); jobject  = NULL; }
+    
+    return NULL;
+}
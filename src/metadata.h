@@ -1,12 +1,18 @@
 #ifndef __METADATA_H__
 #define __METADATA_H__
 
+#include <time.h>
+
 #include <json-c/json.h>
 #include <json-c/json_object_private.h>
 
 #include "common.h"
+#include "http_parse.h"
 #include "ioc.h"
 #include "nn_queue.h"
+#include "pdns.h"
+#include "suppress.h"
+#include "syslog_parse.h"
 
 /* BEGIN PROTOTYPES */
 
@@ -14,7 +20,12 @@ int ss_metadata_prepare_eth(const char* source, const char* rule, nn_queue_t* nn
 int ss_metadata_prepare_ip(const char* source, const char* rule, nn_queue_t* nn_queue, json_object* jobject, ss_frame_t* fbuf);
 int ss_metadata_prepare_ioc(const char* source, const char* rule, nn_queue_t* nn_queue, ss_ioc_entry_t* iptr, json_object* json);
 uint8_t* ss_metadata_prepare_frame(const char* source, const char* rule, nn_queue_t* nn_queue, ss_frame_t* fbuf, ss_ioc_entry_t* iptr);
-uint8_t* ss_metadata_prepare_syslog(const char* source, const char* rule, nn_queue_t* nn_queue, ss_frame_t* fbuf, uint8_t* l4_offset, uint16_t l4_length, ss_ioc_entry_t* iptr);
+int ss_metadata_prepare_syslog_header(json_object* jobject, ss_syslog_t* slog);
+uint8_t* ss_metadata_prepare_syslog(const char* source, const char* rule, nn_queue_t* nn_queue, ss_frame_t* fbuf, ss_syslog_t* slog, ss_ioc_entry_t* iptr);
+uint8_t* ss_metadata_prepare_http(const char* source, const char* rule, nn_queue_t* nn_queue, ss_frame_t* fbuf, ss_http_request_t* http, const char* url, ss_ioc_entry_t* iptr);
+uint8_t* ss_metadata_prepare_suppress(const char* source, const char* rule, nn_queue_t* nn_queue, ss_suppress_entry_t* sptr, time_t first_seen, time_t last_seen);
+int ss_metadata_prepare_dns_names(json_object* jobject, const char* field, uint8_t family, const uint8_t* ip);
+uint8_t* ss_metadata_prepare_pdns(nn_queue_t* nn_queue, ss_pdns_entry_t** batch, int count, uint64_t now, time_t wall);
 
 /* END PROTOTYPES */
 
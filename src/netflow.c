@@ -39,6 +39,7 @@
 #include "sdn_sensor.h"
 
 #include "common.h"
+#include "ioc_hits.h"
 #include "metadata.h"
 #include "netflow.h"
 #include "netflow_common.h"
@@ -46,6 +47,7 @@
 #include "netflow_log.h"
 #include "netflow_packet.h"
 #include "netflow_peer.h"
+#include "suppress.h"
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -120,17 +122,7 @@ dump_packet(const char* tag, const u_int8_t* p, u_int len)
     }
 }
 
-/*
- * Netflow frame extractor function
- * Match netflow metadata against ioc_entries
- * Relay matches to appropriate nm_queue
- */
-int process_flow(struct store_flow_complete* flow) {
-    ss_ioc_entry_t* iptr;
-    uint8_t* metadata = NULL;
-    size_t mlength = 0;
-    int rv = 0;
-    
+static int process_flow_prepare(struct store_flow_complete* flow) {
     /* Another sanity check */
     if (flow->src_addr.af != flow->dst_addr.af) {
         logit(LOG_WARNING, "%s: flow src(%d)/dst(%d) AF mismatch",
@@ -149,12 +141,25 @@ int process_flow(struct store_flow_complete* flow) {
         STORE_DISPLAY_ALL, 0);
     logit(LOG_DEBUG, "%s: ACCEPT flow %s", __func__, fmtbuf);
     
-    iptr = ss_ioc_netflow_match(flow);
+    return 0;
+}
+
+static int process_flow_emit(struct store_flow_complete* flow, ss_ioc_entry_t* iptr) {
+    uint8_t* metadata = NULL;
+    size_t mlength = 0;
+    int rv = 0;
+    
     if (iptr) {
         // match
+        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
+        ss_ioc_hits_record(iptr);
+        if (!ss_suppress_hit("netflow_ioc", NULL, nn_queue, iptr, (uint8_t) flow->src_addr.af,
+            flow->src_addr.addr8, flow->dst_addr.addr8, netflow_ntohll(flow->octets.flow_octets))) {
+            RTE_LOG(DEBUG, EXTRACTOR, "suppressed repeated netflow ioc match\n");
+            return 0;
+        }
         RTE_LOG(NOTICE, EXTRACTOR, "successful netflow ioc match from frame\n");
         ss_ioc_entry_dump_dpdk(iptr);
-        nn_queue_t* nn_queue = &ss_conf->ioc_files[iptr->file_id].nn_queue;
         // XXX: fill in something useful in rule field
         metadata = ss_metadata_prepare_netflow("netflow_ioc", NULL, nn_queue, flow, iptr);
         // XXX: for now assume the output is C char*
@@ -166,6 +171,43 @@ int process_flow(struct store_flow_complete* flow) {
     return rv;
 }
 
+/*
+ * Netflow frame extractor function
+ * Match netflow metadata against ioc_entries
+ * Relay matches to appropriate nm_queue
+ */
+int process_flow(struct store_flow_complete* flow) {
+    if (process_flow_prepare(flow)) return -1;
+    return process_flow_emit(flow, ss_ioc_netflow_match(flow));
+}
+
+/*
+ * Same as process_flow, for a whole decoded packet of flows, so the
+ * IOC lookups of several flows are issued as one bulk lookup
+ */
+int process_flows(struct store_flow_complete* flows, u_int count) {
+    ss_ioc_entry_t* iptrs[SS_IOC_NETFLOW_BULK_MAX];
+    int valid[SS_IOC_NETFLOW_BULK_MAX];
+    u_int i, batch;
+    int rv = 0;
+    
+    for (u_int base = 0; base < count; base += batch) {
+        batch = SS_MIN(count - base, SS_IOC_NETFLOW_BULK_MAX);
+        for (i = 0; i < batch; i++)
+            valid[i] = process_flow_prepare(&flows[base + i]) == 0;
+        batch = ss_ioc_netflow_match_bulk(&flows[base], batch, iptrs);
+        for (i = 0; i < batch; i++) {
+            if (!valid[i]) {
+                rv = -1;
+                continue;
+            }
+            if (process_flow_emit(&flows[base + i], iptrs[i])) rv = -1;
+        }
+    }
+    
+    return rv;
+}
+
 void process_netflow_v1(struct flow_packet* fp, struct peer_state* peer)
 {
     struct NF1_HEADER* nf1_hdr = (struct NF1_HEADER*)fp->packet;
@@ -760,8 +802,7 @@ int process_netflow_v9_data(u_int8_t* pkt, size_t len, struct timeval* tv,
     }
     *num_flows = i;
 
-    for (i = 0; i < *num_flows; i++)
-        process_flow(&flows[i]);
+    process_flows(flows, *num_flows);
 
     je_free(flows);
 
@@ -1184,8 +1225,7 @@ int process_netflow_v10_data(u_int8_t* pkt, size_t len, struct timeval* tv,
     }
     *num_flows = i;
 
-    for (i = 0; i < *num_flows; i++)
-        process_flow(&flows[i]);
+    process_flows(flows, *num_flows);
 
     je_free(flows);
 
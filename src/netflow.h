@@ -47,6 +47,7 @@ void flow_packet_dealloc(struct flow_packet* f);
 const char* data_ntoa(const u_int8_t* p, u_int len);
 void dump_packet(const char* tag, const u_int8_t* p, u_int len);
 int process_flow(struct store_flow_complete* flow);
+int process_flows(struct store_flow_complete* flows, u_int count);
 void process_netflow_v1(struct flow_packet* fp, struct peer_state* peer);
 void process_netflow_v5(struct flow_packet* fp, struct peer_state* peer);
 void process_netflow_v7(struct flow_packet* fp, struct peer_state* peer);
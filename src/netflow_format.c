@@ -33,6 +33,7 @@
 
 #include "ioc.h"
 #include "je_utils.h"
+#include "metadata.h"
 #include "netflow_common.h"
 #include "netflow_format.h"
 #include "netflow_crc32.h"
@@ -286,6 +287,12 @@ uint8_t* ss_metadata_prepare_netflow(
     item = NULL;
     rv = 0;
     
+    // names passive dns saw for the addresses of an indicator hit
+    if (ioc_entry) {
+        if (ss_metadata_prepare_dns_names(jobject, "sip_dns_names", (uint8_t) flow->src_addr.af, flow->src_addr.addr8)) goto error_out;
+        if (ss_metadata_prepare_dns_names(jobject, "dip_dns_names", (uint8_t) flow->dst_addr.af, flow->dst_addr.addr8)) goto error_out;
+    }
+    
     // XXX: NOTE: String pointer is internal to JSON object.
     jstring = (uint8_t*) json_object_to_json_string_ext(jobject, JSON_C_TO_STRING_SPACED);
     rv = (uint8_t*) je_strdup((char*)jstring);
@@ -0,0 +1,298 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <bsd/string.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+
+#include "pdns.h"
+
+#include "common.h"
+#include "metadata.h"
+#include "sdn_sensor.h"
+
+/*
+ * Remembers which names recently resolved to each address, from the A and
+ * AAAA answers the sensor decodes, so an IP indicator hit can say which
+ * name the client looked up, and so the pairs can go out as passive DNS.
+ *
+ * DNS and the flow it leads to usually land on different lcores, so a
+ * lookup reads the tables of every lcore, without locks, under the seq of
+ * each entry.
+ */
+
+static ss_pdns_table_t ss_pdns_tables[RTE_MAX_LCORE];
+static unsigned int    ss_pdns_lcores[RTE_MAX_LCORE];
+static unsigned int    ss_pdns_lcore_count;
+
+static inline uint32_t ss_pdns_hash(uint8_t family, const uint8_t* ip) {
+    return rte_hash_crc(ip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN, SS_PDNS_HASH_INIT + family);
+}
+
+static inline int ss_pdns_ip_equal(ss_pdns_entry_t* pptr, uint8_t family, const uint8_t* ip) {
+    return pptr->family == family &&
+        !memcmp(pptr->ip, ip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN);
+}
+
+int ss_pdns_init() {
+    unsigned int lcore_id;
+    uint32_t buckets;
+
+    if (ss_conf->pdns_entries == 0) return 0;
+
+    /* power of 2 buckets, so the bucket is just the low hash bits */
+    buckets = 1;
+    while (buckets * SS_PDNS_WAYS < ss_conf->pdns_entries) buckets <<= 1;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_pdns_table_t* table = &ss_pdns_tables[lcore_id];
+        table->entries = je_calloc(buckets * SS_PDNS_WAYS, sizeof(ss_pdns_entry_t));
+        table->hands   = je_calloc(buckets, sizeof(uint8_t));
+        if (table->entries == NULL || table->hands == NULL) {
+            RTE_LOG(ERR, EXTRACTOR, "could not allocate passive dns table for lcore %u\n", lcore_id);
+            goto error_out;
+        }
+        table->mask            = buckets - 1;
+        table->next_export_tsc = rte_rdtsc() + ss_conf->pdns_export_seconds * rte_get_tsc_hz();
+        ss_pdns_lcores[ss_pdns_lcore_count++] = lcore_id;
+    }
+
+    RTE_LOG(NOTICE, EXTRACTOR, "passive dns keeps %u names per lcore in %lu KB\n",
+        buckets * SS_PDNS_WAYS, (uint64_t) buckets * SS_PDNS_WAYS * sizeof(ss_pdns_entry_t) / 1024);
+    return 0;
+
+    error_out:
+    ss_pdns_destroy();
+    return -1;
+}
+
+/*
+ * Picks the way for a new name: an empty or expired one if the bucket has
+ * any, else the first one the CLOCK hand finds without a recent hit.
+ */
+static ss_pdns_entry_t* ss_pdns_victim(ss_pdns_table_t* table, uint32_t bucket, uint64_t now) {
+    ss_pdns_entry_t* ways = &table->entries[bucket * SS_PDNS_WAYS];
+    uint8_t* hand = &table->hands[bucket];
+
+    for (int i = 0; i < SS_PDNS_WAYS; ++i) {
+        if (ways[i].expire_tsc <= now) return &ways[i];
+    }
+
+    /* one lap clears every bit, so the second lap always stops */
+    for (;;) {
+        ss_pdns_entry_t* pptr = &ways[*hand];
+        *hand = (uint8_t) ((*hand + 1) % SS_PDNS_WAYS);
+        if (!pptr->referenced) {
+            ++table->evictions;
+            return pptr;
+        }
+        pptr->referenced = 0;
+    }
+}
+
+static void ss_pdns_add(ss_pdns_table_t* table, uint8_t family, const uint8_t* ip, const char* name, uint32_t ttl, uint64_t now) {
+    uint32_t bucket = ss_pdns_hash(family, ip) & table->mask;
+    ss_pdns_entry_t* ways = &table->entries[bucket * SS_PDNS_WAYS];
+    ss_pdns_entry_t* pptr = NULL;
+    uint64_t expire_tsc;
+
+    ttl = SS_MAX(ttl, ss_conf->pdns_ttl_min);
+    ttl = SS_MIN(ttl, ss_conf->pdns_ttl_max);
+    expire_tsc = now + ttl * rte_get_tsc_hz();
+
+    for (int i = 0; i < SS_PDNS_WAYS; ++i) {
+        if (ways[i].expire_tsc > now && ss_pdns_ip_equal(&ways[i], family, ip) &&
+            !strcmp(ways[i].name, name)) {
+            pptr = &ways[i];
+            break;
+        }
+    }
+
+    if (pptr) {
+        /* the name stays the same, a reader only ever sees a newer expiry */
+        pptr->ttl        = ttl;
+        pptr->expire_tsc = expire_tsc;
+        pptr->last_tsc   = now;
+        pptr->referenced = 1;
+        pptr->dirty      = 1;
+        ++pptr->count;
+        ++table->updates;
+        return;
+    }
+
+    pptr = ss_pdns_victim(table, bucket, now);
+    ++pptr->seq;
+    rte_wmb();
+    pptr->family     = family;
+    memset(pptr->ip, 0, sizeof(pptr->ip));
+    memcpy(pptr->ip, ip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN);
+    strlcpy(pptr->name, name, sizeof(pptr->name));
+    pptr->ttl        = ttl;
+    pptr->count      = 1;
+    pptr->first_tsc  = now;
+    pptr->last_tsc   = now;
+    pptr->expire_tsc = expire_tsc;
+    pptr->referenced = 0;
+    pptr->dirty      = 1;
+    rte_wmb();
+    ++pptr->seq;
+    ++table->inserts;
+}
+
+/*
+ * Records each A and AAAA answer of a response against its question name,
+ * which is the name the client asked for, even behind a CNAME chain.
+ */
+void ss_pdns_answers_add(ss_metadata_t* md, uint16_t answer_count) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_pdns_table_t* table;
+    uint64_t now;
+
+    if (lcore_id >= RTE_MAX_LCORE) return;
+    table = &ss_pdns_tables[lcore_id];
+    if (table->entries == NULL || md->dns_name[0] == '\0') return;
+
+    now = rte_rdtsc();
+    for (uint16_t i = 0; i < answer_count; ++i) {
+        ss_answer_t* answer = &md->dns_answers[i];
+        ip_addr_t* ip = (ip_addr_t*) answer->payload;
+        if (answer->type != SS_TYPE_IP) continue;
+        if (ip->family == SS_AF_INET4) {
+            ss_pdns_add(table, SS_AF_INET4, (uint8_t*) &ip->ip4_addr.addr, (char*) md->dns_name, answer->ttl, now);
+        }
+        else if (ip->family == SS_AF_INET6) {
+            ss_pdns_add(table, SS_AF_INET6, ip->ip6_addr.addr, (char*) md->dns_name, answer->ttl, now);
+        }
+    }
+}
+
+/*
+ * Copies up to names_max unexpired names seen for the address into names,
+ * from any lcore, and returns how many. An entry being rewritten while it
+ * is read is skipped.
+ */
+int ss_pdns_lookup(uint8_t family, const uint8_t* ip, char names[][SS_DNS_NAME_MAX], int names_max) {
+    uint32_t hash;
+    uint64_t now;
+    int count = 0;
+
+    if (ss_pdns_lcore_count == 0) return 0;
+    if (family != SS_AF_INET4 && family != SS_AF_INET6) return 0;
+
+    hash = ss_pdns_hash(family, ip);
+    now  = rte_rdtsc();
+
+    for (unsigned int l = 0; l < ss_pdns_lcore_count && count < names_max; ++l) {
+        ss_pdns_table_t* table = &ss_pdns_tables[ss_pdns_lcores[l]];
+        ss_pdns_entry_t* ways  = &table->entries[(hash & table->mask) * SS_PDNS_WAYS];
+
+        for (int i = 0; i < SS_PDNS_WAYS && count < names_max; ++i) {
+            ss_pdns_entry_t* pptr = &ways[i];
+            uint32_t seq = pptr->seq;
+            int is_duplicate = 0;
+
+            if (seq & 1) continue;
+            rte_rmb();
+            if (pptr->expire_tsc <= now || !ss_pdns_ip_equal(pptr, family, ip)) continue;
+            memcpy(names[count], pptr->name, SS_DNS_NAME_MAX);
+            names[count][SS_DNS_NAME_MAX - 1] = '\0';
+            rte_rmb();
+            if (pptr->seq != seq) continue;
+
+            /* the same answer is often seen on several lcores */
+            for (int j = 0; j < count; ++j) {
+                if (!strcmp(names[j], names[count])) { is_duplicate = 1; break; }
+            }
+            if (is_duplicate) continue;
+
+            /* racy on purpose, losing a bit to the owner's CLOCK hand is harmless */
+            if (!pptr->referenced) pptr->referenced = 1;
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+static void ss_pdns_batch_send(ss_pdns_table_t* table, ss_pdns_entry_t** batch, int count, uint64_t now) {
+    uint8_t* metadata;
+
+    metadata = ss_metadata_prepare_pdns(&ss_conf->pdns_nn_queue, batch, count, now, time(NULL));
+    if (metadata == NULL) {
+        RTE_LOG(ERR, EXTRACTOR, "could not prepare passive dns batch of %d names\n", count);
+        return;
+    }
+    // XXX: for now assume the output is C char*
+    ss_nn_queue_send(&ss_conf->pdns_nn_queue, metadata, (uint16_t) strlen((char*) metadata));
+    je_free(metadata);
+    table->exported += (uint64_t) count;
+
+    for (int i = 0; i < count; ++i) {
+        batch[i]->dirty = 0;
+        batch[i]->count = 0;
+    }
+}
+
+/*
+ * Sends every name changed since the last export, in batches of up to
+ * SS_PDNS_BATCH_MAX, on the lcore which owns them. Each call walks at most
+ * SS_PDNS_EXPORT_BUDGET entries from the hand, so one export is spread
+ * over many timer calls instead of stalling the lcore on the whole table.
+ * A batch which could not be prepared is tried again next time.
+ */
+void ss_pdns_timer_callback(unsigned int lcore_id) {
+    ss_pdns_table_t* table = &ss_pdns_tables[lcore_id];
+    ss_pdns_entry_t* batch[SS_PDNS_BATCH_MAX];
+    int batch_count = 0;
+    uint32_t count;
+    uint32_t end;
+    uint64_t now;
+
+    if (table->entries == NULL || !ss_conf->pdns_export) return;
+
+    now = rte_rdtsc();
+    if (!table->exporting) {
+        if (now < table->next_export_tsc) return;
+        table->next_export_tsc = now + ss_conf->pdns_export_seconds * rte_get_tsc_hz();
+        table->export_hand     = 0;
+        table->exporting       = 1;
+    }
+
+    count = (table->mask + 1) * SS_PDNS_WAYS;
+    end   = SS_MIN(table->export_hand + SS_PDNS_EXPORT_BUDGET, count);
+    for (; table->export_hand < end; ++table->export_hand) {
+        ss_pdns_entry_t* pptr = &table->entries[table->export_hand];
+        if (!pptr->dirty || pptr->expire_tsc == 0) continue;
+        batch[batch_count++] = pptr;
+        if (batch_count == SS_PDNS_BATCH_MAX) {
+            ss_pdns_batch_send(table, batch, batch_count, now);
+            batch_count = 0;
+        }
+    }
+    /* send the rest now, the entries may be rewritten before the next call */
+    if (batch_count) ss_pdns_batch_send(table, batch, batch_count, now);
+
+    if (table->export_hand < count) return;
+    table->exporting = 0;
+
+    RTE_LOG(INFO, EXTRACTOR, "passive dns lcore %u: %lu inserts, %lu updates, %lu evictions, %lu exported\n",
+        lcore_id, table->inserts, table->updates, table->evictions, table->exported);
+}
+
+void ss_pdns_destroy() {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        if (ss_pdns_tables[i].entries) je_free(ss_pdns_tables[i].entries);
+        if (ss_pdns_tables[i].hands)   je_free(ss_pdns_tables[i].hands);
+        memset(&ss_pdns_tables[i], 0, sizeof(ss_pdns_tables[i]));
+    }
+    ss_pdns_lcore_count = 0;
+}
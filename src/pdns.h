@@ -0,0 +1,76 @@
+#ifndef __PDNS_H__
+#define __PDNS_H__
+
+#include <stdint.h>
+
+#include <rte_memory.h>
+
+#include "common.h"
+#include "ip_utils.h"
+
+/* CONSTANTS */
+
+#define SS_PDNS_WAYS                 8
+#define SS_PDNS_ENTRIES          65536
+#define SS_PDNS_TTL_MIN             60
+#define SS_PDNS_TTL_MAX          86400
+#define SS_PDNS_EXPORT_SECONDS      60
+#define SS_PDNS_BATCH_MAX           64
+#define SS_PDNS_EXPORT_BUDGET     1024 /* most entries checked per timer call */
+#define SS_PDNS_NAMES_MAX            4
+#define SS_PDNS_HASH_INIT   0x27d4eb2f
+
+/* DATA TYPES */
+
+/*
+ * One address and a name which resolved to it. Entries are only written by
+ * the lcore owning the table; other lcores read them under seq, which is
+ * odd while the owner is rewriting the entry.
+ */
+struct ss_pdns_entry_s {
+    volatile uint32_t seq;
+    volatile uint8_t  referenced; /* CLOCK bit, set on every hit */
+    uint8_t           dirty;      /* changed since the last export */
+    uint8_t           family;
+    uint8_t           ip[IPV6_ALEN];
+    uint32_t          ttl;
+    uint64_t          count;      /* answers since the last export */
+    uint64_t          first_tsc;
+    uint64_t          last_tsc;
+    volatile uint64_t expire_tsc; /* 0 marks an empty way */
+    char              name[SS_DNS_NAME_MAX];
+};
+
+typedef struct ss_pdns_entry_s ss_pdns_entry_t;
+
+/*
+ * Per lcore set associative table. The bucket comes from the address
+ * alone, so every name seen for one address sits in the same bucket, and
+ * hands holds the CLOCK hand of each bucket.
+ */
+struct ss_pdns_table_s {
+    uint32_t mask;
+    uint64_t next_export_tsc;
+    uint32_t export_hand;     /* next entry checked by the running export */
+    uint8_t  exporting;       /* an export sweep is part way through */
+    uint64_t inserts;
+    uint64_t updates;
+    uint64_t evictions;
+    uint64_t exported;
+    uint8_t* hands;
+    ss_pdns_entry_t* entries;
+} __rte_cache_aligned;
+
+typedef struct ss_pdns_table_s ss_pdns_table_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_pdns_init(void);
+void ss_pdns_answers_add(ss_metadata_t* md, uint16_t answer_count);
+int ss_pdns_lookup(uint8_t family, const uint8_t* ip, char names[][SS_DNS_NAME_MAX], int names_max);
+void ss_pdns_timer_callback(unsigned int lcore_id);
+void ss_pdns_destroy(void);
+
+/* END PROTOTYPES */
+
+#endif /* __PDNS_H__ */
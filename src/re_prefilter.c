@@ -0,0 +1,375 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include "re_prefilter.h"
+
+/*
+ * Picks out, for each re_chain rule, a literal which any match must
+ * contain, and puts them all in one Aho-Corasick automaton. One pass over
+ * a message then says which rules can possibly match, and only those
+ * run their regex.
+ */
+
+static uint8_t ss_re_fold[256];
+
+/* returns the character after the [...] class at p, NULL if unterminated */
+static const char* ss_re_class_skip(const char* p) {
+    ++p;
+    if (*p == '^') ++p;
+    // a leading ']' is part of the class
+    if (*p == ']') ++p;
+    while (*p && *p != ']') {
+        if (*p == '\\' && p[1]) {
+            p += 2;
+        }
+        else if (*p == '[' && p[1] == ':') {
+            const char* end = strstr(p + 2, ":]");
+            if (end == NULL) return NULL;
+            p = end + 2;
+        }
+        else {
+            ++p;
+        }
+    }
+    return *p ? p + 1 : NULL;
+}
+
+/* returns the character after the (...) group at p, NULL if unbalanced */
+static const char* ss_re_group_skip(const char* p) {
+    int depth = 0;
+
+    while (*p) {
+        if (*p == '\\' && p[1]) {
+            p += 2;
+            continue;
+        }
+        if (*p == '[') {
+            p = ss_re_class_skip(p);
+            if (p == NULL) return NULL;
+            continue;
+        }
+        if      (*p == '(') ++depth;
+        else if (*p == ')' && --depth == 0) return p + 1;
+        ++p;
+    }
+    return NULL;
+}
+
+/* checks for an option group like (?x) or (?ix:...) turning on extended syntax */
+static int ss_re_group_is_extended(const char* p) {
+    if (p[1] != '?') return 0;
+    for (p += 2; isalpha((unsigned char) *p) || *p == '-'; ++p) {
+        if (*p == '-') return 0;
+        if (*p == 'x') return 1;
+    }
+    return 0;
+}
+
+/*
+ * Returns the character after the quantifier at p, or p if there is none.
+ * is_optional is set if the quantifier allows 0 repeats.
+ */
+static const char* ss_re_quantifier_skip(const char* p, int* is_optional) {
+    const char* start = p;
+
+    *is_optional = 0;
+    if (*p == '*' || *p == '?') {
+        *is_optional = 1;
+        ++p;
+    }
+    else if (*p == '+') {
+        ++p;
+    }
+    else if (*p == '{' && isdigit((unsigned char) p[1])) {
+        const char* end = p + 1;
+        while (isdigit((unsigned char) *end)) ++end;
+        if (*end == ',') {
+            ++end;
+            while (isdigit((unsigned char) *end)) ++end;
+        }
+        // anything else is a literal '{'
+        if (*end != '}') return start;
+        *is_optional = atoi(p + 1) == 0;
+        p = end + 1;
+    }
+    else {
+        return start;
+    }
+    // lazy or possessive
+    if (*p == '?' || *p == '+') ++p;
+    return p;
+}
+
+/*
+ * Copies the longest literal every match of re has to contain into
+ * literal, folded to lower case, and returns its length, or 0 if there is
+ * none. This is a conservative reading of PCRE / RE2 syntax: groups,
+ * classes and escapes only end the current literal, and anything unusual
+ * stops the search.
+ */
+size_t ss_re_literal_extract(const char* re, char* literal, size_t literal_size) {
+    char run[SS_RE_LITERAL_MAX];
+    size_t run_length = 0;
+    size_t best_length = 0;
+    size_t run_max = literal_size - 1 < sizeof(run) ? literal_size - 1 : sizeof(run);
+    int is_full = 0;
+    int is_optional;
+    const char* p;
+    const char* q;
+
+#define SS_RE_RUN_END() do { \
+        if (run_length > best_length) { \
+            memcpy(literal, run, run_length); \
+            best_length = run_length; \
+        } \
+        run_length = 0; \
+        is_full = 0; \
+    } while (0)
+
+    literal[0] = '\0';
+
+    // an alternative at the top means no single literal is required
+    for (p = re; *p; ) {
+        if (*p == '\\' && p[1]) {
+            p += 2;
+        }
+        else if (*p == '[') {
+            p = ss_re_class_skip(p);
+            if (p == NULL) return 0;
+        }
+        else if (*p == '(') {
+            // spaces and comments would look like literals
+            if (ss_re_group_is_extended(p)) return 0;
+            p = ss_re_group_skip(p);
+            if (p == NULL) return 0;
+        }
+        else if (*p == '|') {
+            return 0;
+        }
+        else {
+            ++p;
+        }
+    }
+
+    for (p = re; *p; ) {
+        int c = -1;
+
+        if (*p == '\\') {
+            if (p[1] == '\0') break;
+            if (isalnum((unsigned char) p[1])) {
+                // \d, \w, \s, \b and friends; the rest take arguments
+                if (strchr("dDwWsShHvVbBAzZG", p[1]) == NULL) break;
+                p += 2;
+            }
+            else {
+                c = (unsigned char) p[1];
+                p += 2;
+            }
+        }
+        else if (*p == '[') {
+            p = ss_re_class_skip(p);
+            if (p == NULL) break;
+        }
+        else if (*p == '(') {
+            p = ss_re_group_skip(p);
+            if (p == NULL) break;
+        }
+        else if (strchr(".^$*+?{", *p)) {
+            ++p;
+        }
+        else {
+            c = (unsigned char) *p;
+            ++p;
+        }
+
+        q = ss_re_quantifier_skip(p, &is_optional);
+        if (c < 0) {
+            SS_RE_RUN_END();
+            p = q;
+            continue;
+        }
+        if (q != p && is_optional) {
+            // drop the rest of a UTF-8 character whose last byte is optional
+            if ((c & 0xc0) == 0x80) {
+                while (run_length && ((uint8_t) run[run_length - 1] & 0xc0) == 0x80) --run_length;
+                if (run_length) --run_length;
+            }
+            SS_RE_RUN_END();
+            p = q;
+            continue;
+        }
+        if (run_length == run_max) is_full = 1;
+        if (!is_full) run[run_length++] = (char) (c >= 'A' && c <= 'Z' ? c | 0x20 : c);
+        // c+ or c{n,m} keeps c, but what follows is not next to the first c
+        if (q != p) {
+            SS_RE_RUN_END();
+            p = q;
+        }
+    }
+    SS_RE_RUN_END();
+
+#undef SS_RE_RUN_END
+
+    literal[best_length] = '\0';
+    return best_length;
+}
+
+ss_re_prefilter_t* ss_re_prefilter_create() {
+    ss_re_prefilter_t* prefilter = NULL;
+
+    for (int i = 0; i < 256; ++i) {
+        ss_re_fold[i] = (uint8_t) (i >= 'A' && i <= 'Z' ? i | 0x20 : i);
+    }
+
+    prefilter = je_calloc(1, sizeof(ss_re_prefilter_t));
+    if (prefilter == NULL) {
+        fprintf(stderr, "could not allocate re prefilter\n");
+        goto error_out;
+    }
+
+    prefilter->state_max = SS_RE_PREFILTER_STATES_MIN;
+    prefilter->states    = je_calloc(prefilter->state_max, sizeof(ss_re_prefilter_state_t));
+    if (prefilter->states == NULL) {
+        fprintf(stderr, "could not allocate re prefilter states\n");
+        goto error_out;
+    }
+    // state 0 is the root
+    prefilter->state_count         = 1;
+    prefilter->states[0].out_head  = -1;
+
+    return prefilter;
+
+    error_out:
+    ss_re_prefilter_destroy(prefilter);
+    return NULL;
+}
+
+int ss_re_prefilter_destroy(ss_re_prefilter_t* prefilter) {
+    if (prefilter == NULL) return 0;
+
+    if (prefilter->states) je_free(prefilter->states);
+    je_free(prefilter);
+
+    return 0;
+}
+
+static int32_t ss_re_prefilter_state_create(ss_re_prefilter_t* prefilter) {
+    if (prefilter->state_count == prefilter->state_max) {
+        uint32_t state_max = prefilter->state_max * 2;
+        ss_re_prefilter_state_t* states = je_realloc(prefilter->states, state_max * sizeof(ss_re_prefilter_state_t));
+        if (states == NULL) return -1;
+        prefilter->states    = states;
+        prefilter->state_max = state_max;
+    }
+
+    int32_t index = (int32_t) prefilter->state_count++;
+    memset(&prefilter->states[index], 0, sizeof(ss_re_prefilter_state_t));
+    prefilter->states[index].out_head = -1;
+    return index;
+}
+
+/*
+ * Adds the literal of rule, already folded. A literal shorter than
+ * SS_RE_LITERAL_MIN would pass nearly every message, so such rules are
+ * just always run.
+ */
+int ss_re_prefilter_add(ss_re_prefilter_t* prefilter, uint32_t rule, const char* literal, size_t length) {
+    int32_t state = 0;
+
+    if (rule >= SS_RE_CHAIN_MAX) return -1;
+    if (rule >= prefilter->rule_count) prefilter->rule_count = rule + 1;
+
+    if (length < SS_RE_LITERAL_MIN) {
+        prefilter->always[rule / 64] |= 1ULL << (rule % 64);
+        return 0;
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = ss_re_fold[(uint8_t) literal[i]];
+        // before compiling, 0 means no edge, nothing points back at the root
+        int32_t next = prefilter->states[state].next[c];
+        if (next == 0) {
+            next = ss_re_prefilter_state_create(prefilter);
+            if (next < 0) return -1;
+            prefilter->states[state].next[c] = next;
+        }
+        state = next;
+    }
+
+    uint32_t out = prefilter->out_count++;
+    prefilter->out_rule[out] = (int32_t) rule;
+    prefilter->out_next[out] = prefilter->states[state].out_head;
+    prefilter->states[state].out_head = (int32_t) out;
+
+    return 0;
+}
+
+/* fills in the failure links breadth first, then every missing transition */
+int ss_re_prefilter_compile(ss_re_prefilter_t* prefilter) {
+    ss_re_prefilter_state_t* states = prefilter->states;
+    int32_t* queue;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    queue = je_calloc(prefilter->state_count, sizeof(int32_t));
+    if (queue == NULL) {
+        fprintf(stderr, "could not allocate re prefilter queue\n");
+        return -1;
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        int32_t child = states[0].next[c];
+        if (child == 0) continue;
+        states[child].fail     = 0;
+        states[child].out_link = 0;
+        queue[tail++] = child;
+    }
+
+    while (head < tail) {
+        int32_t state = queue[head++];
+        int32_t fail  = states[state].fail;
+
+        for (int c = 0; c < 256; ++c) {
+            int32_t child = states[state].next[c];
+            if (child == 0) {
+                states[state].next[c] = states[fail].next[c];
+                continue;
+            }
+            int32_t child_fail = states[fail].next[c];
+            states[child].fail     = child_fail;
+            states[child].out_link = states[child_fail].out_head >= 0 ? child_fail : states[child_fail].out_link;
+            queue[tail++] = child;
+        }
+    }
+
+    je_free(queue);
+    return 0;
+}
+
+/*
+ * Sets the bit of every rule whose literal occurs in data, and of every
+ * rule without one, in candidates, SS_RE_CHAIN_WORDS words long.
+ */
+void ss_re_prefilter_scan(ss_re_prefilter_t* prefilter, const uint8_t* data, size_t length, uint64_t* candidates) {
+    ss_re_prefilter_state_t* states = prefilter->states;
+    int32_t state = 0;
+
+    memcpy(candidates, prefilter->always, sizeof(prefilter->always));
+    if (prefilter->out_count == 0) return;
+
+    for (size_t i = 0; i < length; ++i) {
+        state = states[state].next[ss_re_fold[data[i]]];
+        int32_t match = states[state].out_head >= 0 ? state : states[state].out_link;
+        for (; match; match = states[match].out_link) {
+            for (int32_t out = states[match].out_head; out >= 0; out = prefilter->out_next[out]) {
+                int32_t rule = prefilter->out_rule[out];
+                candidates[rule / 64] |= 1ULL << (rule % 64);
+            }
+        }
+    }
+}
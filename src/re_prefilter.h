@@ -0,0 +1,62 @@
+#ifndef __RE_PREFILTER_H__
+#define __RE_PREFILTER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CONSTANTS */
+
+#define SS_RE_CHAIN_MAX          1024
+#define SS_RE_CHAIN_WORDS        (SS_RE_CHAIN_MAX / 64)
+#define SS_RE_LITERAL_MIN           3
+#define SS_RE_LITERAL_MAX          32
+#define SS_RE_PREFILTER_STATES_MIN 64
+
+/* DATA TYPES */
+
+/*
+ * One Aho-Corasick state. After compiling, next holds the complete
+ * transition for every byte, failure links included, so a scan is one
+ * table load per byte. out_link is the nearest state down the failure
+ * chain with outputs of its own, 0 for none.
+ */
+struct ss_re_prefilter_state_s {
+    int32_t next[256];
+    int32_t fail;
+    int32_t out_head;
+    int32_t out_link;
+};
+
+typedef struct ss_re_prefilter_state_s ss_re_prefilter_state_t;
+
+/*
+ * The literal each re_chain rule cannot match without, folded to lower
+ * case, in one automaton. Rules with no such literal are in always.
+ */
+struct ss_re_prefilter_s {
+    uint32_t state_count;
+    uint32_t state_max;
+    ss_re_prefilter_state_t* states;
+
+    uint32_t out_count;
+    int32_t  out_rule[SS_RE_CHAIN_MAX];
+    int32_t  out_next[SS_RE_CHAIN_MAX];
+
+    uint32_t rule_count;
+    uint64_t always[SS_RE_CHAIN_WORDS];
+};
+
+typedef struct ss_re_prefilter_s ss_re_prefilter_t;
+
+/* BEGIN PROTOTYPES */
+
+size_t ss_re_literal_extract(const char* re, char* literal, size_t literal_size);
+ss_re_prefilter_t* ss_re_prefilter_create(void);
+int ss_re_prefilter_destroy(ss_re_prefilter_t* prefilter);
+int ss_re_prefilter_add(ss_re_prefilter_t* prefilter, uint32_t rule, const char* literal, size_t length);
+int ss_re_prefilter_compile(ss_re_prefilter_t* prefilter);
+void ss_re_prefilter_scan(ss_re_prefilter_t* prefilter, const uint8_t* data, size_t length, uint64_t* candidates);
+
+/* END PROTOTYPES */
+
+#endif /* __RE_PREFILTER_H__ */
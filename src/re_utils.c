@@ -6,6 +6,9 @@
 
 #include <jemalloc/jemalloc.h>
 
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
 #include "re_utils.h"
 
 #include "json.h"
@@ -20,6 +23,62 @@ int ss_re_init() {
     return 0;
 }
 
+static ss_re_lcore_t ss_re_lcores[RTE_MAX_LCORE];
+
+/*
+ * Every pcre_extra gets this callback when it is compiled, so each lcore
+ * runs JIT code on its own stack. NULL, off an lcore, makes PCRE use its
+ * 32K default on the machine stack.
+ */
+static pcre_jit_stack* ss_re_jit_stack_get(void* data) {
+    unsigned int lcore_id = rte_lcore_id();
+    
+    if (lcore_id >= RTE_MAX_LCORE) return NULL;
+    return ss_re_lcores[lcore_id].jit_stack;
+}
+
+/*
+ * Runs after the EAL is up, so the match vectors go on the socket of their
+ * lcore. The JIT stacks are mapped by PCRE, and their pages are first
+ * touched by the lcore using them, which puts them on the same node.
+ */
+int ss_re_lcore_init() {
+    unsigned int lcore_id;
+    
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_re_lcore_t* re_lcore = &ss_re_lcores[lcore_id];
+        int socket_id = (int) rte_lcore_to_socket_id(lcore_id);
+        
+        re_lcore->match_vector = rte_zmalloc_socket("re_match_vector",
+            SS_RE_MATCH_MAX * sizeof(int), RTE_CACHE_LINE_SIZE, socket_id);
+        if (re_lcore->match_vector == NULL) {
+            RTE_LOG(ERR, EXTRACTOR, "could not allocate re match vector for lcore %u\n", lcore_id);
+            goto error_out;
+        }
+        
+        re_lcore->jit_stack = pcre_jit_stack_alloc(SS_RE_JIT_STACK_MIN, SS_RE_JIT_STACK_MAX);
+        if (re_lcore->jit_stack == NULL) {
+            RTE_LOG(ERR, EXTRACTOR, "could not allocate pcre jit stack for lcore %u\n", lcore_id);
+            goto error_out;
+        }
+    }
+    
+    RTE_LOG(NOTICE, EXTRACTOR, "pcre jit stacks of up to %d KB per lcore\n", SS_RE_JIT_STACK_MAX / 1024);
+    return 0;
+    
+    error_out:
+    ss_re_lcore_destroy();
+    return -1;
+}
+
+void ss_re_lcore_destroy() {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        if (ss_re_lcores[i].jit_stack)    pcre_jit_stack_free(ss_re_lcores[i].jit_stack);
+        if (ss_re_lcores[i].match_vector) rte_free(ss_re_lcores[i].match_vector);
+        memset(&ss_re_lcores[i], 0, sizeof(ss_re_lcores[i]));
+    }
+}
+
 /* UTILITIES */
 
 const char* ss_pcre_strerror(int pcre_errno) {
@@ -65,6 +124,7 @@ const char* ss_pcre_strerror(int pcre_errno) {
 ss_re_backend_t ss_re_backend_load(const char* backend_type) {
     if (!strcasecmp(backend_type, "pcre")) return SS_RE_BACKEND_PCRE;
     if (!strcasecmp(backend_type, "re2"))  return SS_RE_BACKEND_RE2;
+    if (!strcasecmp(backend_type, "scan")) return SS_RE_BACKEND_SCAN;
     return (ss_re_backend_t) -1;
 }
 
@@ -74,6 +134,12 @@ ss_re_type_t ss_re_type_load(const char* re_type) {
     return (ss_re_type_t) -1;
 }
 
+ss_re_match_mode_t ss_re_match_mode_load(const char* match_mode) {
+    if (!strcasecmp(match_mode, "first")) return SS_RE_MATCH_FIRST;
+    if (!strcasecmp(match_mode, "all"))   return SS_RE_MATCH_ALL;
+    return (ss_re_match_mode_t) -1;
+}
+
 /* RE CHAIN */
 
 int ss_re_chain_destroy() {
@@ -83,14 +149,75 @@ int ss_re_chain_destroy() {
         ss_re_entry_destroy(rptr);
         TAILQ_REMOVE(&ss_conf->re_chain.re_list, rptr, entry);
     }
+    ss_re_prefilter_destroy(ss_conf->re_chain.prefilter);
+    ss_conf->re_chain.prefilter = NULL;
+    ss_conf->re_chain.count     = 0;
     return 0;
 }
 
 int ss_re_chain_add(ss_re_entry_t* re_entry) {
+    ss_re_entry_t* rptr;
+    uint32_t count = 0;
+    
+    TAILQ_FOREACH(rptr, &ss_conf->re_chain.re_list, entry) {
+        ++count;
+    }
+    if (count >= SS_RE_CHAIN_MAX) {
+        fprintf(stderr, "re_chain is limited to %d rules\n", SS_RE_CHAIN_MAX);
+        return -1;
+    }
     TAILQ_INSERT_TAIL(&ss_conf->re_chain.re_list, re_entry, entry);
     return 0;
 }
 
+/*
+ * Numbers the rules in chain order and builds the prefilter over their
+ * literals. Inverted rules match when their regex does not, so like the
+ * rules without a usable literal they are always run.
+ */
+int ss_re_chain_compile() {
+    ss_re_chain_t* chain = &ss_conf->re_chain;
+    ss_re_prefilter_t* prefilter = NULL;
+    ss_re_entry_t* rptr;
+    uint32_t count = 0;
+    uint32_t always = 0;
+    int rv;
+    
+    prefilter = ss_re_prefilter_create();
+    if (prefilter == NULL) {
+        fprintf(stderr, "could not create re_chain prefilter\n");
+        goto error_out;
+    }
+    
+    TAILQ_FOREACH(rptr, &chain->re_list, entry) {
+        size_t length = rptr->inverted ? 0 : strlen(rptr->literal);
+        rptr->index = count;
+        rv = ss_re_prefilter_add(prefilter, count, rptr->literal, length);
+        if (rv) {
+            fprintf(stderr, "could not add re_chain rule %s to prefilter\n", rptr->name);
+            goto error_out;
+        }
+        if (length < SS_RE_LITERAL_MIN) ++always;
+        chain->entries[count++] = rptr;
+    }
+    
+    rv = ss_re_prefilter_compile(prefilter);
+    if (rv) {
+        fprintf(stderr, "could not compile re_chain prefilter\n");
+        goto error_out;
+    }
+    
+    ss_re_prefilter_destroy(chain->prefilter);
+    chain->prefilter = prefilter;
+    chain->count     = count;
+    fprintf(stderr, "compiled re_chain of %u rules, %u without a prefilter literal\n", count, always);
+    return 0;
+    
+    error_out:
+    ss_re_prefilter_destroy(prefilter);
+    return -1;
+}
+
 int ss_re_chain_remove_index(int index) {
     int counter = 0;
     ss_re_entry_t* pptr;
@@ -98,7 +225,7 @@ int ss_re_chain_remove_index(int index) {
     TAILQ_FOREACH_SAFE(pptr, &ss_conf->re_chain.re_list, entry, ptmp) {
         if (counter == index) {
             TAILQ_REMOVE(&ss_conf->re_chain.re_list, pptr, entry);
-            return 0;
+            return ss_re_chain_compile();
         }
         ++counter;
     }
@@ -111,7 +238,7 @@ int ss_re_chain_remove_name(char* name) {
     TAILQ_FOREACH_SAFE(pptr, &ss_conf->re_chain.re_list, entry, ptmp) {
         if (!strcasecmp(name, pptr->name)) {
             TAILQ_REMOVE(&ss_conf->re_chain.re_list, pptr, entry);
-            return 0;
+            return ss_re_chain_compile();
         }
     }
     return -1;
@@ -154,7 +281,9 @@ ss_re_entry_t* ss_re_entry_create(json_object* re_json) {
         goto error_out;
     }
     
+    // scanners only extract substrings, and know the ioc_type of each one
     tmp_string = ss_json_string_view(re_json, "type");
+    if (tmp_string == NULL && re_entry->backend == SS_RE_BACKEND_SCAN) tmp_string = "substring";
     if (tmp_string == NULL) {
         fprintf(stderr, "re_entry type is null\n");
         goto error_out;
@@ -165,15 +294,17 @@ ss_re_entry_t* ss_re_entry_create(json_object* re_json) {
         goto error_out;
     }
     
-    tmp_string = ss_json_string_view(re_json, "ioc_type");
-    if (tmp_string == NULL) {
-        fprintf(stderr, "re_entry ioc_type is null\n");
-        goto error_out;
-    }
-    re_entry->ioc_type = ss_ioc_type_load(tmp_string);
-    if ((int) re_entry->ioc_type == -1) {
-        fprintf(stderr, "re_entry ioc_type is invalid\n");
-        goto error_out;
+    if (re_entry->backend != SS_RE_BACKEND_SCAN) {
+        tmp_string = ss_json_string_view(re_json, "ioc_type");
+        if (tmp_string == NULL) {
+            fprintf(stderr, "re_entry ioc_type is null\n");
+            goto error_out;
+        }
+        re_entry->ioc_type = ss_ioc_type_load(tmp_string);
+        if ((int) re_entry->ioc_type == -1) {
+            fprintf(stderr, "re_entry ioc_type is invalid\n");
+            goto error_out;
+        }
     }
     
     rv = ss_nn_queue_create(re_json, &re_entry->nn_queue);
@@ -182,6 +313,17 @@ ss_re_entry_t* ss_re_entry_create(json_object* re_json) {
         goto error_out;
     }
     
+    rv = ss_re_entry_prepare_scope(re_json, re_entry);
+    if (rv) {
+        fprintf(stderr, "could not prepare re_entry scope\n");
+        goto error_out;
+    }
+    
+    tmp_string = ss_json_string_view(re_json, "re");
+    if (tmp_string) {
+        ss_re_literal_extract(tmp_string, re_entry->literal, sizeof(re_entry->literal));
+    }
+    
     if (re_entry->backend == SS_RE_BACKEND_PCRE) {
         rv = ss_re_entry_prepare_pcre(re_json, re_entry);
         if (rv) {
@@ -196,6 +338,13 @@ ss_re_entry_t* ss_re_entry_create(json_object* re_json) {
             goto error_out;
         }
     }
+    else if (re_entry->backend == SS_RE_BACKEND_SCAN) {
+        rv = ss_re_entry_prepare_scan(re_json, re_entry);
+        if (rv) {
+            fprintf(stderr, "could not prepare scanner\n");
+            goto error_out;
+        }
+    }
     
     fprintf(stderr, "created re entry [%s]\n", re_entry->name);
     return re_entry;
@@ -226,32 +375,131 @@ int ss_re_entry_destroy(ss_re_entry_t* re_entry) {
     return 0;
 }
 
+/*
+ * Reads the optional "field" the rule runs on, by default the whole
+ * message, and "app_name", one app-name or an array of them, limiting the
+ * rule to messages from those programs.
+ */
+int ss_re_entry_prepare_scope(json_object* re_json, ss_re_entry_t* re_entry) {
+    json_object* items;
+    json_object* item;
+    const char* tmp_string;
+    int length;
+    
+    re_entry->field = SS_SYSLOG_FIELD_ALL;
+    items = json_object_object_get(re_json, "field");
+    if (items) {
+        if (!json_object_is_type(items, json_type_string)) {
+            fprintf(stderr, "re_entry field is not string\n");
+            return -1;
+        }
+        re_entry->field = ss_syslog_field_load(json_object_get_string(items));
+        if ((int) re_entry->field == -1) {
+            fprintf(stderr, "re_entry field is invalid\n");
+            return -1;
+        }
+    }
+    
+    items = json_object_object_get(re_json, "app_name");
+    if (items == NULL) return 0;
+    
+    length = json_object_is_type(items, json_type_array) ? json_object_array_length(items) : 1;
+    if (length > SS_RE_APP_NAMES_MAX) {
+        fprintf(stderr, "re_entry has more than %d app_name values\n", SS_RE_APP_NAMES_MAX);
+        return -1;
+    }
+    for (int i = 0; i < length; ++i) {
+        item = json_object_is_type(items, json_type_array) ? json_object_array_get_idx(items, i) : items;
+        if (!json_object_is_type(item, json_type_string)) {
+            fprintf(stderr, "re_entry app_name is not string\n");
+            return -1;
+        }
+        tmp_string = json_object_get_string(item);
+        if (*tmp_string == '\0' || strlen(tmp_string) > SS_SYSLOG_APP_NAME_MAX) {
+            fprintf(stderr, "re_entry app_name %s is invalid\n", tmp_string);
+            return -1;
+        }
+        strcpy(re_entry->app_names[i], tmp_string);
+    }
+    re_entry->app_name_count = length;
+    
+    return 0;
+}
+
 /* RE MATCH INTERFACE */
 
-int ss_re_chain_match(ss_re_match_t* re_match, uint8_t* l4_offset, uint16_t l4_length) {
+static int ss_re_entry_app_name_match(ss_re_entry_t* re_entry, ss_syslog_view_t* app_name) {
+    if (re_entry->app_name_count == 0) return 1;
+    if (app_name->length == 0 || app_name->length > SS_SYSLOG_APP_NAME_MAX) return 0;
+    for (int i = 0; i < re_entry->app_name_count; ++i) {
+        if (!strncmp(re_entry->app_names[i], app_name->data, app_name->length) &&
+            re_entry->app_names[i][app_name->length] == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Fills re_matches with the rules matching the message, in chain order,
+ * and returns how many. In SS_RE_MATCH_FIRST mode that is at most one.
+ * A rule whose regex fails is logged by its backend and skipped, as is one
+ * scoped to an app-name or field the message does not have.
+ */
+int ss_re_chain_match(ss_re_match_t* re_matches, int matches_max, ss_syslog_t* slog) {
+    ss_re_chain_t* chain = &ss_conf->re_chain;
+    uint64_t candidates[SS_RE_CHAIN_WORDS];
+    int match_count = 0;
     int rv = 0;
-    ss_re_entry_t* rptr;
-    ss_re_entry_t* rtmp;
 
-    TAILQ_FOREACH_SAFE(rptr, &ss_conf->re_chain.re_list, entry, rtmp) {
-        RTE_LOG(FINE, EXTRACTOR, "attempt re backend %d match type %d against syslog rule %s\n",
-            rptr->backend, rptr->type, rptr->name);
-        if (rptr->backend == SS_RE_BACKEND_PCRE) {
-            rv = ss_re_chain_match_pcre(re_match, rptr, l4_offset, l4_length);
-        }
-        else if (rptr->backend == SS_RE_BACKEND_RE2) {
-            rv = ss_re_chain_match_re2(re_match, rptr, l4_offset, l4_length);
-        }
-        
-        if (rv) {
-            RTE_LOG(DEBUG, EXTRACTOR, "finish re match type %d against syslog rule %s with result %d\n",
-                rptr->type, rptr->name, rv);
-            re_match->re_entry = rptr;
-            return rv;
+    if (chain->prefilter == NULL || chain->count == 0) return 0;
+    
+    ss_re_prefilter_scan(chain->prefilter, (const uint8_t*) slog->all.data, slog->all.length, candidates);
+    
+    for (uint32_t word = 0; word < SS_RE_CHAIN_WORDS && match_count < matches_max; ++word) {
+        uint64_t bits = candidates[word];
+        while (bits && match_count < matches_max) {
+            uint32_t index = word * 64 + (uint32_t) __builtin_ctzll(bits);
+            ss_re_entry_t* rptr;
+            ss_re_match_t* re_match;
+            ss_syslog_view_t* view;
+            uint8_t* l4_offset;
+            uint16_t l4_length;
+            
+            bits &= bits - 1;
+            if (index >= chain->count) return match_count;
+            rptr = chain->entries[index];
+            if (!ss_re_entry_app_name_match(rptr, &slog->app_name)) continue;
+            view = ss_syslog_field_get(slog, rptr->field);
+            if (view->length == 0) continue;
+            l4_offset = (uint8_t*) view->data;
+            l4_length = view->length;
+            re_match  = &re_matches[match_count];
+            memset(re_match, 0, sizeof(*re_match));
+            
+            RTE_LOG(FINE, EXTRACTOR, "attempt re backend %d match type %d against syslog rule %s\n",
+                rptr->backend, rptr->type, rptr->name);
+            if (rptr->backend == SS_RE_BACKEND_PCRE) {
+                rv = ss_re_chain_match_pcre(re_match, rptr, l4_offset, l4_length);
+            }
+            else if (rptr->backend == SS_RE_BACKEND_RE2) {
+                rv = ss_re_chain_match_re2(re_match, rptr, l4_offset, l4_length);
+            }
+            else if (rptr->backend == SS_RE_BACKEND_SCAN) {
+                rv = ss_re_chain_match_scan(re_match, rptr, l4_offset, l4_length);
+            }
+            
+            if (rv > 0) {
+                RTE_LOG(DEBUG, EXTRACTOR, "finish re match type %d against syslog rule %s with result %d\n",
+                    rptr->type, rptr->name, rv);
+                re_match->re_entry = rptr;
+                ++match_count;
+                if (chain->mode == SS_RE_MATCH_FIRST) return match_count;
+            }
         }
     }
 
-    return 0;
+    return match_count;
 }
 
 /* PCRE BACKEND */
@@ -292,6 +540,7 @@ int ss_re_entry_prepare_pcre(json_object* re_json, ss_re_entry_t* re_entry) {
             re_entry->name, re_perror);
         return -1;
     }
+    pcre_assign_jit_stack(re_entry->pcre_re_extra, &ss_re_jit_stack_get, NULL);
     
     return 0;
 }
@@ -311,12 +560,12 @@ int ss_re_chain_match_pcre(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uin
 
 int ss_re_chain_match_pcre_complete(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length) {
     int match_count;
-    int match_vector[(0 + 1) * 3];
+    int* match_vector = ss_re_lcores[rte_lcore_id()].match_vector;
     
     match_count = pcre_exec(re_entry->pcre_re, re_entry->pcre_re_extra,
                             (char*) l4_offset, l4_length,
                             0, PCRE_NEWLINE_ANYCRLF,
-                            match_vector, (0 + 1) * 3);
+                            match_vector, SS_RE_MATCH_MAX);
     
     // flip around match logic if invert flag is set
     if (re_entry->inverted) {
@@ -343,19 +592,17 @@ int ss_re_chain_match_pcre_substring(ss_re_match_t* re_match, ss_re_entry_t* re_
     int             match_count;
     int             start_point = 0;
     int             have_match  = 0;
-    int             match_vector[(0 + 1) * 3];
+    int*            match_vector = ss_re_lcores[rte_lcore_id()].match_vector;
     int             match_index = 0;
-    uint8_t*        match_string;
+    const char*     match_string;
+    int             match_length;
     ss_ioc_entry_t* iptr;
     
-    // XXX: this is buggy because it will not be a true per-thread stack
-    pcre_assign_jit_stack(re_entry->pcre_re_extra, NULL, NULL);
-    
     do {
         match_count = pcre_exec(re_entry->pcre_re, re_entry->pcre_re_extra,
                                 (char*) l4_offset, l4_length,
                                 start_point, PCRE_NEWLINE_ANYCRLF,
-                                match_vector, (0 + 1) * 3);
+                                match_vector, SS_RE_MATCH_MAX);
         
         if (match_count == 0 || match_count == PCRE_ERROR_NOMATCH) {
             goto end_loop;
@@ -366,24 +613,23 @@ int ss_re_chain_match_pcre_substring(ss_re_match_t* re_match, ss_re_entry_t* re_
             return -1;
         }
         
-        if (pcre_get_substring((char*) l4_offset,
-                               match_vector, match_count,
-                               0, (const char**) &match_string) >= 0) {
-            RTE_LOG(FINER, EXTRACTOR, "attempt ioc match against substring %d: %s\n",
-                match_index, match_string);
-            iptr = ss_ioc_syslog_match((char*) match_string, re_entry->ioc_type);
-            if (iptr) {
-                RTE_LOG(FINE, EXTRACTOR, "successful ioc match for syslog rule %s against substring %s\n",
-                    re_entry->name, match_string);
-                have_match = 1;
-                re_match->ioc_entry = iptr;
-            }
-            pcre_free_substring((char*) match_string);
-            ++match_index;
+        // substring 0 (full content of match), looked up in place
+        match_string = (char*) l4_offset + match_vector[0];
+        match_length = match_vector[1] - match_vector[0];
+        RTE_LOG(FINER, EXTRACTOR, "attempt ioc match against substring %d: %.*s\n",
+            match_index, match_length, match_string);
+        iptr = ss_ioc_syslog_match(match_string, (size_t) match_length, re_entry->ioc_type);
+        if (iptr) {
+            RTE_LOG(FINE, EXTRACTOR, "successful ioc match for syslog rule %s against substring %.*s\n",
+                re_entry->name, match_length, match_string);
+            have_match = 1;
+            re_match->ioc_entry = iptr;
         }
+        ++match_index;
         
-        start_point = match_vector[1];
-    } while (match_count > 0 && start_point < l4_length && !have_match);
+        // step over an empty match, or it would be found again forever
+        start_point = match_vector[1] + (match_length == 0);
+    } while (start_point < l4_length && !have_match);
     
     end_loop:
     if (have_match) {
@@ -493,18 +739,13 @@ int ss_re_chain_match_re2_complete(ss_re_match_t* re_match, ss_re_entry_t* re_en
 int ss_re_chain_match_re2_substring(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length) {
     int             match_flag;
     int             match_length;
-    int             start_point;
+    int             start_point = 0;
     int             have_match = 0;
     int             match_index = 0;
     ss_ioc_entry_t* iptr;
     cre2_string_t   match[1];
-    char            substring[SS_IOC_DNS_SIZE + 1];
-    
-    match[0].data   = (char*) l4_offset;
-    match[0].length = 0;
     
     do {
-        start_point = (int) ((char*) match[0].data + match[0].length - (char*) l4_offset);
         match_flag = cre2_match(re_entry->re2_re,
             (char*) l4_offset, l4_length,
             start_point, l4_length,
@@ -514,24 +755,23 @@ int ss_re_chain_match_re2_substring(ss_re_match_t* re_match, ss_re_entry_t* re_e
             goto end_loop;
         }
         
-        // extract substring 0 (full content of match)
+        // substring 0 (full content of match), looked up in place
         match_length = match[0].length;
-        rte_memcpy(substring, match[0].data, match_length > SS_IOC_DNS_SIZE? SS_IOC_DNS_SIZE : match_length);
-        substring[match_length] = '\0';
+        RTE_LOG(FINER, EXTRACTOR, "attempt ioc match against substring %d: %.*s\n",
+            match_index, match_length, match[0].data);
         
-        RTE_LOG(FINER, EXTRACTOR, "attempt ioc match against substring %d: %s\n",
-            match_index, substring);
-        
-        iptr = ss_ioc_syslog_match(substring, re_entry->ioc_type);
+        iptr = ss_ioc_syslog_match(match[0].data, (size_t) match_length, re_entry->ioc_type);
         if (iptr) {
-            RTE_LOG(FINE, EXTRACTOR, "successful ioc match for syslog rule %s against substring %s\n",
-                re_entry->name, substring);
+            RTE_LOG(FINE, EXTRACTOR, "successful ioc match for syslog rule %s against substring %.*s\n",
+                re_entry->name, match_length, match[0].data);
             have_match = 1;
             re_match->ioc_entry = iptr;
-            return 1;
         }
         ++match_index;
-    } while (match_flag > 0 && !have_match);
+        
+        // step over an empty match, or it would be found again forever
+        start_point = (int) (match[0].data + match_length - (char*) l4_offset) + (match_length == 0);
+    } while (start_point < l4_length && !have_match);
     
     end_loop:
     if (have_match) {
@@ -544,3 +784,59 @@ int ss_re_chain_match_re2_substring(ss_re_match_t* re_match, ss_re_entry_t* re_e
         return 0;
     }
 }
+
+/* SCAN BACKEND */
+
+int ss_re_entry_prepare_scan(json_object* re_json, ss_re_entry_t* re_entry) {
+    const char* scan_string = NULL;
+    
+    scan_string = ss_json_string_view(re_json, "scanner");
+    if (scan_string == NULL) {
+        fprintf(stderr, "re_entry scanner is null\n");
+        return -1;
+    }
+    re_entry->scan_type = ss_scan_type_load(scan_string);
+    if ((int) re_entry->scan_type == -1) {
+        fprintf(stderr, "re_entry %s scanner %s is invalid\n", re_entry->name, scan_string);
+        return -1;
+    }
+    if (re_entry->type != SS_RE_TYPE_SUBSTRING) {
+        fprintf(stderr, "re_entry %s scanner only supports substring type\n", re_entry->name);
+        return -1;
+    }
+    
+    // hash scanners pick md5, sha1 or sha256 per token
+    re_entry->ioc_type = ss_scan_ioc_type(re_entry->scan_type);
+    re_entry->inverted = 0;
+    
+    return 0;
+}
+
+static int ss_re_scan_cb(const char* token, size_t length, ss_ioc_type_t ioc_type, void* data) {
+    ss_re_match_t* re_match = (ss_re_match_t*) data;
+    ss_ioc_entry_t* iptr;
+    
+    RTE_LOG(FINER, EXTRACTOR, "attempt ioc match against token %.*s\n", (int) length, token);
+    iptr = ss_ioc_syslog_match(token, length, ioc_type);
+    if (iptr == NULL) return 0;
+    re_match->ioc_entry = iptr;
+    return 1;
+}
+
+int ss_re_chain_match_scan(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length) {
+    int rv;
+    
+    rv = ss_scan_tokens(re_entry->scan_type, l4_offset, l4_length, &ss_re_scan_cb, re_match);
+    if (rv < 0) {
+        RTE_LOG(ERR, EXTRACTOR, "unknown scanner %d for syslog rule %s\n", re_entry->scan_type, re_entry->name);
+        return -1;
+    }
+    else if (rv) {
+        RTE_LOG(FINE, EXTRACTOR, "successful scanner ioc match for syslog rule %s\n", re_entry->name);
+        return 1;
+    }
+    else {
+        RTE_LOG(FINER, EXTRACTOR, "no scanner match against syslog rule %s\n", re_entry->name);
+        return 0;
+    }
+}
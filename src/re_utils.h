@@ -15,10 +15,17 @@
 #include "ioc.h"
 #include "ip_utils.h"
 #include "nn_queue.h"
+#include "re_prefilter.h"
+#include "scan_utils.h"
+#include "syslog_parse.h"
 
 /* CONSTANTS */
 
 #define SS_RE_MATCH_MAX  (16 * 3)
+#define SS_RE_MATCH_RESULT_MAX 16
+#define SS_RE_JIT_STACK_MIN    (32 * 1024)
+#define SS_RE_JIT_STACK_MAX    (1024 * 1024)
+#define SS_RE_APP_NAMES_MAX     8
 
 /* RE CHAIN */
 
@@ -35,11 +42,20 @@ enum ss_re_backend_e {
     SS_RE_BACKEND_EMPTY = 0,
     SS_RE_BACKEND_PCRE  = 1,
     SS_RE_BACKEND_RE2   = 2,
+    SS_RE_BACKEND_SCAN  = 3,
     SS_RE_BACKEND_MAX,
 };
 
 typedef enum ss_re_backend_e ss_re_backend_t;
 
+/* whether a message stops at the first matching rule or gets all of them */
+enum ss_re_match_mode_e {
+    SS_RE_MATCH_FIRST = 0,
+    SS_RE_MATCH_ALL   = 1,
+};
+
+typedef enum ss_re_match_mode_e ss_re_match_mode_t;
+
 struct ss_re_entry_s {
     uint64_t matches;
     int inverted;
@@ -52,11 +68,22 @@ struct ss_re_entry_s {
     
     cre2_regexp_t* re2_re;
     
+    ss_scan_type_t scan_type;
+    
     ss_ioc_type_t ioc_type;
     
     nn_queue_t nn_queue;
     char* name;
     
+    /* position in the chain, and the literal the prefilter looks for */
+    uint32_t index;
+    char literal[SS_RE_LITERAL_MAX];
+    
+    /* the syslog field the rule runs on, and the app-names it is limited to */
+    ss_syslog_field_t field;
+    int app_name_count;
+    char app_names[SS_RE_APP_NAMES_MAX][SS_SYSLOG_APP_NAME_MAX + 1];
+    
     TAILQ_ENTRY(ss_re_entry_s) entry;
 } __rte_cache_aligned;
 
@@ -65,8 +92,17 @@ typedef struct ss_re_entry_s ss_re_entry_t;
 TAILQ_HEAD(ss_re_list_s, ss_re_entry_s);
 typedef struct ss_re_list_s ss_re_list_t;
 
+/*
+ * entries and prefilter are rebuilt from re_list by ss_re_chain_compile,
+ * so a message is scanned once for the literals of every rule, and only
+ * the rules whose literal turned up run their regex.
+ */
 struct ss_re_chain_s {
     ss_re_list_t re_list;
+    ss_re_match_mode_t mode;
+    uint32_t count;
+    ss_re_entry_t* entries[SS_RE_CHAIN_MAX];
+    ss_re_prefilter_t* prefilter;
 } __rte_cache_aligned;
 
 typedef struct ss_re_chain_s ss_re_chain_t;
@@ -78,19 +114,32 @@ struct ss_re_match_s {
 
 typedef struct ss_re_match_s ss_re_match_t;
 
+/* the PCRE state each lcore matches with, so no two lcores share any */
+struct ss_re_lcore_s {
+    pcre_jit_stack* jit_stack;
+    int* match_vector; /* SS_RE_MATCH_MAX ints */
+} __rte_cache_aligned;
+
+typedef struct ss_re_lcore_s ss_re_lcore_t;
+
 /* BEGIN PROTOTYPES */
 
 int ss_re_init(void);
+int ss_re_lcore_init(void);
+void ss_re_lcore_destroy(void);
 const char* ss_pcre_strerror(int pcre_errno);
 ss_re_backend_t ss_re_backend_load(const char* backend_type);
 ss_re_type_t ss_re_type_load(const char* re_type);
+ss_re_match_mode_t ss_re_match_mode_load(const char* match_mode);
 int ss_re_chain_destroy(void);
 int ss_re_chain_add(ss_re_entry_t* re_entry);
+int ss_re_chain_compile(void);
 int ss_re_chain_remove_index(int index);
 int ss_re_chain_remove_name(char* name);
 ss_re_entry_t* ss_re_entry_create(json_object* re_json);
 int ss_re_entry_destroy(ss_re_entry_t* re_entry);
-int ss_re_chain_match(ss_re_match_t* re_match, uint8_t* l4_offset, uint16_t l4_length);
+int ss_re_entry_prepare_scope(json_object* re_json, ss_re_entry_t* re_entry);
+int ss_re_chain_match(ss_re_match_t* re_matches, int matches_max, ss_syslog_t* slog);
 int ss_re_entry_prepare_pcre(json_object* re_json, ss_re_entry_t* re_entry);
 int ss_re_chain_match_pcre(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
 int ss_re_chain_match_pcre_complete(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
@@ -99,6 +148,8 @@ int ss_re_entry_prepare_re2(json_object* re_json, ss_re_entry_t* re_entry);
 int ss_re_chain_match_re2(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
 int ss_re_chain_match_re2_complete(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
 int ss_re_chain_match_re2_substring(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
+int ss_re_entry_prepare_scan(json_object* re_json, ss_re_entry_t* re_entry);
+int ss_re_chain_match_scan(ss_re_match_t* re_match, ss_re_entry_t* re_entry, uint8_t* l4_offset, uint16_t l4_length);
 
 /* END PROTOTYPES */
 
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE /* memmem */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "scan_utils.h"
+
+/*
+ * Finds IOC shaped tokens in syslog text without a regex. Each scanner
+ * has a set of byte ranges its tokens are made of. The SIMD loop turns 64
+ * bytes at a time into a bitmap of the bytes inside those ranges, so text
+ * which cannot be part of a token is skipped a word at a time, and each
+ * run of set bits is then validated in place.
+ */
+
+static const ss_scan_class_t ss_scan_classes[SS_SCAN_TYPE_MAX] = {
+    [SS_SCAN_TYPE_IPV4]   = { 2, { {'.', '.'}, {'0', '9'} } },
+    [SS_SCAN_TYPE_IPV6]   = { 4, { {'.', '.'}, {'0', ':'}, {'A', 'F'}, {'a', 'f'} } },
+    [SS_SCAN_TYPE_DOMAIN] = { 4, { {'-', '.'}, {'0', '9'}, {'A', 'Z'}, {'a', 'z'} } },
+    [SS_SCAN_TYPE_EMAIL]  = { 7, { {'%', '%'}, {'+', '+'}, {'-', '.'}, {'0', '9'}, {'@', 'Z'}, {'_', '_'}, {'a', 'z'} } },
+    // printable ASCII, less the quotes, '`', '<' and '>' URLs tend to be
+    // wrapped in; '[' and ']' stay for IPv6 hosts, a trailing ']' is trimmed
+    [SS_SCAN_TYPE_URL]    = { 6, { {'!', '!'}, {'#', '&'}, {'(', ';'}, {'=', '='}, {'?', '_'}, {'a', '~'} } },
+    [SS_SCAN_TYPE_HASH]   = { 3, { {'0', '9'}, {'A', 'F'}, {'a', 'f'} } },
+};
+
+ss_scan_type_t ss_scan_type_load(const char* scan_type) {
+    if (!strcasecmp(scan_type, "ipv4"))   return SS_SCAN_TYPE_IPV4;
+    if (!strcasecmp(scan_type, "ipv6"))   return SS_SCAN_TYPE_IPV6;
+    if (!strcasecmp(scan_type, "domain")) return SS_SCAN_TYPE_DOMAIN;
+    if (!strcasecmp(scan_type, "email"))  return SS_SCAN_TYPE_EMAIL;
+    if (!strcasecmp(scan_type, "url"))    return SS_SCAN_TYPE_URL;
+    if (!strcasecmp(scan_type, "hash"))   return SS_SCAN_TYPE_HASH;
+    return (ss_scan_type_t) -1;
+}
+
+/* hash tokens are md5, sha1 or sha256 depending on their length */
+ss_ioc_type_t ss_scan_ioc_type(ss_scan_type_t scan_type) {
+    switch (scan_type) {
+        case SS_SCAN_TYPE_IPV4:
+        case SS_SCAN_TYPE_IPV6:   return SS_IOC_TYPE_IP;
+        case SS_SCAN_TYPE_DOMAIN: return SS_IOC_TYPE_DOMAIN;
+        case SS_SCAN_TYPE_EMAIL:  return SS_IOC_TYPE_EMAIL;
+        case SS_SCAN_TYPE_URL:    return SS_IOC_TYPE_URL;
+        default:                  return SS_IOC_TYPE_EMPTY;
+    }
+}
+
+/* CHARACTER CLASSES */
+
+static inline int ss_scan_is_digit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline int ss_scan_is_alpha(uint8_t c) {
+    return (uint8_t) ((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+static inline int ss_scan_is_hex(uint8_t c) {
+    return ss_scan_is_digit(c) || (uint8_t) ((c | 0x20) - 'a') <= 'f' - 'a';
+}
+
+static inline int ss_scan_is_word(uint8_t c) {
+    return ss_scan_is_digit(c) || ss_scan_is_alpha(c) || c == '_';
+}
+
+static inline uint64_t ss_scan_mask_scalar(const ss_scan_class_t* class, const uint8_t* data, size_t count) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        for (int r = 0; r < class->count; ++r) {
+            if ((uint8_t) (data[i] - class->ranges[r].lo) <= (uint8_t) (class->ranges[r].hi - class->ranges[r].lo)) {
+                mask |= 1ULL << i;
+                break;
+            }
+        }
+    }
+    return mask;
+}
+
+/*
+ * Returns a bit for each of the count (at most 64) bytes at data which is
+ * in one of the ranges of class. A byte is in lo..hi when byte - lo,
+ * wrapped around as unsigned, is no more than hi - lo.
+ */
+static inline __attribute__((always_inline)) uint64_t ss_scan_mask(const ss_scan_class_t* class, const uint8_t* data, size_t count) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    uint8_t tail[64];
+
+    // pad the last bytes of the message with NULs, which match no class
+    if (count < 64) {
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, data, count);
+        data = tail;
+    }
+#endif
+
+#if defined(__AVX2__)
+    __m256i chars0 = _mm256_loadu_si256((const __m256i*) data);
+    __m256i chars1 = _mm256_loadu_si256((const __m256i*) (data + 32));
+    __m256i match0 = _mm256_setzero_si256();
+    __m256i match1 = _mm256_setzero_si256();
+
+    for (int r = 0; r < class->count; ++r) {
+        __m256i lo    = _mm256_set1_epi8((char) class->ranges[r].lo);
+        __m256i width = _mm256_set1_epi8((char) (class->ranges[r].hi - class->ranges[r].lo));
+        __m256i off0  = _mm256_sub_epi8(chars0, lo);
+        __m256i off1  = _mm256_sub_epi8(chars1, lo);
+        match0 = _mm256_or_si256(match0, _mm256_cmpeq_epi8(_mm256_min_epu8(off0, width), off0));
+        match1 = _mm256_or_si256(match1, _mm256_cmpeq_epi8(_mm256_min_epu8(off1, width), off1));
+    }
+    return (uint64_t) (uint32_t) _mm256_movemask_epi8(match0) |
+        ((uint64_t) (uint32_t) _mm256_movemask_epi8(match1) << 32);
+#elif defined(__SSE2__)
+    uint64_t mask = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        __m128i chars = _mm_loadu_si128((const __m128i*) (data + i * 16));
+        __m128i match = _mm_setzero_si128();
+        for (int r = 0; r < class->count; ++r) {
+            __m128i lo    = _mm_set1_epi8((char) class->ranges[r].lo);
+            __m128i width = _mm_set1_epi8((char) (class->ranges[r].hi - class->ranges[r].lo));
+            __m128i off   = _mm_sub_epi8(chars, lo);
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(_mm_min_epu8(off, width), off));
+        }
+        mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(match) << (i * 16);
+    }
+    return mask;
+#else
+    return ss_scan_mask_scalar(class, data, count);
+#endif
+}
+
+/* VALIDATORS */
+
+/*
+ * Each validator gets one run of token bytes, trims punctuation which
+ * more likely ends a sentence than a token, and returns 1 if what is left
+ * is a token, with token and length narrowed down to it.
+ */
+
+static inline void ss_scan_trim(const char** token, size_t* length, const char* leading, const char* trailing) {
+    while (*length && strchr(leading, (*token)[0]))            { ++*token; --*length; }
+    while (*length && strchr(trailing, (*token)[*length - 1])) { --*length; }
+}
+
+static int ss_scan_ipv4_valid(const char* p, size_t length) {
+    int parts  = 0;
+    int digits = 0;
+    int value  = 0;
+
+    if (length < 7 || length > SS_SCAN_IPV4_MAX) return 0;
+    for (size_t i = 0; i <= length; ++i) {
+        if (i == length || p[i] == '.') {
+            if (digits == 0 || value > 255) return 0;
+            ++parts;
+            digits = 0;
+            value  = 0;
+        }
+        else {
+            if (!ss_scan_is_digit((uint8_t) p[i]) || ++digits > 3) return 0;
+            value = value * 10 + (p[i] - '0');
+        }
+    }
+    return parts == 4;
+}
+
+static int ss_scan_ipv4(const char** token, size_t* length) {
+    ss_scan_trim(token, length, ".", ".");
+    return ss_scan_ipv4_valid(*token, *length);
+}
+
+/*
+ * Groups of 1 to 4 hex digits split by ':', at most one "::", and maybe a
+ * dotted quad counted as two groups at the end. Times and MAC addresses
+ * have too few groups and no "::", so they fail.
+ */
+static int ss_scan_ipv6(const char** token, size_t* length) {
+    const char* p;
+    size_t n;
+    size_t i = 0;
+    int groups = 0;
+    int is_compressed = 0;
+
+    ss_scan_trim(token, length, ".", ".");
+    p = *token;
+    n = *length;
+    if (n >= 2 && p[n - 1] == ':' && p[n - 2] != ':') --n;
+    if (n < 2 || n > SS_SCAN_IPV6_MAX) return 0;
+
+    if (p[0] == ':') {
+        if (p[1] != ':') return 0;
+        is_compressed = 1;
+        i = 2;
+    }
+    while (i < n) {
+        size_t g = i;
+        while (g < n && g - i < 5 && ss_scan_is_hex((uint8_t) p[g])) ++g;
+        if (g < n && p[g] == '.') {
+            if (!ss_scan_ipv4_valid(p + i, n - i)) return 0;
+            groups += 2;
+            break;
+        }
+        if (g == i || g - i > 4) return 0;
+        ++groups;
+        i = g;
+        if (i == n) break;
+        if (p[i++] != ':') return 0;
+        if (i < n && p[i] == ':') {
+            if (is_compressed) return 0;
+            is_compressed = 1;
+            ++i;
+        }
+        else if (i == n) {
+            return 0;
+        }
+    }
+
+    if (groups == 0 || (is_compressed ? groups > 7 : groups != 8)) return 0;
+    *length = n;
+    return 1;
+}
+
+/* at least two labels of 1 to 63 bytes, and an alphabetic top level label */
+static int ss_scan_domain_valid(const char* p, size_t length) {
+    size_t label_start = 0;
+    int labels = 0;
+
+    if (length < 4 || length > SS_SCAN_DOMAIN_MAX) return 0;
+    for (size_t i = 0; i <= length; ++i) {
+        if (i < length && p[i] != '.') continue;
+        if (i == label_start || i - label_start > SS_SCAN_LABEL_MAX) return 0;
+        ++labels;
+        if (i == length) {
+            if (i - label_start < 2) return 0;
+            for (size_t j = label_start; j < i; ++j) {
+                if (!ss_scan_is_alpha((uint8_t) p[j])) return 0;
+            }
+        }
+        label_start = i + 1;
+    }
+    return labels >= 2;
+}
+
+static int ss_scan_domain(const char** token, size_t* length) {
+    // most runs are plain words
+    if (memchr(*token, '.', *length) == NULL) return 0;
+    ss_scan_trim(token, length, ".-", ".-");
+    return ss_scan_domain_valid(*token, *length);
+}
+
+static int ss_scan_email(const char** token, size_t* length) {
+    const char* at;
+    size_t local_length;
+
+    if (memchr(*token, '@', *length) == NULL) return 0;
+    ss_scan_trim(token, length, ".-", ".-");
+    at = memchr(*token, '@', *length);
+    if (at == NULL) return 0;
+    local_length = (size_t) (at - *token);
+    if (local_length == 0 || memchr(at + 1, '@', *length - local_length - 1)) return 0;
+    return ss_scan_domain_valid(at + 1, *length - local_length - 1);
+}
+
+/* a scheme, "://", and a host, taken to the end of the run */
+static int ss_scan_url(const char** token, size_t* length) {
+    const char* p = *token;
+    const char* separator;
+    const char* scheme;
+
+    separator = memmem(p, *length, "://", 3);
+    if (separator == NULL) return 0;
+
+    scheme = separator;
+    while (scheme > p && (ss_scan_is_alpha((uint8_t) scheme[-1]) || ss_scan_is_digit((uint8_t) scheme[-1]) ||
+        scheme[-1] == '+' || scheme[-1] == '-' || scheme[-1] == '.')) {
+        --scheme;
+    }
+    while (scheme < separator && !ss_scan_is_alpha((uint8_t) *scheme)) ++scheme;
+    if (scheme == separator) return 0;
+
+    *length -= (size_t) (scheme - p);
+    *token   = scheme;
+    ss_scan_trim(token, length, "", ".,;:!?)]}");
+    return *token + *length > separator + 3;
+}
+
+/* a hex run of exactly a digest's length, not part of a longer word */
+static ss_ioc_type_t ss_scan_hash(const uint8_t* data, size_t data_length, size_t start, size_t end) {
+    if (start > 0 && ss_scan_is_word(data[start - 1])) return SS_IOC_TYPE_EMPTY;
+    if (end < data_length && ss_scan_is_word(data[end])) return SS_IOC_TYPE_EMPTY;
+    switch (end - start) {
+        case SS_MD5_SIZE * 2:    return SS_IOC_TYPE_MD5;
+        case SS_SHA1_SIZE * 2:   return SS_IOC_TYPE_SHA1;
+        case SS_SHA256_SIZE * 2: return SS_IOC_TYPE_SHA256;
+        default:                 return SS_IOC_TYPE_EMPTY;
+    }
+}
+
+static inline __attribute__((always_inline)) int ss_scan_emit(ss_scan_type_t scan_type, const uint8_t* data, size_t data_length, size_t start, size_t end, ss_scan_cb scan_cb, void* cb_data) {
+    const char* token = (const char*) data + start;
+    size_t length = end - start;
+    ss_ioc_type_t ioc_type = ss_scan_ioc_type(scan_type);
+    int is_valid = 0;
+
+    switch (scan_type) {
+        case SS_SCAN_TYPE_IPV4:   is_valid = ss_scan_ipv4(&token, &length);   break;
+        case SS_SCAN_TYPE_IPV6:   is_valid = ss_scan_ipv6(&token, &length);   break;
+        case SS_SCAN_TYPE_DOMAIN: is_valid = ss_scan_domain(&token, &length); break;
+        case SS_SCAN_TYPE_EMAIL:  is_valid = ss_scan_email(&token, &length);  break;
+        case SS_SCAN_TYPE_URL:    is_valid = ss_scan_url(&token, &length);    break;
+        case SS_SCAN_TYPE_HASH: {
+            ioc_type = ss_scan_hash(data, data_length, start, end);
+            is_valid = ioc_type != SS_IOC_TYPE_EMPTY;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    if (!is_valid) return 0;
+    return scan_cb(token, length, ioc_type, cb_data);
+}
+
+/* SCANNER */
+
+/*
+ * Inlined once per scan type from ss_scan_tokens, so the ranges of the
+ * class are constants and the SIMD range loop unrolls.
+ */
+static inline __attribute__((always_inline)) int ss_scan_runs(ss_scan_type_t scan_type, const uint8_t* data, size_t length, ss_scan_cb scan_cb, void* cb_data) {
+    const ss_scan_class_t* class = &ss_scan_classes[scan_type];
+    size_t run_start = 0;
+    int is_run = 0;
+    int rv;
+
+    for (size_t base = 0; base < length; base += 64) {
+        size_t count = length - base < 64 ? length - base : 64;
+        size_t end   = base + count;
+        size_t pos   = base;
+        uint64_t mask = ss_scan_mask(class, data + base, count);
+
+        // alternate between looking for the next set bit and the next clear one
+        while (pos < end) {
+            uint64_t bits = (is_run ? ~mask : mask) >> (pos - base);
+            if (count < 64) bits &= (1ULL << (end - pos)) - 1;
+            if (bits == 0) break;
+            pos += (size_t) __builtin_ctzll(bits);
+            if (is_run) {
+                rv = ss_scan_emit(scan_type, data, length, run_start, pos, scan_cb, cb_data);
+                if (rv) return rv;
+            }
+            else {
+                run_start = pos;
+            }
+            is_run = !is_run;
+        }
+    }
+    if (is_run) {
+        rv = ss_scan_emit(scan_type, data, length, run_start, length, scan_cb, cb_data);
+        if (rv) return rv;
+    }
+
+    return 0;
+}
+
+/*
+ * Calls scan_cb on each valid scan_type token in data, left to right.
+ * Returns the first nonzero scan_cb result, which stops the scan, 0 at
+ * the end of data, or -1 for an unknown scan_type.
+ */
+int ss_scan_tokens(ss_scan_type_t scan_type, const uint8_t* data, size_t length, ss_scan_cb scan_cb, void* cb_data) {
+    switch (scan_type) {
+        case SS_SCAN_TYPE_IPV4:   return ss_scan_runs(SS_SCAN_TYPE_IPV4,   data, length, scan_cb, cb_data);
+        case SS_SCAN_TYPE_IPV6:   return ss_scan_runs(SS_SCAN_TYPE_IPV6,   data, length, scan_cb, cb_data);
+        case SS_SCAN_TYPE_DOMAIN: return ss_scan_runs(SS_SCAN_TYPE_DOMAIN, data, length, scan_cb, cb_data);
+        case SS_SCAN_TYPE_EMAIL:  return ss_scan_runs(SS_SCAN_TYPE_EMAIL,  data, length, scan_cb, cb_data);
+        case SS_SCAN_TYPE_URL:    return ss_scan_runs(SS_SCAN_TYPE_URL,    data, length, scan_cb, cb_data);
+        case SS_SCAN_TYPE_HASH:   return ss_scan_runs(SS_SCAN_TYPE_HASH,   data, length, scan_cb, cb_data);
+        default:                  return -1;
+    }
+}
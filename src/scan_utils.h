@@ -0,0 +1,58 @@
+#ifndef __SCAN_UTILS_H__
+#define __SCAN_UTILS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ioc.h"
+
+/* CONSTANTS */
+
+#define SS_SCAN_RANGES_MAX      8
+#define SS_SCAN_DOMAIN_MAX    253
+#define SS_SCAN_LABEL_MAX      63
+#define SS_SCAN_IPV4_MAX       15
+#define SS_SCAN_IPV6_MAX       45
+
+/* DATA TYPES */
+
+enum ss_scan_type_e {
+    SS_SCAN_TYPE_EMPTY  = 0,
+    SS_SCAN_TYPE_IPV4   = 1,
+    SS_SCAN_TYPE_IPV6   = 2,
+    SS_SCAN_TYPE_DOMAIN = 3,
+    SS_SCAN_TYPE_EMAIL  = 4,
+    SS_SCAN_TYPE_URL    = 5,
+    SS_SCAN_TYPE_HASH   = 6,
+    SS_SCAN_TYPE_MAX,
+};
+
+typedef enum ss_scan_type_e ss_scan_type_t;
+
+/* an inclusive byte range, one of those making up the characters of a token */
+struct ss_scan_range_s {
+    uint8_t lo;
+    uint8_t hi;
+};
+
+typedef struct ss_scan_range_s ss_scan_range_t;
+
+struct ss_scan_class_s {
+    int count;
+    ss_scan_range_t ranges[SS_SCAN_RANGES_MAX];
+};
+
+typedef struct ss_scan_class_s ss_scan_class_t;
+
+/* gets each token found, returns nonzero to stop the scan */
+typedef int (*ss_scan_cb)(const char* token, size_t length, ss_ioc_type_t ioc_type, void* data);
+
+/* BEGIN PROTOTYPES */
+
+ss_scan_type_t ss_scan_type_load(const char* scan_type);
+ss_ioc_type_t ss_scan_ioc_type(ss_scan_type_t scan_type);
+int ss_scan_tokens(ss_scan_type_t scan_type, const uint8_t* data, size_t length, ss_scan_cb scan_cb, void* cb_data);
+
+/* END PROTOTYPES */
+
+#endif /* __SCAN_UTILS_H__ */
@@ -28,11 +28,17 @@
 #include "common.h"
 #include "dpdk.h"
 #include "ethernet.h"
+#include "ioc.h"
+#include "ioc_hits.h"
 #include "je_utils.h"
 #include "re_utils.h"
 #include "sdn_sensor.h"
 #include "sensor_conf.h"
+#include "dns_txn.h"
+#include "pdns.h"
+#include "suppress.h"
 #include "tcp.h"
+#include "tcp_stream.h"
 
 /* GLOBAL VARIABLES */
 
@@ -69,6 +75,18 @@ static struct rte_eth_conf port_conf = {
     },
 };
 
+/*
+ * The default Toeplitz key hashes the two directions of a flow apart. With
+ * 0x6d5a repeated, swapping the addresses gives the same hash, so a query
+ * and its response, or both halves of a TCP stream, reach the same lcore.
+ */
+static uint8_t rss_symmetric_key[40] = {
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
 static const struct rte_eth_rxconf rx_conf = {
     .rx_thresh = {
         .pthresh = RX_PTHRESH,
@@ -145,19 +163,41 @@ static void ss_timer_callback(uint16_t lcore_id, uint64_t* timer_tsc) {
         mbuf_table[port_id][lcore_id].length = 0;
     }
 
+    /* close this lcore's tcp sockets idle for too long, a few at a time */
+    ss_tcp_timer_callback(lcore_id);
+    
+    /* let go of the streams this lcore follows once they go quiet */
+    ss_tcp_stream_timer_callback(lcore_id);
+    
+    /* time out this lcore's unanswered dns queries, a slice at a time */
+    ss_dns_txn_expire_callback(lcore_id);
+    
+    /* export the passive dns names this lcore saw, a slice at a time */
+    ss_pdns_timer_callback(lcore_id);
+    
     /* return if statistics timer is not ready yet */
     if (likely(*timer_tsc < ss_conf->timer_cycles)) return;
     
+    double elapsed = *timer_tsc / (double) rte_get_tsc_hz();
+    *timer_tsc = 0;
+    
+    /* renew this lcore's view of the IOC tables */
+    ss_ioc_timer_callback(lcore_id);
+    
+    /* send summaries of repeated ioc hits held back on this lcore */
+    ss_suppress_timer_callback(lcore_id);
+    
+    /* hand this lcore's ioc hit counts to the master, which merges them */
+    ss_ioc_hits_timer_callback(lcore_id);
+    
+    /* hand this lcore's dns counts to the master, which merges them */
+    ss_dns_txn_timer_callback(lcore_id);
+    
     /* return if not on master lcore */
     if (likely(lcore_id != rte_get_master_lcore())) return;
 
-    double elapsed = *timer_tsc / (double) rte_get_tsc_hz();
     RTE_LOG(NOTICE, SS, "call ss_port_stats_print after %011.6f secs.\n", elapsed);
     ss_port_stats_print(port_statistics, rte_eth_dev_count());
-    
-    ss_tcp_timer_callback();
-    
-    *timer_tsc = 0;
 }
 
 /* main processing loop */
@@ -181,6 +221,9 @@ void ss_main_loop(void) __attribute__ ((noreturn)) {
     while (1) {
         curr_tsc = rte_rdtsc();
 
+        /* no ioc pointers are held between bursts */
+        ss_ioc_lcore_quiesce(lcore_id);
+
         /* TX queue drain */
         diff_tsc = curr_tsc - prev_tsc;
         if (unlikely(diff_tsc > drain_tsc)) {
@@ -247,13 +290,18 @@ int main(int argc, char* argv[]) {
     uint8_t port_id, last_port;
     uint16_t lcore_count, lcore_id;
     char* conf_path = NULL;
+    int is_bench = 0;
     char pool_name[32];
     
     fprintf(stderr, "launching sdn_sensor version %s\n", SS_VERSION);
     
     opterr = 0;
-    while ((c = getopt(argc, argv, "c:")) != -1) {
+    while ((c = getopt(argc, argv, "bc:")) != -1) {
         switch (c) {
+            case 'b': {
+                is_bench = 1;
+                break;
+            }
             case 'c': {
                 rv = access(optarg, R_OK);
                 if (rv != 0) {
@@ -294,10 +342,17 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
     
+    /* time the ioc lookups against the loaded indicators, and stop */
+    if (is_bench) {
+        rv = ss_ioc_ip_bench(SS_IOC_BENCH_ROUNDS);
+        exit(rv ? 1 : 0);
+    }
+    
     /* copy over any ss_conf settings used in DPDK */
     if (ss_conf->rss_enabled) {
         port_conf.rxmode.mq_mode = ETH_MQ_RX_RSS;
-        port_conf.rx_adv_conf.rss_conf.rss_hf = ETH_RSS_IP;
+        port_conf.rx_adv_conf.rss_conf.rss_key = rss_symmetric_key;
+        port_conf.rx_adv_conf.rss_conf.rss_hf  = ETH_RSS_IP;
     }
     else {
         port_conf.rxmode.mq_mode = ETH_MQ_RX_NONE;
@@ -326,11 +381,41 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    rv = ss_re_lcore_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize per-lcore regular expression state\n");
+    }
+    
     rv = ss_tcp_init();
     if (rv) {
         rte_exit(EXIT_FAILURE, "could not initialize tcp protocol\n");
     }
     
+    rv = ss_tcp_stream_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize tcp stream reassembly\n");
+    }
+    
+    rv = ss_suppress_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize ioc suppression cache\n");
+    }
+    
+    rv = ss_ioc_hits_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize ioc hit counters\n");
+    }
+    
+    rv = ss_dns_txn_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize dns transaction table\n");
+    }
+    
+    rv = ss_pdns_init();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not initialize passive dns table\n");
+    }
+    
     if (rte_eal_pci_probe() < 0) {
         rte_exit(EXIT_FAILURE, "could not initialize pci bus / ethernet nics\n");
     }
@@ -423,6 +508,12 @@ int main(int argc, char* argv[]) {
     
     //ss_port_link_status_check_all(ss_conf->port_count);
     
+    /* apply ioc feed deltas and expiry in the background */
+    rv = ss_ioc_update_start();
+    if (rv) {
+        rte_exit(EXIT_FAILURE, "could not start ioc updates\n");
+    }
+    
     /* launch per-lcore init on every lcore */
     rte_eal_mp_remote_launch(ss_launch_one_lcore, NULL, CALL_MASTER);
     RTE_LCORE_FOREACH_SLAVE(lcore_id) {
@@ -20,18 +20,33 @@
 #include <json-c/json.h>
 #include <json-c/json_object_private.h>
 
+#include <rte_lcore.h>
 #include <rte_log.h>
 
 #include "common.h"
 #include "ip_utils.h"
+#include "je_utils.h"
+#include "json.h"
 #include "sdn_sensor.h"
+#include "ioc_hits.h"
 #include "sensor_conf.h"
+#include "dns_txn.h"
+#include "pdns.h"
+#include "suppress.h"
+#include "tcp.h"
+#include "tcp_buffer.h"
+#include "tcp_stream.h"
 
 #define PROGRAM_PATH "/proc/self/exe"
 #define CONF_PATH "/../conf/sdn_sensor.json"
 
 #define MDB_SIZE_4_GB 4294967296
 #define MDB_COUNT_32  32
+#define MDB_PATH      "/tmp/sdn_sensor_lmdb"
+
+#define IOC_UPDATE_SECONDS 60
+#define IOC_STATS_SECONDS  60
+#define IOC_STATS_TOP      10
 
 #define SS_NS_PER_SEC 1E9
 #define SS_NS_PER_HALF_SEC 5E8
@@ -47,10 +62,15 @@ int ss_conf_destroy() {
     ss_dns_chain_destroy();
     ss_re_chain_destroy();
     ss_ioc_chain_destroy();
+    if (ss_conf->pdns_export) ss_nn_queue_destroy(&ss_conf->pdns_nn_queue);
 
-    // XXX: destroy ss_ioc_entry_t* tables
+    // XXX: destroy ss_ioc_entry_t* entries
+    ss_ioc_tables_destroy(ss_conf->ioc_tables);
+    ss_conf->ioc_tables = NULL;
 
-    mdb_env_close(ss_conf->mdb_env);
+    ss_ioc_mdb_txns_destroy();
+    if (ss_conf->mdb_env) mdb_env_close(ss_conf->mdb_env);
+    if (ss_conf->mdb_path) je_free(ss_conf->mdb_path);
 
     je_free(ss_conf);
 
@@ -421,6 +441,449 @@ int ss_conf_dpdk_parse(json_object* items) {
     return 0;
 }
 
+int ss_conf_ioc_update_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    ss_conf->ioc_update_seconds = IOC_UPDATE_SECONDS;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "ioc_update is not object\n");
+        return -1;
+    }
+    
+    // 0 turns off delta files and ttl expiry
+    item = json_object_object_get(items, "interval_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "interval_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->ioc_update_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_ioc_suppress_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    // repeated ioc hits are reported one by one unless configured
+    ss_conf->suppress_seconds = 0;
+    ss_conf->suppress_entries = SS_SUPPRESS_ENTRIES;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "ioc_suppress is not object\n");
+        return -1;
+    }
+    
+    item = json_object_object_get(items, "window_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "window_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->suppress_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < SS_SUPPRESS_WAYS ||
+            json_object_get_int64(item) > (1 << 24)) {
+            fprintf(stderr, "entries is not a valid suppression cache size\n");
+            return -1;
+        }
+        ss_conf->suppress_entries = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_ioc_stats_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    ss_conf->ioc_stats_seconds = IOC_STATS_SECONDS;
+    ss_conf->ioc_stats_top     = IOC_STATS_TOP;
+    ss_conf->ioc_stats_entries = SS_IOC_HITS_ENTRIES;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "ioc_stats is not object\n");
+        return -1;
+    }
+    
+    // 0 turns off hit counting
+    item = json_object_object_get(items, "interval_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "interval_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->ioc_stats_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "top");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > SS_IOC_HITS_TOP_MAX) {
+            fprintf(stderr, "top is not between 0 and %d\n", SS_IOC_HITS_TOP_MAX);
+            return -1;
+        }
+        ss_conf->ioc_stats_top = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > (1 << 24)) {
+            fprintf(stderr, "entries is not a valid hit counter size\n");
+            return -1;
+        }
+        ss_conf->ioc_stats_entries = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_passive_dns_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    // names are only kept for enrichment and export when configured
+    ss_conf->pdns_entries        = 0;
+    ss_conf->pdns_ttl_min        = SS_PDNS_TTL_MIN;
+    ss_conf->pdns_ttl_max        = SS_PDNS_TTL_MAX;
+    ss_conf->pdns_export_seconds = SS_PDNS_EXPORT_SECONDS;
+    ss_conf->pdns_export         = 0;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "passive_dns is not object\n");
+        return -1;
+    }
+    
+    ss_conf->pdns_entries = SS_PDNS_ENTRIES;
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > (1 << 24)) {
+            fprintf(stderr, "entries is not a valid passive dns table size\n");
+            return -1;
+        }
+        ss_conf->pdns_entries = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "ttl_min_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "ttl_min_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->pdns_ttl_min = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "ttl_max_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "ttl_max_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->pdns_ttl_max = (uint32_t) json_object_get_int64(item);
+    }
+    if (ss_conf->pdns_ttl_min > ss_conf->pdns_ttl_max) {
+        fprintf(stderr, "ttl_min_seconds is more than ttl_max_seconds\n");
+        return -1;
+    }
+    
+    item = json_object_object_get(items, "export_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "export_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->pdns_export_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    // batches go out only if a queue is configured
+    if (ss_conf->pdns_entries && json_object_object_get(items, "nm_url")) {
+        if (ss_nn_queue_create(items, &ss_conf->pdns_nn_queue)) {
+            fprintf(stderr, "could not allocate passive_dns nm_queue\n");
+            return -1;
+        }
+        ss_conf->pdns_export = 1;
+    }
+    
+    return 0;
+}
+
+int ss_conf_dns_stats_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    ss_conf->dns_txn_seconds = SS_DNS_TXN_SECONDS;
+    ss_conf->dns_txn_timeout = SS_DNS_TXN_TIMEOUT;
+    ss_conf->dns_txn_entries = SS_DNS_TXN_ENTRIES;
+    ss_conf->dns_txn_clients = SS_DNS_TXN_CLIENTS;
+    ss_conf->dns_txn_top     = SS_DNS_TXN_TOP;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "dns_stats is not object\n");
+        return -1;
+    }
+    
+    // 0 turns off query / response pairing
+    item = json_object_object_get(items, "interval_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > UINT32_MAX) {
+            fprintf(stderr, "interval_seconds is not valid seconds\n");
+            return -1;
+        }
+        ss_conf->dns_txn_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "timeout_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > 3600) {
+            fprintf(stderr, "timeout_seconds is not between 1 and 3600\n");
+            return -1;
+        }
+        ss_conf->dns_txn_timeout = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < SS_DNS_TXN_PROBE_MAX ||
+            json_object_get_int64(item) > (1 << 24)) {
+            fprintf(stderr, "entries is not a valid dns transaction table size\n");
+            return -1;
+        }
+        ss_conf->dns_txn_entries = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "clients");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > (1 << 20)) {
+            fprintf(stderr, "clients is not a valid dns client table size\n");
+            return -1;
+        }
+        ss_conf->dns_txn_clients = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "top");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > SS_DNS_TXN_TOP_MAX) {
+            fprintf(stderr, "top is not between 0 and %d\n", SS_DNS_TXN_TOP_MAX);
+            return -1;
+        }
+        ss_conf->dns_txn_top = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_tcp_sockets_parse(json_object* items) {
+    json_object* item = NULL;
+    int64_t entries;
+    
+    ss_conf->tcp_socket_entries    = SS_TCP_SOCKET_ENTRIES;
+    ss_conf->tcp_idle_seconds      = SS_TCP_IDLE_SECONDS;
+    ss_conf->tcp_ooo_max           = SS_TCP_OOO_MAX;
+    ss_conf->tcp_syn_rate          = SS_TCP_SYN_RATE;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "tcp_sockets is not object\n");
+        return -1;
+    }
+    
+    // rte_hash wants a power of 2, split into whole buckets
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        entries = json_object_is_type(item, json_type_int) ? json_object_get_int64(item) : 0;
+        if (entries < 1024 || entries > (1 << 24) || (entries & (entries - 1))) {
+            fprintf(stderr, "entries is not a power of 2 between 1024 and %d\n", 1 << 24);
+            return -1;
+        }
+        ss_conf->tcp_socket_entries = (uint32_t) entries;
+    }
+    
+    // the timer wheel reaches three days ahead
+    item = json_object_object_get(items, "idle_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > 86400) {
+            fprintf(stderr, "idle_seconds is not between 1 and 86400\n");
+            return -1;
+        }
+        ss_conf->tcp_idle_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    // held mbufs come out of the RX pool, so keep this well below its size
+    item = json_object_object_get(items, "ooo_segments");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > 65536) {
+            fprintf(stderr, "ooo_segments is not between 0 and 65536\n");
+            return -1;
+        }
+        ss_conf->tcp_ooo_max = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "syn_rate");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > 1000000) {
+            fprintf(stderr, "syn_rate is not between 1 and 1000000\n");
+            return -1;
+        }
+        ss_conf->tcp_syn_rate = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_tcp_streams_parse(json_object* items) {
+    json_object* item = NULL;
+    int64_t entries;
+    
+    ss_conf->tcp_stream_entries      = SS_TCP_STREAM_ENTRIES;
+    ss_conf->tcp_stream_depth        = SS_TCP_STREAM_DEPTH;
+    ss_conf->tcp_stream_ooo_max      = SS_TCP_STREAM_OOO_MAX;
+    ss_conf->tcp_stream_idle_seconds = SS_TCP_STREAM_IDLE_SECONDS;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "tcp_streams is not object\n");
+        return -1;
+    }
+    
+    item = json_object_object_get(items, "entries");
+    if (item) {
+        entries = json_object_is_type(item, json_type_int) ? json_object_get_int64(item) : 0;
+        if (entries < 1024 || entries > (1 << 24) || (entries & (entries - 1))) {
+            fprintf(stderr, "entries is not a power of 2 between 1024 and %d\n", 1 << 24);
+            return -1;
+        }
+        ss_conf->tcp_stream_entries = (uint32_t) entries;
+    }
+    
+    item = json_object_object_get(items, "depth_bytes");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > (1LL << 30)) {
+            fprintf(stderr, "depth_bytes is not between 1 and %lld\n", 1LL << 30);
+            return -1;
+        }
+        ss_conf->tcp_stream_depth = (uint32_t) json_object_get_int64(item);
+    }
+    
+    // held mbufs come out of the RX pool, so keep this well below its size
+    item = json_object_object_get(items, "ooo_segments");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 0 ||
+            json_object_get_int64(item) > 65536) {
+            fprintf(stderr, "ooo_segments is not between 0 and 65536\n");
+            return -1;
+        }
+        ss_conf->tcp_stream_ooo_max = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "idle_seconds");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < 1 ||
+            json_object_get_int64(item) > 86400) {
+            fprintf(stderr, "idle_seconds is not between 1 and 86400\n");
+            return -1;
+        }
+        ss_conf->tcp_stream_idle_seconds = (uint32_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_tcp_buffers_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    ss_conf->tcp_buffer_max  = SS_TCP_BUFFER_MAX;
+    ss_conf->tcp_buffer_pool = SS_TCP_BUFFER_POOL;
+    ss_conf->tcp_stream_buffer_pool = SS_TCP_STREAM_POOL;
+    if (items == NULL) return 0;
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "tcp_buffers is not object\n");
+        return -1;
+    }
+    
+    // messages are matched in one piece, which a uint16_t length bounds
+    item = json_object_object_get(items, "connection_max_bytes");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < SS_TCP_CHUNK_SIZE ||
+            json_object_get_int64(item) > UINT16_MAX) {
+            fprintf(stderr, "connection_max_bytes is not between %d and %d\n", SS_TCP_CHUNK_SIZE, UINT16_MAX);
+            return -1;
+        }
+        ss_conf->tcp_buffer_max = (uint32_t) json_object_get_int64(item);
+    }
+    
+    item = json_object_object_get(items, "pool_bytes");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < (1 << 20) ||
+            json_object_get_int64(item) > (1LL << 36)) {
+            fprintf(stderr, "pool_bytes is not between 1 MB and 64 GB\n");
+            return -1;
+        }
+        ss_conf->tcp_buffer_pool = (uint64_t) json_object_get_int64(item);
+    }
+    
+    // followed streams have a pool of their own, so they never evict sockets
+    item = json_object_object_get(items, "stream_pool_bytes");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) < (1 << 20) ||
+            json_object_get_int64(item) > (1LL << 36)) {
+            fprintf(stderr, "stream_pool_bytes is not between 1 MB and 64 GB\n");
+            return -1;
+        }
+        ss_conf->tcp_stream_buffer_pool = (uint64_t) json_object_get_int64(item);
+    }
+    
+    return 0;
+}
+
+int ss_conf_mdb_parse(json_object* items) {
+    json_object* item = NULL;
+    
+    ss_conf->mdb_map_size = MDB_SIZE_4_GB;
+    ss_conf->mdb_reuse    = 0;
+    if (items == NULL) {
+        ss_conf->mdb_path = je_strdup(MDB_PATH);
+        return ss_conf->mdb_path ? 0 : -1;
+    }
+    if (!json_object_is_type(items, json_type_object)) {
+        fprintf(stderr, "ioc_mdb is not object\n");
+        return -1;
+    }
+    
+    ss_conf->mdb_path = ss_json_string_get(items, "path");
+    if (ss_conf->mdb_path == NULL) ss_conf->mdb_path = je_strdup(MDB_PATH);
+    if (ss_conf->mdb_path == NULL) return -1;
+    
+    item = json_object_object_get(items, "map_size");
+    if (item) {
+        if (!json_object_is_type(item, json_type_int) || json_object_get_int64(item) <= 0) {
+            fprintf(stderr, "map_size is not positive integer\n");
+            return -1;
+        }
+        ss_conf->mdb_map_size = (uint64_t) json_object_get_int64(item);
+    }
+    
+    // reopen a map loaded by an earlier run instead of parsing the ioc files
+    ss_conf->mdb_reuse = ss_json_boolean_get(items, "reuse", 0);
+    
+    return 0;
+}
+
 int ss_conf_mdb_init() {
     int rv;
     MDB_txn* mdb_txn = NULL;
@@ -431,7 +894,7 @@ int ss_conf_mdb_init() {
         goto error_out;
     }
     
-    rv = mdb_env_set_mapsize(ss_conf->mdb_env, MDB_SIZE_4_GB);
+    rv = mdb_env_set_mapsize(ss_conf->mdb_env, ss_conf->mdb_map_size);
     if (rv) {
         fprintf(stderr, "could not set mdb map size: %s\n", mdb_strerror(rv));
         goto error_out;
@@ -443,13 +906,22 @@ int ss_conf_mdb_init() {
         goto error_out;
     }
     
-    rv = mkdir("/tmp/sdn_sensor_lmdb", 0755);
+    // every lcore holds a read transaction, plus a few for other threads
+    rv = mdb_env_set_maxreaders(ss_conf->mdb_env, RTE_MAX_LCORE + 8);
+    if (rv) {
+        fprintf(stderr, "could not set mdb reader count: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+    
+    rv = mkdir(ss_conf->mdb_path, 0755);
     if (rv && errno != EEXIST) {
         fprintf(stderr, "could not create mdb directory: %s\n", strerror(errno));
         goto error_out;
     }
     
-    rv = mdb_env_open(ss_conf->mdb_env, "/tmp/sdn_sensor_lmdb", 0, 0644);
+    // NOTLS: read transactions belong to lcores, not to threads
+    // NORDAHEAD: lookups are random, readahead only evicts useful pages
+    rv = mdb_env_open(ss_conf->mdb_env, ss_conf->mdb_path, MDB_NOTLS | MDB_NORDAHEAD, 0644);
     if (rv) {
         fprintf(stderr, "could not open mdb environment: %s\n", mdb_strerror(rv));
         goto error_out;
@@ -461,6 +933,12 @@ int ss_conf_mdb_init() {
         goto error_out;
     }
 
+    rv = mdb_dbi_open(mdb_txn, "meta_dbi",   MDB_CREATE, &ss_conf->meta_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb meta_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
     rv = mdb_dbi_open(mdb_txn, "ip4_dbi",    MDB_CREATE, &ss_conf->ip4_dbi);
     if (rv) {
         fprintf(stderr, "could not open mdb ip4_table: %s\n", mdb_strerror(rv));
@@ -479,6 +957,12 @@ int ss_conf_mdb_init() {
         goto error_out;
     }
 
+    rv = mdb_dbi_open(mdb_txn, "host_dbi",   MDB_CREATE, &ss_conf->host_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb host_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
     rv = mdb_dbi_open(mdb_txn, "url_dbi",    MDB_CREATE, &ss_conf->url_dbi);
     if (rv) {
         fprintf(stderr, "could not open mdb url_table: %s\n", mdb_strerror(rv));
@@ -491,6 +975,58 @@ int ss_conf_mdb_init() {
         goto error_out;
     }
 
+    rv = mdb_dbi_open(mdb_txn, "md5_dbi",    MDB_CREATE, &ss_conf->md5_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb md5_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
+    rv = mdb_dbi_open(mdb_txn, "sha1_dbi",   MDB_CREATE, &ss_conf->sha1_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb sha1_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
+    rv = mdb_dbi_open(mdb_txn, "sha256_dbi", MDB_CREATE, &ss_conf->sha256_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb sha256_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
+    rv = mdb_dbi_open(mdb_txn, "expire_dbi", MDB_CREATE, &ss_conf->expire_dbi);
+    if (rv) {
+        fprintf(stderr, "could not open mdb expire_table: %s\n", mdb_strerror(rv));
+        goto error_out;
+    }
+
+#ifdef SS_IOC_BACKEND_DISK
+    MDB_val key, value;
+    key.mv_size = strlen(SS_IOC_MDB_FORMAT_KEY);
+    key.mv_data = SS_IOC_MDB_FORMAT_KEY;
+    rv = mdb_get(mdb_txn, ss_conf->meta_dbi, &key, &value);
+    if (ss_conf->mdb_reuse && rv == 0 && value.mv_size == sizeof(uint32_t) &&
+        *(uint32_t*) value.mv_data == SS_IOC_MDB_FORMAT) {
+        fprintf(stderr, "reusing loaded mdb environment %s\n", ss_conf->mdb_path);
+        ss_conf->mdb_is_loaded = 1;
+    }
+    else {
+        // stale or partial contents from an earlier run must not match
+        MDB_dbi dbis[] = {
+            ss_conf->meta_dbi, ss_conf->ip4_dbi, ss_conf->ip6_dbi,
+            ss_conf->domain_dbi, ss_conf->host_dbi, ss_conf->url_dbi, ss_conf->email_dbi,
+            ss_conf->md5_dbi, ss_conf->sha1_dbi, ss_conf->sha256_dbi,
+            ss_conf->expire_dbi,
+        };
+        for (size_t i = 0; i < sizeof(dbis) / sizeof(dbis[0]); ++i) {
+            rv = mdb_drop(mdb_txn, dbis[i], 0);
+            if (rv) {
+                fprintf(stderr, "could not empty mdb table: %s\n", mdb_strerror(rv));
+                goto error_out;
+            }
+        }
+    }
+#endif
+
     rv = mdb_txn_commit(mdb_txn);
     if (rv) {
         fprintf(stderr, "could not commit mdb table creation transaction: %s\n", mdb_strerror(rv));
@@ -500,8 +1036,8 @@ int ss_conf_mdb_init() {
     return 0;
     
     error_out:
-    if (ss_conf->mdb_env) { mdb_env_close(ss_conf->mdb_env); ss_conf->mdb_env = NULL; }
     if (mdb_txn)          { mdb_txn_abort(mdb_txn); mdb_txn = NULL; }
+    if (ss_conf->mdb_env) { mdb_env_close(ss_conf->mdb_env); ss_conf->mdb_env = NULL; }
     return -1;
 }
 
@@ -548,6 +1084,56 @@ ss_conf_t* ss_conf_file_parse(char* conf_path) {
     TAILQ_INIT(&ss_conf->pcap_chain.pcap_list);
     TAILQ_INIT(&ss_conf->dns_chain.dns_list);
     TAILQ_INIT(&ss_conf->ioc_chain.ioc_list);
+    ss_conf->dns_chain.dns_trie = ss_dns_trie_create();
+    if (ss_conf->dns_chain.dns_trie == NULL) {
+        fprintf(stderr, "could not allocate dns trie\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_ioc_update_parse(json_object_object_get(json_conf, "ioc_update"));
+    if (rv) {
+        fprintf(stderr, "could not parse ioc_update configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_ioc_suppress_parse(json_object_object_get(json_conf, "ioc_suppress"));
+    if (rv) {
+        fprintf(stderr, "could not parse ioc_suppress configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_ioc_stats_parse(json_object_object_get(json_conf, "ioc_stats"));
+    if (rv) {
+        fprintf(stderr, "could not parse ioc_stats configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_passive_dns_parse(json_object_object_get(json_conf, "passive_dns"));
+    if (rv) {
+        fprintf(stderr, "could not parse passive_dns configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_dns_stats_parse(json_object_object_get(json_conf, "dns_stats"));
+    if (rv) {
+        fprintf(stderr, "could not parse dns_stats configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_tcp_sockets_parse(json_object_object_get(json_conf, "tcp_sockets"));
+    if (rv) {
+        fprintf(stderr, "could not parse tcp_sockets configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_tcp_streams_parse(json_object_object_get(json_conf, "tcp_streams"));
+    if (rv) {
+        fprintf(stderr, "could not parse tcp_streams configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_tcp_buffers_parse(json_object_object_get(json_conf, "tcp_buffers"));
+    if (rv) {
+        fprintf(stderr, "could not parse tcp_buffers configuration\n");
+        is_ok = 0; goto error_out;
+    }
+    rv = ss_conf_mdb_parse(json_object_object_get(json_conf, "ioc_mdb"));
+    if (rv) {
+        fprintf(stderr, "could not parse ioc_mdb configuration\n");
+        is_ok = 0; goto error_out;
+    }
     rv = ss_conf_mdb_init();
     if (rv) {
         fprintf(stderr, "could not initialize mdb: %s\n", mdb_strerror(rv));
@@ -610,9 +1196,34 @@ ss_conf_t* ss_conf_file_parse(char* conf_path) {
                 ss_re_entry_destroy(entry);
                 is_ok = 0; goto error_out;
             }
-            ss_re_chain_add(entry);
+            rv = ss_re_chain_add(entry);
+            if (rv) {
+                fprintf(stderr, "could not add re_chain entry %d\n", i);
+                ss_re_entry_destroy(entry);
+                is_ok = 0; goto error_out;
+            }
+        }
+    }
+    
+    // rules are tried in order; "all" reports every matching rule, not just the first
+    ss_conf->re_chain.mode = SS_RE_MATCH_FIRST;
+    item = json_object_object_get(json_conf, "re_chain_match");
+    if (item) {
+        is_ok = json_object_is_type(item, json_type_string);
+        if (is_ok) {
+            ss_conf->re_chain.mode = ss_re_match_mode_load(json_object_get_string(item));
+            is_ok = (int) ss_conf->re_chain.mode != -1;
+        }
+        if (!is_ok) {
+            fprintf(stderr, "re_chain_match is not first or all\n");
+            goto error_out;
         }
     }
+    rv = ss_re_chain_compile();
+    if (rv) {
+        fprintf(stderr, "could not compile re_chain\n");
+        is_ok = 0; goto error_out;
+    }
 
     items = json_object_object_get(json_conf, "pcap_chain");
     if (items) {
@@ -650,7 +1261,12 @@ ss_conf_t* ss_conf_file_parse(char* conf_path) {
                 ss_dns_entry_destroy(entry);
                 is_ok = 0; goto error_out;
             }
-            ss_dns_chain_add(entry);
+            rv = ss_dns_chain_add(entry);
+            if (rv) {
+                fprintf(stderr, "could not add dns_chain entry %d\n", i);
+                ss_dns_entry_destroy(entry);
+                is_ok = 0; goto error_out;
+            }
         }
     }
 
@@ -698,7 +1314,11 @@ ss_conf_t* ss_conf_file_parse(char* conf_path) {
         }
         
         ss_ioc_chain_dump(20);
-        ss_ioc_chain_optimize();
+        rv = ss_ioc_chain_optimize();
+        if (rv) {
+            fprintf(stderr, "could not optimize ioc_chain\n");
+            is_ok = 0; goto error_out;
+        }
         ss_ioc_tables_dump(5);
     }
     
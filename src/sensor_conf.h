@@ -48,18 +48,55 @@ struct ss_conf_s {
     ss_ioc_file_t ioc_files[SS_IOC_FILE_MAX];
     ss_ioc_chain_t ioc_chain;
     
-    ss_ioc_entry_t* ip4_table;
-    ss_ioc_entry_t* ip6_table;
-    ss_ioc_entry_t* domain_table;
-    ss_ioc_entry_t* url_table;
-    ss_ioc_entry_t* email_table;
+    ss_ioc_tables_t* ioc_tables;
+    uint32_t ioc_update_seconds;
+    uint32_t suppress_seconds;
+    uint32_t suppress_entries;
+    uint32_t ioc_stats_seconds;
+    uint32_t ioc_stats_top;
+    uint32_t ioc_stats_entries;
     
+    uint32_t dns_txn_seconds;
+    uint32_t dns_txn_timeout;
+    uint32_t dns_txn_entries;
+    uint32_t dns_txn_clients;
+    uint32_t dns_txn_top;
+    
+    uint32_t tcp_socket_entries;
+    uint32_t tcp_idle_seconds;
+    uint32_t tcp_ooo_max;
+    uint32_t tcp_syn_rate;
+    uint32_t tcp_stream_entries;
+    uint32_t tcp_stream_depth;
+    uint32_t tcp_stream_ooo_max;
+    uint32_t tcp_stream_idle_seconds;
+    uint32_t tcp_buffer_max;
+    uint64_t tcp_buffer_pool;
+    uint64_t tcp_stream_buffer_pool;
+    
+    uint32_t   pdns_entries;
+    uint32_t   pdns_ttl_min;
+    uint32_t   pdns_ttl_max;
+    uint32_t   pdns_export_seconds;
+    int        pdns_export;
+    nn_queue_t pdns_nn_queue;
+    
+    char*    mdb_path;
+    uint64_t mdb_map_size;
+    int      mdb_reuse;
+    int      mdb_is_loaded;
     MDB_env* mdb_env;
+    MDB_dbi  meta_dbi;
     MDB_dbi  ip4_dbi;
     MDB_dbi  ip6_dbi;
     MDB_dbi  domain_dbi;
+    MDB_dbi  host_dbi;
     MDB_dbi  url_dbi;
     MDB_dbi  email_dbi;
+    MDB_dbi  md5_dbi;
+    MDB_dbi  sha1_dbi;
+    MDB_dbi  sha256_dbi;
+    MDB_dbi  expire_dbi;
 } __rte_cache_aligned;
 
 typedef struct ss_conf_s ss_conf_t;
@@ -73,6 +110,15 @@ uint64_t ss_conf_tsc_hz_get(void);
 char* ss_conf_file_read(char* conf_path);
 int ss_conf_network_parse(json_object* items);
 int ss_conf_dpdk_parse(json_object* items);
+int ss_conf_ioc_update_parse(json_object* items);
+int ss_conf_ioc_suppress_parse(json_object* items);
+int ss_conf_ioc_stats_parse(json_object* items);
+int ss_conf_passive_dns_parse(json_object* items);
+int ss_conf_dns_stats_parse(json_object* items);
+int ss_conf_tcp_sockets_parse(json_object* items);
+int ss_conf_tcp_streams_parse(json_object* items);
+int ss_conf_tcp_buffers_parse(json_object* items);
+int ss_conf_mdb_parse(json_object* items);
 int ss_conf_mdb_init(void);
 ss_conf_t* ss_conf_file_parse(char* conf_path);
 
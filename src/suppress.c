@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <jemalloc/jemalloc.h>
+
+#include <rte_cycles.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+
+#include "suppress.h"
+
+#include "common.h"
+#include "metadata.h"
+#include "sdn_sensor.h"
+
+static ss_suppress_table_t ss_suppress_tables[RTE_MAX_LCORE];
+
+/*
+ * Repeated IOC hits between the same two hosts would otherwise produce one
+ * record per frame. The first hit of a window is sent right away, the rest
+ * are counted, and a summary with the counts goes out when the window ends.
+ */
+
+int ss_suppress_init() {
+    unsigned int lcore_id;
+    uint32_t buckets;
+
+    if (ss_conf->suppress_seconds == 0) return 0;
+
+    /* power of 2 buckets, so the bucket is just the low signature bits */
+    buckets = 1;
+    while (buckets * SS_SUPPRESS_WAYS < ss_conf->suppress_entries) buckets <<= 1;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_suppress_table_t* table = &ss_suppress_tables[lcore_id];
+        table->entries = je_calloc(buckets * SS_SUPPRESS_WAYS, sizeof(ss_suppress_entry_t));
+        if (table->entries == NULL) {
+            RTE_LOG(ERR, IOC, "could not allocate suppression cache for lcore %u\n", lcore_id);
+            goto error_out;
+        }
+        table->mask          = buckets - 1;
+        table->window_cycles = ss_conf->suppress_seconds * rte_get_tsc_hz();
+    }
+
+    RTE_LOG(NOTICE, IOC, "suppress repeated ioc hits for %u secs, %u entries per lcore\n",
+        ss_conf->suppress_seconds, buckets * SS_SUPPRESS_WAYS);
+    return 0;
+
+    error_out:
+    ss_suppress_destroy();
+    return -1;
+}
+
+static void ss_suppress_flush(ss_suppress_table_t* table, ss_suppress_entry_t* sptr, uint64_t now) {
+    uint8_t* metadata;
+    uint64_t hz = rte_get_tsc_hz();
+    time_t wall = time(NULL);
+    time_t first_seen = wall - (time_t) ((now - sptr->first_tsc) / hz);
+    time_t last_seen  = wall - (time_t) ((now - sptr->last_tsc)  / hz);
+
+    metadata = ss_metadata_prepare_suppress(sptr->key.source, sptr->key.rule,
+        sptr->nn_queue, sptr, first_seen, last_seen);
+    if (metadata == NULL) {
+        RTE_LOG(ERR, IOC, "could not prepare summary for ioc id %lu\n", sptr->key.ioc_id);
+        return;
+    }
+    // XXX: for now assume the output is C char*
+    ss_nn_queue_send(sptr->nn_queue, metadata, (uint16_t) strlen((char*) metadata));
+    je_free(metadata);
+    ++table->summaries;
+}
+
+/*
+ * Returns 1 when the caller should send its record for this hit, 0 when
+ * the hit was counted toward the next summary instead.
+ */
+int ss_suppress_hit(const char* source, const char* rule, nn_queue_t* nn_queue, ss_ioc_entry_t* iptr, uint8_t family, const uint8_t* sip, const uint8_t* dip, uint64_t bytes) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_suppress_table_t* table;
+    ss_suppress_entry_t* bucket;
+    ss_suppress_entry_t* victim = NULL;
+    ss_suppress_key_t key;
+    uint32_t signature;
+    uint64_t now;
+
+    if (lcore_id >= RTE_MAX_LCORE) return 1;
+    table = &ss_suppress_tables[lcore_id];
+    if (table->entries == NULL) return 1;
+
+    /* zeroed first, so the padding compares equal too */
+    memset(&key, 0, sizeof(key));
+    key.ioc_id  = iptr->id;
+    key.file_id = iptr->file_id;
+    key.source  = source;
+    key.rule    = rule;
+    key.family  = family;
+    memcpy(key.sip, sip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN);
+    memcpy(key.dip, dip, family == SS_AF_INET6 ? IPV6_ALEN : IPV4_ALEN);
+
+    /* 0 marks an empty way */
+    signature = rte_hash_crc(&key, sizeof(key), SS_SUPPRESS_HASH_INIT) | 1;
+    bucket    = &table->entries[(signature & table->mask) * SS_SUPPRESS_WAYS];
+    now       = rte_rdtsc();
+
+    for (int i = 0; i < SS_SUPPRESS_WAYS; ++i) {
+        ss_suppress_entry_t* sptr = &bucket[i];
+        if (sptr->signature == signature && !memcmp(&sptr->key, &key, sizeof(key))) {
+            if (now - sptr->window_tsc < table->window_cycles) {
+                ++sptr->hits;
+                sptr->bytes   += bytes;
+                sptr->last_tsc = now;
+                ++table->suppressed;
+                return 0;
+            }
+            /* window ran out before the timer got to it */
+            if (sptr->hits) ss_suppress_flush(table, sptr, now);
+            sptr->window_tsc = now;
+            sptr->last_tsc   = now;
+            sptr->hits       = 0;
+            sptr->bytes      = 0;
+            return 1;
+        }
+        if (sptr->signature == 0) {
+            if (victim == NULL || victim->signature) victim = sptr;
+        }
+        else if (victim == NULL || (victim->signature && sptr->last_tsc < victim->last_tsc)) {
+            victim = sptr;
+        }
+    }
+
+    /* bucket full, the least recently hit stream gives up its way */
+    if (victim->signature) {
+        if (victim->hits) ss_suppress_flush(table, victim, now);
+        ++table->evictions;
+    }
+
+    /* memcpy, not assignment, which need not copy the zeroed padding */
+    memcpy(&victim->key, &key, sizeof(key));
+    victim->signature  = signature;
+    victim->first_tsc  = now;
+    victim->window_tsc = now;
+    victim->last_tsc   = now;
+    victim->hits       = 0;
+    victim->bytes      = 0;
+    victim->nn_queue   = nn_queue;
+
+    return 1;
+}
+
+/*
+ * Sends a summary for each window that ended with suppressed hits, and
+ * starts the next window. Quiet streams are dropped, so their next hit is
+ * sent right away again.
+ */
+void ss_suppress_timer_callback(unsigned int lcore_id) {
+    ss_suppress_table_t* table = &ss_suppress_tables[lcore_id];
+    ss_suppress_entry_t* sptr;
+    uint64_t now;
+    uint32_t count;
+
+    if (table->entries == NULL) return;
+
+    now   = rte_rdtsc();
+    count = (table->mask + 1) * SS_SUPPRESS_WAYS;
+    for (uint32_t i = 0; i < count; ++i) {
+        sptr = &table->entries[i];
+        if (sptr->signature == 0) continue;
+        if (now - sptr->window_tsc < table->window_cycles) continue;
+        if (sptr->hits == 0) {
+            sptr->signature = 0;
+            continue;
+        }
+        ss_suppress_flush(table, sptr, now);
+        sptr->window_tsc = now;
+        sptr->hits       = 0;
+        sptr->bytes      = 0;
+    }
+}
+
+void ss_suppress_destroy() {
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) {
+        if (ss_suppress_tables[i].entries) {
+            je_free(ss_suppress_tables[i].entries);
+        }
+        memset(&ss_suppress_tables[i], 0, sizeof(ss_suppress_tables[i]));
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef __SUPPRESS_H__
+#define __SUPPRESS_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include <rte_memory.h>
+
+#include "ioc.h"
+#include "ip_utils.h"
+#include "nn_queue.h"
+
+/* CONSTANTS */
+
+#define SS_SUPPRESS_WAYS               8
+#define SS_SUPPRESS_ENTRIES         4096
+#define SS_SUPPRESS_HASH_INIT 0x85ebca6b
+
+/* DATA TYPES */
+
+/*
+ * One stream of repeated hits: the same indicator between the same two
+ * addresses, from the same source and rule. source and rule are compared
+ * by address, they always point at constants or at chain entries.
+ */
+struct ss_suppress_key_s {
+    uint64_t    ioc_id;
+    uint64_t    file_id;
+    const char* source;
+    const char* rule;
+    uint8_t     family;
+    uint8_t     sip[IPV6_ALEN];
+    uint8_t     dip[IPV6_ALEN];
+};
+
+typedef struct ss_suppress_key_s ss_suppress_key_t;
+
+/*
+ * hits and bytes count what was held back since the window_tsc the current
+ * window began, first_tsc is the first hit of the stream. The indicator is
+ * only known by the ids in the key, the tables may be swapped before the
+ * summary, and the first record already carried the rest of it.
+ */
+struct ss_suppress_entry_s {
+    ss_suppress_key_t key;
+    uint32_t       signature;
+    uint64_t       first_tsc;
+    uint64_t       window_tsc;
+    uint64_t       last_tsc;
+    uint64_t       hits;
+    uint64_t       bytes;
+    nn_queue_t*    nn_queue;
+};
+
+typedef struct ss_suppress_entry_s ss_suppress_entry_t;
+
+/*
+ * Per lcore set associative cache, SS_SUPPRESS_WAYS entries per bucket,
+ * only ever touched by its own lcore.
+ */
+struct ss_suppress_table_s {
+    uint32_t mask;
+    uint64_t window_cycles;
+    uint64_t suppressed;
+    uint64_t summaries;
+    uint64_t evictions;
+    ss_suppress_entry_t* entries;
+} __rte_cache_aligned;
+
+typedef struct ss_suppress_table_s ss_suppress_table_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_suppress_init(void);
+int ss_suppress_hit(const char* source, const char* rule, nn_queue_t* nn_queue, ss_ioc_entry_t* iptr, uint8_t family, const uint8_t* sip, const uint8_t* dip, uint64_t bytes);
+void ss_suppress_timer_callback(unsigned int lcore_id);
+void ss_suppress_destroy(void);
+
+/* END PROTOTYPES */
+
+#endif /* __SUPPRESS_H__ */
@@ -0,0 +1,261 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "syslog_parse.h"
+
+/*
+ * Splits the header of an RFC 5424 or RFC 3164 message into views of the
+ * payload. Anything which does not look like either is left whole in
+ * message, so a rule scoped to the message still sees it.
+ */
+
+ss_syslog_field_t ss_syslog_field_load(const char* field) {
+    if (!strcasecmp(field, "all"))             return SS_SYSLOG_FIELD_ALL;
+    if (!strcasecmp(field, "message"))         return SS_SYSLOG_FIELD_MESSAGE;
+    if (!strcasecmp(field, "hostname"))        return SS_SYSLOG_FIELD_HOSTNAME;
+    if (!strcasecmp(field, "app_name"))        return SS_SYSLOG_FIELD_APP_NAME;
+    if (!strcasecmp(field, "msgid"))           return SS_SYSLOG_FIELD_MSGID;
+    if (!strcasecmp(field, "structured_data")) return SS_SYSLOG_FIELD_STRUCTURED_DATA;
+    return (ss_syslog_field_t) -1;
+}
+
+const char* ss_syslog_format_dump(ss_syslog_format_t format) {
+    switch (format) {
+        case SS_SYSLOG_FORMAT_RFC3164: return "rfc3164";
+        case SS_SYSLOG_FORMAT_RFC5424: return "rfc5424";
+        default:                       return "unknown";
+    }
+}
+
+static inline void ss_syslog_view_set(ss_syslog_view_t* view, const char* data, uint16_t start, uint16_t end) {
+    view->data   = data + start;
+    view->length = (uint16_t) (end - start);
+}
+
+static inline int ss_syslog_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* "<" 1 to 3 digits ">", at most 191 */
+static int ss_syslog_pri_parse(ss_syslog_t* slog, const char* p, uint16_t length, uint16_t* offset) {
+    uint16_t i = 1;
+    int pri = 0;
+
+    if (length < 3 || p[0] != '<') return -1;
+    while (i < length && i <= 3 && ss_syslog_is_digit(p[i])) {
+        pri = pri * 10 + (p[i] - '0');
+        ++i;
+    }
+    if (i == 1 || i >= length || p[i] != '>' || pri > SS_SYSLOG_PRI_MAX) return -1;
+
+    slog->pri      = (int16_t) pri;
+    slog->facility = (uint8_t) (pri >> 3);
+    slog->severity = (uint8_t) (pri & 0x07);
+    *offset = (uint16_t) (i + 1);
+    return 0;
+}
+
+/* one space delimited RFC 5424 header field, "-" is left empty */
+static int ss_syslog_token_parse(ss_syslog_view_t* view, const char* p, uint16_t length, uint16_t* offset, uint16_t max) {
+    uint16_t start = *offset;
+    uint16_t end   = start;
+
+    while (end < length && p[end] != ' ') ++end;
+    if (end == start || end - start > max || end == length) return -1;
+    if (end - start != 1 || p[start] != '-') ss_syslog_view_set(view, p, start, end);
+    *offset = (uint16_t) (end + 1);
+    return 0;
+}
+
+/*
+ * "-", or one or more [id param="value" ...] elements. Inside the quotes
+ * '\' escapes '"', '\' and ']', so only the quotes are tracked.
+ */
+static int ss_syslog_sd_parse(ss_syslog_t* slog, const char* p, uint16_t length, uint16_t* offset) {
+    uint16_t start = *offset;
+    uint16_t i     = start;
+
+    if (i < length && p[i] == '-') {
+        *offset = (uint16_t) (i + 1);
+        return 0;
+    }
+    while (i < length && p[i] == '[') {
+        int is_quoted = 0;
+        for (++i; i < length; ++i) {
+            if (is_quoted && p[i] == '\\') ++i;
+            else if (p[i] == '"')          is_quoted = !is_quoted;
+            else if (!is_quoted && p[i] == ']') break;
+        }
+        if (i >= length) return -1;
+        ++i;
+    }
+    if (i == start) return -1;
+
+    ss_syslog_view_set(&slog->structured_data, p, start, i);
+    *offset = i;
+    return 0;
+}
+
+static int ss_syslog_rfc5424_parse(ss_syslog_t* slog, const char* p, uint16_t length, uint16_t offset) {
+    uint16_t i = offset;
+
+    // VERSION is 1 or 2 digits, not starting with 0
+    if (i >= length || !ss_syslog_is_digit(p[i]) || p[i] == '0') return -1;
+    ++i;
+    if (i < length && ss_syslog_is_digit(p[i])) ++i;
+    if (i >= length || p[i] != ' ') return -1;
+    ++i;
+
+    if (ss_syslog_token_parse(&slog->timestamp, p, length, &i, length))                 return -1;
+    if (ss_syslog_token_parse(&slog->hostname,  p, length, &i, SS_SYSLOG_HOSTNAME_MAX)) return -1;
+    if (ss_syslog_token_parse(&slog->app_name,  p, length, &i, SS_SYSLOG_APP_NAME_MAX)) return -1;
+    if (ss_syslog_token_parse(&slog->procid,    p, length, &i, SS_SYSLOG_PROCID_MAX))   return -1;
+    if (ss_syslog_token_parse(&slog->msgid,     p, length, &i, SS_SYSLOG_MSGID_MAX))    return -1;
+    if (ss_syslog_sd_parse(slog, p, length, &i))                                        return -1;
+
+    if (i < length) {
+        if (p[i] != ' ') return -1;
+        ++i;
+        // a UTF-8 BOM marks the message as UTF-8, but is not part of it
+        if (length - i >= 3 && !memcmp(p + i, "\xef\xbb\xbf", 3)) i = (uint16_t) (i + 3);
+    }
+    ss_syslog_view_set(&slog->message, p, i, length);
+    slog->format = SS_SYSLOG_FORMAT_RFC5424;
+    return 0;
+}
+
+/* "Mmm dd hh:mm:ss", where a day below 10 has a leading space */
+static int ss_syslog_rfc3164_timestamp_parse(const char* p, uint16_t length, uint16_t offset) {
+    const char* ts = p + offset;
+
+    if (length - offset < SS_SYSLOG_RFC3164_TS_SIZE + 1) return -1;
+    if (ts[3] != ' ' || ts[6] != ' ' || ts[9] != ':' || ts[12] != ':' || ts[15] != ' ') return -1;
+    if (!ss_syslog_is_digit(ts[5]) || !ss_syslog_is_digit(ts[7]) || !ss_syslog_is_digit(ts[8])) return -1;
+    return 0;
+}
+
+/*
+ * TAG, up to 48 characters, maybe a [procid], and ':'. Leaves offset
+ * alone and returns -1 if the text there is not a tag.
+ */
+static int ss_syslog_tag_parse(ss_syslog_t* slog, const char* p, uint16_t length, uint16_t* offset) {
+    uint16_t start = *offset;
+    uint16_t i     = start;
+    uint16_t tag_end;
+    ss_syslog_view_t procid = { NULL, 0 };
+
+    while (i < length && i - start <= SS_SYSLOG_APP_NAME_MAX && p[i] != '[' && p[i] != ':' && p[i] != ' ') ++i;
+    if (i == start || i - start > SS_SYSLOG_APP_NAME_MAX || i == length || p[i] == ' ') return -1;
+    tag_end = i;
+
+    if (p[i] == '[') {
+        uint16_t procid_start = ++i;
+        while (i < length && i - procid_start <= SS_SYSLOG_PROCID_MAX && p[i] != ']') ++i;
+        if (i == length || p[i] != ']') return -1;
+        ss_syslog_view_set(&procid, p, procid_start, i);
+        ++i;
+        if (i < length && p[i] == ':') ++i;
+    }
+    else {
+        ++i;
+    }
+    if (i < length && p[i] == ' ') ++i;
+
+    ss_syslog_view_set(&slog->app_name, p, start, tag_end);
+    slog->procid = procid;
+    *offset = i;
+    return 0;
+}
+
+static int ss_syslog_rfc3164_parse(ss_syslog_t* slog, const char* p, uint16_t length, uint16_t offset) {
+    uint16_t i = offset;
+
+    // without a timestamp everything after PRI is the message
+    if (ss_syslog_rfc3164_timestamp_parse(p, length, i) == 0) {
+        ss_syslog_view_set(&slog->timestamp, p, i, (uint16_t) (i + SS_SYSLOG_RFC3164_TS_SIZE));
+        i = (uint16_t) (i + SS_SYSLOG_RFC3164_TS_SIZE + 1);
+
+        // a local sender leaves out HOSTNAME, so the first word can be the tag
+        if (ss_syslog_tag_parse(slog, p, length, &i)) {
+            uint16_t start = i;
+            while (i < length && p[i] != ' ') ++i;
+            if (i > start && i - start <= SS_SYSLOG_HOSTNAME_MAX && i < length) {
+                ss_syslog_view_set(&slog->hostname, p, start, i);
+                ++i;
+                ss_syslog_tag_parse(slog, p, length, &i);
+            }
+            else {
+                i = start;
+            }
+        }
+    }
+
+    ss_syslog_view_set(&slog->message, p, i, length);
+    slog->format = SS_SYSLOG_FORMAT_RFC3164;
+    return 0;
+}
+
+/*
+ * Fills in slog from the length bytes at data. Returns 0 when a header was
+ * found, -1 when slog only has the whole payload in all and message.
+ */
+int ss_syslog_parse(ss_syslog_t* slog, const uint8_t* data, uint16_t length) {
+    const char* p = (const char*) data;
+    uint16_t offset = 0;
+
+    memset(slog, 0, sizeof(*slog));
+    slog->pri = -1;
+
+    // senders end messages with any of these, and UDP adds a NUL here
+    while (length && (p[length - 1] == '\n' || p[length - 1] == '\r' || p[length - 1] == '\0')) --length;
+    ss_syslog_view_set(&slog->all,     p, 0, length);
+    ss_syslog_view_set(&slog->message, p, 0, length);
+
+    if (ss_syslog_pri_parse(slog, p, length, &offset)) return -1;
+    if (ss_syslog_rfc5424_parse(slog, p, length, offset) == 0) return 0;
+
+    // a failed RFC 5424 header leaves fields behind
+    slog->timestamp = slog->hostname = slog->app_name = slog->procid = slog->msgid =
+        slog->structured_data = (ss_syslog_view_t) { NULL, 0 };
+    return ss_syslog_rfc3164_parse(slog, p, length, offset);
+}
+
+ss_syslog_view_t* ss_syslog_field_get(ss_syslog_t* slog, ss_syslog_field_t field) {
+    switch (field) {
+        case SS_SYSLOG_FIELD_MESSAGE:         return &slog->message;
+        case SS_SYSLOG_FIELD_HOSTNAME:        return &slog->hostname;
+        case SS_SYSLOG_FIELD_APP_NAME:        return &slog->app_name;
+        case SS_SYSLOG_FIELD_MSGID:           return &slog->msgid;
+        case SS_SYSLOG_FIELD_STRUCTURED_DATA: return &slog->structured_data;
+        default:                              return &slog->all;
+    }
+}
+
+/*
+ * Returns the first LF or NUL in the length bytes at data, the message
+ * trailers of RFC 6587 3.4.2 seen in practice, or NULL if there is none.
+ * The SSE2 loop checks 16 bytes per iteration for either one.
+ */
+const uint8_t* ss_syslog_delimiter_find(const uint8_t* data, size_t length) {
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i lf  = _mm_set1_epi8('\n');
+    const __m128i nul = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (data + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, nul)));
+        if (mask) return data + i + __builtin_ctz((unsigned int) mask);
+    }
+#endif
+    for (; i < length; ++i) {
+        if (data[i] == '\n' || data[i] == '\0') return data + i;
+    }
+    return NULL;
+}
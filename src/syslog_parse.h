@@ -0,0 +1,78 @@
+#ifndef __SYSLOG_PARSE_H__
+#define __SYSLOG_PARSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CONSTANTS */
+
+#define SS_SYSLOG_PRI_MAX         191
+#define SS_SYSLOG_HOSTNAME_MAX    255
+#define SS_SYSLOG_APP_NAME_MAX     48
+#define SS_SYSLOG_PROCID_MAX      128
+#define SS_SYSLOG_MSGID_MAX        32
+#define SS_SYSLOG_RFC3164_TS_SIZE  15 /* "Mmm dd hh:mm:ss" */
+
+enum ss_syslog_format_e {
+    SS_SYSLOG_FORMAT_EMPTY   = 0, /* not a syslog header, message is everything */
+    SS_SYSLOG_FORMAT_RFC3164 = 1,
+    SS_SYSLOG_FORMAT_RFC5424 = 2,
+};
+
+typedef enum ss_syslog_format_e ss_syslog_format_t;
+
+/* the part of a message a re_chain rule runs against */
+enum ss_syslog_field_e {
+    SS_SYSLOG_FIELD_ALL             = 0,
+    SS_SYSLOG_FIELD_MESSAGE         = 1,
+    SS_SYSLOG_FIELD_HOSTNAME        = 2,
+    SS_SYSLOG_FIELD_APP_NAME        = 3,
+    SS_SYSLOG_FIELD_MSGID           = 4,
+    SS_SYSLOG_FIELD_STRUCTURED_DATA = 5,
+    SS_SYSLOG_FIELD_MAX,
+};
+
+typedef enum ss_syslog_field_e ss_syslog_field_t;
+
+/* DATA TYPES */
+
+/* a piece of the payload, not NUL terminated, empty when length is 0 */
+struct ss_syslog_view_s {
+    const char* data;
+    uint16_t    length;
+};
+
+typedef struct ss_syslog_view_s ss_syslog_view_t;
+
+/*
+ * The header fields of one message, as views into the payload, so
+ * parsing neither copies nor allocates. A "-" NILVALUE is left empty.
+ */
+struct ss_syslog_s {
+    ss_syslog_format_t format;
+    int16_t pri;      /* -1 without one */
+    uint8_t facility;
+    uint8_t severity;
+    ss_syslog_view_t all;
+    ss_syslog_view_t timestamp;
+    ss_syslog_view_t hostname;
+    ss_syslog_view_t app_name;
+    ss_syslog_view_t procid;
+    ss_syslog_view_t msgid;
+    ss_syslog_view_t structured_data;
+    ss_syslog_view_t message;
+};
+
+typedef struct ss_syslog_s ss_syslog_t;
+
+/* BEGIN PROTOTYPES */
+
+ss_syslog_field_t ss_syslog_field_load(const char* field);
+const char* ss_syslog_format_dump(ss_syslog_format_t format);
+int ss_syslog_parse(ss_syslog_t* slog, const uint8_t* data, uint16_t length);
+ss_syslog_view_t* ss_syslog_field_get(ss_syslog_t* slog, ss_syslog_field_t field);
+const uint8_t* ss_syslog_delimiter_find(const uint8_t* data, size_t length);
+
+/* END PROTOTYPES */
+
+#endif /* __SYSLOG_PARSE_H__ */
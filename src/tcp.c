@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -14,77 +15,396 @@
 #include <rte_hexdump.h>
 #include <rte_lcore.h>
 #include <rte_log.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 #include <rte_random.h>
-#include <rte_rwlock.h>
 
 #include "tcp.h"
 
 #include "checksum.h"
 #include "common.h"
+#include "dns_parse.h"
 #include "ethernet.h"
 #include "extractor.h"
 #include "je_utils.h"
 #include "l4_utils.h"
 #include "sdn_sensor.h"
+#include "syslog_parse.h"
+#include "tcp_buffer.h"
+#include "tcp_stream.h"
+#include "timer_wheel.h"
 
-// XXX: how can I place a TCP hash on each socket?
-static struct rte_hash_parameters tcp_hash_params = {
-    .name               = "tcp_hash_socket_0",
-    .entries            = L4_TCP_HASH_SIZE,
-    .bucket_entries     = L4_TCP_BUCKET_SIZE,
-    .key_len            = sizeof(ss_flow_key_t),
-    .hash_func          = rte_hash_crc,
-    .hash_func_init_val = 0,
-    .socket_id          = 0,
-};
-
-static rte_rwlock_t tcp_hash_lock;
-static rte_hash_t* tcp_hash;
-static ss_tcp_socket_t* tcp_sockets[L4_TCP_HASH_SIZE];
+static ss_tcp_table_t tcp_tables[RTE_MAX_LCORE];
+
+// SYN and RST rate limits per source, per lcore
+static ss_tcp_syn_limit_t* tcp_syn_limits[RTE_MAX_LCORE];
+
+// keys the SYN cookies; nothing is gained by rotating it, since the time
+// counter in each cookie already limits how long it is valid
+static uint64_t tcp_cookie_secret;
+
+static rte_hash_t* ss_tcp_hash_create(const char* prefix, unsigned int lcore_id, uint32_t key_len) {
+    char hash_name[32];
+    struct rte_hash_parameters hash_params = {
+        .name               = hash_name,
+        .entries            = ss_conf->tcp_socket_entries,
+        .bucket_entries     = L4_TCP_BUCKET_SIZE,
+        .key_len            = key_len,
+        .hash_func          = rte_hash_crc,
+        .hash_func_init_val = 0,
+        .socket_id          = (int) rte_lcore_to_socket_id(lcore_id),
+    };
+    
+    snprintf(hash_name, sizeof(hash_name), "%s_lcore_%02u", prefix, lcore_id);
+    return rte_hash_create(&hash_params);
+}
 
 int ss_tcp_init() {
-    rte_rwlock_init(&tcp_hash_lock);
+    unsigned int lcore_id;
+    size_t sockets_size = ss_conf->tcp_socket_entries * sizeof(ss_tcp_socket_t*);
+    
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_tcp_table_t* table = &tcp_tables[lcore_id];
+        int socket_id = (int) rte_lcore_to_socket_id(lcore_id);
+        
+        table->hash4    = ss_tcp_hash_create("tcp4_hash", lcore_id, sizeof(ss_tcp_key4_t));
+        table->hash6    = ss_tcp_hash_create("tcp6_hash", lcore_id, sizeof(ss_tcp_key6_t));
+        table->sockets4 = rte_zmalloc_socket("tcp4_sockets", sockets_size, RTE_CACHE_LINE_SIZE, socket_id);
+        table->sockets6 = rte_zmalloc_socket("tcp6_sockets", sockets_size, RTE_CACHE_LINE_SIZE, socket_id);
+        if (table->hash4 == NULL || table->hash6 == NULL || table->sockets4 == NULL || table->sockets6 == NULL) {
+            RTE_LOG(ERR, L3L4, "could not initialize tcp socket table for lcore %u\n", lcore_id);
+            return -1;
+        }
+        // one second ticks; the timeouts are whole seconds
+        ss_wheel_init(&table->wheel, rte_get_tsc_hz(), rte_rdtsc());
+        
+        tcp_syn_limits[lcore_id] = rte_zmalloc_socket("tcp_syn_limits",
+            SS_TCP_SYN_SOURCES * sizeof(ss_tcp_syn_limit_t), RTE_CACHE_LINE_SIZE, socket_id);
+        if (tcp_syn_limits[lcore_id] == NULL) {
+            RTE_LOG(ERR, L3L4, "could not allocate tcp syn limits for lcore %u\n", lcore_id);
+            return -1;
+        }
+    }
+    tcp_cookie_secret = rte_rand();
+    
+    RTE_LOG(NOTICE, L3L4, "tcp socket tables of %u ipv4 and ipv6 entries per lcore, idle timeout %u secs, %u syns per sec per source, %u out of order mbufs per lcore\n",
+        ss_conf->tcp_socket_entries, ss_conf->tcp_idle_seconds, ss_conf->tcp_syn_rate, ss_conf->tcp_ooo_max);
+    return ss_tcp_buffer_init();
+}
+
+/* fills in the table key for key, and returns the hash and sockets it goes in */
+static rte_hash_t* ss_tcp_table_key_get(ss_tcp_table_t* table, ss_flow_key_t* key, ss_tcp_key_t* tcp_key,
+    ss_tcp_socket_t*** sockets) {
+    if (key->protocol == L4_TCP4) {
+        rte_memcpy(tcp_key->key4.sip, key->sip, IPV4_ALEN);
+        rte_memcpy(tcp_key->key4.dip, key->dip, IPV4_ALEN);
+        tcp_key->key4.sport = key->sport;
+        tcp_key->key4.dport = key->dport;
+        *sockets = table->sockets4;
+        return table->hash4;
+    }
+    rte_memcpy(tcp_key->key6.sip, key->sip, IPV6_ALEN);
+    rte_memcpy(tcp_key->key6.dip, key->dip, IPV6_ALEN);
+    tcp_key->key6.sport = key->sport;
+    tcp_key->key6.dport = key->dport;
+    *sockets = table->sockets6;
+    return table->hash6;
+}
+
+/* when socket expires, counted from its last segment either way */
+static uint64_t ss_tcp_socket_deadline(ss_tcp_socket_t* socket) {
+    return SS_MAX(socket->rx_ticks, socket->tx_ticks) + (uint64_t) ss_conf->tcp_idle_seconds * rte_get_tsc_hz();
+}
+
+/*
+ * Segments only update rx_ticks and tx_ticks, rather than moving the timer
+ * each time, so a busy socket costs one reschedule per timeout here.
+ */
+static void ss_tcp_socket_expire(ss_wheel_timer_t* timer, void* data) {
+    ss_tcp_socket_t* socket = timer->data;
+    int* expired_sockets = data;
+    uint64_t deadline = ss_tcp_socket_deadline(socket);
+    
+    if (deadline > rte_rdtsc()) {
+        ss_wheel_add(&tcp_tables[rte_lcore_id()].wheel, timer, deadline);
+        return;
+    }
+    ss_tcp_socket_delete(&socket->key);
+    ++*expired_sockets;
+}
+
+/*
+ * Only looks at the sockets whose timers came due, at most
+ * SS_TCP_EXPIRE_BUDGET of them per call, so it runs every drain tick
+ * without a full table scan.
+ */
+int ss_tcp_timer_callback(unsigned int lcore_id) {
+    int expired_sockets = 0;
+    ss_tcp_table_t* table = &tcp_tables[lcore_id];
+    
+    if (table->sockets4 == NULL) return 0;
+    
+    ss_wheel_advance(&table->wheel, rte_rdtsc(), ss_tcp_socket_expire, &expired_sockets, SS_TCP_EXPIRE_BUDGET);
+    if (expired_sockets) {
+        RTE_LOG(INFO, L3L4, "deleted %d expired tcp sockets on lcore %u, %lu tcp buffer evictions so far\n",
+            expired_sockets, lcore_id, ss_tcp_buffer_evictions_get());
+    }
+    return 0;
+}
+
+/* TCP payload length from the IP header, so Ethernet padding is left out */
+static uint16_t ss_tcp_data_length(ss_frame_t* rx_buf, uint16_t hdr_length) {
+    int length;
+    int available;
+    
+    if (rx_buf->data.eth_type == ETHER_TYPE_IPV4) {
+        length = rte_bswap16(rx_buf->ip4->tot_len) - 4 * rx_buf->ip4->ihl - hdr_length;
+    }
+    else {
+        // anything between the fixed IPv6 header and TCP is extension headers
+        length = rte_bswap16(rx_buf->ip6->ip6_plen) - hdr_length -
+            (int) ((uint8_t*) rx_buf->tcp - (uint8_t*) rx_buf->ip6 - sizeof(ip6_hdr_t));
+    }
+    // never past the end of the frame
+    available = (int) rx_buf->data.l4_length + (int) sizeof(tcp_hdr_t) - hdr_length;
+    length    = SS_MIN(length, available);
+    return length < 0 ? 0 : (uint16_t) length;
+}
+
+/* how much of a segment at seq is past rx_seq, moving data up to it */
+static inline uint16_t ss_tcp_segment_trim(ss_tcp_socket_t* socket, uint32_t seq, uint8_t** data, uint16_t length) {
+    int32_t overlap = (int32_t) (socket->rx_seq - seq);
+    
+    if (overlap <= 0) return length;
+    if (overlap >= length) return 0;
+    *data += overlap;
+    return (uint16_t) (length - overlap);
+}
+
+/*
+ * Hands the next length bytes of the stream to the framing layer. Queued
+ * segments come with the rx_buf of the segment which filled the gap, which
+ * is the same connection, so the metadata comes out the same.
+ */
+static void ss_tcp_deliver(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    socket->rx_seq += length;
+    
+    switch (rx_buf->data.dport) {
+        case L4_PORT_DNS: {
+            RTE_LOG(DEBUG, L3L4, "rx tcp dns packet\n");
+            ss_tcp_extract_dns(&socket->dns_framing, &socket->rx_buffer, rx_buf, data, length);
+            break;
+        }
+        case L4_PORT_SYSLOG: {
+            RTE_LOG(DEBUG, L3L4, "rx tcp syslog packet\n");
+            ss_tcp_extract_syslog(socket, rx_buf, data, length);
+            break;
+        }
+        case L4_PORT_SYSLOG_TCP: {
+            RTE_LOG(DEBUG, L3L4, "rx tcp syslog-conn packet\n");
+            ss_tcp_extract_syslog(socket, rx_buf, data, length);
+            break;
+        }
+        case L4_PORT_NETFLOW_1:
+        case L4_PORT_NETFLOW_2:
+        case L4_PORT_NETFLOW_3: {
+            RTE_LOG(DEBUG, L3L4, "rx tcp NetFlow packet\n");
+            break;
+        }
+    }
+}
+
+/* delivers the queued segments which the stream has caught up with */
+static void ss_tcp_ooo_drain(ss_tcp_socket_t* socket, ss_frame_t* rx_buf) {
+    ss_tcp_segment_t* segment = &socket->ooo_segments[0];
+    uint8_t* data;
+    uint16_t length;
+    
+    while (socket->ooo_count && (int32_t) (segment->seq - socket->rx_seq) <= 0) {
+        data   = segment->data;
+        length = ss_tcp_segment_trim(socket, segment->seq, &data, segment->length);
+        if (length) ss_tcp_deliver(socket, rx_buf, data, length);
+        else        ++socket->retransmitted;
+        rte_pktmbuf_free(segment->mbuf);
+        --tcp_tables[rte_lcore_id()].ooo_held;
+        --socket->ooo_count;
+        memmove(segment, segment + 1, socket->ooo_count * sizeof(ss_tcp_segment_t));
+    }
+}
 
-    tcp_hash = rte_hash_create(&tcp_hash_params);
-    if (tcp_hash == NULL) {
-        RTE_LOG(ERR, L3L4, "could not initialize tcp socket hash\n");
+/*
+ * Holds a segment which arrived ahead of a gap, in seq order, by taking
+ * a reference on its mbuf, so nothing is copied. Overlaps between queued
+ * segments are trimmed when they are delivered. The mbufs come out of
+ * the RX pool, so an lcore holds at most tcp_ooo_max of them; past that
+ * the segment is dropped, and the sender retransmits it after the gap.
+ */
+static int ss_tcp_ooo_queue(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint32_t seq, uint8_t* data, uint16_t length) {
+    ss_tcp_table_t* table = &tcp_tables[rte_lcore_id()];
+    uint32_t window = (uint32_t) L4_TCP_WINDOW_SIZE << L4_TCP_WINDOW_SHIFT;
+    int i;
+    
+    if (socket->ooo_count == L4_TCP_OOO_SEGMENTS || table->ooo_held >= ss_conf->tcp_ooo_max ||
+        seq - socket->rx_seq >= window) {
+        RTE_LOG(DEBUG, L3L4, "rx tcp out of order segment dropped, seq: %u expected: %u\n", seq, socket->rx_seq);
+        ++socket->dropped;
         return -1;
     }
     
-    memset(tcp_sockets, 0, sizeof(tcp_sockets));
+    for (i = 0; i < socket->ooo_count && (int32_t) (socket->ooo_segments[i].seq - seq) <= 0; ++i) {
+        if (socket->ooo_segments[i].seq == seq && socket->ooo_segments[i].length >= length) {
+            ++socket->retransmitted;
+            return 0;
+        }
+    }
+    memmove(&socket->ooo_segments[i + 1], &socket->ooo_segments[i],
+        (size_t) (socket->ooo_count - i) * sizeof(ss_tcp_segment_t));
+    rte_mbuf_refcnt_update(rx_buf->mbuf, 1);
+    socket->ooo_segments[i] = (ss_tcp_segment_t) { rx_buf->mbuf, data, seq, length };
+    ++socket->ooo_count;
+    ++socket->ooo_queued;
+    ++table->ooo_held;
+    return 0;
+}
+
+/*
+ * Delivers the payload of rx_buf to the framing layer in stream order:
+ * data seen before is trimmed off, data past a gap waits in the queue
+ * until the gap is filled, and filling it delivers the queue as well.
+ */
+static int ss_tcp_receive(ss_tcp_socket_t* socket, ss_frame_t* rx_buf) {
+    uint32_t seq    = rte_bswap32(rx_buf->tcp->seq);
+    uint8_t* data   = rx_buf->l4_offset;
+    uint16_t length = rx_buf->data.l4_length;
+    
+    if (length == 0) return 0;
+    if (!socket->has_rx_seq) {
+        // joined mid-stream without the SYN, so start with what is here
+        socket->rx_seq     = seq;
+        socket->has_rx_seq = 1;
+    }
+    
+    if ((int32_t) (seq - socket->rx_seq) > 0) {
+        RTE_LOG(DEBUG, L3L4, "rx tcp out of order segment, seq: %u expected: %u\n", seq, socket->rx_seq);
+        return ss_tcp_ooo_queue(socket, rx_buf, seq, data, length);
+    }
+    
+    length = ss_tcp_segment_trim(socket, seq, &data, length);
+    if (length == 0) {
+        RTE_LOG(DEBUG, L3L4, "rx tcp retransmitted segment skipped, seq: %u\n", seq);
+        ++socket->retransmitted;
+        return 0;
+    }
     
+    RTE_LOG(FINE, L3L4, "rx tcp data packet\n");
+    ss_tcp_deliver(socket, rx_buf, data, length);
+    ss_tcp_ooo_drain(socket, rx_buf);
     return 0;
 }
 
-int ss_tcp_timer_callback() {
-    uint64_t expired_ticks = rte_rdtsc() - (rte_get_tsc_hz() * L4_TCP_EXPIRED_SECONDS);
-    int expired_sockets = 0;
-    ss_tcp_socket_t* socket;
-
-    rte_rwlock_write_lock(&tcp_hash_lock);
-    for (int i = 0; i < L4_TCP_HASH_SIZE; ++i) {
-        socket = tcp_sockets[i];
-        if (!socket) continue;
-        if (socket->rx_ticks < expired_ticks &&
-            socket->tx_ticks < expired_ticks) {
-            rte_spinlock_recursive_lock(&socket->lock);
-            ss_tcp_socket_delete(&socket->key, 1);
-            rte_spinlock_recursive_unlock(&socket->lock);
-            ++expired_sockets;
+/*
+ * The cookie for a connection: a time counter in the top bits, which
+ * moves every SS_TCP_COOKIE_SECONDS, and a hash of the connection, the
+ * peer's ISN, the counter and the secret in the rest.
+ * XXX: CRC32 is not a MAC, so a peer which sees many cookies could forge
+ * more; it does keep blind spoofing at 1 in 2^27 per try.
+ */
+static uint32_t ss_tcp_cookie_get(ss_flow_key_t* key, uint32_t peer_isn, uint32_t count) {
+    uint32_t alen = key->protocol == L4_TCP4 ? IPV4_ALEN : IPV6_ALEN;
+    uint32_t hash = (uint32_t) tcp_cookie_secret;
+    
+    count &= (1 << SS_TCP_COOKIE_COUNT_BITS) - 1;
+    hash = rte_hash_crc(key->sip, alen, hash);
+    hash = rte_hash_crc(key->dip, alen, hash);
+    hash = rte_hash_crc_4byte((uint32_t) key->sport << 16 | key->dport, hash);
+    hash = rte_hash_crc_4byte(peer_isn, hash);
+    hash = rte_hash_crc_4byte(count, hash ^ (uint32_t) (tcp_cookie_secret >> 32));
+    return count << (32 - SS_TCP_COOKIE_COUNT_BITS) | (hash >> SS_TCP_COOKIE_COUNT_BITS);
+}
+
+static inline uint32_t ss_tcp_cookie_count(void) {
+    return (uint32_t) (rte_rdtsc() / (rte_get_tsc_hz() * SS_TCP_COOKIE_SECONDS));
+}
+
+/* 0 if the ACK in rx_buf returns a cookie from this or the last period */
+static int ss_tcp_cookie_check(ss_flow_key_t* key, ss_frame_t* rx_buf) {
+    uint32_t cookie   = rte_bswap32(rx_buf->tcp->ack_seq) - 1;
+    uint32_t peer_isn = rte_bswap32(rx_buf->tcp->seq) - 1;
+    uint32_t count    = ss_tcp_cookie_count();
+    
+    if (cookie == ss_tcp_cookie_get(key, peer_isn, count))     return 0;
+    if (cookie == ss_tcp_cookie_get(key, peer_isn, count - 1)) return 0;
+    return -1;
+}
+
+/*
+ * 0 if the source of key may have another SYN-ACK or RST. A source
+ * missing from its set takes over the least recently used bucket there,
+ * tokens and all, so sources which share a set cannot refill each other
+ * by taking turns, and a busy one only evicts a quiet one.
+ */
+static int ss_tcp_syn_limit(ss_flow_key_t* key) {
+    uint32_t alen   = key->protocol == L4_TCP4 ? IPV4_ALEN : IPV6_ALEN;
+    uint32_t source = rte_hash_crc(key->sip, alen, 0);
+    uint64_t tsc    = rte_rdtsc();
+    uint64_t hz     = rte_get_tsc_hz();
+    uint64_t refill;
+    uint32_t set_id = source & (SS_TCP_SYN_SOURCES / SS_TCP_SYN_WAYS - 1);
+    ss_tcp_syn_limit_t* set   = &tcp_syn_limits[rte_lcore_id()][set_id * SS_TCP_SYN_WAYS];
+    ss_tcp_syn_limit_t* limit = &set[0];
+    
+    for (int i = 0; i < SS_TCP_SYN_WAYS; ++i) {
+        if (set[i].source == source) {
+            limit = &set[i];
+            break;
         }
+        if (set[i].tsc < limit->tsc) limit = &set[i];
     }
-    rte_rwlock_write_unlock(&tcp_hash_lock);
+    limit->source = source;
     
-    RTE_LOG(NOTICE, L3L4, "deleted %d expired tcp sockets\n", expired_sockets);
+    if (tsc - limit->tsc >= hz) {
+        // quiet long enough to have a full bucket
+        limit->tokens = ss_conf->tcp_syn_rate;
+        limit->tsc    = tsc;
+    }
+    else {
+        refill = (tsc - limit->tsc) * ss_conf->tcp_syn_rate / hz;
+        if (refill) {
+            limit->tokens = (uint32_t) SS_MIN(ss_conf->tcp_syn_rate, limit->tokens + refill);
+            limit->tsc   += refill * hz / ss_conf->tcp_syn_rate;
+        }
+    }
+    
+    if (limit->tokens == 0) return -1;
+    --limit->tokens;
     return 0;
 }
 
+/*
+ * A segment of no connection. A SYN gets a SYN-ACK carrying a cookie
+ * instead of a socket, so a SYN flood costs no memory; the socket is made
+ * when an ACK returns a valid cookie. Anything else gets a RST, so a
+ * sender which lost its connection opens a new one.
+ */
+static int ss_tcp_handle_listen(ss_flow_key_t* key, ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
+    uint8_t tcp_flags = rx_buf->tcp->th_flags;
+    
+    if (tcp_flags & TH_RST) return 0;
+    if (ss_tcp_syn_limit(key)) {
+        RTE_LOG(DEBUG, L3L4, "rx tcp segment of no connection over source rate limit\n");
+        return 0;
+    }
+    if (tcp_flags == TH_SYN) {
+        RTE_LOG(FINE, L3L4, "rx tcp syn packet\n");
+        return ss_tcp_handle_open(key, rx_buf, tx_buf);
+    }
+    RTE_LOG(DEBUG, L3L4, "rx tcp segment of no connection, flags: %s\n", ss_tcp_flags_dump(tcp_flags));
+    return ss_tcp_handle_reset(rx_buf, tx_buf);
+}
+
 int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     int rv = 0;
     
-    SS_CHECK_SELF(rx_buf, 0);    
-    
     ss_flow_key_t key;
     memset(&key, 0, sizeof(key));
 
@@ -104,7 +424,7 @@ int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     
     // tcp_data_len must be based on ip_total_len or padding will be included
     // adjust L4 data to account for TCP options
-    uint16_t tcp_data_len  = rte_bswap16(rx_buf->ip4->tot_len) - sizeof(ip4_hdr_t) - hdr_length;
+    uint16_t tcp_data_len  = ss_tcp_data_length(rx_buf, hdr_length);
     rx_buf->l4_offset      = (uint8_t*) rx_buf->tcp + hdr_length;
     rx_buf->data.l4_length = tcp_data_len;
 
@@ -129,8 +449,27 @@ int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     RTE_LOG(DEBUG, L3L4, "rx tcp packet: sport: %hu dport: %hu seq: %u ack: %u hlen: %hu dlen: %hu flags: %s wsize: %hu\n",
         sport, dport, seq, ack_seq, hdr_length, rx_buf->data.l4_length, ss_tcp_flags_dump(tcp_flags), wsize);
 
+    // streams between other hosts are only followed, never answered
+    if (!rx_buf->data.self) {
+        return ss_tcp_stream_handle(rx_buf, &key, seq, tcp_flags);
+    }
+
+    /*    
+     * C: SYN
+     * S: SYN, ACK (cookie)
+     * C: ACK (cookie + 1), which makes the socket
+     */
+
     ss_tcp_socket_t* socket     = ss_tcp_socket_lookup(&key);
+    if (socket && tcp_flags == TH_SYN) {
+        // the peer reused the ports, so the old connection is gone
+        ss_tcp_socket_delete(&key);
+        socket = NULL;
+    }
     if (socket == NULL) {
+        if (!(tcp_flags & TH_ACK) || (tcp_flags & (TH_SYN | TH_RST)) || ss_tcp_cookie_check(&key, rx_buf)) {
+            return ss_tcp_handle_listen(&key, rx_buf, tx_buf);
+        }
         socket = ss_tcp_socket_create(&key, rx_buf);
     }
     if (unlikely(socket == NULL)) {
@@ -138,33 +477,22 @@ int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
         return -1;
     }
     
-    rte_spinlock_recursive_lock(&socket->lock);
     ss_tcp_prepare_rx(rx_buf, socket);
-    uint32_t curr_seq = 0;
-
-    /*    
-     * C: SYN
-     * S: SYN, ACK
-     * C: ACK
-     */
 
     if      (tcp_flags & TH_RST) {
         RTE_LOG(FINE, L3L4, "rx tcp rst packet\n");
         // just delete the connection
-        rv = ss_tcp_handle_close(socket, rx_buf, tx_buf);
+        return ss_tcp_handle_close(socket, rx_buf, tx_buf);
     }
     else if (tcp_flags & TH_FIN) {
         // send RST (as if SO_LINGER is 0) and delete the connection
         RTE_LOG(FINE, L3L4, "rx tcp fin packet\n");
-        rv = ss_tcp_handle_close(socket, rx_buf, tx_buf);
-    }
-    else if (tcp_flags == TH_SYN) {
-        RTE_LOG(FINE, L3L4, "rx tcp syn packet\n");
-        rv = ss_tcp_handle_open(socket, rx_buf, tx_buf);
+        ss_tcp_receive(socket, rx_buf);
+        return ss_tcp_handle_close(socket, rx_buf, tx_buf);
     }
     else if (tcp_flags & TH_ACK || tcp_flags == 0) {
         RTE_LOG(FINE, L3L4, "rx tcp ack packet\n");
-        rv = ss_tcp_handle_update(socket, rx_buf, tx_buf, &curr_seq);
+        rv = ss_tcp_handle_update(socket, rx_buf, tx_buf);
     }
     else {
         RTE_LOG(ERR, L3L4, "unknown tcp flags: %s\n",
@@ -172,112 +500,207 @@ int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
         rv = -1;
     }
     
-    // check for stale packets
-    if (socket->state != SS_TCP_SYN_RX && curr_seq < socket->last_ack_seq) {
-        RTE_LOG(DEBUG, L3L4, "rx tcp stale skipped packet\n");
-        goto out;
-    }
-    else if (rx_buf->data.l4_length == 0) {
-        RTE_LOG(FINE, L3L4, "rx tcp control packet\n");
-        goto out;
-    }
-    else {
-        RTE_LOG(FINE, L3L4, "rx tcp data packet\n");
-    }
+    return rv;
+}
 
-    switch (rx_buf->data.dport) {
-        case L4_PORT_DNS: {
-            RTE_LOG(DEBUG, L3L4, "rx tcp dns packet\n");
-            break;
+static int ss_tcp_extract_syslog_delimited(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_tcp_buffer_t* buffer = &socket->rx_buffer;
+    const uint8_t* end;
+    uint16_t count;
+    
+    while (length) {
+        end = ss_syslog_delimiter_find(data, length);
+        if (end == NULL) {
+            // the rest of the message is in later segments
+            ss_tcp_buffer_append(buffer, data, length);
+            if (ss_tcp_buffer_is_full(buffer)) {
+                char message[256];
+                snprintf(message, sizeof(message), "syslog_tcp: truncate message at %hu bytes due to buffer limit",
+                    buffer->length);
+                ss_flow_key_dump(message, &socket->key);
+                // XXX: check return value
+                ss_extract_syslog("tcp_syslog", rx_buf, ss_tcp_buffer_data(buffer), buffer->length);
+                ss_tcp_buffer_release(buffer);
+            }
+            return 0;
         }
-        case L4_PORT_SYSLOG: {
-            RTE_LOG(DEBUG, L3L4, "rx tcp syslog packet\n");
-            ss_tcp_extract_syslog(socket, rx_buf);
-            break;
+        
+        count = (uint16_t) (end - data);
+        if (buffer->is_discarding) {
+            // the start of this message was evicted, so drop its tail
+            ss_tcp_buffer_release(buffer);
         }
-        case L4_PORT_SYSLOG_TCP: {
-            RTE_LOG(DEBUG, L3L4, "rx tcp syslog-conn packet\n");
-            ss_tcp_extract_syslog(socket, rx_buf);
-            break;
+        else if (buffer->length == 0) {
+            // whole in this segment, so match it in place; skip empty lines
+            if (count) ss_extract_syslog("tcp_syslog", rx_buf, data, count);
         }
-        case L4_PORT_NETFLOW_1:
-        case L4_PORT_NETFLOW_2:
-        case L4_PORT_NETFLOW_3: {
-            RTE_LOG(DEBUG, L3L4, "rx tcp NetFlow packet\n");
-            break;
+        else {
+            ss_tcp_buffer_append(buffer, data, count);
+            ss_extract_syslog("tcp_syslog", rx_buf, ss_tcp_buffer_data(buffer), buffer->length);
+            ss_tcp_buffer_release(buffer);
         }
+        data   += count + 1;
+        length -= count + 1;
     }
     
-    out:
-    rte_spinlock_recursive_unlock(&socket->lock);
-
-    return rv;
+    return 0;
 }
 
-int ss_tcp_extract_syslog(ss_tcp_socket_t* socket, ss_frame_t* rx_buf) {
-    int    rv    = 0;
-    size_t len   = 0;
-    char*  c     = (char*) rx_buf->l4_offset;
-    char*  limit = (char*) (rx_buf->l4_offset + rx_buf->data.l4_length);
-    char*  next  = (char*) rx_buf->l4_offset;
+static int ss_tcp_extract_syslog_counted(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_syslog_framing_t* framing = &socket->syslog_framing;
+    ss_tcp_buffer_t* buffer = &socket->rx_buffer;
+    uint16_t count;
     
-    if (rte_get_log_level() >= RTE_LOG_FINEST) {
-        RTE_LOG(FINEST, L3L4, "dump tcp syslog segment:\n");
-        rte_pktmbuf_dump(stderr, rx_buf->mbuf, rte_pktmbuf_pkt_len(rx_buf->mbuf));
-    }
-    
-    while (c < limit) {
-        if (*c == '\n') {
-            // append to existing rx_data
-            len = (size_t) SS_MIN((uint8_t*) c - rx_buf->l4_offset, (long) sizeof(socket->rx_data) - socket->rx_length);
-            RTE_LOG(FINER, L3L4, "syslog_tcp: copy %zu bytes to rx_data from %hu to %hu due to delimiter\n",
-                len, socket->rx_length, (uint16_t) (socket->rx_length + len));
-            rte_memcpy((uint8_t*) (socket->rx_data + socket->rx_length), (uint8_t*) rx_buf->l4_offset, len);
-            socket->rx_length += len;
-            socket->rx_data[socket->rx_length + 1]  = '\0';
-
-            //ss_buffer_dump("delimited message", socket->rx_data, socket->rx_length);
-            // process full message, XXX: check return value
-            rv = ss_extract_syslog("tcp_syslog", rx_buf, socket->rx_data, socket->rx_length);
-
-            // mark new message start
-            socket->rx_length = 0;
-            next = c + 1;
+    while (length) {
+        if (!framing->in_message) {
+            // MSG-LEN is NONZERO-DIGIT *DIGIT, then SP
+            if (*data >= '0' && *data <= '9' && framing->digits < L4_TCP_SYSLOG_DIGITS_MAX &&
+                (framing->digits || *data != '0')) {
+                framing->expected = framing->expected * 10 + (uint32_t) (*data - '0');
+                ++framing->digits;
+                ++data; --length;
+                continue;
+            }
+            if (*data == ' ' && framing->digits) {
+                framing->in_message = 1;
+                framing->seen       = 0;
+                ss_tcp_buffer_release(buffer);
+                ++data; --length;
+                continue;
+            }
+            ss_flow_key_dump("syslog_tcp: bad octet count, switch to delimited framing", &socket->key);
+            memset(framing, 0, sizeof(*framing));
+            framing->mode = SS_SYSLOG_FRAMING_DELIMITED;
+            return ss_tcp_extract_syslog_delimited(socket, rx_buf, data, length);
+        }
+        
+        count = (uint16_t) SS_MIN(length, framing->expected - framing->seen);
+        if (count == framing->expected) {
+            ss_extract_syslog("tcp_syslog", rx_buf, data, count);
+        }
+        else {
+            ss_tcp_buffer_append(buffer, data, count);
+            if (framing->seen + count == framing->expected && buffer->is_discarding) {
+                RTE_LOG(DEBUG, L3L4, "syslog_tcp: drop %u byte message evicted from buffer\n", framing->expected);
+            }
+            else if (framing->seen + count == framing->expected) {
+                if (framing->expected > buffer->length) {
+                    RTE_LOG(INFO, L3L4, "syslog_tcp: match first %hu of %u message bytes\n",
+                        buffer->length, framing->expected);
+                }
+                if (buffer->length) ss_extract_syslog("tcp_syslog", rx_buf, ss_tcp_buffer_data(buffer), buffer->length);
+            }
+        }
+        
+        framing->seen += count;
+        data          += count;
+        length        -= count;
+        if (framing->seen == framing->expected) {
+            framing->in_message = 0;
+            framing->expected   = 0;
+            framing->digits     = 0;
+            ss_tcp_buffer_release(buffer);
         }
-        ++c;
     }
+    
+    return 0;
+}
 
-    if (next < limit) {
-        len = (size_t) SS_MIN(limit - next, (long) sizeof(socket->rx_data) - socket->rx_length);
-        RTE_LOG(FINER, L3L4, "syslog_tcp: copy %zu bytes to rx_data from %hu to %hu due to segment end\n",
-            len, socket->rx_length, (uint16_t) (socket->rx_length + len));
-        rte_memcpy((uint8_t*) (socket->rx_data + socket->rx_length), (uint8_t*) next, len);
-        socket->rx_length += len;
-        socket->rx_data[socket->rx_length + 1]  = '\0';
+/*
+ * Splits a syslog over TCP stream into messages, octet counted or LF / NUL
+ * delimited per RFC 6587, whichever the first byte of the stream shows. A
+ * message which arrives whole in one segment is matched in place in the
+ * mbuf; otherwise it is gathered into rx_buffer, and only its first
+ * tcp_buffer_max bytes are kept.
+ */
+int ss_tcp_extract_syslog(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_syslog_framing_t* framing = &socket->syslog_framing;
+    
+    if (rte_get_log_level() >= RTE_LOG_FINEST) {
+        rte_hexdump(stderr, "dump tcp syslog data", data, length);
     }
+    if (length == 0) return 0;
     
-    if (socket->rx_length >= L4_TCP_BUFFER_SIZE) {
-        char message[256];
-        snprintf(message, sizeof(message), "syslog_tcp: truncate message at %hu bytes due to buffer limit",
-            socket->rx_length);
-        ss_flow_key_dump(message, &socket->key);
-
-        //ss_buffer_dump("truncated message", socket->rx_data, socket->rx_length);
-        // process full message, XXX: check return value
-        rv = ss_extract_syslog("tcp_syslog", rx_buf, socket->rx_data, socket->rx_length);
+    if (framing->mode == SS_SYSLOG_FRAMING_UNKNOWN) {
+        // a delimited message starts with "<PRI>", a counted one with MSG-LEN
+        framing->mode = *data >= '1' && *data <= '9' ? SS_SYSLOG_FRAMING_OCTET_COUNT : SS_SYSLOG_FRAMING_DELIMITED;
+        RTE_LOG(FINE, L3L4, "syslog_tcp: stream uses framing mode %d\n", framing->mode);
+    }
+    
+    if (framing->mode == SS_SYSLOG_FRAMING_OCTET_COUNT) {
+        return ss_tcp_extract_syslog_counted(socket, rx_buf, data, length);
+    }
+    return ss_tcp_extract_syslog_delimited(socket, rx_buf, data, length);
+}
 
-        // mark new message start
-        socket->rx_length = 0;
+/*
+ * Splits a DNS over TCP stream into messages, whatever the segment
+ * boundaries. A message which arrives whole in one segment is parsed in
+ * place; otherwise it is gathered into buffer, and only its first
+ * tcp_buffer_max bytes are kept.
+ */
+int ss_tcp_extract_dns(ss_dns_framing_t* framing, ss_tcp_buffer_t* buffer,
+    ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    uint16_t count;
+    
+    while (length) {
+        if (framing->prefix_length < SS_DNS_TCP_PREFIX_SIZE) {
+            framing->prefix[framing->prefix_length++] = *data++;
+            --length;
+            if (framing->prefix_length < SS_DNS_TCP_PREFIX_SIZE) continue;
+            framing->expected = (uint16_t) (framing->prefix[0] << 8 | framing->prefix[1]);
+            framing->seen     = 0;
+            ss_tcp_buffer_release(buffer);
+            if (framing->expected == 0) framing->prefix_length = 0;
+            continue;
+        }
+        
+        count = (uint16_t) SS_MIN(length, framing->expected - framing->seen);
+        if (count == framing->expected) {
+            ss_extract_dns(rx_buf, data, count);
+        }
+        else {
+            ss_tcp_buffer_append(buffer, data, count);
+            if (framing->seen + count == framing->expected && buffer->is_discarding) {
+                RTE_LOG(DEBUG, L3L4, "tcp dns: drop %hu byte message evicted from buffer\n", framing->expected);
+            }
+            else if (framing->seen + count == framing->expected) {
+                if (framing->expected > buffer->length) {
+                    RTE_LOG(INFO, L3L4, "tcp dns: parse first %hu of %hu message bytes\n",
+                        buffer->length, framing->expected);
+                }
+                if (buffer->length) ss_extract_dns(rx_buf, ss_tcp_buffer_data(buffer), buffer->length);
+            }
+        }
+        
+        framing->seen += count;
+        data          += count;
+        length        -= count;
+        if (framing->seen == framing->expected) {
+            framing->prefix_length = 0;
+            ss_tcp_buffer_release(buffer);
+        }
     }
     
     return 0;
 }
 
+/*
+ * The pool ran dry and this socket was the idle one whose partial message
+ * went, so the connection goes as well; the sender gets a reset on its
+ * next segment and reconnects.
+ */
+static void ss_tcp_socket_evict(ss_tcp_buffer_t* buffer) {
+    ss_tcp_socket_t* socket = (ss_tcp_socket_t*) ((uint8_t*) buffer - offsetof(ss_tcp_socket_t, rx_buffer));
+    
+    ss_tcp_socket_delete(&socket->key);
+}
+
 int ss_tcp_socket_init(ss_flow_key_t* key, ss_tcp_socket_t* socket) {
     memset(socket, 0, sizeof(ss_tcp_socket_t));
     rte_memcpy(&socket->key, key, sizeof(ss_flow_key_t));
-    rte_spinlock_recursive_init(&socket->lock);
     socket->state = SS_TCP_CLOSED;
+    socket->rx_buffer.evict_cb = ss_tcp_socket_evict;
     return 0;
 }
 
@@ -291,23 +714,26 @@ ss_tcp_socket_t* ss_tcp_socket_create(ss_flow_key_t* key, ss_frame_t* rx_buf) {
     
     ss_tcp_socket_init(key, socket);
 
-    if (rx_buf->tcp->th_flags == TH_SYN) {
-        socket->state = SS_TCP_SYN_RX;
-    }
-    else {
-        socket->state = SS_TCP_UNKNOWN;
-    }
+    // made from the ACK which ended the handshake, whose seq is where the
+    // peer's stream starts
+    socket->state      = SS_TCP_OPEN;
+    socket->rx_seq     = rte_bswap32(rx_buf->tcp->seq);
+    socket->has_rx_seq = 1;
     
-    rte_rwlock_write_lock(&tcp_hash_lock);
-    int32_t socket_id = rte_hash_add_key(tcp_hash, key);
+    ss_tcp_key_t tcp_key;
+    ss_tcp_socket_t** sockets;
+    rte_hash_t* hash = ss_tcp_table_key_get(&tcp_tables[rte_lcore_id()], key, &tcp_key, &sockets);
+    int32_t socket_id = rte_hash_add_key(hash, &tcp_key);
     socket->id = (uint64_t) socket_id;
     if (socket_id >= 0) {
-        tcp_sockets[socket->id] = socket;
+        sockets[socket->id] = socket;
+        socket->rx_ticks    = rte_rdtsc();
+        socket->timer.data  = socket;
+        ss_wheel_add(&tcp_tables[rte_lcore_id()].wheel, &socket->timer, ss_tcp_socket_deadline(socket));
     }
     else {
         is_error = 1;
     }
-    rte_rwlock_write_unlock(&tcp_hash_lock);
 
     RTE_LOG(INFO, L3L4, "new tcp socket: sport: %hu dport: %hu id: %lu is_error: %d\n",
         rte_bswap16(key->sport), rte_bswap16(key->dport), socket->id, is_error);
@@ -322,29 +748,41 @@ ss_tcp_socket_t* ss_tcp_socket_create(ss_flow_key_t* key, ss_frame_t* rx_buf) {
     return socket;
 }
 
-int ss_tcp_socket_delete(ss_flow_key_t* key, int is_locked) {
+int ss_tcp_socket_delete(ss_flow_key_t* key) {
+    ss_tcp_key_t tcp_key;
+    ss_tcp_socket_t** sockets;
+    
     ss_flow_key_dump("delete socket for key", key);
 
-    if (likely(!is_locked)) rte_rwlock_write_lock(&tcp_hash_lock);
-    int32_t socket_id = rte_hash_del_key(tcp_hash, key);
-    ss_tcp_socket_t* socket = ((int32_t) socket_id) < 0 ? NULL : tcp_sockets[socket_id];
-    if (likely(!is_locked)) rte_rwlock_write_unlock(&tcp_hash_lock);
+    rte_hash_t* hash = ss_tcp_table_key_get(&tcp_tables[rte_lcore_id()], key, &tcp_key, &sockets);
+    int32_t socket_id = rte_hash_del_key(hash, &tcp_key);
+    ss_tcp_socket_t* socket = ((int32_t) socket_id) < 0 ? NULL : sockets[socket_id];
 
     if (!socket) return -1;
     
+    if (socket->ooo_queued || socket->retransmitted || socket->dropped) {
+        RTE_LOG(INFO, L3L4, "tcp socket id: %d out of order: %u retransmitted: %u dropped: %u\n",
+            socket_id, socket->ooo_queued, socket->retransmitted, socket->dropped);
+    }
     socket->state = SS_TCP_CLOSED;
+    for (int i = 0; i < socket->ooo_count; ++i) rte_pktmbuf_free(socket->ooo_segments[i].mbuf);
+    tcp_tables[rte_lcore_id()].ooo_held -= socket->ooo_count;
+    ss_wheel_remove(&socket->timer);
+    ss_tcp_buffer_release(&socket->rx_buffer);
     je_free(socket);
-    tcp_sockets[socket_id] = NULL;
+    sockets[socket_id] = NULL;
 
     return 0;
 }
 
 ss_tcp_socket_t* ss_tcp_socket_lookup(ss_flow_key_t* key) {
+    ss_tcp_key_t tcp_key;
+    ss_tcp_socket_t** sockets;
+    
     ss_flow_key_dump("find socket for key", key);
-    rte_rwlock_read_lock(&tcp_hash_lock);
-    int32_t socket_id = rte_hash_lookup(tcp_hash, key);
-    rte_rwlock_read_unlock(&tcp_hash_lock);
-    ss_tcp_socket_t* socket = ((int32_t) socket_id) < 0 ? NULL : tcp_sockets[socket_id];
+    rte_hash_t* hash = ss_tcp_table_key_get(&tcp_tables[rte_lcore_id()], key, &tcp_key, &sockets);
+    int32_t socket_id = rte_hash_lookup(hash, &tcp_key);
+    ss_tcp_socket_t* socket = ((int32_t) socket_id) < 0 ? NULL : sockets[socket_id];
     if (socket) {
         RTE_LOG(DEBUG, L3L4, "found socket at id: %u\n", socket_id);
     }
@@ -382,7 +820,7 @@ int ss_tcp_prepare_tx(ss_frame_t* tx_buf, ss_tcp_socket_t* socket, ss_tcp_state_
     return 0;
 }
 
-uint16_t ss_tcp_rx_mss_get(ss_tcp_socket_t* socket) {
+uint16_t ss_tcp_rx_mss_get() {
     uint16_t ip_hdr_max = SS_MAX(sizeof(ip4_hdr_t), sizeof(ip6_hdr_t));
     return ss_conf->mtu - ip_hdr_max - sizeof(tcp_hdr_t);
 }
@@ -416,10 +854,48 @@ int ss_tcp_handle_close(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t*
     
     shutdown_only:
     ss_tcp_prepare_tx(tx_buf, socket, SS_TCP_CLOSED);
-    return ss_tcp_socket_delete(&socket->key, 0);
+    return ss_tcp_socket_delete(&socket->key);
+}
+
+/* answers a segment of no connection with a RST, as RFC 793 3.4 has it */
+int ss_tcp_handle_reset(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
+    int rv = 0;
+    
+    rv = ss_frame_prepare_tcp(rx_buf, tx_buf);
+    if (rv) {
+        RTE_LOG(ERR, L3L4, "could not prepare tcp tx_mbuf, error: %d\n", rv);
+        return -1;
+    }
+    
+    if (rx_buf->tcp->th_flags & TH_ACK) {
+        tx_buf->tcp->seq      = rx_buf->tcp->ack_seq;
+        tx_buf->tcp->ack_seq  = 0;
+        tx_buf->tcp->th_flags = TH_RST;
+    }
+    else {
+        // the SYN and FIN flags take up a sequence number each
+        uint32_t length = rx_buf->data.l4_length +
+            !!(rx_buf->tcp->th_flags & TH_SYN) + !!(rx_buf->tcp->th_flags & TH_FIN);
+        tx_buf->tcp->seq      = 0;
+        tx_buf->tcp->ack_seq  = rte_bswap32(rte_bswap32(rx_buf->tcp->seq) + length);
+        tx_buf->tcp->th_flags = TH_RST | TH_ACK;
+    }
+    tx_buf->tcp->doff     = L4_TCP_HEADER_OFFSET;
+    tx_buf->tcp->window   = 0;
+    tx_buf->tcp->check    = rte_bswap16(0x0000);
+    tx_buf->tcp->urg_ptr  = rte_bswap16(0x0000);
+    
+    rv = ss_tcp_prepare_checksum(tx_buf);
+    if (rv) {
+        RTE_LOG(ERR, L3L4, "could not prepare tcp tx_mbuf checksum, error: %d\n", rv);
+        return -1;
+    }
+    
+    return 0;
 }
 
-int ss_tcp_handle_open(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
+/* answers a SYN with a SYN-ACK whose ISN is the cookie, and keeps no state */
+int ss_tcp_handle_open(ss_flow_key_t* key, ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     int rv = 0;
 
     rv = ss_frame_prepare_tcp(rx_buf, tx_buf);
@@ -429,12 +905,12 @@ int ss_tcp_handle_open(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t*
     }
     
     // SYN flag is set. Client is opening connection.
-    // Send back server's initial seq_num.
-    uint32_t rand_seq     = (uint32_t) rte_rand();
-    tx_buf->tcp->seq      = rte_bswap32(rand_seq);
+    // Send back server's initial seq_num, which the ACK returns plus 1.
+    uint32_t peer_isn     = rte_bswap32(rx_buf->tcp->seq);
+    tx_buf->tcp->seq      = rte_bswap32(ss_tcp_cookie_get(key, peer_isn, ss_tcp_cookie_count()));
     // ACK flag is set. Client sent initial seq_num.
     // Send back initial seq_num + 1.
-    tx_buf->tcp->ack_seq  = rte_bswap32(rte_bswap32(rx_buf->tcp->seq) + 1);
+    tx_buf->tcp->ack_seq  = rte_bswap32(peer_isn + 1);
     tx_buf->tcp->doff     = L4_TCP_HEADER_OFFSET + 2; // 1-byte MSS, 1-byte window scale
     tx_buf->tcp->th_flags = TH_SYN | TH_ACK;
     tx_buf->tcp->window   = rte_bswap16(L4_TCP_WINDOW_SIZE);
@@ -447,7 +923,7 @@ int ss_tcp_handle_open(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t*
         return -1;
     }
     // mss: kind 2, length 4, uint16_t mss
-    *tcp_mss              = rte_bswap32(0x0204 << 16 | ss_tcp_rx_mss_get(socket));
+    *tcp_mss              = rte_bswap32(0x0204 << 16 | ss_tcp_rx_mss_get());
 
     uint32_t* win_scale   = (uint32_t*) rte_pktmbuf_append(tx_buf->mbuf, sizeof(uint32_t));
     if (!win_scale) {
@@ -463,36 +939,28 @@ int ss_tcp_handle_open(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t*
         return -1;
     }
     
-    ss_tcp_prepare_tx(tx_buf, socket, SS_TCP_SYN_TX);
-    
     return 0;
 }
 
-int ss_tcp_handle_update(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf, uint32_t* curr_ack_seq_ptr) {
+int ss_tcp_handle_update(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     int rv = 0;
     
     if (socket->state == SS_TCP_CLOSED) return 0;
-
-    uint16_t tcp_data_len  = rte_bswap16(rx_buf->ip4->tot_len) - (4 * rx_buf->tcp->doff) - sizeof(tcp_hdr_t);
-    uint32_t curr_seq      = rx_buf->tcp->ack_seq;
-    uint32_t curr_ack_seq  = rte_bswap32(rx_buf->tcp->seq) + (tcp_data_len ? tcp_data_len : 1);
-
-    if (curr_ack_seq <= socket->last_ack_seq) {
-        socket->last_ack_seq = curr_ack_seq;
-        *curr_ack_seq_ptr = curr_ack_seq;
-        return 0;
-    }
-        
+    // a bare ACK needs no answer
+    if (rx_buf->data.l4_length == 0) return 0;
+    
+    ss_tcp_receive(socket, rx_buf);
+    
     rv = ss_frame_prepare_tcp(rx_buf, tx_buf);
     if (rv) {
         RTE_LOG(ERR, L3L4, "could not prepare tcp tx_mbuf, error: %d\n", rv);
         return -1;
     }
 
-    // XXX: Make the client "happy", and just ACK everything.
-    // This is lossy, but back-pressure on syslog messages is pointless.
-    tx_buf->tcp->seq       = curr_seq;
-    tx_buf->tcp->ack_seq   = rte_bswap32(curr_ack_seq);
+    // ACK up to the first gap, so the peer resends what is missing; the
+    // same ACK again for data past the gap is its fast retransmit signal
+    tx_buf->tcp->seq       = rx_buf->tcp->ack_seq;
+    tx_buf->tcp->ack_seq   = rte_bswap32(socket->rx_seq);
     tx_buf->tcp->doff      = L4_TCP_HEADER_OFFSET;
     tx_buf->tcp->th_flags  = TH_ACK;
     tx_buf->tcp->window    = rte_bswap16(L4_TCP_WINDOW_SIZE);
@@ -507,7 +975,6 @@ int ss_tcp_handle_update(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t
     
     ss_tcp_prepare_tx(tx_buf, socket, SS_TCP_OPEN);
     
-    *curr_ack_seq_ptr = curr_ack_seq;
     return 0;
 }
 
@@ -1,24 +1,96 @@
 #ifndef __TCP_H__
 #define __TCP_H__
 
+#include <stdint.h>
+
+#include <rte_memory.h>
+
 #include "common.h"
+#include "timer_wheel.h"
+
+/* CONSTANTS */
+
+#define SS_TCP_SOCKET_ENTRIES   65536
+#define SS_TCP_IDLE_SECONDS       600
+#define SS_TCP_OOO_MAX            256 /* mbufs held per lcore across all sockets */
+#define SS_TCP_SYN_RATE            64 /* SYNs and RSTs per second per source */
+#define SS_TCP_SYN_SOURCES       1024 /* rate limited sources per lcore */
+#define SS_TCP_SYN_WAYS             4 /* sources per set of the rate limit table */
+#define SS_TCP_COOKIE_SECONDS      64 /* how long a SYN cookie stays valid, at least */
+#define SS_TCP_COOKIE_COUNT_BITS    5 /* of the cookie, the rest is the hash */
+#define SS_TCP_EXPIRE_BUDGET     1024 /* most sockets expired per timer call */
+
+/* DATA TYPES */
+
+/* table keys, so an IPv4 connection hashes 12 bytes, not a whole ss_flow_key_t */
+struct ss_tcp_key4_s {
+    uint8_t  sip[IPV4_ALEN];
+    uint8_t  dip[IPV4_ALEN];
+    uint16_t sport;
+    uint16_t dport;
+} __attribute__((packed));
+
+typedef struct ss_tcp_key4_s ss_tcp_key4_t;
+
+struct ss_tcp_key6_s {
+    uint8_t  sip[IPV6_ALEN];
+    uint8_t  dip[IPV6_ALEN];
+    uint16_t sport;
+    uint16_t dport;
+} __attribute__((packed));
+
+typedef struct ss_tcp_key6_s ss_tcp_key6_t;
+
+union ss_tcp_key_u {
+    ss_tcp_key4_t key4;
+    ss_tcp_key6_t key6;
+};
+
+typedef union ss_tcp_key_u ss_tcp_key_t;
+
+/*
+ * The connections of one lcore. Symmetric RSS hands every segment of a
+ * flow to the same lcore, so nothing else touches the table, and neither
+ * lookups nor updates take a lock.
+ */
+struct ss_tcp_table_s {
+    rte_hash_t* hash4;
+    rte_hash_t* hash6;
+    ss_tcp_socket_t** sockets4;
+    ss_tcp_socket_t** sockets6;
+    ss_wheel_t wheel; /* when each socket is next checked for expiry */
+    uint32_t ooo_held; /* mbufs held by the out of order queues */
+} __rte_cache_aligned;
+
+typedef struct ss_tcp_table_s ss_tcp_table_t;
+
+/* the token bucket of one source, in a set of SS_TCP_SYN_WAYS */
+struct ss_tcp_syn_limit_s {
+    uint32_t source;
+    uint32_t tokens;
+    uint64_t tsc;
+};
+
+typedef struct ss_tcp_syn_limit_s ss_tcp_syn_limit_t;
 
 /* BEGIN PROTOTYPES */
 
 int ss_tcp_init(void);
-int ss_tcp_timer_callback(void);
+int ss_tcp_timer_callback(unsigned int lcore_id);
 int ss_frame_handle_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf);
-int ss_tcp_extract_syslog(ss_tcp_socket_t* socket, ss_frame_t* rx_buf);
+int ss_tcp_extract_syslog(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, uint8_t* data, uint16_t length);
+int ss_tcp_extract_dns(ss_dns_framing_t* framing, ss_tcp_buffer_t* buffer, ss_frame_t* rx_buf, uint8_t* data, uint16_t length);
 int ss_tcp_socket_init(ss_flow_key_t* key, ss_tcp_socket_t* socket);
 ss_tcp_socket_t* ss_tcp_socket_create(ss_flow_key_t* key, ss_frame_t* rx_buf);
-int ss_tcp_socket_delete(ss_flow_key_t* key, int is_locked);
+int ss_tcp_socket_delete(ss_flow_key_t* key);
 ss_tcp_socket_t* ss_tcp_socket_lookup(ss_flow_key_t* key);
 int ss_tcp_prepare_rx(ss_frame_t* rx_buf, ss_tcp_socket_t* socket);
 int ss_tcp_prepare_tx(ss_frame_t* tx_buf, ss_tcp_socket_t* socket, ss_tcp_state_t state);
-uint16_t ss_tcp_rx_mss_get(ss_tcp_socket_t* socket);
+uint16_t ss_tcp_rx_mss_get(void);
 int ss_tcp_handle_close(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf);
-int ss_tcp_handle_open(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf);
-int ss_tcp_handle_update(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf, uint32_t* curr_ack_seq_ptr);
+int ss_tcp_handle_reset(ss_frame_t* rx_buf, ss_frame_t* tx_buf);
+int ss_tcp_handle_open(ss_flow_key_t* key, ss_frame_t* rx_buf, ss_frame_t* tx_buf);
+int ss_tcp_handle_update(ss_tcp_socket_t* socket, ss_frame_t* rx_buf, ss_frame_t* tx_buf);
 int ss_frame_prepare_tcp(ss_frame_t* rx_buf, ss_frame_t* tx_buf);
 int ss_tcp_prepare_checksum(ss_frame_t* tx_buf);
 
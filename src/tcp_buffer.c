@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <bsd/sys/queue.h>
+
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+#include <rte_mempool.h>
+
+#include "tcp_buffer.h"
+
+#include "common.h"
+#include "sdn_sensor.h"
+
+/*
+ * TCP sockets and passively followed streams keep a partial message in
+ * chunks taken from a pool, rather than a fixed array each, so a quiet
+ * connection costs no buffer memory. Each budget has a pool, whose size is
+ * its global cap, and whose per-lcore cache keeps each lcore on chunks of
+ * its own.
+ */
+
+static rte_mempool_t* ss_tcp_chunk_pools[SS_TCP_BUDGET_MAX];
+static ss_tcp_buffer_lcore_t ss_tcp_buffer_lcores[RTE_MAX_LCORE];
+
+static rte_mempool_t* ss_tcp_chunk_pool_create(const char* name, uint64_t pool_bytes) {
+    uint32_t chunk_count = (uint32_t) (pool_bytes / SS_TCP_CHUNK_SIZE);
+    rte_mempool_t* pool;
+
+    pool = rte_mempool_create(name, chunk_count,
+        sizeof(ss_tcp_chunk_t), SS_TCP_CHUNK_CACHE, 0,
+        NULL, NULL, NULL, NULL, (int) rte_socket_id(), 0);
+    if (pool == NULL) {
+        RTE_LOG(ERR, L3L4, "could not create %s of %u chunks\n", name, chunk_count);
+    }
+    return pool;
+}
+
+int ss_tcp_buffer_init() {
+    unsigned int lcore_id;
+
+    ss_tcp_chunk_pools[SS_TCP_BUDGET_SOCKET] = ss_tcp_chunk_pool_create("tcp_chunk_pool", ss_conf->tcp_buffer_pool);
+    ss_tcp_chunk_pools[SS_TCP_BUDGET_STREAM] = ss_tcp_chunk_pool_create("tcp_stream_chunk_pool", ss_conf->tcp_stream_buffer_pool);
+    if (ss_tcp_chunk_pools[SS_TCP_BUDGET_SOCKET] == NULL || ss_tcp_chunk_pools[SS_TCP_BUDGET_STREAM] == NULL) {
+        return -1;
+    }
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_tcp_buffer_lcore_t* buffer_lcore = &ss_tcp_buffer_lcores[lcore_id];
+
+        for (int i = 0; i < SS_TCP_BUDGET_MAX; ++i) TAILQ_INIT(&buffer_lcore->idle_lists[i]);
+        buffer_lcore->linear = rte_zmalloc_socket("tcp_buffer_linear", ss_conf->tcp_buffer_max,
+            RTE_CACHE_LINE_SIZE, (int) rte_lcore_to_socket_id(lcore_id));
+        if (buffer_lcore->linear == NULL) {
+            RTE_LOG(ERR, L3L4, "could not allocate tcp linear buffer for lcore %u\n", lcore_id);
+            return -1;
+        }
+    }
+
+    RTE_LOG(NOTICE, L3L4, "tcp buffers of up to %u bytes from pools of %lu socket and %lu stream chunks\n",
+        ss_conf->tcp_buffer_max, ss_conf->tcp_buffer_pool / SS_TCP_CHUNK_SIZE,
+        ss_conf->tcp_stream_buffer_pool / SS_TCP_CHUNK_SIZE);
+    return 0;
+}
+
+/* gives the chunks of buffer back */
+static void ss_tcp_buffer_free(ss_tcp_buffer_lcore_t* buffer_lcore, ss_tcp_buffer_t* buffer) {
+    ss_tcp_chunk_t* chunk;
+    ss_tcp_chunk_t* next;
+
+    TAILQ_REMOVE(&buffer_lcore->idle_lists[buffer->budget], buffer, entry);
+    for (chunk = buffer->head; chunk; chunk = next) {
+        next = chunk->next;
+        rte_mempool_put(ss_tcp_chunk_pools[buffer->budget], chunk);
+    }
+    buffer->head   = NULL;
+    buffer->tail   = NULL;
+    buffer->length = 0;
+}
+
+/*
+ * Takes a chunk from the pool of the budget of buffer. When it is empty,
+ * the least recently used buffer of this lcore and budget, other than the
+ * one growing, loses its partial message, and the next one after that,
+ * until a chunk comes free. The rest of an evicted message is dropped as
+ * it arrives, and the owner is told, so it can let go of the idle
+ * connection as well.
+ */
+static ss_tcp_chunk_t* ss_tcp_chunk_get(ss_tcp_buffer_lcore_t* buffer_lcore, ss_tcp_buffer_t* buffer) {
+    void* object;
+    ss_tcp_chunk_t* chunk;
+    ss_tcp_buffer_t* victim;
+
+    while (rte_mempool_get(ss_tcp_chunk_pools[buffer->budget], &object) < 0) {
+        victim = TAILQ_FIRST(&buffer_lcore->idle_lists[buffer->budget]);
+        if (victim == buffer) victim = TAILQ_NEXT(victim, entry);
+        if (victim == NULL) return NULL;
+        RTE_LOG(INFO, L3L4, "tcp buffer: evict %hu bytes of idle connection\n", victim->length);
+        ss_tcp_buffer_free(buffer_lcore, victim);
+        victim->is_discarding = 1;
+        ++buffer_lcore->evictions;
+        // the callback may free the owner, and victim with it
+        if (victim->evict_cb) victim->evict_cb(victim);
+    }
+
+    chunk = object;
+    chunk->next   = NULL;
+    chunk->length = 0;
+    return chunk;
+}
+
+/*
+ * Appends what fits under tcp_buffer_max, and returns how much that was.
+ * Less comes back if the pool ran dry with nothing left to evict, and
+ * nothing while the buffer is discarding the rest of an evicted message.
+ */
+uint16_t ss_tcp_buffer_append(ss_tcp_buffer_t* buffer, const uint8_t* data, uint16_t length) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_tcp_buffer_lcore_t* buffer_lcore;
+    ss_tcp_chunk_t* chunk;
+    uint16_t copied = 0;
+    uint16_t count;
+
+    if (lcore_id >= RTE_MAX_LCORE || buffer->is_discarding) return 0;
+    length = (uint16_t) SS_MIN(length, ss_conf->tcp_buffer_max - buffer->length);
+    if (length == 0) return 0;
+
+    // a buffer stays on the list of the lcore which first filled it
+    buffer_lcore = &ss_tcp_buffer_lcores[buffer->head ? buffer->lcore_id : lcore_id];
+    if (buffer->head) {
+        TAILQ_REMOVE(&buffer_lcore->idle_lists[buffer->budget], buffer, entry);
+    }
+    else {
+        buffer->lcore_id = (uint16_t) lcore_id;
+    }
+    // on the list while chunks are taken, so eviction sees a consistent list
+    TAILQ_INSERT_TAIL(&buffer_lcore->idle_lists[buffer->budget], buffer, entry);
+
+    while (copied < length) {
+        chunk = buffer->tail;
+        if (chunk == NULL || chunk->length == SS_TCP_CHUNK_SIZE) {
+            chunk = ss_tcp_chunk_get(buffer_lcore, buffer);
+            if (chunk == NULL) {
+                RTE_LOG(ERR, L3L4, "tcp buffer: could not get chunk, drop %hu bytes\n", (uint16_t) (length - copied));
+                break;
+            }
+            if (buffer->tail) buffer->tail->next = chunk;
+            else              buffer->head       = chunk;
+            buffer->tail = chunk;
+        }
+        count = (uint16_t) SS_MIN(length - copied, SS_TCP_CHUNK_SIZE - chunk->length);
+        rte_memcpy(chunk->data + chunk->length, data + copied, count);
+        chunk->length += count;
+        copied        += count;
+    }
+    buffer->length += copied;
+
+    if (buffer->head == NULL) TAILQ_REMOVE(&buffer_lcore->idle_lists[buffer->budget], buffer, entry);
+
+    return copied;
+}
+
+/*
+ * Returns the buffered bytes in one piece: in place when they fit in one
+ * chunk, else copied into the linear buffer of this lcore, which holds
+ * them until the next call on the same lcore.
+ */
+uint8_t* ss_tcp_buffer_data(ss_tcp_buffer_t* buffer) {
+    unsigned int lcore_id = rte_lcore_id();
+    uint8_t* linear;
+    uint16_t offset = 0;
+
+    if (buffer->head == buffer->tail) return buffer->head ? buffer->head->data : NULL;
+    if (lcore_id >= RTE_MAX_LCORE) return NULL;
+
+    linear = ss_tcp_buffer_lcores[lcore_id].linear;
+    for (ss_tcp_chunk_t* chunk = buffer->head; chunk; chunk = chunk->next) {
+        rte_memcpy(linear + offset, chunk->data, chunk->length);
+        offset += chunk->length;
+    }
+    return linear;
+}
+
+int ss_tcp_buffer_is_full(ss_tcp_buffer_t* buffer) {
+    return buffer->length >= ss_conf->tcp_buffer_max;
+}
+
+/* called between messages, so it also ends any discarding */
+void ss_tcp_buffer_release(ss_tcp_buffer_t* buffer) {
+    buffer->is_discarding = 0;
+    if (buffer->head == NULL) return;
+    ss_tcp_buffer_free(&ss_tcp_buffer_lcores[buffer->lcore_id], buffer);
+}
+
+/* for the expiry log, read from other lcores, so a racy sum is fine */
+uint64_t ss_tcp_buffer_evictions_get() {
+    uint64_t evictions = 0;
+
+    for (int i = 0; i < RTE_MAX_LCORE; ++i) evictions += ss_tcp_buffer_lcores[i].evictions;
+    return evictions;
+}
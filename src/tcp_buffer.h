@@ -0,0 +1,70 @@
+#ifndef __TCP_BUFFER_H__
+#define __TCP_BUFFER_H__
+
+#include <stdint.h>
+
+#include <bsd/sys/queue.h>
+
+#include <rte_memory.h>
+
+#include "common.h"
+
+/* CONSTANTS */
+
+#define SS_TCP_CHUNK_SIZE           512
+#define SS_TCP_CHUNK_CACHE           64
+#define SS_TCP_BUFFER_MAX         16384
+#define SS_TCP_BUFFER_POOL   (64 << 20)
+#define SS_TCP_STREAM_POOL   (16 << 20)
+
+/* DATA TYPES */
+
+/*
+ * Buffers of connections to the sensor and of passively followed streams
+ * take chunks from pools of their own, and only evict their own kind, so
+ * mirror traffic cannot push out the partial messages of syslog senders.
+ */
+enum ss_tcp_buffer_budget_e {
+    SS_TCP_BUDGET_SOCKET = 0,
+    SS_TCP_BUDGET_STREAM = 1,
+    SS_TCP_BUDGET_MAX,
+};
+
+typedef enum ss_tcp_buffer_budget_e ss_tcp_buffer_budget_t;
+
+struct ss_tcp_chunk_s {
+    struct ss_tcp_chunk_s* next;
+    uint16_t length;
+    uint8_t  data[SS_TCP_CHUNK_SIZE];
+};
+
+typedef struct ss_tcp_chunk_s ss_tcp_chunk_t;
+
+TAILQ_HEAD(ss_tcp_buffer_list_s, ss_tcp_buffer_s);
+typedef struct ss_tcp_buffer_list_s ss_tcp_buffer_list_t;
+
+/*
+ * The buffers an lcore filled, least recently used first, so the one idle
+ * the longest gives up its chunks when the pool runs dry. Only the lcore
+ * owning the connections touches it, so it needs no lock.
+ */
+struct ss_tcp_buffer_lcore_s {
+    ss_tcp_buffer_list_t idle_lists[SS_TCP_BUDGET_MAX];
+    uint8_t* linear; /* tcp_buffer_max bytes, for a message spread over chunks */
+    uint64_t evictions;
+} __rte_cache_aligned;
+
+typedef struct ss_tcp_buffer_lcore_s ss_tcp_buffer_lcore_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_tcp_buffer_init(void);
+uint16_t ss_tcp_buffer_append(ss_tcp_buffer_t* buffer, const uint8_t* data, uint16_t length);
+uint8_t* ss_tcp_buffer_data(ss_tcp_buffer_t* buffer);
+int ss_tcp_buffer_is_full(ss_tcp_buffer_t* buffer);
+void ss_tcp_buffer_release(ss_tcp_buffer_t* buffer);
+uint64_t ss_tcp_buffer_evictions_get(void);
+
+/* END PROTOTYPES */
+
+#endif /* __TCP_BUFFER_H__ */
@@ -0,0 +1,444 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_memcpy.h>
+#include <rte_mempool.h>
+
+#include "tcp_stream.h"
+
+#include "common.h"
+#include "extractor.h"
+#include "http_parse.h"
+#include "sdn_sensor.h"
+#include "tcp.h"
+#include "tcp_buffer.h"
+#include "timer_wheel.h"
+
+/*
+ * Follows TCP connections between other hosts, as seen on a mirror port,
+ * and hands each direction to the parser registered for the server port
+ * as an in-order byte stream. Only the first tcp_stream_depth bytes of a
+ * direction are followed, and a direction is let go as soon as it hits a
+ * gap it cannot fill, a FIN, or its parser has had enough, so most of the
+ * traffic costs a lookup in a port table and nothing more.
+ */
+
+static ss_tcp_stream_table_t tcp_stream_tables[RTE_MAX_LCORE];
+
+static ss_tcp_stream_parser_t tcp_stream_parsers[SS_TCP_STREAM_PARSERS_MAX];
+static int tcp_stream_parser_count;
+
+// 1 + the parser index for each port, 0 for ports nobody parses
+static uint8_t tcp_stream_ports[UINT16_MAX + 1];
+
+static int ss_tcp_stream_dns(ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_tcp_half_t* half = &stream->halves[dir];
+
+    return ss_tcp_extract_dns(&half->state.dns, &half->buffer, rx_buf, data, length);
+}
+
+/*
+ * Gathers the head of the first request of a connection, at most
+ * SS_HTTP_HEAD_MAX bytes, and lets the connection go once it is parsed;
+ * what the server sends is never looked at.
+ */
+static int ss_tcp_stream_http(ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir, ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_tcp_half_t* half = &stream->halves[dir];
+    uint16_t count;
+    int head_length;
+
+    if (dir == SS_TCP_STREAM_SERVER) return -1;
+
+    // usually the whole head is in the first segment, so parse it in place
+    if (half->buffer.length == 0) {
+        head_length = ss_http_head_length(data, length);
+        if (head_length > 0) {
+            ss_extract_http(rx_buf, data, (uint16_t) head_length);
+            return -1;
+        }
+        if (head_length < 0) return -1;
+    }
+
+    count = (uint16_t) SS_MIN(length, SS_HTTP_HEAD_MAX - half->buffer.length);
+    if (ss_tcp_buffer_append(&half->buffer, data, count) < count) return -1;
+    data        = ss_tcp_buffer_data(&half->buffer);
+    head_length = ss_http_head_length(data, half->buffer.length);
+    if (head_length > 0) {
+        ss_extract_http(rx_buf, data, (uint16_t) head_length);
+        return -1;
+    }
+    if (head_length < 0 || half->buffer.length >= SS_HTTP_HEAD_MAX) return -1;
+    return 0;
+}
+
+/* only at startup, before the lcores run */
+int ss_tcp_stream_parser_register(const char* name, uint16_t port, ss_tcp_stream_cb parse_cb) {
+    if (tcp_stream_parser_count == SS_TCP_STREAM_PARSERS_MAX || tcp_stream_ports[port]) {
+        RTE_LOG(ERR, L3L4, "could not register tcp stream parser %s for port %hu\n", name, port);
+        return -1;
+    }
+
+    tcp_stream_parsers[tcp_stream_parser_count] = (ss_tcp_stream_parser_t) { name, port, parse_cb };
+    tcp_stream_ports[port] = (uint8_t) ++tcp_stream_parser_count;
+    RTE_LOG(NOTICE, L3L4, "tcp stream parser %s for port %hu\n", name, port);
+    return 0;
+}
+
+static rte_hash_t* ss_tcp_stream_hash_create(const char* prefix, unsigned int lcore_id, uint32_t key_len) {
+    char hash_name[32];
+    struct rte_hash_parameters hash_params = {
+        .name               = hash_name,
+        .entries            = ss_conf->tcp_stream_entries,
+        .bucket_entries     = L4_TCP_BUCKET_SIZE,
+        .key_len            = key_len,
+        .hash_func          = rte_hash_crc,
+        .hash_func_init_val = 0,
+        .socket_id          = (int) rte_lcore_to_socket_id(lcore_id),
+    };
+
+    snprintf(hash_name, sizeof(hash_name), "%s_lcore_%02u", prefix, lcore_id);
+    return rte_hash_create(&hash_params);
+}
+
+/*
+ * Out of order segments of sockets and streams are held in mbufs of the RX
+ * pool of the socket, which each lcore on it shares. Lets them take half of
+ * it on the busiest socket at most, so RX never starves, by scaling both
+ * caps down alike when they ask for more.
+ */
+static void ss_tcp_stream_ooo_check() {
+    unsigned int lcore_id;
+    unsigned int lcore_counts[SOCKET_COUNT] = { 0 };
+    unsigned int lcores_max = 1;
+    uint32_t budget;
+    uint32_t total = ss_conf->tcp_ooo_max + ss_conf->tcp_stream_ooo_max;
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        unsigned int socket_id = rte_lcore_to_socket_id(lcore_id) % SOCKET_COUNT;
+        ++lcore_counts[socket_id];
+        lcores_max = SS_MAX(lcores_max, lcore_counts[socket_id]);
+    }
+    budget = MBUF_COUNT / 2 / lcores_max;
+    if (total <= budget) return;
+
+    ss_conf->tcp_ooo_max        = (uint32_t) ((uint64_t) ss_conf->tcp_ooo_max * budget / total);
+    ss_conf->tcp_stream_ooo_max = (uint32_t) ((uint64_t) ss_conf->tcp_stream_ooo_max * budget / total);
+    RTE_LOG(WARNING, L3L4, "tcp ooo_segments over %u per lcore for %u lcores per socket, scaled to %u sockets + %u streams\n",
+        budget, lcores_max, ss_conf->tcp_ooo_max, ss_conf->tcp_stream_ooo_max);
+}
+
+int ss_tcp_stream_init() {
+    unsigned int lcore_id;
+    char pool_name[32];
+    size_t streams_size = ss_conf->tcp_stream_entries * sizeof(ss_tcp_stream_t*);
+
+    ss_tcp_stream_ooo_check();
+
+    RTE_LCORE_FOREACH(lcore_id) {
+        ss_tcp_stream_table_t* table = &tcp_stream_tables[lcore_id];
+        int socket_id = (int) rte_lcore_to_socket_id(lcore_id);
+
+        // both address families share the pool, which caps the memory
+        snprintf(pool_name, sizeof(pool_name), "tcp_stream_pool_%02u", lcore_id);
+        table->pool     = rte_mempool_create(pool_name, ss_conf->tcp_stream_entries, sizeof(ss_tcp_stream_t),
+            0, 0, NULL, NULL, NULL, NULL, socket_id, MEMPOOL_F_SP_PUT | MEMPOOL_F_SC_GET);
+        table->hash4    = ss_tcp_stream_hash_create("stream4_hash", lcore_id, sizeof(ss_tcp_key4_t));
+        table->hash6    = ss_tcp_stream_hash_create("stream6_hash", lcore_id, sizeof(ss_tcp_key6_t));
+        table->streams4 = rte_zmalloc_socket("tcp4_streams", streams_size, RTE_CACHE_LINE_SIZE, socket_id);
+        table->streams6 = rte_zmalloc_socket("tcp6_streams", streams_size, RTE_CACHE_LINE_SIZE, socket_id);
+        if (table->pool == NULL || table->hash4 == NULL || table->hash6 == NULL ||
+            table->streams4 == NULL || table->streams6 == NULL) {
+            RTE_LOG(ERR, L3L4, "could not initialize tcp stream table for lcore %u\n", lcore_id);
+            return -1;
+        }
+        ss_wheel_init(&table->wheel, rte_get_tsc_hz(), rte_rdtsc());
+    }
+
+    if (ss_tcp_stream_parser_register("dns", L4_PORT_DNS, ss_tcp_stream_dns)) return -1;
+    if (ss_tcp_stream_parser_register("http", L4_PORT_HTTP, ss_tcp_stream_http)) return -1;
+
+    RTE_LOG(NOTICE, L3L4, "tcp stream tables of %u entries per lcore, depth %u bytes, %u ooo segments, idle timeout %u secs\n",
+        ss_conf->tcp_stream_entries, ss_conf->tcp_stream_depth, ss_conf->tcp_stream_ooo_max,
+        ss_conf->tcp_stream_idle_seconds);
+    return 0;
+}
+
+/*
+ * Fills in tcp_key with the lower endpoint first, and returns the hash
+ * and streams it goes in. swapped says if the source went second.
+ */
+static rte_hash_t* ss_tcp_stream_key_get(ss_tcp_stream_table_t* table, ss_flow_key_t* key, ss_tcp_key_t* tcp_key,
+    ss_tcp_stream_t*** streams, uint8_t* swapped) {
+    uint32_t alen = key->protocol == L4_TCP4 ? IPV4_ALEN : IPV6_ALEN;
+    int cmp = memcmp(key->sip, key->dip, alen);
+
+    *swapped = cmp > 0 || (cmp == 0 && key->sport > key->dport);
+    if (key->protocol == L4_TCP4) {
+        rte_memcpy(tcp_key->key4.sip, *swapped ? key->dip : key->sip, IPV4_ALEN);
+        rte_memcpy(tcp_key->key4.dip, *swapped ? key->sip : key->dip, IPV4_ALEN);
+        tcp_key->key4.sport = *swapped ? key->dport : key->sport;
+        tcp_key->key4.dport = *swapped ? key->sport : key->dport;
+        *streams = table->streams4;
+        return table->hash4;
+    }
+    rte_memcpy(tcp_key->key6.sip, *swapped ? key->dip : key->sip, IPV6_ALEN);
+    rte_memcpy(tcp_key->key6.dip, *swapped ? key->sip : key->dip, IPV6_ALEN);
+    tcp_key->key6.sport = *swapped ? key->dport : key->sport;
+    tcp_key->key6.dport = *swapped ? key->sport : key->dport;
+    *streams = table->streams6;
+    return table->hash6;
+}
+
+/* lets go of a direction: its queued mbufs, its buffer, and any more data */
+static void ss_tcp_stream_half_done(ss_tcp_stream_table_t* table, ss_tcp_half_t* half) {
+    for (int i = 0; i < half->ooo_count; ++i) rte_pktmbuf_free(half->ooo_segments[i].mbuf);
+    table->ooo_held -= half->ooo_count;
+    half->ooo_count  = 0;
+    ss_tcp_buffer_release(&half->buffer);
+    half->is_done    = 1;
+}
+
+/*
+ * The pool ran dry and this direction was the idle one whose partial
+ * message went, so it is let go; the stream goes once both are done.
+ * The other direction may be the one growing, so the stream stays put.
+ */
+static void ss_tcp_stream_evict(ss_tcp_buffer_t* buffer) {
+    ss_tcp_half_t* half = (ss_tcp_half_t*) ((uint8_t*) buffer - offsetof(ss_tcp_half_t, buffer));
+
+    ss_tcp_stream_half_done(&tcp_stream_tables[rte_lcore_id()], half);
+}
+
+static void ss_tcp_stream_release(ss_tcp_stream_table_t* table, ss_tcp_stream_t* stream) {
+    rte_hash_t* hash = stream->protocol == L4_TCP4 ? table->hash4 : table->hash6;
+    ss_tcp_stream_t** streams = stream->protocol == L4_TCP4 ? table->streams4 : table->streams6;
+
+    ss_tcp_stream_half_done(table, &stream->halves[SS_TCP_STREAM_CLIENT]);
+    ss_tcp_stream_half_done(table, &stream->halves[SS_TCP_STREAM_SERVER]);
+    ss_wheel_remove(&stream->timer);
+    rte_hash_del_key(hash, &stream->key);
+    streams[stream->id] = NULL;
+    rte_mempool_put(table->pool, stream);
+}
+
+/* streams are let go after tcp_stream_idle_seconds without a segment */
+static void ss_tcp_stream_expire(ss_wheel_timer_t* timer, void* data) {
+    ss_tcp_stream_t* stream = timer->data;
+    ss_tcp_stream_table_t* table = data;
+    uint64_t deadline = stream->rx_ticks + (uint64_t) ss_conf->tcp_stream_idle_seconds * rte_get_tsc_hz();
+
+    if (deadline > rte_rdtsc()) {
+        ss_wheel_add(&table->wheel, timer, deadline);
+        return;
+    }
+    ss_tcp_stream_release(table, stream);
+}
+
+int ss_tcp_stream_timer_callback(unsigned int lcore_id) {
+    ss_tcp_stream_table_t* table = &tcp_stream_tables[lcore_id];
+    int count;
+
+    if (table->pool == NULL) return 0;
+
+    count = ss_wheel_advance(&table->wheel, rte_rdtsc(), ss_tcp_stream_expire, table, SS_TCP_STREAM_EXPIRE_BUDGET);
+    if (count) {
+        RTE_LOG(DEBUG, L3L4, "checked %d idle tcp streams on lcore %u, %lu gaps, %lu not followed so far\n",
+            count, lcore_id, table->gaps, table->full);
+    }
+    return 0;
+}
+
+static ss_tcp_stream_t* ss_tcp_stream_create(ss_tcp_stream_table_t* table, rte_hash_t* hash, ss_tcp_stream_t** streams,
+    ss_tcp_key_t* tcp_key, uint8_t protocol, uint8_t parser) {
+    void* object;
+    ss_tcp_stream_t* stream;
+    int32_t stream_id;
+
+    if (rte_mempool_get(table->pool, &object) < 0) {
+        ++table->full;
+        return NULL;
+    }
+    stream_id = rte_hash_add_key(hash, tcp_key);
+    if (stream_id < 0) {
+        rte_mempool_put(table->pool, object);
+        ++table->full;
+        return NULL;
+    }
+
+    stream = object;
+    memset(stream, 0, sizeof(ss_tcp_stream_t));
+    rte_memcpy(&stream->key, tcp_key, sizeof(ss_tcp_key_t));
+    stream->id         = (uint64_t) stream_id;
+    stream->protocol   = protocol;
+    stream->parser     = parser;
+    stream->rx_ticks   = rte_rdtsc();
+    stream->timer.data = stream;
+    stream->halves[SS_TCP_STREAM_CLIENT].buffer.budget   = SS_TCP_BUDGET_STREAM;
+    stream->halves[SS_TCP_STREAM_SERVER].buffer.budget   = SS_TCP_BUDGET_STREAM;
+    stream->halves[SS_TCP_STREAM_CLIENT].buffer.evict_cb = ss_tcp_stream_evict;
+    stream->halves[SS_TCP_STREAM_SERVER].buffer.evict_cb = ss_tcp_stream_evict;
+    streams[stream_id] = stream;
+    ss_wheel_add(&table->wheel, &stream->timer,
+        stream->rx_ticks + (uint64_t) ss_conf->tcp_stream_idle_seconds * rte_get_tsc_hz());
+    return stream;
+}
+
+/* hands data to the parser, up to the depth of the direction */
+static void ss_tcp_stream_deliver(ss_tcp_stream_table_t* table, ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir,
+    ss_frame_t* rx_buf, uint8_t* data, uint16_t length) {
+    ss_tcp_half_t* half = &stream->halves[dir];
+    uint16_t count = (uint16_t) SS_MIN(length, ss_conf->tcp_stream_depth - half->depth);
+    int rv;
+
+    half->next_seq += length;
+    half->depth    += count;
+    rv = tcp_stream_parsers[stream->parser].parse_cb(stream, dir, rx_buf, data, count);
+    if (rv < 0 || half->depth >= ss_conf->tcp_stream_depth) ss_tcp_stream_half_done(table, half);
+}
+
+/* delivers the queued segments which the direction has caught up with */
+static void ss_tcp_stream_drain(ss_tcp_stream_table_t* table, ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir,
+    ss_frame_t* rx_buf) {
+    ss_tcp_half_t* half = &stream->halves[dir];
+    ss_tcp_segment_t* segment = &half->ooo_segments[0];
+    rte_mbuf_t* mbuf;
+    int32_t overlap;
+
+    while (half->ooo_count && (int32_t) (segment->seq - half->next_seq) <= 0) {
+        overlap = (int32_t) (half->next_seq - segment->seq);
+        mbuf    = segment->mbuf;
+        if (overlap < segment->length) {
+            ss_tcp_stream_deliver(table, stream, dir, rx_buf,
+                segment->data + overlap, (uint16_t) (segment->length - overlap));
+        }
+        // delivery can end the direction, which frees the queue
+        if (half->is_done) return;
+        rte_pktmbuf_free(mbuf);
+        --table->ooo_held;
+        --half->ooo_count;
+        memmove(segment, segment + 1, half->ooo_count * sizeof(ss_tcp_segment_t));
+    }
+}
+
+/* holds a segment past a gap; returns -1 if there is no room for it */
+static int ss_tcp_stream_queue(ss_tcp_stream_table_t* table, ss_tcp_half_t* half, ss_frame_t* rx_buf,
+    uint32_t seq, uint8_t* data, uint16_t length) {
+    int i;
+
+    if (half->ooo_count == SS_TCP_STREAM_OOO_SEGMENTS || table->ooo_held >= ss_conf->tcp_stream_ooo_max) return -1;
+
+    for (i = 0; i < half->ooo_count && (int32_t) (half->ooo_segments[i].seq - seq) <= 0; ++i) {
+        if (half->ooo_segments[i].seq == seq && half->ooo_segments[i].length >= length) return 0;
+    }
+    memmove(&half->ooo_segments[i + 1], &half->ooo_segments[i],
+        (size_t) (half->ooo_count - i) * sizeof(ss_tcp_segment_t));
+    rte_mbuf_refcnt_update(rx_buf->mbuf, 1);
+    half->ooo_segments[i] = (ss_tcp_segment_t) { rx_buf->mbuf, data, seq, length };
+    ++half->ooo_count;
+    ++table->ooo_held;
+    return 0;
+}
+
+static void ss_tcp_stream_receive(ss_tcp_stream_table_t* table, ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir,
+    ss_frame_t* rx_buf, uint32_t seq) {
+    ss_tcp_half_t* half = &stream->halves[dir];
+    uint8_t* data   = rx_buf->l4_offset;
+    uint16_t length = rx_buf->data.l4_length;
+    int32_t overlap;
+
+    if (half->is_done || length == 0) return;
+    if (!half->has_seq) {
+        // the SYN-ACK went by unseen, so start with what is here
+        half->next_seq = seq;
+        half->has_seq  = 1;
+    }
+
+    overlap = (int32_t) (half->next_seq - seq);
+    if (overlap < 0) {
+        if (ss_tcp_stream_queue(table, half, rx_buf, seq, data, length)) {
+            // what is missing will not come back, so the framing is lost
+            RTE_LOG(DEBUG, L3L4, "tcp stream: let go of direction after gap, seq: %u expected: %u\n",
+                seq, half->next_seq);
+            ++table->gaps;
+            ss_tcp_stream_half_done(table, half);
+        }
+        return;
+    }
+    if (overlap >= length) return;
+
+    ss_tcp_stream_deliver(table, stream, dir, rx_buf, data + overlap, (uint16_t) (length - overlap));
+    if (!half->is_done) ss_tcp_stream_drain(table, stream, dir, rx_buf);
+}
+
+/*
+ * Follows a segment between other hosts. Streams are only made from a
+ * SYN to a port with a parser, so anything else costs one table lookup
+ * and one port check.
+ */
+int ss_tcp_stream_handle(ss_frame_t* rx_buf, ss_flow_key_t* key, uint32_t seq, uint8_t tcp_flags) {
+    unsigned int lcore_id = rte_lcore_id();
+    ss_tcp_stream_table_t* table;
+    ss_tcp_stream_t** streams;
+    ss_tcp_stream_t* stream;
+    ss_tcp_stream_dir_t dir;
+    ss_tcp_key_t tcp_key;
+    rte_hash_t* hash;
+    uint8_t swapped;
+    int32_t stream_id;
+
+    if (lcore_id >= RTE_MAX_LCORE) return -1;
+    if (!tcp_stream_ports[rte_bswap16(key->sport)] && !tcp_stream_ports[rte_bswap16(key->dport)]) return 0;
+
+    table     = &tcp_stream_tables[lcore_id];
+    hash      = ss_tcp_stream_key_get(table, key, &tcp_key, &streams, &swapped);
+    stream_id = rte_hash_lookup(hash, &tcp_key);
+    stream    = stream_id < 0 ? NULL : streams[stream_id];
+
+    if ((tcp_flags & (TH_SYN | TH_ACK)) == TH_SYN) {
+        uint8_t parser = tcp_stream_ports[rte_bswap16(key->dport)];
+
+        // a new connection on the same ports replaces the old one
+        if (stream) ss_tcp_stream_release(table, stream);
+        if (!parser) return 0;
+        stream = ss_tcp_stream_create(table, hash, streams, &tcp_key, key->protocol, (uint8_t) (parser - 1));
+        if (stream == NULL) return 0;
+        stream->client_swapped = swapped;
+        stream->halves[SS_TCP_STREAM_CLIENT].next_seq = seq + 1;
+        stream->halves[SS_TCP_STREAM_CLIENT].has_seq  = 1;
+        return 0;
+    }
+    if (stream == NULL) return 0;
+
+    dir = swapped == stream->client_swapped ? SS_TCP_STREAM_CLIENT : SS_TCP_STREAM_SERVER;
+    stream->rx_ticks = rte_rdtsc();
+
+    if (tcp_flags & TH_RST) {
+        ss_tcp_stream_release(table, stream);
+        return 0;
+    }
+    if (tcp_flags & TH_SYN) {
+        // the SYN-ACK; its ISN takes up one sequence number
+        stream->halves[dir].next_seq = seq + 1;
+        stream->halves[dir].has_seq  = 1;
+        return 0;
+    }
+
+    ss_tcp_stream_receive(table, stream, dir, rx_buf, seq);
+    if (tcp_flags & TH_FIN) ss_tcp_stream_half_done(table, &stream->halves[dir]);
+
+    // nothing more to parse either way, so let go early
+    if (stream->halves[SS_TCP_STREAM_CLIENT].is_done && stream->halves[SS_TCP_STREAM_SERVER].is_done) {
+        ss_tcp_stream_release(table, stream);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef __TCP_STREAM_H__
+#define __TCP_STREAM_H__
+
+#include <stdint.h>
+
+#include <rte_hash.h>
+#include <rte_memory.h>
+#include <rte_mempool.h>
+
+#include "common.h"
+#include "tcp.h"
+#include "timer_wheel.h"
+
+/* CONSTANTS */
+
+#define SS_TCP_STREAM_ENTRIES       16384
+#define SS_TCP_STREAM_DEPTH         65536 /* bytes per direction handed to the parser */
+#define SS_TCP_STREAM_OOO_MAX         256 /* mbufs held per lcore across all streams */
+#define SS_TCP_STREAM_IDLE_SECONDS     60
+#define SS_TCP_STREAM_OOO_SEGMENTS      4 /* per direction */
+#define SS_TCP_STREAM_PARSERS_MAX      16
+#define SS_TCP_STREAM_EXPIRE_BUDGET  1024 /* most streams expired per timer call */
+
+enum ss_tcp_stream_dir_e {
+    SS_TCP_STREAM_CLIENT = 0, /* client to server */
+    SS_TCP_STREAM_SERVER = 1, /* server to client */
+};
+
+typedef enum ss_tcp_stream_dir_e ss_tcp_stream_dir_t;
+
+/* DATA TYPES */
+
+/* what a parser keeps between the segments of one direction */
+union ss_tcp_stream_state_u {
+    ss_dns_framing_t dns;
+};
+
+typedef union ss_tcp_stream_state_u ss_tcp_stream_state_t;
+
+/* one direction of a followed stream */
+struct ss_tcp_half_s {
+    uint32_t next_seq;
+    uint8_t  has_seq;
+    uint8_t  is_done;   /* FIN, depth, gap, or the parser had enough */
+    uint8_t  ooo_count;
+    uint32_t depth;     /* bytes handed to the parser */
+    ss_tcp_segment_t ooo_segments[SS_TCP_STREAM_OOO_SEGMENTS]; /* by seq */
+    ss_tcp_buffer_t buffer;
+    ss_tcp_stream_state_t state;
+};
+
+typedef struct ss_tcp_half_s ss_tcp_half_t;
+
+/*
+ * A TCP connection between other hosts, followed from its SYN in both
+ * directions. The key puts the lower endpoint first, so both directions
+ * find the same stream.
+ */
+struct ss_tcp_stream_s {
+    ss_tcp_key_t key;
+    uint64_t id;
+    uint8_t  protocol;
+    uint8_t  parser;         /* index of the parser for the server port */
+    uint8_t  client_swapped; /* the client is the second endpoint of key */
+    uint64_t rx_ticks;
+    ss_wheel_timer_t timer;
+    ss_tcp_half_t halves[2]; /* by ss_tcp_stream_dir_t */
+};
+
+typedef struct ss_tcp_stream_s ss_tcp_stream_t;
+
+/*
+ * Gets the next length bytes of one direction, in order and without
+ * overlaps. Returns -1 when it wants no more of that direction.
+ */
+typedef int (*ss_tcp_stream_cb)(ss_tcp_stream_t* stream, ss_tcp_stream_dir_t dir, ss_frame_t* rx_buf, uint8_t* data, uint16_t length);
+
+struct ss_tcp_stream_parser_s {
+    const char* name;
+    uint16_t port;
+    ss_tcp_stream_cb parse_cb;
+};
+
+typedef struct ss_tcp_stream_parser_s ss_tcp_stream_parser_t;
+
+/* the streams of one lcore; like the sockets, no other lcore sees them */
+struct ss_tcp_stream_table_s {
+    rte_hash_t* hash4;
+    rte_hash_t* hash6;
+    ss_tcp_stream_t** streams4;
+    ss_tcp_stream_t** streams6;
+    rte_mempool_t* pool;
+    ss_wheel_t wheel;
+    uint32_t ooo_held; /* mbufs held by the out of order queues */
+    uint64_t gaps;
+    uint64_t full;     /* streams not followed since the table was full */
+} __rte_cache_aligned;
+
+typedef struct ss_tcp_stream_table_s ss_tcp_stream_table_t;
+
+/* BEGIN PROTOTYPES */
+
+int ss_tcp_stream_parser_register(const char* name, uint16_t port, ss_tcp_stream_cb parse_cb);
+int ss_tcp_stream_init(void);
+int ss_tcp_stream_timer_callback(unsigned int lcore_id);
+int ss_tcp_stream_handle(ss_frame_t* rx_buf, ss_flow_key_t* key, uint32_t seq, uint8_t tcp_flags);
+
+/* END PROTOTYPES */
+
+#endif /* __TCP_STREAM_H__ */
@@ -0,0 +1,93 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <bsd/sys/queue.h>
+
+#include "timer_wheel.h"
+
+void ss_wheel_init(ss_wheel_t* wheel, uint64_t tick_cycles, uint64_t tsc) {
+    memset(wheel, 0, sizeof(*wheel));
+    for (int level = 0; level < SS_WHEEL_LEVELS; ++level) {
+        for (int slot = 0; slot < SS_WHEEL_SLOTS; ++slot) {
+            LIST_INIT(&wheel->slots[level][slot]);
+        }
+    }
+    LIST_INIT(&wheel->expired);
+    wheel->tick_cycles = tick_cycles;
+    wheel->now         = tsc / tick_cycles;
+}
+
+/* links timer into the slot for its expires tick, relative to now */
+static void ss_wheel_insert(ss_wheel_t* wheel, ss_wheel_timer_t* timer) {
+    uint64_t delta;
+    ss_wheel_list_t* list;
+
+    // a timer further out than the wheel reaches waits at the top, and
+    // comes back through the callback to be added again
+    if (timer->expires > wheel->now && timer->expires - wheel->now >= SS_WHEEL_SPAN) {
+        timer->expires = wheel->now + SS_WHEEL_SPAN - 1;
+    }
+
+    delta = timer->expires > wheel->now ? timer->expires - wheel->now : 0;
+    if (delta == 0) {
+        list = &wheel->expired;
+    }
+    else {
+        int level = 0;
+        while (delta >> (SS_WHEEL_BITS * (level + 1))) ++level;
+        list = &wheel->slots[level][(timer->expires >> (SS_WHEEL_BITS * level)) & SS_WHEEL_MASK];
+    }
+    LIST_INSERT_HEAD(list, timer, entry);
+    timer->is_pending = 1;
+}
+
+/* schedules timer for expires_tsc, or reschedules it if it is pending */
+void ss_wheel_add(ss_wheel_t* wheel, ss_wheel_timer_t* timer, uint64_t expires_tsc) {
+    ss_wheel_remove(timer);
+    timer->expires = (expires_tsc + wheel->tick_cycles - 1) / wheel->tick_cycles;
+    ss_wheel_insert(wheel, timer);
+}
+
+void ss_wheel_remove(ss_wheel_timer_t* timer) {
+    if (!timer->is_pending) return;
+    LIST_REMOVE(timer, entry);
+    timer->is_pending = 0;
+}
+
+/* moves the timers of one slot down a level, or to expired */
+static void ss_wheel_cascade(ss_wheel_t* wheel, ss_wheel_list_t* list) {
+    ss_wheel_timer_t* timer;
+
+    while ((timer = LIST_FIRST(list)) != NULL) {
+        LIST_REMOVE(timer, entry);
+        ss_wheel_insert(wheel, timer);
+    }
+}
+
+/*
+ * Moves the wheel up to tsc, then hands at most budget expired timers to
+ * wheel_cb, leaving the rest for the next call. Returns how many it did.
+ */
+int ss_wheel_advance(ss_wheel_t* wheel, uint64_t tsc, ss_wheel_cb wheel_cb, void* cb_data, int budget) {
+    uint64_t target = tsc / wheel->tick_cycles;
+    ss_wheel_timer_t* timer;
+    int count = 0;
+
+    while (wheel->now < target) {
+        ++wheel->now;
+        // when a level wraps, the next slot of the level above drops down
+        for (int level = SS_WHEEL_LEVELS - 1; level > 0; --level) {
+            if (wheel->now & ((1ULL << (SS_WHEEL_BITS * level)) - 1)) continue;
+            ss_wheel_cascade(wheel, &wheel->slots[level][(wheel->now >> (SS_WHEEL_BITS * level)) & SS_WHEEL_MASK]);
+        }
+        ss_wheel_cascade(wheel, &wheel->slots[0][wheel->now & SS_WHEEL_MASK]);
+    }
+
+    while (count < budget && (timer = LIST_FIRST(&wheel->expired)) != NULL) {
+        LIST_REMOVE(timer, entry);
+        timer->is_pending = 0;
+        wheel_cb(timer, cb_data);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,58 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdint.h>
+
+#include <bsd/sys/queue.h>
+
+/* CONSTANTS */
+
+#define SS_WHEEL_BITS        6
+#define SS_WHEEL_SLOTS       (1 << SS_WHEEL_BITS)
+#define SS_WHEEL_MASK        (SS_WHEEL_SLOTS - 1)
+#define SS_WHEEL_LEVELS      3 /* 64^3 ticks, three days of 1 second ticks */
+#define SS_WHEEL_SPAN        (1ULL << (SS_WHEEL_BITS * SS_WHEEL_LEVELS))
+
+/* DATA TYPES */
+
+/* goes inside whatever it times, and is only linked while pending */
+struct ss_wheel_timer_s {
+    uint64_t expires; /* in ticks */
+    void* data;
+    int is_pending;
+    LIST_ENTRY(ss_wheel_timer_s) entry;
+};
+
+typedef struct ss_wheel_timer_s ss_wheel_timer_t;
+
+LIST_HEAD(ss_wheel_list_s, ss_wheel_timer_s);
+typedef struct ss_wheel_list_s ss_wheel_list_t;
+
+/*
+ * A hierarchical timing wheel: level 0 has a slot per tick, and each level
+ * above a slot per 64 slots of the one below, which drop a level as their
+ * turn comes. Adding, removing and expiring a timer cost O(1), and a
+ * timer is moved at most once per level, whatever the number of timers.
+ */
+struct ss_wheel_s {
+    uint64_t tick_cycles; /* TSC cycles per tick */
+    uint64_t now;         /* the last tick processed */
+    ss_wheel_list_t slots[SS_WHEEL_LEVELS][SS_WHEEL_SLOTS];
+    ss_wheel_list_t expired; /* due, but past the budget of the last advance */
+};
+
+typedef struct ss_wheel_s ss_wheel_t;
+
+/* gets each expired timer, already unlinked, so it may add it again */
+typedef void (*ss_wheel_cb)(ss_wheel_timer_t* timer, void* data);
+
+/* BEGIN PROTOTYPES */
+
+void ss_wheel_init(ss_wheel_t* wheel, uint64_t tick_cycles, uint64_t tsc);
+void ss_wheel_add(ss_wheel_t* wheel, ss_wheel_timer_t* timer, uint64_t expires_tsc);
+void ss_wheel_remove(ss_wheel_timer_t* timer);
+int ss_wheel_advance(ss_wheel_t* wheel, uint64_t tsc, ss_wheel_cb wheel_cb, void* cb_data, int budget);
+
+/* END PROTOTYPES */
+
+#endif /* __TIMER_WHEEL_H__ */
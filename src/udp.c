@@ -30,10 +30,17 @@ int ss_frame_handle_udp(ss_frame_t* rx_buf, ss_frame_t* tx_buf) {
     RTE_LOG(DEBUG, L3L4, "rx udp packet: sport: %hu dport: %hu length: %hu\n",
         rx_buf->data.sport, rx_buf->data.dport, rx_buf->data.l4_length);
     
+    /* responses come back from port 53, for passive dns and latency */
+    if (rx_buf->data.sport == L4_PORT_DNS && rx_buf->data.dport != L4_PORT_DNS) {
+        RTE_LOG(DEBUG, L3L4, "rx udp dns response packet\n");
+        ss_extract_dns(rx_buf, rx_buf->l4_offset, rx_buf->data.l4_length);
+        return rv;
+    }
+    
     switch (rx_buf->data.dport) {
         case L4_PORT_DNS: {
             RTE_LOG(DEBUG, L3L4, "rx udp dns packet\n");
-            ss_extract_dns(rx_buf);
+            ss_extract_dns(rx_buf, rx_buf->l4_offset, rx_buf->data.l4_length);
             break;
         }
         case L4_PORT_SYSLOG: {